@@ -141,11 +141,13 @@ class EventObject:
 
 
 class FunctionObject:
-    def __init__(self, name, id, request_params, response_params):
+    def __init__(self, name, id, request_params, response_params, request_stream=False, response_stream=False):
         self.name = name
         self.id = id
         self.request_params = request_params
         self.response_params = response_params
+        self.request_stream = request_stream
+        self.response_stream = response_stream
 
     def get_name(self):
         return self.name
@@ -159,6 +161,12 @@ class FunctionObject:
     def get_response_params(self):
         return self.response_params
 
+    def get_request_stream(self):
+        return self.request_stream
+
+    def get_response_stream(self):
+        return self.response_stream
+
 
 class ServiceObject:
     def __init__(self, namespace, serviceId, name, types, enums, structs, functions, events):
@@ -116,7 +116,7 @@ def get_scoped_typename(namespaced_type):
 
 
 def get_message_flags_func(func):
-    if len(func.get_response_params()) == 0:
+    if len(func.get_response_params()) == 0 and not func.get_response_stream():
         return "MESSAGE_FLAG_ASYNC"
     return "MESSAGE_FLAG_SYNC"
 
@@ -220,6 +220,24 @@ def get_server_service_response_name(service: ServiceObject, func):
     return service.get_namespace() + "_" + service.get_name() + "_" + func.get_name() + "_response"
 
 
+def get_client_chunk_callback_name(service: ServiceObject, func):
+    return service.get_namespace() + "_" + service.get_name() + "_" + func.get_name() + "_chunk_invocation"
+
+
+def get_server_chunk_callback_name(service: ServiceObject, func):
+    return service.get_namespace() + "_" + service.get_name() + "_" + func.get_name() + "_chunk_invocation"
+
+
+def get_client_chunk_internal_name(service: ServiceObject, func):
+    return f"__{service.get_namespace()}_{service.get_name()}_{func.get_name()}_chunk_internal"
+
+
+# Functions with streamed responses are delivered to the client chunk by chunk, through callbacks
+# registered in the client protocol next to the events
+def get_stream_functions(service: ServiceObject):
+    return [func for func in service.get_functions() if func.get_response_stream()]
+
+
 def get_service_callback_name(service: ServiceObject, cb):
     return service.get_namespace() + "_" + service.get_name() + "_" + cb.get_name() + "_invocation"
 
@@ -310,6 +328,13 @@ def define_shared_ids(service: ServiceObject, outfile: CodeWriter):
     return
 
 
+# Arrays of value types in requests can be moved to shared memory by the client, if the
+# link supports passing it to the server
+def is_bulk_param(service: ServiceObject, member):
+    typename = member.get_typename()
+    return member.get_is_variable() and typename.lower() != "string" and not service.typename_is_struct(typename)
+
+
 def write_variable_count(members, outfile: CodeWriter):
     needs_count = False
     for member in members:
@@ -335,9 +360,36 @@ def write_variable_struct_member_serializer(service: ServiceObject, member, outf
         print("error: variable string arrays are not supported at this moment for the C-code generator")
         exit(-1)
     else:
+        outfile.writeln(f"if (in->{name}_count && !serialize_reserve(buffer, sizeof({get_c_typename(service, typename)}) * in->{name}_count)) {{")
+        outfile.indent_inc()
         outfile.writeln(
             f"memcpy(&buffer->data[buffer->index], &in->{name}[0], sizeof({get_c_typename(service, typename)}) * in->{name}_count);")
         outfile.writeln(f"buffer->index += sizeof({get_c_typename(service, typename)}) * in->{name}_count;")
+        outfile.indent_dec()
+        outfile.writeln("}")
+
+
+def write_variable_member_bulk_serializer(service: ServiceObject, member, outfile: CodeWriter):
+    name = member.get_name()
+    c_typename = get_c_typename(service, member.get_typename())
+    outfile.writeln(f"__bulk = {name}_count ? gracht_client_attach_bulk(client, &__buffer, &{name}[0], sizeof({c_typename}) * {name}_count) : -1;")
+    outfile.writeln("if (__bulk >= 0) {")
+    outfile.indent_inc()
+    outfile.writeln(f"serialize_uint32(&__buffer, {name}_count | GRACHT_BULK_FLAG);")
+    outfile.writeln("serialize_uint32(&__buffer, (uint32_t)__bulk);")
+    outfile.indent_dec()
+    outfile.writeln("}")
+    outfile.writeln("else {")
+    outfile.indent_inc()
+    outfile.writeln(f"serialize_uint32(&__buffer, {name}_count);")
+    outfile.writeln(f"if ({name}_count && !serialize_reserve(&__buffer, sizeof({c_typename}) * {name}_count)) {{")
+    outfile.indent_inc()
+    outfile.writeln(f"memcpy(&__buffer.data[__buffer.index], &{name}[0], sizeof({c_typename}) * {name}_count);")
+    outfile.writeln(f"__buffer.index += sizeof({c_typename}) * {name}_count;")
+    outfile.indent_dec()
+    outfile.writeln("}")
+    outfile.indent_dec()
+    outfile.writeln("}")
 
 
 def write_variable_member_serializer(service: ServiceObject, member, outfile: CodeWriter):
@@ -358,7 +410,7 @@ def write_variable_member_serializer(service: ServiceObject, member, outfile: Co
         outfile.indent_dec()
         outfile.writeln("}")
     else:
-        outfile.writeln(f"if ({name}_count) {{")
+        outfile.writeln(f"if ({name}_count && !serialize_reserve(&__buffer, sizeof({get_c_typename(service, typename)}) * {name}_count)) {{")
         outfile.indent_inc()
         outfile.writeln(
             f"memcpy(&__buffer.data[__buffer.index], &{name}[0], sizeof({get_c_typename(service, typename)}) * {name}_count);")
@@ -395,8 +447,10 @@ def write_struct_member_serializer(service: ServiceObject, prefix, struct, membe
         outfile.writeln(f"serialize_{member.get_typename()}(buffer, in->{prefix}{member.get_name()});")
 
 
-def write_member_serializer(service: ServiceObject, member, outfile: CodeWriter):
-    if member.get_is_variable():
+def write_member_serializer(service: ServiceObject, member, outfile: CodeWriter, bulk=False):
+    if bulk and is_bulk_param(service, member):
+        write_variable_member_bulk_serializer(service, member, outfile)
+    elif member.get_is_variable():
         write_variable_member_serializer(service, member, outfile)
     elif service.typename_is_struct(member.get_typename()):
         struct_type = service.lookup_struct(member.get_typename())
@@ -440,19 +494,36 @@ def write_variable_struct_member_deserializer(service: ServiceObject, member, ou
     outfile.writeln("}")
 
 
-def write_variable_member_deserializer2(service: ServiceObject, member, outfile: CodeWriter):
+def write_variable_member_deserializer2(service: ServiceObject, member, outfile: CodeWriter, bulk=False,
+                                        on_error=None):
     name = member.get_name()
     typename = member.get_typename()
     c_typename = get_c_typename(service, typename)
 
-    # get the count of elements to deserialize, and then allocate buffer space
+    # get the count of elements to deserialize, and then allocate buffer space. Arrays the
+    # client moved to shared memory are mapped instead
     outfile.writeln(f"{name}_count = deserialize_uint32(__buffer);")
-    outfile.writeln(f"if ({name}_count) {{")
+    if bulk:
+        outfile.writeln(f"if ({name}_count & GRACHT_BULK_FLAG) {{")
+        outfile.indent_inc()
+        outfile.writeln(f"{name}_count &= ~GRACHT_BULK_FLAG;")
+        outfile.writeln(f"{name} = ({c_typename}*)gracht_server_map_bulk(__message, deserialize_uint32(__buffer), sizeof({c_typename}) * {name}_count);")
+        outfile.writeln(f"if (!{name}) {{")
+        outfile.indent_inc()
+        write_deserializer_error(outfile, on_error, "errno")
+        outfile.indent_dec()
+        outfile.writeln("}")
+        outfile.writeln(f"{name}_bulk = 1;")
+        outfile.indent_dec()
+        outfile.writeln("}")
+        outfile.writeln(f"else if ({name}_count) {{")
+    else:
+        outfile.writeln(f"if ({name}_count) {{")
     outfile.indent_inc()
     outfile.writeln(f"{name} = malloc(sizeof({c_typename}) * {name}_count);")
     outfile.writeln(f"if (!{name}) {{")
     outfile.indent_inc()
-    outfile.writeln(f"return;\n")
+    write_deserializer_error(outfile, on_error, "ENOMEM")
     outfile.indent_dec()
     outfile.writeln("}")
     outfile.writeln("")
@@ -546,12 +617,21 @@ def write_struct_member_deserializer(service: ServiceObject, prefix, struct, mem
         outfile.writeln(f"out->{prefix}{name} = deserialize_{typename}(buffer);")
 
 
-def write_member_deserializer2(service: ServiceObject, member, outfile: CodeWriter):
+# Writes the handling of a member that could not be deserialized, on_error writes the cleanup of
+# the members deserialized before it and is given the errno value the deserialization failed with
+def write_deserializer_error(outfile: CodeWriter, on_error, error_code):
+    if on_error is not None:
+        on_error(error_code)
+    outfile.writeln("return;")
+
+
+def write_member_deserializer2(service: ServiceObject, member, outfile: CodeWriter, bulk=False, on_error=None):
     name = member.get_name()
     typename = member.get_typename()
 
     if member.get_is_variable():
-        write_variable_member_deserializer2(service, member, outfile)
+        write_variable_member_deserializer2(service, member, outfile, bulk and is_bulk_param(service, member),
+                                            on_error)
     elif typename.lower() == "string":
         outfile.writeln(f"{name} = deserialize_string_nocopy(__buffer);")
     elif service.typename_is_struct(typename):
@@ -585,9 +665,16 @@ def write_member_deserializer(service: ServiceObject, member, outfile: CodeWrite
         outfile.writeln(f"*{name}_out = deserialize_{typename}(&__buffer);")
 
 
-def write_function_body_prologue(service: ServiceObject, action_id, flags, params, is_server, outfile: CodeWriter):
+def write_function_body_prologue(service: ServiceObject, action_id, flags, params, is_server, outfile: CodeWriter,
+                                 response_params=None):
+    if response_params is not None:
+        outfile.writeln("struct gracht_message_context __context;")
     outfile.writeln("gracht_buffer_t __buffer;")
     outfile.writeln("int __status;")
+    if not is_server and any(is_bulk_param(service, param) for param in params):
+        outfile.writeln("int __bulk;")
+    if response_params is not None:
+        write_variable_count(response_params, outfile)
     outfile.writeln("")
 
     if is_server:
@@ -611,7 +698,7 @@ def write_function_body_prologue(service: ServiceObject, action_id, flags, param
     outfile.writeln(f"serialize_uint8(&__buffer, {str(flags)});")
 
     for param in params:
-        write_member_serializer(service, param, outfile)
+        write_member_serializer(service, param, outfile, not is_server)
 
 
 def write_function_body_epilogue(service: ServiceObject, func: FunctionObject, outfile: CodeWriter):
@@ -627,10 +714,37 @@ def define_function_body(service: ServiceObject, func: FunctionObject, outfile:
     return
 
 
+# The chunks and the end of a call with streamed parameters are sent with the id the call was
+# opened with
+def define_stream_body(service: ServiceObject, func: FunctionObject, flags, params, outfile: CodeWriter):
+    write_function_body_prologue(service, func.get_id(), flags, params, False, outfile)
+    outfile.write("__status = gracht_client_invoke_stream(client, context, &__buffer);\n")
+    write_function_body_epilogue(service, func, outfile)
+
+
+# The fused call sends the request, waits for the response and decodes it in place, without
+# the caller holding a context
+def define_call_sync_body(service: ServiceObject, func: FunctionObject, outfile: CodeWriter):
+    write_function_body_prologue(service, func.get_id(), get_message_flags_func(func), func.get_request_params(),
+                                 False, outfile, func.get_response_params())
+    outfile.writeln("__status = gracht_client_call_sync(client, &__context, &__buffer);")
+    outfile.writeln("if (__status != GRACHT_MESSAGE_COMPLETED) {")
+    outfile.writeln("    return __status;")
+    outfile.writeln("}")
+    outfile.writeln("")
+
+    if not func.get_response_stream():
+        for param in func.get_response_params():
+            write_member_deserializer(service, param, outfile)
+    outfile.writeln("__status = gracht_client_status_finalize(client, &__buffer);")
+    outfile.writeln("return __status;")
+
+
 def write_status_body_prologue(service: ServiceObject, func: FunctionObject, outfile: CodeWriter):
     outfile.writeln("gracht_buffer_t __buffer;")
     outfile.writeln("int __status;")
-    write_variable_count(func.get_response_params(), outfile)
+    if not func.get_response_stream():
+        write_variable_count(func.get_response_params(), outfile)
     outfile.writeln("")
 
     outfile.writeln("__status = gracht_client_get_status_buffer(client, context, &__buffer);")
@@ -639,6 +753,11 @@ def write_status_body_prologue(service: ServiceObject, func: FunctionObject, out
     outfile.writeln("}")
     outfile.writeln("")
 
+    # the return values of streamed responses have been delivered with the chunks, the
+    # final response only marks the end of the stream
+    if func.get_response_stream():
+        return
+
     # in the status body we must use string_copy versions as the buffer dissappears shortly after
     # deserialization. That unfortunately means all deserialization code that is not known before-hand
     # which situtation must use _copy code instead of _nocopy
@@ -671,9 +790,8 @@ def define_event_body_all(service: ServiceObject, evt, outfile: CodeWriter):
     write_function_body_epilogue(service, evt, outfile)
 
 
-def define_response_body(service: ServiceObject, func, flags, outfile: CodeWriter):
-    flags = "MESSAGE_FLAG_RESPONSE"
-    write_function_body_prologue(service, func.get_id(), flags, func.get_response_params(), True, outfile)
+def define_response_body(service: ServiceObject, func, flags, params, outfile: CodeWriter):
+    write_function_body_prologue(service, func.get_id(), flags, params, True, outfile)
     outfile.write("__status = gracht_server_respond(message, &__buffer);\n")
     write_function_body_epilogue(service, func, outfile)
 
@@ -704,7 +822,17 @@ def define_shared_serializers(service: ServiceObject, outfile: CodeWriter):
 
 #ifndef __GRACHT_SERVICE_SHARED_SERIALIZERS
 #define __GRACHT_SERVICE_SHARED_SERIALIZERS
+// The buffer is grown when it is full, anything that does not fit once it can not be
+// grown any further is skipped, and sending the message fails
+static inline int serialize_reserve(gracht_buffer_t* buffer, size_t length) {
+    if ((size_t)buffer->index + length <= buffer->capacity) {
+        return 0;
+    }
+    return gracht_buffer_grow(buffer, length);
+}
+
 #define SERIALIZE_VALUE(name, type) static inline void serialize_##name(gracht_buffer_t* buffer, type value) { \\
+                                        if (serialize_reserve(buffer, sizeof(type))) { return; } \\
                                         *((type*)&buffer->data[buffer->index]) = value; buffer->index += sizeof(type); \\
                                     }
 
@@ -728,6 +856,9 @@ def define_shared_serializers(service: ServiceObject, outfile: CodeWriter):
     outfile.writeln("""
 static inline void serialize_string(gracht_buffer_t* buffer, const char* string) {
     uint32_t length = string != NULL ? (uint32_t)strlen(string) : 0;
+    if (serialize_reserve(buffer, sizeof(uint32_t) + length + 1)) {
+        return;
+    }
     *((uint32_t*)&buffer->data[buffer->index]) = length;
     if (length == 0) {
         buffer->data[buffer->index + sizeof(uint32_t)] = 0;
@@ -1127,6 +1258,10 @@ GRACHTAPI int gracht_client_get_buffer(gracht_client_t*, gracht_buffer_t*);
 GRACHTAPI int gracht_client_get_status_buffer(gracht_client_t*, struct gracht_message_context*, gracht_buffer_t*);
 GRACHTAPI int gracht_client_status_finalize(gracht_client_t*, struct gracht_buffer*);
 GRACHTAPI int gracht_client_invoke(gracht_client_t*, struct gracht_message_context*, gracht_buffer_t*);
+GRACHTAPI int gracht_client_call_sync(gracht_client_t*, struct gracht_message_context*, gracht_buffer_t*);
+GRACHTAPI int gracht_client_open_stream(gracht_client_t*, struct gracht_message_context*);
+GRACHTAPI int gracht_client_invoke_stream(gracht_client_t*, struct gracht_message_context*, gracht_buffer_t*);
+GRACHTAPI int gracht_client_attach_bulk(gracht_client_t*, gracht_buffer_t*, const void* data, size_t length);
 """)
 
 
@@ -1134,25 +1269,33 @@ def write_server_api(service: ServiceObject, outfile: CodeWriter):
     outfile.writeln("""
 GRACHTAPI int gracht_server_get_buffer(gracht_server_t*, gracht_buffer_t*);
 GRACHTAPI int gracht_server_respond(struct gracht_message*, gracht_buffer_t*);
+GRACHTAPI int gracht_server_respond_error(struct gracht_message*, int errorCode);
 GRACHTAPI int gracht_server_send_event(gracht_server_t*, gracht_conn_t client, gracht_buffer_t*, unsigned int flags);
 GRACHTAPI int gracht_server_broadcast_event(gracht_server_t*, gracht_buffer_t*, unsigned int flags);
+GRACHTAPI const void* gracht_server_map_bulk(struct gracht_message*, uint32_t index, size_t length);
+GRACHTAPI int gracht_server_message_is_chunk(struct gracht_message*);
+GRACHTAPI void gracht_server_unmap_bulk(const void* data, size_t length);
 """)
 
 
 # Define the client callback array - this is the one that will be registered with the client
 # and handles the delegation of deserializing of incoming events.
 def write_client_callback_array(service: ServiceObject, outfile: CodeWriter):
-    if len(service.get_events()) == 0:
+    stream_funcs = get_stream_functions(service)
+    if len(service.get_events()) == 0 and len(stream_funcs) == 0:
         return
 
     # define the internal callback prototypes first
     for evt in service.get_events():
         write_client_deserializer_prototype(service, evt, outfile)
         outfile.write(";\n")
+    for func in stream_funcs:
+        write_client_chunk_deserializer_prototype(service, func, outfile)
+        outfile.write(";\n")
     outfile.write("\n")
 
     callback_array_name = service.get_namespace() + "_" + service.get_name() + "_callbacks"
-    callback_array_size = str(len(service.get_events()))
+    callback_array_size = str(len(service.get_events()) + len(stream_funcs))
     outfile.write("static gracht_protocol_function_t ")
     outfile.write(f"{callback_array_name}[{callback_array_size}] = ")
     outfile.write("{\n")
@@ -1163,6 +1306,13 @@ def write_client_callback_array(service: ServiceObject, outfile: CodeWriter):
         outfile.write("    { " + evt_definition + ", ")
         outfile.write(get_service_internal_callback_name(service, evt))
         outfile.write(" },\n")
+    for func in stream_funcs:
+        func_name = service.get_namespace().upper() + "_" \
+                    + service.get_name().upper() + "_" + func.get_name().upper()
+        func_definition = "SERVICE_" + func_name + "_ID"
+        outfile.write("    { " + func_definition + ", ")
+        outfile.write(get_client_chunk_internal_name(service, func))
+        outfile.write(" },\n")
     outfile.write("};\n\n")
 
     outfile.write(f"gracht_protocol_t {service.get_namespace()}_{service.get_name()}_client_protocol = ")
@@ -1172,13 +1322,15 @@ def write_client_callback_array(service: ServiceObject, outfile: CodeWriter):
 
 
 # Shared deserializer logic subunits
-def write_deserializer_prologue(service: ServiceObject, members, outfile: CodeWriter):
+def write_deserializer_prologue(service: ServiceObject, members, outfile: CodeWriter, bulk=False):
     # write definitions
     for param in members:
         star_modifier = ""
         default_value = ""
         if param.get_is_variable():
             outfile.writeln(f"uint32_t {param.get_name()}_count;")
+            if bulk and is_bulk_param(service, param):
+                outfile.writeln(f"int {param.get_name()}_bulk = 0;")
             star_modifier = "*"
             default_value = " = NULL"
         if param.get_typename().lower() == "string":
@@ -1209,7 +1361,7 @@ def write_deserializer_invocation_members(service: ServiceObject, members, outfi
             outfile.append(", ")
 
 
-def write_deserializer_destroy_members(service: ServiceObject, members, outfile: CodeWriter):
+def write_deserializer_destroy_members(service: ServiceObject, members, outfile: CodeWriter, bulk=False):
     for member in members:
         if service.typename_is_struct(member.get_typename()):
             struct_type = service.lookup_struct(member.get_typename())
@@ -1223,7 +1375,19 @@ def write_deserializer_destroy_members(service: ServiceObject, members, outfile:
             if member.get_is_variable():
                 outfile.indent_dec()
                 outfile.writeln("}")
-        if member.get_is_variable():
+        if bulk and is_bulk_param(service, member):
+            c_typename = get_c_typename(service, member.get_typename())
+            outfile.writeln(f"if ({member.get_name()}_bulk) {{")
+            outfile.indent_inc()
+            outfile.writeln(f"gracht_server_unmap_bulk({member.get_name()}, sizeof({c_typename}) * {member.get_name()}_count);")
+            outfile.indent_dec()
+            outfile.writeln("}")
+            outfile.writeln("else {")
+            outfile.indent_inc()
+            outfile.writeln(f"free({member.get_name()});")
+            outfile.indent_dec()
+            outfile.writeln("}")
+        elif member.get_is_variable():
             outfile.writeln(f"free({member.get_name()});")
 
 
@@ -1234,6 +1398,8 @@ def write_deserializer_destroy_members(service: ServiceObject, members, outfile:
 def write_client_deserializers(service: ServiceObject, outfile):
     for evt in service.get_events():
         write_client_deserializer(service, evt, outfile)
+    for func in get_stream_functions(service):
+        write_client_chunk_deserializer(service, func, outfile)
 
 
 def write_client_deserializer(service: ServiceObject, evt: EventObject, outfile):
@@ -1255,8 +1421,11 @@ def write_client_deserializer_body(service: ServiceObject, evt: EventObject, out
     write_deserializer_prologue(service, evt.get_params(), outfile)
 
     # write deserializer calls
-    for param in evt.get_params():
-        write_member_deserializer2(service, param, outfile)
+    params = evt.get_params()
+    for index, param in enumerate(params):
+        write_member_deserializer2(service, param, outfile,
+                                   on_error=lambda _, done=params[:index]:
+                                   write_deserializer_destroy_members(service, done, outfile))
 
     # write invocation line
     outfile.write(f"{get_client_event_callback_name(service, evt)}(__client")
@@ -1270,6 +1439,41 @@ def write_client_deserializer_body(service: ServiceObject, evt: EventObject, out
     outfile.writeln("")
 
 
+# The chunks of a streamed response are deserialized like events, but the callback is also
+# given the context of the call, so the chunks can be matched with the call they belong to
+def write_client_chunk_deserializer(service: ServiceObject, func: FunctionObject, outfile):
+    write_client_chunk_deserializer_prototype(service, func, outfile)
+    outfile.write("\n")
+    write_client_chunk_deserializer_body(service, func, outfile)
+
+
+def write_client_chunk_deserializer_prototype(service: ServiceObject, func: FunctionObject, outfile):
+    outfile.write(
+        f"void {get_client_chunk_internal_name(service, func)}(gracht_client_t* __client, "
+        "struct gracht_message_context* __context, gracht_buffer_t* __buffer)")
+
+
+def write_client_chunk_deserializer_body(service: ServiceObject, func: FunctionObject, outfile: CodeWriter):
+    outfile.writeln("{")
+    outfile.indent_inc()
+
+    params = func.get_response_params()
+    write_deserializer_prologue(service, params, outfile)
+    for index, param in enumerate(params):
+        write_member_deserializer2(service, param, outfile,
+                                   on_error=lambda _, done=params[:index]:
+                                   write_deserializer_destroy_members(service, done, outfile))
+
+    outfile.write(f"{get_client_chunk_callback_name(service, func)}(__client, __context")
+    write_deserializer_invocation_members(service, func.get_response_params(), outfile)
+    outfile.append(");\n")
+
+    write_deserializer_destroy_members(service, func.get_response_params(), outfile)
+    outfile.indent_dec()
+    outfile.writeln("}")
+    outfile.writeln("")
+
+
 # Define the server callback array - this is the one that will be registered with the server
 # and handles the delegation of deserializing of incoming calls.
 def write_server_callback_array(service: ServiceObject, outfile):
@@ -1322,64 +1526,120 @@ def write_server_deserializer_prototype(service: ServiceObject, func: FunctionOb
         f"void {get_service_internal_callback_name(service, func)}(struct gracht_message* __message, gracht_buffer_t* __buffer)")
 
 
+def write_server_deserializer_error(service: ServiceObject, members, outfile: CodeWriter, error_code):
+    outfile.writeln(f"gracht_server_respond_error(__message, {error_code});")
+    write_deserializer_destroy_members(service, members, outfile, True)
+
+
 def write_server_deserializer_body(service: ServiceObject, func: FunctionObject, outfile):
     outfile.writeln("{")
     outfile.indent_inc()
 
     # write pre-definition
-    write_deserializer_prologue(service, func.get_request_params(), outfile)
+    write_deserializer_prologue(service, func.get_request_params(), outfile, True)
 
-    # write deserializer calls
-    for param in func.get_request_params():
-        write_member_deserializer2(service, param, outfile)
+    # the end of a call with streamed parameters carries no parameters
+    if func.get_request_stream():
+        outfile.writeln("if (!gracht_server_message_is_chunk(__message)) {")
+        outfile.writeln(f"    {get_service_callback_name(service, func)}(__message);")
+        outfile.writeln("    return;")
+        outfile.writeln("}")
+        outfile.writeln("")
+
+    # write deserializer calls, a message that can not be deserialized fails the call, so the
+    # client is not left waiting for a response
+    params = func.get_request_params()
+    for index, param in enumerate(params):
+        write_member_deserializer2(service, param, outfile, True,
+                                   lambda code, done=params[:index]:
+                                   write_server_deserializer_error(service, done, outfile, code))
 
     # write invocation line
-    outfile.write(f"{get_service_callback_name(service, func)}(__message")
+    if func.get_request_stream():
+        outfile.write(f"{get_server_chunk_callback_name(service, func)}(__message")
+    else:
+        outfile.write(f"{get_service_callback_name(service, func)}(__message")
     write_deserializer_invocation_members(service, func.get_request_params(), outfile)
     outfile.append(");\n")
 
     # write destroy calls
-    write_deserializer_destroy_members(service, func.get_request_params(), outfile)
+    write_deserializer_destroy_members(service, func.get_request_params(), outfile, True)
     outfile.indent_dec()
     outfile.writeln("}")
     outfile.writeln("")
 
 
 class CGenerator:
-    def get_server_callback_prototype(self, service, func):
-        function_prototype = "void " + get_service_callback_name(service, func) + "("
+    def get_server_callback_prototype(self, service, func, name=None, params=None):
+        if name is None:
+            name = get_service_callback_name(service, func)
+        if params is None:
+            params = func.get_request_params()
+        function_prototype = "void " + name + "("
         function_message_param = get_param_typename(service, VariableObject("struct gracht_message*", "message", False),
                                                     CONST.TYPENAME_CASE_FUNCTION_CALL, False)
         parameter_string = function_message_param
-        if len(func.get_request_params()) > 0:
-            parameter_string = parameter_string + ", " + get_parameter_string(service, func.get_request_params(),
+        if len(params) > 0:
+            parameter_string = parameter_string + ", " + get_parameter_string(service, params,
                                                                               CONST.TYPENAME_CASE_FUNCTION_CALL, False)
         return function_prototype + parameter_string + ")"
 
-    def get_response_prototype(self, service, func, case):
-        function_prototype = "int " + get_server_service_response_name(service, func) + "("
+    # Streamed parameters are received as any number of chunks, followed by the end of the call
+    def get_server_callback_prototypes(self, service, func):
+        if func.get_request_stream():
+            return [self.get_server_callback_prototype(service, func, get_server_chunk_callback_name(service, func)),
+                    self.get_server_callback_prototype(service, func, params=[])]
+        return [self.get_server_callback_prototype(service, func)]
+
+    def get_response_prototype(self, service, func, case, suffix=""):
+        function_prototype = "int " + get_server_service_response_name(service, func) + suffix + "("
         function_message_param = get_param_typename(service, VariableObject("struct gracht_message*", "message", False),
                                                     case, False)
         parameter_string = function_message_param + ", "
         parameter_string = parameter_string + get_parameter_string(service, func.get_response_params(), case, True)
         return function_prototype + parameter_string + ")"
 
-    def get_function_prototype(self, service, func, case):
+    def get_response_end_prototype(self, service, func, case):
+        function_message_param = get_param_typename(service, VariableObject("struct gracht_message*", "message", False),
+                                                    case, False)
+        return "int " + get_server_service_response_name(service, func) + "_end(" + function_message_param + ")"
+
+    # Streamed responses are sent as any number of chunks, followed by the end of the stream
+    def get_response_prototypes(self, service, func):
+        case = CONST.TYPENAME_CASE_FUNCTION_RESPONSE
+        if func.get_response_stream():
+            return [self.get_response_prototype(service, func, case, "_chunk"),
+                    self.get_response_end_prototype(service, func, case)]
+        elif len(func.get_response_params()) > 0:
+            return [self.get_response_prototype(service, func, case)]
+        return []
+
+    def get_function_prototype(self, service, func, case, suffix="", params=None):
+        if params is None:
+            params = func.get_request_params()
         function_prototype = "int " + service.get_namespace().lower() + "_" \
-                             + service.get_name().lower() + "_" + func.get_name()
+                             + service.get_name().lower() + "_" + func.get_name() + suffix
         function_client_param = get_param_typename(service, VariableObject("gracht_client_t*", "client", False), case,
                                                    False)
         function_context_param = get_param_typename(service,
                                                     VariableObject("struct gracht_message_context*", "context", False),
                                                     case, False)
         function_prototype = function_prototype + "(" + function_client_param + ", " + function_context_param
-        input_parameters = get_parameter_string(service, func.get_request_params(), case, False)
+        input_parameters = get_parameter_string(service, params, case, False)
 
         if input_parameters != "":
             input_parameters = ", " + input_parameters
 
         return function_prototype + input_parameters + ")"
 
+    # Calls with streamed parameters are opened, then sent as any number of chunks and then ended
+    def get_function_prototypes(self, service, func, case):
+        if func.get_request_stream():
+            return [self.get_function_prototype(service, func, case, params=[]),
+                    self.get_function_prototype(service, func, case, "_chunk"),
+                    self.get_function_prototype(service, func, case, "_end", [])]
+        return [self.get_function_prototype(service, func, case)]
+
     def get_function_status_prototype(self, service, func):
         case = CONST.TYPENAME_CASE_FUNCTION_STATUS
         client_param = VariableObject("gracht_client_t*", "client", False)
@@ -1391,9 +1651,33 @@ class CGenerator:
         function_context_param = get_param_typename(service, context_param, case, False)
 
         function_prototype = function_prototype + "(" + function_client_param + ", " + function_context_param
+        if func.get_response_stream():
+            return function_prototype + ")"
         output_param_string = get_parameter_string(service, func.get_response_params(), case, True)
         return function_prototype + ", " + output_param_string + ")"
 
+    # The parameters of the request and the response are combined in the fused call, so it is
+    # only available when none of their names clash
+    def get_function_call_sync_prototype(self, service, func):
+        if func.get_request_stream() or (len(func.get_response_params()) == 0 and not func.get_response_stream()):
+            return None
+
+        input_parameters = get_parameter_string(service, func.get_request_params(),
+                                                CONST.TYPENAME_CASE_FUNCTION_CALL, False)
+        output_parameters = ""
+        if not func.get_response_stream():
+            output_parameters = get_parameter_string(service, func.get_response_params(),
+                                                     CONST.TYPENAME_CASE_FUNCTION_STATUS, True)
+        parameters = [p for p in [input_parameters, output_parameters] if p != ""]
+        names = [p.split(" ")[-1].lstrip("*") for p in ", ".join(parameters).split(", ") if p != ""]
+        if len(names) != len(set(names)):
+            return None
+
+        function_client_param = get_param_typename(service, VariableObject("gracht_client_t*", "client", False),
+                                                   CONST.TYPENAME_CASE_FUNCTION_CALL, False)
+        return "int " + service.get_namespace().lower() + "_" + service.get_name().lower() + "_" \
+               + func.get_name() + "_call_sync(" + ", ".join([function_client_param] + parameters) + ")"
+
     def define_prototypes(self, service, outfile):
         # This actually defines the client functions implementations, to support the subscribe/unsubscribe we must
         # generate two additional functions that have special ids
@@ -1401,14 +1685,17 @@ class CGenerator:
         self.define_client_unsubscribe_prototype(service, outfile)
 
         for func in service.get_functions():
-            outfile.write("    " +
-                          self.get_function_prototype(service, func, CONST.TYPENAME_CASE_FUNCTION_CALL) + ";\n")
-            if len(func.get_response_params()) > 0:
+            for prototype in self.get_function_prototypes(service, func, CONST.TYPENAME_CASE_FUNCTION_CALL):
+                outfile.write("    " + prototype + ";\n")
+            if len(func.get_response_params()) > 0 or func.get_response_stream():
                 outfile.write("    " + self.get_function_status_prototype(service, func) + ";\n")
+            call_sync_prototype = self.get_function_call_sync_prototype(service, func)
+            if call_sync_prototype is not None:
+                outfile.write("    " + call_sync_prototype + ";\n")
         outfile.write("\n")
 
     def define_client_service_extern(self, service, outfile):
-        if len(service.get_events()) == 0:
+        if len(service.get_events()) == 0 and len(get_stream_functions(service)) == 0:
             return
         outfile.write(
             f"    extern gracht_protocol_t {service.get_namespace()}_{service.get_name()}_client_protocol;\n\n")
@@ -1470,32 +1757,76 @@ class CGenerator:
         self.define_client_unsubscribe(service, outfile)
 
         for func in service.get_functions():
-            outfile.writeln(f"{self.get_function_prototype(service, func, CONST.TYPENAME_CASE_FUNCTION_CALL)} {{")
-            outfile.indent_inc()
-            define_function_body(service, func, outfile)
-            outfile.indent_dec()
-            outfile.writeln("}")
-            outfile.writeln("")
+            if func.get_request_stream():
+                self.define_client_stream_functions(service, func, outfile)
+            else:
+                outfile.writeln(f"{self.get_function_prototype(service, func, CONST.TYPENAME_CASE_FUNCTION_CALL)} {{")
+                outfile.indent_inc()
+                define_function_body(service, func, outfile)
+                outfile.indent_dec()
+                outfile.writeln("}")
+                outfile.writeln("")
 
-            if len(func.get_response_params()) > 0:
+            if len(func.get_response_params()) > 0 or func.get_response_stream():
                 outfile.writeln(f"{self.get_function_status_prototype(service, func)} {{")
                 outfile.indent_inc()
                 define_status_body(service, func, outfile)
                 outfile.indent_dec()
                 outfile.writeln("}")
                 outfile.writeln("")
-        return
 
-    def define_server_responses(self, service: ServiceObject, outfile: CodeWriter):
-        for func in service.get_functions():
-            if len(func.get_response_params()) > 0:
-                outfile.writeln(self.get_response_prototype(service, func, CONST.TYPENAME_CASE_FUNCTION_RESPONSE))
-                outfile.writeln("{")
+            call_sync_prototype = self.get_function_call_sync_prototype(service, func)
+            if call_sync_prototype is not None:
+                outfile.writeln(f"{call_sync_prototype} {{")
                 outfile.indent_inc()
-                define_response_body(service, func, "MESSAGE_FLAG_RESPONSE", outfile)
+                define_call_sync_body(service, func, outfile)
                 outfile.indent_dec()
                 outfile.writeln("}")
                 outfile.writeln("")
+        return
+
+    def define_client_stream_functions(self, service: ServiceObject, func, outfile: CodeWriter):
+        prototypes = self.get_function_prototypes(service, func, CONST.TYPENAME_CASE_FUNCTION_CALL)
+        outfile.writeln(f"{prototypes[0]} {{")
+        outfile.writeln("    return gracht_client_open_stream(client, context);")
+        outfile.writeln("}")
+        outfile.writeln("")
+
+        outfile.writeln(f"{prototypes[1]} {{")
+        outfile.indent_inc()
+        define_stream_body(service, func, "MESSAGE_FLAG_ASYNC | MESSAGE_FLAG_STREAM", func.get_request_params(), outfile)
+        outfile.indent_dec()
+        outfile.writeln("}")
+        outfile.writeln("")
+
+        outfile.writeln(f"{prototypes[2]} {{")
+        outfile.indent_inc()
+        define_stream_body(service, func, get_message_flags_func(func), [], outfile)
+        outfile.indent_dec()
+        outfile.writeln("}")
+        outfile.writeln("")
+
+    def define_server_response(self, service: ServiceObject, func, prototype, flags, params, outfile: CodeWriter):
+        outfile.writeln(prototype)
+        outfile.writeln("{")
+        outfile.indent_inc()
+        define_response_body(service, func, flags, params, outfile)
+        outfile.indent_dec()
+        outfile.writeln("}")
+        outfile.writeln("")
+
+    def define_server_responses(self, service: ServiceObject, outfile: CodeWriter):
+        case = CONST.TYPENAME_CASE_FUNCTION_RESPONSE
+        for func in service.get_functions():
+            if func.get_response_stream():
+                self.define_server_response(service, func, self.get_response_prototype(service, func, case, "_chunk"),
+                                            "MESSAGE_FLAG_RESPONSE | MESSAGE_FLAG_STREAM",
+                                            func.get_response_params(), outfile)
+                self.define_server_response(service, func, self.get_response_end_prototype(service, func, case),
+                                            "MESSAGE_FLAG_RESPONSE", [], outfile)
+            elif len(func.get_response_params()) > 0:
+                self.define_server_response(service, func, self.get_response_prototype(service, func, case),
+                                            "MESSAGE_FLAG_RESPONSE", func.get_response_params(), outfile)
 
     def define_events(self, service: ServiceObject, outfile: CodeWriter):
         for evt in service.get_events():
@@ -1517,12 +1848,11 @@ class CGenerator:
         return
 
     def write_server_callback(self, service: ServiceObject, func, outfile: CodeWriter):
-        outfile.write("    " + self.get_server_callback_prototype(service, func))
-        outfile.write(";\n")
+        for prototype in self.get_server_callback_prototypes(service, func):
+            outfile.write("    " + prototype + ";\n")
 
-        if len(func.get_response_params()) > 0:
-            outfile.write("    " + self.get_response_prototype(service, func, CONST.TYPENAME_CASE_FUNCTION_RESPONSE))
-            outfile.write(";\n")
+        for prototype in self.get_response_prototypes(service, func):
+            outfile.write("    " + prototype + ";\n")
         return
 
     def write_service_event_prototype(self, service, evt, outfile):
@@ -1532,6 +1862,12 @@ class CGenerator:
                                                             CONST.TYPENAME_CASE_FUNCTION_CALL) + ";\n")
         return
 
+    def get_client_chunk_callback_prototype(self, service, func):
+        prototype = "void " + get_client_chunk_callback_name(service, func) + "("
+        prototype = prototype + "gracht_client_t* client, struct gracht_message_context* context"
+        return prototype + ", " + get_parameter_string(service, func.get_response_params(),
+                                                       CONST.TYPENAME_CASE_FUNCTION_CALL, False) + ")"
+
     def get_client_callback_prototype(self, service, evt):
         prototype = "void " + get_client_event_callback_name(service, evt) + "("
         prototype = prototype + "gracht_client_t* client"
@@ -1548,10 +1884,8 @@ class CGenerator:
             outfile.write("     * message based on a message context.\n")
             outfile.write("     */\n")
             for func in service.get_functions():
-                if len(func.get_response_params()) > 0:
-                    outfile.write("    " + self.get_response_prototype(
-                        service, func, CONST.TYPENAME_CASE_FUNCTION_RESPONSE))
-                    outfile.write(";\n")
+                for prototype in self.get_response_prototypes(service, func):
+                    outfile.write("    " + prototype + ";\n")
             outfile.write("\n")
 
     def write_server_event_prototypes(self, service, outfile):
@@ -1564,7 +1898,7 @@ class CGenerator:
             outfile.write("\n")
         return
 
-    def write_callback_prototypes(self, service, callbacks, outfile):
+    def write_callback_prototypes(self, service, callbacks, outfile, client=False):
         if len(callbacks) > 0:
             outfile.write("    /**\n")
             outfile.write("     * Invocation callback prototypes that must be defined. These are the functions\n")
@@ -1573,8 +1907,11 @@ class CGenerator:
             for cb in callbacks:
                 if isinstance(cb, EventObject):
                     outfile.write("    " + self.get_client_callback_prototype(service, cb) + ";\n")
+                elif client:
+                    outfile.write("    " + self.get_client_chunk_callback_prototype(service, cb) + ";\n")
                 else:
-                    outfile.write("    " + self.get_server_callback_prototype(service, cb) + ";\n")
+                    for prototype in self.get_server_callback_prototypes(service, cb):
+                        outfile.write("    " + prototype + ";\n")
             outfile.write("\n")
 
     def generate_shared_header(self, service, directory):
@@ -1605,7 +1942,7 @@ class CGenerator:
             define_headers(["<gracht/client.h>"], cout)
             include_shared_header(service, cout)
             write_c_guard_start(cout)
-            self.write_callback_prototypes(service, service.get_events(), cout)
+            self.write_callback_prototypes(service, service.get_events() + get_stream_functions(service), cout, True)
             self.define_prototypes(service, cout)
             self.define_client_service_extern(service, cout)
             write_c_guard_end(cout)
@@ -1653,7 +1990,7 @@ class CGenerator:
             write_header(cout)
             define_headers([
                 "\"" + service.get_namespace() + "_" + service.get_name() + "_service_server.h\"",
-                "<string.h>", "<stdlib.h>"], cout)
+                "<errno.h>", "<string.h>", "<stdlib.h>"], cout)
             write_server_api(service, cout)
             write_server_callback_array(service, cout)
             write_server_deserializers(service, cout)
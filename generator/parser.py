@@ -38,6 +38,7 @@ class TOKENS(object):
     QUOTE = 20
     FROM = 21
     VARIANT = 22
+    STREAM = 23
 
 # convert token to string
 def token_to_string(token):
@@ -87,6 +88,8 @@ def token_to_string(token):
         return "FROM"
     elif token == TOKENS.VARIANT:
         return "VARIANT"
+    elif token == TOKENS.STREAM:
+        return "STREAM"
     return "UNKNOWN"
 
 class Token:
@@ -197,8 +200,10 @@ class ParseContext:
         self.events = []
         return
 
-    def create_function(self, function_id, name, request_params, response_params):
-        self.funcs.append(FunctionObject(name, function_id, request_params, response_params))
+    def create_function(self, function_id, name, request_params, response_params, request_stream=False,
+                        response_stream=False):
+        self.funcs.append(FunctionObject(name, function_id, request_params, response_params, request_stream,
+                                         response_stream))
         return
 
     def create_event(self, event_id, name, params):
@@ -299,6 +304,21 @@ def get_service_scope_syntax():
                                 TOKENS.COLON, TOKENS.LPARENTHESIS, -1, TOKENS.RPARENTHESIS,
                                 TOKENS.EQUAL, TOKENS.DIGIT, TOKENS.SEMICOLON],
 
+        # func <identifier>(EXPRESSION) : stream (EXPRESSION) = <DIGIT>;
+        ("sfunc", handle_func): [TOKENS.FUNC, TOKENS.IDENTIFIER, TOKENS.LPARENTHESIS, -1, TOKENS.RPARENTHESIS,
+                                 TOKENS.COLON, TOKENS.STREAM, TOKENS.LPARENTHESIS, -1, TOKENS.RPARENTHESIS,
+                                 TOKENS.EQUAL, TOKENS.DIGIT, TOKENS.SEMICOLON],
+
+        # func <identifier> stream (EXPRESSION) : (EXPRESSION) = <DIGIT>;
+        ("rfunc", handle_func): [TOKENS.FUNC, TOKENS.IDENTIFIER, TOKENS.STREAM, TOKENS.LPARENTHESIS, -1,
+                                 TOKENS.RPARENTHESIS, TOKENS.COLON, TOKENS.LPARENTHESIS, -1, TOKENS.RPARENTHESIS,
+                                 TOKENS.EQUAL, TOKENS.DIGIT, TOKENS.SEMICOLON],
+
+        # func <identifier> stream (EXPRESSION) : stream (EXPRESSION) = <DIGIT>;
+        ("rsfunc", handle_func): [TOKENS.FUNC, TOKENS.IDENTIFIER, TOKENS.STREAM, TOKENS.LPARENTHESIS, -1,
+                                  TOKENS.RPARENTHESIS, TOKENS.COLON, TOKENS.STREAM, TOKENS.LPARENTHESIS, -1,
+                                  TOKENS.RPARENTHESIS, TOKENS.EQUAL, TOKENS.DIGIT, TOKENS.SEMICOLON],
+
         # event <identifier> : (EXPRESSION) = <DIGIT>;
         ("vevent", handle_event): [TOKENS.EVENT, TOKENS.IDENTIFIER, TOKENS.COLON, TOKENS.LPARENTHESIS, -1,
                                    TOKENS.RPARENTHESIS, TOKENS.EQUAL, TOKENS.DIGIT, TOKENS.SEMICOLON],
@@ -364,7 +384,8 @@ def get_keywords():
         "func": TOKENS.FUNC,
         "event": TOKENS.EVENT,
         "from": TOKENS.FROM,
-        "variant": TOKENS.VARIANT
+        "variant": TOKENS.VARIANT,
+        "stream": TOKENS.STREAM
     }
     return keywords
 
@@ -516,6 +537,11 @@ def handle_func(context, tokens):
 
     tokens.pop(0)  # consume FUNC
     tokens.pop(0)  # consume IDENTIFIER
+
+    # the parameters are sent as a series of chunks, followed by the end of the call
+    requestStream = tokens[0].token_type() == TOKENS.STREAM
+    if requestStream:
+        tokens.pop(0)  # consume STREAM
     tokens.pop(0)  # consume LPARENTHESIS
 
     trace("parsing function parameters")
@@ -532,6 +558,11 @@ def handle_func(context, tokens):
     requestMembers = context.finish_members()
 
     tokens.pop(0)  # consume COLON
+
+    # the response is sent as a series of chunks that each carry the return values
+    responseStream = tokens[0].token_type() == TOKENS.STREAM
+    if responseStream:
+        tokens.pop(0)  # consume STREAM
     tokens.pop(0)  # consume LPARENTHESIS
 
     trace("parsing function return values")
@@ -552,7 +583,7 @@ def handle_func(context, tokens):
     tokens.pop(0)  # consume SEMICOLON
     responseMembers = context.finish_members()
 
-    context.create_function(actionId, name, requestMembers, responseMembers)
+    context.create_function(actionId, name, requestMembers, responseMembers, requestStream, responseStream)
 
 
 def handle_event(context, tokens):
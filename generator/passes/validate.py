@@ -51,6 +51,10 @@ def pass_validate(service: ServiceObject):
             raise ValueError(f"The id of function {func.get_name()} ({func.get_id()}) is already in use")
         if func.get_id() < 1 or func.get_id() > 255:
             raise ValueError(f"The id of function {func.get_name()} must be in range of 1..255")
+        if func.get_response_stream() and len(func.get_response_params()) == 0:
+            raise ValueError(f"The streamed response of function {func.get_name()} must have return values")
+        if func.get_request_stream() and len(func.get_request_params()) == 0:
+            raise ValueError(f"The streamed request of function {func.get_name()} must have parameters")
         ids_parsed.append(func.get_id())
     for evt in service.get_events():
         if evt.get_id() in ids_parsed:
@@ -23,6 +23,7 @@
 #ifndef __GRACHT_AIO_H__
 #define __GRACHT_AIO_H__
 
+#include "config.h"
 #include "gracht/types.h"
 
 #if defined(MOLLENOS)
@@ -32,15 +33,43 @@
 
 typedef struct ioset_event gracht_aio_event_t;
 #define GRACHT_AIO_EVENT_IN         IOSETIN
+#define GRACHT_AIO_EVENT_OUT        IOSETOUT
 #define GRACHT_AIO_EVENT_DISCONNECT IOSETCTL
 
 #define gracht_aio_create()                ioset(0)
 #define gracht_io_wait(aio, events, count) ioset_wait(aio, events, count, NULL)
+#define gracht_io_wait_timeout(aio, events, count, timeout) \
+    ioset_wait(aio, events, count, &(struct timespec) { .tv_sec = (timeout) / 1000, .tv_nsec = ((timeout) % 1000) * 1000000 })
 #define gracht_aio_destroy(aio)            close(aio)
 
+static int gracht_aio_modify(int aio, int iod, unsigned int events) {
+    struct ioset_event event = {
+        .events = events | IOSETCTL | IOSETLVT,
+        .data.iod = iod
+    };
+    return ioset_ctrl(aio, IOSET_MOD, iod, &event);
+}
+
 #define gracht_aio_event_handle(event)    (event)->data.iod
 #define gracht_aio_event_events(event) (event)->events
 
+#elif defined(__linux__) && defined(GRACHT_AIO_URING)
+#include "aio_uring.h"
+
+typedef struct epoll_event gracht_aio_event_t;
+#define GRACHT_AIO_EVENT_IN         EPOLLIN
+#define GRACHT_AIO_EVENT_OUT        EPOLLOUT
+#define GRACHT_AIO_EVENT_DISCONNECT EPOLLRDHUP
+
+#define gracht_aio_create()                                 gracht_uring_create()
+#define gracht_io_wait(aio, events, count)                  gracht_uring_wait(aio, events, count, -1)
+#define gracht_io_wait_timeout(aio, events, count, timeout) gracht_uring_wait(aio, events, count, timeout)
+#define gracht_aio_destroy(aio)                             gracht_uring_destroy(aio)
+#define gracht_aio_modify(aio, iod, events)                 gracht_uring_modify(aio, iod, events)
+
+#define gracht_aio_event_handle(event) (event)->data.fd
+#define gracht_aio_event_events(event) (event)->events
+
 #elif defined(__linux__)
 #include <unistd.h>
 #include <sys/epoll.h>
@@ -48,16 +77,29 @@ typedef struct ioset_event gracht_aio_event_t;
 
 typedef struct epoll_event gracht_aio_event_t;
 #define GRACHT_AIO_EVENT_IN         EPOLLIN
+#define GRACHT_AIO_EVENT_OUT        EPOLLOUT
 #define GRACHT_AIO_EVENT_DISCONNECT EPOLLRDHUP
 
 #define gracht_aio_create()                epoll_create1(0)
 #define gracht_io_wait(aio, events, count) epoll_wait(aio, events, count, -1);
+#define gracht_io_wait_timeout(aio, events, count, timeout) epoll_wait(aio, events, count, timeout)
 #define gracht_aio_destroy(aio)            close(aio)
 
+// Changes the events a handle added to the aio descriptor is listening for, disconnect
+// events are always listened for.
+static int gracht_aio_modify(int aio, int iod, unsigned int events) {
+    struct epoll_event event = {
+        .events = events | EPOLLRDHUP,
+        .data.fd = iod
+    };
+    return epoll_ctl(aio, EPOLL_CTL_MOD, iod, &event);
+}
+
 #define gracht_aio_event_handle(event) (event)->data.fd
 #define gracht_aio_event_events(event) (event)->events
 
 #elif defined(_WIN32)
+#include <errno.h>
 #include <windows.h>
 #include <stdlib.h>
 #include "logging.h"
@@ -75,6 +117,7 @@ typedef struct gracht_aio_win32_event {
 
 #define GRACHT_AIO_EVENT_IN         0x1
 #define GRACHT_AIO_EVENT_DISCONNECT 0x2
+#define GRACHT_AIO_EVENT_OUT        0x4
 
 static gracht_handle_t gracht_aio_create(void) {
     struct iocp_handle* iocp = malloc(sizeof(struct iocp_handle));
@@ -102,17 +145,17 @@ static int gracht_aio_destroy(gracht_handle_t aio) {
     return 0;
 }
 
-static int gracht_io_wait(gracht_handle_t aio, gracht_aio_event_t* events, int count)
+static int gracht_io_wait_timeout(gracht_handle_t aio, gracht_aio_event_t* events, int count, int timeout)
 {
     struct iocp_handle* iocp    = aio;
     OVERLAPPED* overlapped      = NULL;
     DWORD       bytesTransfered = 0;
     void*       context         = NULL;
     BOOL        status          = GetQueuedCompletionStatus(iocp->iocp,
-        &bytesTransfered, (PULONG_PTR)&context, &overlapped, INFINITE);
+        &bytesTransfered, (PULONG_PTR)&context, &overlapped, timeout < 0 ? INFINITE : (DWORD)timeout);
     if (overlapped == NULL) {
-        // something horrible failed
-        return -1;
+        // either the wait timed out, or something horrible failed
+        return GetLastError() == WAIT_TIMEOUT ? 0 : -1;
     }
 
     events[0].iod = (gracht_conn_t)(uintptr_t)context;
@@ -128,6 +171,18 @@ static int gracht_io_wait(gracht_handle_t aio, gracht_aio_event_t* events, int c
     return 1;
 }
 
+#define gracht_io_wait(aio, events, count) gracht_io_wait_timeout(aio, events, count, -1)
+
+// Completion ports deliver completions and not readiness, so there is no way to listen
+// for the socket becoming writable. Callers must fall back to blocking writes.
+static int gracht_aio_modify(gracht_handle_t aio, gracht_conn_t iod, unsigned int events) {
+    (void)aio;
+    (void)iod;
+    (void)events;
+    errno = ENOTSUP;
+    return -1;
+}
+
 #define gracht_aio_event_handle(event) (event)->iod
 #define gracht_aio_event_events(event) (event)->events
 #else
@@ -0,0 +1,74 @@
+/**
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Gracht io_uring Async IO Definitions
+ * - An aio backend for linux that is built on io_uring instead of epoll. Listening
+ *   sockets use multishot accept, and stream sockets use multishot recvmsg with a ring of
+ *   provided buffers, so the data is already received when the event is reported. The
+ *   accept and recv functions below hand out what was received. Other descriptors are
+ *   polled. Events are reported as epoll events, so the server does not need to know
+ *   which backend is in use.
+ */
+
+#ifndef __GRACHT_AIO_URING_H__
+#define __GRACHT_AIO_URING_H__
+
+#include <stddef.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+/**
+ * Creates a new io_uring instance, the returned descriptor is used as the aio handle.
+ * Requires linux 6.0 or newer for multishot recv and provided buffer rings.
+ */
+int  gracht_uring_create(void);
+void gracht_uring_destroy(int ring);
+
+/**
+ * Submits any queued requests and waits for events, a timeout of -1 waits forever.
+ * Returns the number of events stored, or -1 with errno set.
+ */
+int gracht_uring_wait(int ring, struct epoll_event* events, int count, int timeout);
+
+/**
+ * Adds a descriptor to the ring, it is listened on for EPOLLIN events. The way it is
+ * listened on depends on whether it is a listening socket, a stream socket or anything else.
+ */
+int gracht_uring_add(int ring, int iod);
+int gracht_uring_remove(int ring, int iod);
+int gracht_uring_modify(int ring, int iod, unsigned int events);
+
+/**
+ * Returns the next connection accepted on the listening socket, or -1 with errno set to
+ * EAGAIN if none are ready.
+ */
+int gracht_uring_accept(int ring, int iod, struct sockaddr* address, socklen_t* addressLength);
+
+/**
+ * Copies data received on the stream socket into the buffer. Returns the number of bytes
+ * copied, or -1 with errno set to EAGAIN if nothing has been received.
+ */
+long gracht_uring_recv(int ring, int iod, void* buffer, size_t length);
+
+/**
+ * Takes up to count of the descriptors passed over the stream socket, in the order they were
+ * received. Descriptors are queued as their data is received, so they are always available
+ * before the data they were sent with is handed out. Returns the number of descriptors stored.
+ */
+int gracht_uring_recv_fds(int ring, int iod, int* fds, int count);
+
+#endif // !__GRACHT_AIO_URING_H__
@@ -0,0 +1,82 @@
+/**
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Gracht Send Buffer Type Definitions & Structures
+ * - Messages are serialized into buffers of the maximum message size, which are grown
+ *   while a larger message is serialized, and shrunk back once it has been sent. This way
+ *   only messages that are sent in frames need the memory for their full size.
+ */
+
+#ifndef __GRACHT_BUFFER_H__
+#define __GRACHT_BUFFER_H__
+
+#include "gracht/types.h"
+
+// The header that precedes the data of a send buffer, it is moved along with the data
+// when the buffer is grown
+struct gracht_buffer_header {
+    void*    owner; // the pool entry of the buffer, if the pool keeps any
+    uint32_t size;  // the size the buffer starts out with
+};
+
+/**
+ * Allocates a send buffer of the given size.
+ *
+ * @param size  The size of the buffer, which is the maximum message size.
+ * @param owner The pool entry of the buffer, which can be retrieved from the data later.
+ * @return char* The data of the buffer, or NULL if it could not be allocated.
+ */
+char* gracht_buffer_create(uint32_t size, void* owner);
+
+/**
+ * Frees a send buffer that was allocated by gracht_buffer_create.
+ */
+void gracht_buffer_destroy(char* data);
+
+/**
+ * Retrieves the pool entry of the send buffer.
+ */
+void* gracht_buffer_owner(const char* data);
+
+/**
+ * Prepares the buffer descriptor for serializing a message into the send buffer.
+ *
+ * @param data   The data of the send buffer.
+ * @param limit  The buffer is never grown beyond this, which is the maximum transfer size.
+ * @param buffer The buffer descriptor that is handed to the serializers.
+ */
+void gracht_buffer_open(char* data, uint32_t limit, struct gracht_buffer* buffer);
+
+/**
+ * Shrinks the send buffer back to the size it started out with, once the message in
+ * it has been sent.
+ *
+ * @param buffer The buffer descriptor the message was serialized with.
+ * @return char* The data of the send buffer, which may have moved.
+ */
+char* gracht_buffer_close(struct gracht_buffer* buffer);
+
+/**
+ * Checks that the message was serialized completely.
+ *
+ * @param buffer The buffer descriptor the message was serialized with.
+ * @return int Returns 0 if the message can be sent, otherwise -1 and errno is set to EMSGSIZE if the
+ *             message was too large, or ENOMEM if the buffer could not be grown.
+ */
+int gracht_buffer_check(struct gracht_buffer* buffer);
+
+#endif // !__GRACHT_BUFFER_H__
@@ -28,7 +28,8 @@
 // forward declarations
 struct gracht_client;
 
-// Callback prototype
+// Callback prototypes
 typedef void (*client_invoke_t)(struct gracht_client*, gracht_buffer_t*);
+typedef void (*client_invoke_chunk_t)(struct gracht_client*, struct gracht_message_context*, gracht_buffer_t*);
 
 #endif // !__CLIENT_PRIVATE_H__
@@ -0,0 +1,73 @@
+/**
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Gracht Message Fragmentation Type Definitions & Structures
+ * - Messages larger than the maximum message size are split into frames, which are
+ *   messages of their own that each carry the next part of the original message, header
+ *   included. The receiver assembles the frames back into the original message.
+ */
+
+#ifndef __GRACHT_FRAGMENT_H__
+#define __GRACHT_FRAGMENT_H__
+
+#include "gracht/types.h"
+
+struct gracht_fragmenter {
+    const uint8_t* message;
+    uint32_t       length;
+    uint32_t       offset;
+    uint32_t       frame_size;
+};
+
+struct gracht_assembly {
+    uint8_t* data;
+    uint32_t length;
+    uint32_t offset;
+};
+
+/**
+ * @param fragmenter The fragmenter to initialize.
+ * @param message The complete serialized message that should be split.
+ * @param length The length of the message.
+ * @param frameSize The maximum size of each frame, must be larger than the message header.
+ */
+void gracht_fragmenter_init(struct gracht_fragmenter* fragmenter, const void* message, uint32_t length, uint32_t frameSize);
+
+/**
+ * Writes the next frame of the message into the buffer, which must be able to hold a frame.
+ * The index of the buffer is set to the length of the frame.
+ *
+ * @return int Returns 1 if a frame was written, or 0 if all frames have been written.
+ */
+int gracht_fragmenter_next(struct gracht_fragmenter* fragmenter, struct gracht_buffer* frame);
+
+/**
+ * @param frame The first frame of a message, marked with MESSAGE_FLAG_FRAGMENT_START.
+ * @return uint32_t The length of the complete message, or 0 if the frame is invalid.
+ */
+uint32_t gracht_assembly_length(const void* frame);
+
+/**
+ * Appends the part of the message in the frame. The data of the assembly must be
+ * allocated by the caller for the length returned by gracht_assembly_length.
+ *
+ * @return int Returns 1 if the message is complete, 0 if more frames are expected, or -1
+ *             with errno set to EPROTO if the frame does not belong to the message.
+ */
+int gracht_assembly_append(struct gracht_assembly* assembly, const void* frame);
+
+#endif // !__GRACHT_FRAGMENT_H__
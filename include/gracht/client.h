@@ -26,25 +26,51 @@
 #include "types.h"
 #include "link/link.h"
 
+#define GRACHT_DEFAULT_CALLS_IN_FLIGHT 1024
+
 typedef struct gracht_client_configuration {
     // Link operations, which can be filled by any link-implementation under <link/*>
     // these provide the underlying link implementation like a socket interface or a serial interface.
     struct gracht_link* link;
 
-    // <send_buffer>      if set, provides a buffer that the client should use for sending messages. The size of this
-    //                    buffer must be provided in max_message_size. This buffer is not freed upon calling gracht_client_shutdown
-    // <recv_buffer>      if set, provides a buffer that the client should use for receiving messages. The size of this
-    //                    buffer must be atleast twice of max_message_size. 
-    // <max_message_size> specifies the maximum message size that can be handled at once. If not set it defaults
-    //                    to GRACHT_DEFAULT_MESSAGE_SIZE as the default value.
+    // <send_buffer>       if set, provides a buffer that the client should use for sending messages. The buffer must be
+    //                     able to hold the largest message that is sent, which is at most max_transfer_size. This buffer
+    //                     is not freed upon calling gracht_client_shutdown. Threads take turns using it, if not set each
+    //                     thread that invokes at the same time gets a buffer of its own.
+    // <recv_buffer>       if set, provides a buffer that the client should use for receiving messages. The size of this
+    //                     buffer must be atleast twice of max_message_size. 
+    // <max_message_size>  specifies the maximum message size that can be handled at once. If not set it defaults
+    //                     to GRACHT_DEFAULT_MESSAGE_SIZE as the default value.
+    // <max_transfer_size> specifies the maximum size of messages that are larger than max_message_size, these are
+    //                     split into frames of max_message_size and assembled by the receiver. Defaults to
+    //                     GRACHT_DEFAULT_TRANSFER_SIZE.
+    // <max_calls_in_flight> specifies the number of calls that can await their response at once, this is rounded up
+    //                     to a power of two. A call holds on to its slot until the result has been retrieved, and calls
+    //                     with streamed parameters hold it from the moment they are opened. Defaults to
+    //                     GRACHT_DEFAULT_CALLS_IN_FLIGHT.
+    // <await_spin_us>     if set, threads awaiting with GRACHT_AWAIT_ASYNC spin for up to this many microseconds
+    //                     before they sleep, as long as awaits on the client usually complete within that time.
+    //                     This only pays off when another core is receiving the responses. Disabled by default.
     void*               send_buffer;
     void*               recv_buffer;
     int                 recv_buffer_size;
     int                 max_message_size;
+    int                 max_transfer_size;
+    int                 max_calls_in_flight;
+    int                 await_spin_us;
 } gracht_client_configuration_t;
 
 // Prototype declaration to hide implementation details.
 typedef struct gracht_client gracht_client_t;
+typedef struct gracht_client_cq gracht_client_cq_t;
+
+// A completed call that was added to a completion queue. The status is either GRACHT_MESSAGE_COMPLETED
+// or GRACHT_MESSAGE_ERROR, and the result of the call is retrieved with the *_result function as usual.
+struct gracht_client_completion {
+    struct gracht_message_context* context;
+    void*                          tag;
+    int                            status;
+};
 
 #ifdef __cplusplus
 extern "C" {
@@ -58,6 +84,9 @@ GRACHTAPI void gracht_client_configuration_set_link(gracht_client_configuration_
 GRACHTAPI void gracht_client_configuration_set_send_buffer(gracht_client_configuration_t* config, void* buffer);
 GRACHTAPI void gracht_client_configuration_set_recv_buffer(gracht_client_configuration_t* config, void* buffer, int size);
 GRACHTAPI void gracht_client_configuration_set_max_msg_size(gracht_client_configuration_t* config, int maxMessageSize);
+GRACHTAPI void gracht_client_configuration_set_max_transfer_size(gracht_client_configuration_t* config, int maxTransferSize);
+GRACHTAPI void gracht_client_configuration_set_max_calls_in_flight(gracht_client_configuration_t* config, int maxCallsInFlight);
+GRACHTAPI void gracht_client_configuration_set_await_spin(gracht_client_configuration_t* config, int spinMicroseconds);
 
 /**
  * Creates a new instance of a gracht client based on the link configuration. An application
@@ -151,6 +180,59 @@ GRACHTAPI int gracht_client_await(gracht_client_t* client, struct gracht_message
  */
 GRACHTAPI int gracht_client_await_multiple(gracht_client_t* client, struct gracht_message_context** contexts, int count, unsigned int flags);
 
+/**
+ * Abandons a call with streamed parameters before its end has been sent, which releases the call slot
+ * claimed when the call was opened. The chunks already sent have been delivered to the server, which is
+ * not told that the call was abandoned.
+ *
+ * @param client A pointer to a previously created gracht client.
+ * @param context The message context the call was opened with.
+ * @return int Returns 0 if the call was abandoned, otherwise -1 and errno is set to ENOENT if the call is not open.
+ */
+GRACHTAPI int gracht_client_abort_stream(gracht_client_t* client, struct gracht_message_context* context);
+
+/**
+ * Creates a completion queue for the client. Calls added to the queue are posted to it when they complete,
+ * by the thread that receives the response. Usually that is a thread that calls gracht_client_wait_message
+ * in a loop, so many calls can be outstanding without awaiting each of them. The response of a completed
+ * call is held in the memory of the client until its result is retrieved, so the number of outstanding
+ * calls should still be bounded by the caller.
+ *
+ * @param client A pointer to a previously created gracht client.
+ * @param cqOut Storage for the completion queue pointer.
+ * @return int Returns 0 if the queue was created, otherwise -1 and errno is set.
+ */
+GRACHTAPI int gracht_client_cq_create(gracht_client_t* client, gracht_client_cq_t** cqOut);
+
+/**
+ * Destroys the completion queue. The calls added to it must have completed, and no threads may be polling it.
+ *
+ * @param cq The completion queue to destroy.
+ */
+GRACHTAPI void gracht_client_cq_destroy(gracht_client_cq_t* cq);
+
+/**
+ * Adds an invoked call to the completion queue. The call is posted right away if it has already completed.
+ * The context must stay valid until the completion has been polled.
+ *
+ * @param cq The completion queue the call should be posted to.
+ * @param context The message context the call was invoked with, the call must expect a response.
+ * @param tag A user pointer that is returned with the completion.
+ * @return int Returns 0 if the call was added, otherwise -1 and errno is set.
+ */
+GRACHTAPI int gracht_client_cq_add(gracht_client_cq_t* cq, struct gracht_message_context* context, void* tag);
+
+/**
+ * Takes completed calls from the completion queue.
+ *
+ * @param cq The completion queue to poll.
+ * @param completions Storage for the completed calls.
+ * @param count The maximum number of completions to take.
+ * @param flags The flag GRACHT_MESSAGE_BLOCK can be specified to block untill a call completes.
+ * @return int The number of completions taken, 0 if none were available.
+ */
+GRACHTAPI int gracht_client_cq_poll(gracht_client_cq_t* cq, struct gracht_client_completion* completions, int count, unsigned int flags);
+
 #ifdef __cplusplus
 }
 #endif
@@ -50,6 +50,10 @@ typedef int (*server_create_client_fn)(struct gracht_link*, struct gracht_messag
 typedef int (*server_destroy_client_fn)(struct gracht_server_client*, gracht_handle_t set_handle);
 typedef int (*server_recv_client_fn)(struct gracht_server_client*, struct gracht_message*, unsigned int flags);
 typedef int (*server_send_client_fn)(struct gracht_server_client*, struct gracht_buffer*, unsigned int flags);
+typedef int (*server_send_client_vec_fn)(struct gracht_server_client*, struct gracht_buffer*, int count, unsigned int flags, size_t* bytesWritten);
+typedef int (*server_pending_client_fn)(struct gracht_server_client*);
+typedef int (*server_writable_client_fn)(struct gracht_server_client*);
+typedef int (*server_recv_client_fds_fn)(struct gracht_server_client*, int* fds, int count);
 
 typedef int (*server_link_recv_fn)(struct gracht_link*, struct gracht_message*, unsigned int flags);
 typedef int (*server_link_send_fn)(struct gracht_link*, struct gracht_message*, struct gracht_buffer*);
@@ -68,6 +72,35 @@ struct server_link_ops {
     server_recv_client_fn    recv_client;
     server_send_client_fn    send_client;
 
+    /**
+     * Optional, sends a number of complete messages in one go. The first buffer may be the
+     * remainder of a previously partially written message. For streaming clients this may
+     * write only part of the data, the number of bytes written is then stored in bytesWritten.
+     * For connection-less clients each buffer is a message, and only whole messages are sent.
+     */
+    server_send_client_vec_fn send_client_vec;
+
+    /**
+     * Optional, for links that read ahead from the client. Returns non-zero if a complete message
+     * has already been received, and the next recv_client will return it without the client
+     * handle becoming readable.
+     */
+    server_pending_client_fn pending_client;
+
+    /**
+     * Optional, for links whose client handle never reports being writable. The link raises a read
+     * event on the client handle instead once the client can be written to again. Called for every
+     * read event before the client is read from, returns non-zero if the client can be written to.
+     */
+    server_writable_client_fn writable_client;
+
+    /**
+     * Optional, for links that can pass descriptors. Takes the next descriptors the client has sent,
+     * in the order they were sent, and returns how many were stored. Descriptors must be received no
+     * later than the message they were sent with.
+     */
+    server_recv_client_fds_fn recv_client_fds;
+
     /**
      * Connection-less oriented functions, and must be supported by the link
      * if the link-type is packet.
@@ -86,6 +119,7 @@ struct server_link_ops {
 typedef gracht_conn_t (*client_link_connect_fn)(struct gracht_link*);
 typedef int           (*client_link_recv_fn)(struct gracht_link*, struct gracht_buffer*, unsigned int flags);
 typedef int           (*client_link_send_fn)(struct gracht_link*, struct gracht_buffer*, void* messageContext);
+typedef int           (*client_link_send_fds_fn)(struct gracht_link*, struct gracht_buffer*, void* messageContext, const int* fds, int count);
 typedef void          (*client_link_destroy_fn)(struct gracht_link*);
 
 struct client_link_ops {
@@ -93,6 +127,12 @@ struct client_link_ops {
     client_link_recv_fn    recv;
     client_link_send_fn    send;
     client_link_destroy_fn destroy;
+
+    /**
+     * Optional, for links that can pass descriptors. Sends the message together with the
+     * descriptors, which are only valid during the call. Set by the link once connected.
+     */
+    client_link_send_fds_fn send_fds;
 };
 
 #ifdef __cplusplus
@@ -0,0 +1,59 @@
+/**
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Gracht Loopback Link Type Definitions & Structures
+ * - This header describes the base link-structure, prototypes
+ *   and functionality, refer to the individual things for descriptions
+ */
+
+#ifndef __GRACHT_LINK_LOOPBACK_H__
+#define __GRACHT_LINK_LOOPBACK_H__
+
+#if !defined(__linux__)
+#error "The loopback link is only supported on linux"
+#endif
+
+#include "link.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Represents the loopback link datastructure, for clients and servers in the same process.
+ * Clients connect to the listening link with the same name, after which all messages travel
+ * through a pair of lock-free ring buffers, like the shared memory link. The server must be
+ * running when a client connects, as the client waits for the server to accept it. The link
+ * is always stream based, and the default configuration is non-listen.
+ */
+struct gracht_link_loopback;
+
+GRACHTAPI int  gracht_link_loopback_create(struct gracht_link_loopback** linkOut);
+GRACHTAPI void gracht_link_loopback_set_listen(struct gracht_link_loopback* link, int listen);
+GRACHTAPI void gracht_link_loopback_set_name(struct gracht_link_loopback* link, const char* name);
+
+/**
+ * Sets the size of each of the two ring buffers the server creates per client, it is rounded up
+ * to a power of two. Messages larger than the ring size can not be sent. Only used by the server.
+ */
+GRACHTAPI void gracht_link_loopback_set_ring_size(struct gracht_link_loopback* link, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // !__GRACHT_LINK_LOOPBACK_H__
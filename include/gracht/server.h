@@ -26,6 +26,10 @@
 #include "types.h"
 #include "link/link.h"
 
+#define GRACHT_DEFAULT_OUTBOUND_LOW_WATERMARK  (64 * 1024)
+#define GRACHT_DEFAULT_OUTBOUND_HIGH_WATERMARK (256 * 1024)
+#define GRACHT_DEFAULT_QUEUE_CAPACITY          32
+
 struct gracht_server_callbacks {
     void (*clientConnected)(gracht_conn_t client);    // invoked only when a new stream-based client has connected
                                                       // or when a new connectionless-client has subscribed to the server
@@ -41,6 +45,7 @@ typedef struct gracht_server_configuration {
     // Server configuration parameters, in this case the set descriptor (select/poll descriptor) to use
     // when the application wants control of the main loop and not use the gracht_server_main_loop function.
     // Then the application can manually call gracht_server_handle_event with the fd's that it does not handle.
+    // This is not supported when the library is built with GRACHT_AIO_URING.
     gracht_handle_t                set_descriptor;
     int                            set_descriptor_provided;
 
@@ -48,12 +53,44 @@ typedef struct gracht_server_configuration {
     // <server_workers>   specifies the number of worker-threads that will be used to handle requests. If 0 then
     //                    worker pool will not be created, and that means the server will handle incoming messages
     //                    on the current thread.
+    // <server_reactors>  specifies the number of event loops (reactors) the server should run. The primary reactor
+    //                    is always the one running on the set descriptor, any additional reactors are run on seperate
+    //                    threads with their own aio descriptor. Newly accepted stream-based clients are spread across
+    //                    all reactors, while links and connection-less clients always stay on the primary reactor.
+    //                    Multiple reactors require <server_workers> to be above 1, creating the server fails otherwise.
     // <max_message_size> specifies the maximum message size that can be handled at once. If not set it defaults
     //                    to GRACHT_DEFAULT_MESSAGE_SIZE as the default value.
+    // <max_transfer_size> specifies the maximum size of messages that are larger than max_message_size, these are
+    //                    split into frames of max_message_size and assembled by the receiver. Only stream-based clients
+    //                    can send fragmented messages. Defaults to GRACHT_DEFAULT_TRANSFER_SIZE.
+    // <queue_capacity>   specifies the number of messages that can be queued for each worker, this is rounded up to a
+    //                    power of two. When the queues of all
+    //                    workers are full, the server stops reading from the client (or link) that the message came
+    //                    from, and resumes once the workers have caught up. Defaults to GRACHT_DEFAULT_QUEUE_CAPACITY.
     int                            server_workers;
+    int                            server_reactors;
     int                            max_message_size;
+    int                            max_transfer_size;
+    int                            queue_capacity;
+
+    // Server configuration parameters for outgoing data. Messages that can not be written to a client right away
+    // are queued and written when the client is ready to receive again.
+    // <outbound_high_watermark> when the number of queued bytes for a client reaches this, events for the client are
+    //                           dropped and no more requests are read from it until the queue has drained.
+    // <outbound_low_watermark>  when the number of queued bytes for a client falls to this, the server resumes
+    //                           reading requests from the client.
+    size_t                         outbound_low_watermark;
+    size_t                         outbound_high_watermark;
 } gracht_server_configuration_t;
 
+// Overload statistics of a multi-threaded server, these are only updated when the server
+// uses workers.
+struct gracht_server_overload_stats {
+    uint64_t stalls;  // number of times reading from a client or link was paused due to full worker queues
+    uint64_t resumes; // number of times reading from a client or link was resumed again
+    uint32_t stalled; // number of clients and links that are currently paused
+};
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -68,7 +105,11 @@ extern "C" {
 GRACHTAPI void gracht_server_configuration_init(gracht_server_configuration_t* config);
 GRACHTAPI void gracht_server_configuration_set_aio_descriptor(gracht_server_configuration_t* config, gracht_handle_t descriptor);
 GRACHTAPI void gracht_server_configuration_set_num_workers(gracht_server_configuration_t* config, int workerCount);
+GRACHTAPI void gracht_server_configuration_set_num_reactors(gracht_server_configuration_t* config, int reactorCount);
 GRACHTAPI void gracht_server_configuration_set_max_msg_size(gracht_server_configuration_t* config, int maxMessageSize);
+GRACHTAPI void gracht_server_configuration_set_max_transfer_size(gracht_server_configuration_t* config, int maxTransferSize);
+GRACHTAPI void gracht_server_configuration_set_outbound_watermarks(gracht_server_configuration_t* config, size_t lowWatermark, size_t highWatermark);
+GRACHTAPI void gracht_server_configuration_set_queue_capacity(gracht_server_configuration_t* config, int queueCapacity);
 
 /**
  * Creates a new instance of the gracht server instance based on the config provided. The configuratipn
@@ -145,6 +186,36 @@ GRACHTAPI int gracht_server_main_loop(gracht_server_t* server);
  */
 GRACHTAPI gracht_handle_t gracht_server_get_aio_handle(gracht_server_t* server);
 
+/**
+ * Retrieves the overload statistics of the server, which tell how often the server had to stop
+ * reading from clients because all workers were busy.
+ * 
+ * @param server The server to retrieve the statistics for.
+ * @param stats  A pointer to storage for the statistics.
+ * @return int Returns 0 if the statistics were retrieved.
+ */
+GRACHTAPI int gracht_server_get_overload_stats(gracht_server_t* server, struct gracht_server_overload_stats* stats);
+
+/**
+ * Retrieves the id of the call the message belongs to. The id is unique for the calls a client has
+ * in progress, and the chunks of a call with streamed parameters share it with the end of the call,
+ * so it can be used together with the client to keep track of the state of such a call.
+ * 
+ * @param message The message to retrieve the call id of.
+ * @return uint32_t The id of the call.
+ */
+GRACHTAPI uint32_t gracht_server_message_id(struct gracht_message* message);
+
+/**
+ * Fails the call the message belongs to. The client receives the error code instead of a
+ * response, which is used by the generated code when a message can not be deserialized.
+ * 
+ * @param message   The message of the call that should fail.
+ * @param errorCode The errno value the call fails with.
+ * @return int Returns 0 if the error was sent, otherwise -1 and errno is set.
+ */
+GRACHTAPI int gracht_server_respond_error(struct gracht_message* message, int errorCode);
+
 /**
  * Creates a deferrable copy of a received message, allowing the caller to specify both
  * storage that must be of size GRACHT_MESSAGE_DEFERRABLE_SIZE, and also the message that
@@ -72,6 +72,37 @@ typedef int gracht_conn_t;
 #define MESSAGE_FLAG_EVENT    0x00000002
 #define MESSAGE_FLAG_RESPONSE 0x00000003
 
+/**
+ * Arrays of primitive types in client requests can be moved to shared memory instead of
+ * being copied into the message, when the link can pass descriptors. This is done for arrays
+ * of at least GRACHT_BULK_MIN_SIZE bytes, or arrays that do not fit in the maximum transfer
+ * size. Only the descriptor travels with the message, the array count is then marked with
+ * GRACHT_BULK_FLAG and followed by the index of the descriptor. The number of descriptors a
+ * message carries is kept in the message flags.
+ */
+#define GRACHT_BULK_MAX                7
+#define GRACHT_BULK_MIN_SIZE           (64 * 1024)
+#define GRACHT_BULK_FLAG               0x80000000U
+#define MESSAGE_FLAG_BULK_SHIFT        2
+#define MESSAGE_FLAG_BULK_COUNT(flags) (((flags) >> MESSAGE_FLAG_BULK_SHIFT) & GRACHT_BULK_MAX)
+
+/**
+ * Messages larger than the maximum message size are sent as a series of frames, each of them
+ * being a message of its own that carries the next part of the original message. The first
+ * frame is marked with MESSAGE_FLAG_FRAGMENT_START, and all of them with MESSAGE_FLAG_FRAGMENT.
+ * The receiver assembles the original message, which can be up to the maximum transfer size.
+ */
+#define MESSAGE_FLAG_FRAGMENT       0x20
+#define MESSAGE_FLAG_FRAGMENT_START 0x40
+
+/**
+ * Functions with streamed responses respond with any number of chunks, which are responses
+ * marked with MESSAGE_FLAG_STREAM. The call is completed by a response without the flag.
+ * Functions with streamed parameters are called the same way, the chunks are sent with the
+ * id of the call and the call is completed by a message without the flag.
+ */
+#define MESSAGE_FLAG_STREAM 0x80
+
 /**
  * The message status, this is returned by any function that directly
  * refers to a specific message. Error indiciates a transmission error
@@ -104,6 +135,12 @@ typedef int gracht_conn_t;
  */
 #define GRACHT_DEFAULT_MESSAGE_SIZE 2048
 
+/**
+ * Messages above the maximum message size are split into frames, the default maximum
+ * size of such messages is 1MB. Only the send buffers are allocated at this size.
+ */
+#define GRACHT_DEFAULT_TRANSFER_SIZE (1024 * 1024)
+
 // Represents a received message on the server. What is relevant here and why
 // the structure is exposed is when servers would like to respond to invocations
 // in the form of events, they will access to the client member of this structure.
@@ -119,13 +156,29 @@ struct gracht_message {
 
 /**
  * The message buffer descriptor. Used internally by the generated system to perform
- * serialization and deserialization of messages
+ * serialization and deserialization of messages. Buffers that messages are serialized into
+ * start out at the maximum message size, and are grown by the serializers up to the limit,
+ * which is the maximum transfer size. The capacity is zero once the buffer could not be grown.
  */
 typedef struct gracht_buffer {
     char*    data;
     uint32_t index;
+    uint32_t capacity;
+    uint32_t limit;
 } gracht_buffer_t;
 
+/**
+ * Grows the buffer so atleast length more bytes can be serialized into it. Used by the generated
+ * serializers when the buffer is full. Once a buffer could not be grown, because the message would be
+ * larger than the limit or the memory could not be allocated, nothing more is serialized into it and
+ * sending the message fails.
+ *
+ * @param buffer The buffer the message is being serialized into.
+ * @param length The number of bytes that are about to be serialized.
+ * @return int Returns 0 if the bytes fit in the buffer, otherwise -1.
+ */
+GRACHTAPI int gracht_buffer_grow(gracht_buffer_t* buffer, size_t length);
+
 /**
  * The context of a message. This is used as the message identifier when using
  * function calls that expect responses. The context that the message was invoked with
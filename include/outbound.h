@@ -0,0 +1,119 @@
+/**
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Gracht Outbound Queue Type Definitions & Structures
+ * - Serialized messages are stored in reference counted payloads, so the same
+ *   payload can be queued for any number of clients without copying it. Each client
+ *   has an outbound queue of payloads, which is flushed with vectored writes.
+ */
+
+#ifndef __GRACHT_OUTBOUND_H__
+#define __GRACHT_OUTBOUND_H__
+
+#include "gracht/link/link.h"
+#include "gatomic.h"
+#include "queue.h"
+#include "thread_api.h"
+
+// The maximum number of payloads that are written in a single flush call
+#define GRACHT_OUTBOUND_MAX_BATCH 64
+
+struct gracht_payload {
+    atomic_int references;
+    uint32_t   length;
+    char       data[];
+};
+
+struct gracht_outbound {
+    mtx_t           lock;
+    struct gr_queue queue;
+    uint32_t        offset;       // number of bytes of the head payload already written
+    size_t          queued_bytes; // number of bytes queued that have not been written yet
+};
+
+/**
+ * Creates a new payload with a single reference, the data is copied into the payload.
+ * @param data The serialized message.
+ * @param length The length of the serialized message.
+ * @return A new payload, or NULL if memory ran out.
+ */
+struct gracht_payload* gracht_payload_create(const char* data, uint32_t length);
+
+/**
+ * @param payload The payload to acquire another reference on.
+ */
+void gracht_payload_acquire(struct gracht_payload* payload);
+
+/**
+ * @param payload The payload to release a reference on. The payload is freed when
+ *                the last reference is released.
+ */
+void gracht_payload_release(struct gracht_payload* payload);
+
+/**
+ * @param outbound The outbound queue to initialize.
+ * @param capacity The initial number of payloads that can be queued, the queue grows when needed.
+ * @return Status of the construction.
+ */
+int gracht_outbound_construct(struct gracht_outbound* outbound, unsigned int capacity);
+
+/**
+ * Releases all payloads still queued, and cleans up resources.
+ * @param outbound The outbound queue to destroy.
+ */
+void gracht_outbound_destroy(struct gracht_outbound* outbound);
+
+/**
+ * Releases all payloads still queued without writing them. Must be called with the outbound lock held.
+ * @param outbound The outbound queue to clear.
+ */
+void gracht_outbound_clear(struct gracht_outbound* outbound);
+
+/**
+ * Makes sure the queue has room for the given number of payloads, so pushing them can not fail.
+ * Must be called with the outbound lock held.
+ * @param outbound The outbound queue to grow.
+ * @param count The number of payloads that will be pushed.
+ * @return 0 if there is room for the payloads, -1 if the queue could not be grown.
+ */
+int gracht_outbound_reserve(struct gracht_outbound* outbound, unsigned int count);
+
+/**
+ * Queues a payload, a reference is acquired on the payload. Must be called with the outbound lock held.
+ * @param outbound The outbound queue to add the payload to.
+ * @param payload The payload to add.
+ * @return 0 if the payload was queued, -1 if the queue could not be grown.
+ */
+int gracht_outbound_push(struct gracht_outbound* outbound, struct gracht_payload* payload);
+
+/**
+ * Writes as much of the queued data as the link accepts, this is done in batches of
+ * GRACHT_OUTBOUND_MAX_BATCH payloads. Must be called with the outbound lock held.
+ * @param outbound The outbound queue to flush.
+ * @param link The link the client belongs to.
+ * @param client The client the queued data should be written to.
+ * @param flags The message flags that should be used for sending.
+ * @return 0 if the queue was fully flushed, 1 if data remains queued, -1 on errors.
+ */
+int gracht_outbound_flush(struct gracht_outbound* outbound, struct gracht_link* link,
+    struct gracht_server_client* client, unsigned int flags);
+
+static inline int gracht_outbound_empty(struct gracht_outbound* outbound) {
+    return gr_queue_count(&outbound->queue) == 0;
+}
+
+#endif // !__GRACHT_OUTBOUND_H__
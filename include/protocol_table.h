@@ -0,0 +1,89 @@
+/**
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Gracht Protocol Table Type Definitions & Structures
+ * - Protocol and action ids are both 8 bit, so actions are looked up by indexing
+ *   directly into a table of protocols, each having a dense table of actions. Lookups
+ *   take no locks, protocols are published atomically once their table is built.
+ */
+
+#ifndef __GRACHT_PROTOCOL_TABLE_H__
+#define __GRACHT_PROTOCOL_TABLE_H__
+
+#include "gracht/types.h"
+#include "gatomic.h"
+#include "thread_api.h"
+
+#define GR_PROTOCOL_TABLE_SIZE 256
+
+struct gr_protocol_entry {
+    gracht_protocol_t*          protocol;
+    gracht_protocol_function_t* actions[GR_PROTOCOL_TABLE_SIZE];
+    struct gr_protocol_entry*   retired_link;
+};
+
+typedef struct gr_protocol_table {
+    mtx_t                     lock;
+    atomic_uintptr_t          protocols[GR_PROTOCOL_TABLE_SIZE];
+    struct gr_protocol_entry* retired;
+} gr_protocol_table_t;
+
+/**
+ * @param table The protocol table to initialize.
+ * @return Status of the construction.
+ */
+int gr_protocol_table_construct(gr_protocol_table_t* table);
+
+/**
+ * The table must not be in use by anyone when it is destroyed.
+ * @param table The protocol table to cleanup.
+ */
+void gr_protocol_table_destroy(gr_protocol_table_t* table);
+
+/**
+ * Builds the action table for the protocol, and then publishes it.
+ * @param table The protocol table to add the protocol to.
+ * @param protocol The protocol to add, it must stay valid until removed.
+ * @return 0 on success, -1 if a protocol with the same id already exists or memory ran out.
+ */
+int gr_protocol_table_add(gr_protocol_table_t* table, gracht_protocol_t* protocol);
+
+/**
+ * Unpublishes a protocol. As lookups take no locks the memory is not released before
+ * the table is destroyed, protocols are not expected to be removed often.
+ * @param table The protocol table to remove the protocol from.
+ * @param protocolId The id of the protocol to remove.
+ */
+void gr_protocol_table_remove(gr_protocol_table_t* table, uint8_t protocolId);
+
+/**
+ * @param table The protocol table to use for the lookup.
+ * @param protocolId The protocol id of the action.
+ * @param actionId The action id.
+ * @return The protocol function, or NULL if the protocol or action is not implemented.
+ */
+static inline gracht_protocol_function_t* gr_protocol_table_get(gr_protocol_table_t* table,
+    uint8_t protocolId, uint8_t actionId)
+{
+    struct gr_protocol_entry* entry = (struct gr_protocol_entry*)atomic_load(&table->protocols[protocolId]);
+    if (!entry) {
+        return NULL;
+    }
+    return entry->actions[actionId];
+}
+
+#endif // !__GRACHT_PROTOCOL_TABLE_H__
@@ -23,6 +23,8 @@
 #ifndef __GRACHT_QUEUE_H__
 #define __GRACHT_QUEUE_H__
 
+#include "gatomic.h"
+#include <stddef.h>
 #include <stdint.h>
 
 struct gr_queue {
@@ -36,5 +38,39 @@ int   gr_queue_construct(struct gr_queue* queue, unsigned int capacity);
 void  gr_queue_destroy(struct gr_queue* queue);
 int   gr_queue_enqueue(struct gr_queue* queue, void* pointer);
 void* gr_queue_dequeue(struct gr_queue* queue);
+void* gr_queue_peek(struct gr_queue* queue, unsigned int index);
+
+static inline unsigned int gr_queue_count(struct gr_queue* queue) {
+    return queue->queue_index - queue->dequeue_index;
+}
+
+// Bounded multi-producer multi-consumer ring, each cell carries a sequence number
+// that tells producers and consumers whether the cell is ready for them. Neither
+// side ever takes a lock. The capacity is rounded up to a power of two.
+struct gr_mpmc_cell {
+    atomic_size_t sequence;
+    uintptr_t     element;
+};
+
+struct gr_mpmc_queue {
+    atomic_size_t        enqueue_index;
+    uint8_t              padding0[64 - sizeof(atomic_size_t)];
+    atomic_size_t        dequeue_index;
+    uint8_t              padding1[64 - sizeof(atomic_size_t)];
+    size_t               mask;
+    struct gr_mpmc_cell* cells;
+};
+
+int   gr_mpmc_queue_construct(struct gr_mpmc_queue* queue, unsigned int capacity);
+void  gr_mpmc_queue_destroy(struct gr_mpmc_queue* queue);
+int   gr_mpmc_queue_enqueue(struct gr_mpmc_queue* queue, void* pointer);
+void* gr_mpmc_queue_dequeue(struct gr_mpmc_queue* queue);
+
+// The count is only a snapshot, it might be outdated as soon as it is returned
+static inline size_t gr_mpmc_queue_count(struct gr_mpmc_queue* queue) {
+    size_t enqueueIndex = atomic_load(&queue->enqueue_index);
+    size_t dequeueIndex = atomic_load(&queue->dequeue_index);
+    return enqueueIndex > dequeueIndex ? enqueueIndex - dequeueIndex : 0;
+}
 
 #endif // !__GRACHT_QUEUE_H__
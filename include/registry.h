@@ -0,0 +1,116 @@
+/**
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Gracht Registry Type Definitions & Structures
+ * - Read-mostly table of elements keyed by an integer. Lookups never take a lock,
+ *   instead readers enter a read section that writers wait out before they reclaim
+ *   any memory (a simple epoch based reclamation scheme). Writers are serialized.
+ */
+
+#ifndef __GRACHT_REGISTRY_H__
+#define __GRACHT_REGISTRY_H__
+
+#include "gatomic.h"
+#include "thread_api.h"
+#include <stdint.h>
+#include <stddef.h>
+
+#define GR_REGISTRY_READER_SLOTS 16
+#define GR_REGISTRY_MINIMUM_CAPACITY 16
+
+typedef uint64_t (*gr_registry_keyfn)(const void* element);
+typedef void     (*gr_registry_enumfn)(void* element, void* userContext);
+
+// Reader counters are striped over a number of cache lines to avoid all readers
+// hammering the same counter. Each thread is assigned a slot on first use.
+struct gr_registry_reader {
+    atomic_uint count[2];
+    uint8_t     padding[64 - (2 * sizeof(atomic_uint))];
+};
+
+typedef struct gr_registry {
+    mtx_t                     lock;
+    atomic_uint               epoch;
+    atomic_uintptr_t          table;
+    size_t                    element_count;
+    size_t                    used_count;
+    gr_registry_keyfn         key;
+    struct gr_registry_reader readers[GR_REGISTRY_READER_SLOTS];
+} gr_registry_t;
+
+/**
+ * @param registry The registry that will be initialized.
+ * @param keyFunction Function that returns the key of an element stored in the registry.
+ * @return Status of the registry construction.
+ */
+int gr_registry_construct(gr_registry_t* registry, gr_registry_keyfn keyFunction);
+
+/**
+ * The registry must not be in use by any readers when it is destroyed. Elements stored
+ * are not freed, use gr_registry_enumerate to clean them up before destroying.
+ * @param registry The registry to cleanup.
+ */
+void gr_registry_destroy(gr_registry_t* registry);
+
+/**
+ * Enters a read section, any element retrieved during the read section stays valid
+ * until the read section is left again. Read sections can be nested, but writers must
+ * not be invoked from within a read section as they wait for readers to leave.
+ * @param registry The registry to read from.
+ * @return A token that must be passed to gr_registry_read_unlock.
+ */
+unsigned int gr_registry_read_lock(gr_registry_t* registry);
+
+/**
+ * @param registry The registry to stop reading from.
+ * @param token The token returned by gr_registry_read_lock.
+ */
+void gr_registry_read_unlock(gr_registry_t* registry, unsigned int token);
+
+/**
+ * Looks up an element without taking any locks. Must be called from within a read section.
+ * @param registry The registry to use for the lookup.
+ * @param key The key of the element to lookup.
+ * @return A pointer to the element, or NULL if no element was found.
+ */
+void* gr_registry_get(gr_registry_t* registry, uint64_t key);
+
+/**
+ * @param registry The registry the element should be inserted into.
+ * @param element The element to insert, must stay valid until it has been removed again.
+ * @return 0 if the element was inserted, -1 if the key already exists or memory ran out.
+ */
+int gr_registry_add(gr_registry_t* registry, void* element);
+
+/**
+ * Removes an element from the registry, and waits for any readers that could still be
+ * referencing the element. When this returns the element is safe to free.
+ * @param registry The registry to remove the element from.
+ * @param key The key of the element to remove.
+ * @return The removed element, or NULL if no element was found.
+ */
+void* gr_registry_remove(gr_registry_t* registry, uint64_t key);
+
+/**
+ * Enumerates all elements in the registry. Must be called from within a read section.
+ * @param registry The registry to enumerate elements in.
+ * @param enumFunction Callback function to invoke on each element.
+ * @param context A user-provided callback context.
+ */
+void gr_registry_enumerate(gr_registry_t* registry, gr_registry_enumfn enumFunction, void* context);
+
+#endif //!__GRACHT_REGISTRY_H__
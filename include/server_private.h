@@ -26,8 +26,6 @@
 #include "gracht/types.h"
 #include "queue.h"
 
-#define SERVER_WORKER_DEFAULT_QUEUE_SIZE 32
-
 // forward declarations
 struct gracht_server;
 struct gracht_worker_pool;
@@ -42,10 +40,11 @@ typedef void (*server_invoke_t)(struct gracht_message*, struct gracht_buffer*);
  * 
  * @param server
  * @param numberOfWorkers The number of workers that should be in the pool
+ * @param queueCapacity The number of messages that can be queued for each worker.
  * @param poolOut A pointer to storage for the worker pool.
  * @return int Returns 0 if creation was succesfull, otherwise errno is set.
  */
-int gracht_worker_pool_create(struct gracht_server* server, int numberOfWorkers, struct gracht_worker_pool** poolOut);
+int gracht_worker_pool_create(struct gracht_server* server, int numberOfWorkers, int queueCapacity, struct gracht_worker_pool** poolOut);
 
 /**
  * Defined in dispatch.c
@@ -62,8 +61,10 @@ void gracht_worker_pool_destroy(struct gracht_worker_pool* pool);
  * 
  * @param pool A pointer to the worker pool that was created earlier.
  * @param recvMessage A pointer to the recieved message.
+ * @return int Returns 0 if the message was queued, or -1 with errno set to EBUSY if the queues of all
+ *             workers are full. The message is still owned by the caller in that case.
  */
-void gracht_worker_pool_dispatch(struct gracht_worker_pool* pool, struct gracht_message* recvMessage);
+int gracht_worker_pool_dispatch(struct gracht_worker_pool* pool, struct gracht_message* recvMessage);
 
 /**
  * Defined in server.c
@@ -74,6 +75,16 @@ void gracht_worker_pool_dispatch(struct gracht_worker_pool* pool, struct gracht_
  */
 void server_invoke_action(struct gracht_server* server, struct gracht_message* recvMessage);
 
+/**
+ * Defined in server.c
+ * Handles a message that was dispatched to a worker and cleans it up afterwards. If the message is
+ * part of a streamed call, the messages of the call that were received in the meantime are handled as well.
+ * 
+ * @param server A pointer to the server the messages originates on.
+ * @param recvMessage A pointer to the message structure.
+ */
+void server_handle_message(struct gracht_server* server, struct gracht_message* recvMessage);
+
 /**
  * Defined in server.c
  * Callback to server to notify that the message is now free for cleanup. Called by workers.
@@ -0,0 +1,69 @@
+/**
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Gracht Slab Allocator Type Definitions & Structures
+ * - Allocations are served from power of two size classes. Each size class has
+ *   a shared free list (the depot), and each thread keeps a small cache of free
+ *   objects per size class in front of it, so most allocations and frees never
+ *   touch a lock. Memory is only returned to the system when the slab is destroyed.
+ */
+
+#ifndef __GRACHT_SLAB_H__
+#define __GRACHT_SLAB_H__
+
+#include <stddef.h>
+
+// The smallest size class is 256 bytes, and the largest is 256 << (GRACHT_SLAB_MAX_CLASSES - 1)
+#define GRACHT_SLAB_MIN_SIZE    256
+#define GRACHT_SLAB_MAX_CLASSES 12
+
+// The number of free objects each thread caches per size class
+#define GRACHT_SLAB_CACHE_SIZE 16
+
+struct gracht_slab;
+
+/**
+ * @param maxObjectSize The largest allocation that will be served from the size classes,
+ *                      allocations above this size are passed on to malloc.
+ * @param limit The maximum number of bytes that can be allocated at any time, 0 for no limit. This
+ *              counts the requested sizes, not the size classes they are served from.
+ * @param slabOut A pointer to storage for the new slab allocator.
+ * @return int Returns 0 if the slab was created, otherwise errno is set.
+ */
+int gracht_slab_create(size_t maxObjectSize, size_t limit, struct gracht_slab** slabOut);
+
+/**
+ * Frees all memory owned by the slab allocator, all allocations must have been freed.
+ *
+ * @param slab The slab allocator to destroy.
+ */
+void gracht_slab_destroy(struct gracht_slab* slab);
+
+/**
+ * @param slab The slab allocator to allocate from.
+ * @param size The number of bytes needed.
+ * @return void* A pointer to the allocation, or NULL with errno set to ENOMEM if the limit was reached.
+ */
+void* gracht_slab_allocate(struct gracht_slab* slab, size_t size);
+
+/**
+ * @param slab The slab allocator the memory was allocated from.
+ * @param memory The allocation to free.
+ */
+void gracht_slab_free(struct gracht_slab* slab, void* memory);
+
+#endif // !__GRACHT_SLAB_H__
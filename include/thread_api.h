@@ -37,6 +37,7 @@
 #include <threads.h>
 #elif defined(HAVE_PTHREAD)
 #include <pthread.h>
+#include <sched.h>
 
 typedef pthread_mutex_t mtx_t;
 typedef pthread_cond_t cnd_t;
@@ -59,6 +60,7 @@ typedef pthread_t thrd_t;
 
 #define thrd_join(thr, ret)          pthread_join(thr, (void**)ret)
 #define thrd_create(thrp, func, arg) pthread_create(thrp, NULL, func, arg)
+#define thrd_yield                   sched_yield
 
 #elif defined(_WIN32)
 #include <windows.h>
@@ -129,6 +131,10 @@ static inline int thrd_join(thrd_t thrp, int* exitCode) {
     status = GetExitCodeThread(thrp, (LPDWORD)exitCode);
     return status == TRUE ? thrd_success : thrd_error;
 }
+
+static inline void thrd_yield(void) {
+    SwitchToThread();
+}
 #else
 #error "Undefined platform for threads"
 #endif
@@ -26,7 +26,7 @@
 #include "gracht/types.h"
 #include "gracht/link/link.h"
 
-typedef struct gr_hashtable gr_hashtable_t;
+typedef struct gr_protocol_table gr_protocol_table_t;
 
 #ifdef _WIN32
 #include <malloc.h>
@@ -60,19 +60,6 @@ struct gracht_link {
 #define GB_MSG_AID(buffer) *((uint8_t*)(&((buffer)->data[(buffer)->index + MSG_INDEX_AID])))
 #define GB_MSG_FLG(buffer) *((uint8_t*)(&((buffer)->data[(buffer)->index + MSG_INDEX_FLG])))
 
-gracht_protocol_function_t* get_protocol_action(gr_hashtable_t* protocols, uint8_t protocol_id, uint8_t action_id);
-
-static uint64_t protocol_hash(const void* element)
-{
-    const struct gracht_protocol* protocol = element;
-    return protocol->id;
-}
-
-static int protocol_cmp(const void* element1, const void* element2)
-{
-    const struct gracht_protocol* protocol1 = element1;
-    const struct gracht_protocol* protocol2 = element2;
-    return protocol1->id == protocol2->id ? 0 : 1;
-}
+gracht_protocol_function_t* get_protocol_action(gr_protocol_table_t* protocols, uint8_t protocol_id, uint8_t action_id);
 
 #endif // !__GRACHT_UTILS_H__
@@ -0,0 +1,1095 @@
+/**
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Gracht io_uring Async IO Implementation
+ * - The ring is owned by the reactor waiting on it. Requests queued on the reactor
+ *   thread are submitted together with the next wait, while requests queued from other
+ *   threads are submitted right away. All state is protected by the ring lock.
+ */
+
+#if !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // POLLRDHUP
+#endif
+
+#include <errno.h>
+#include "aio_uring.h"
+#include "gatomic.h"
+#include <gracht/types.h>
+#include "logging.h"
+#include "thread_api.h"
+#include <linux/io_uring.h>
+#include <linux/time_types.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define URING_ENTRIES      256
+#define URING_MAX_RINGS    64
+#define URING_BUFFER_GROUP 0
+#define URING_BUFFER_COUNT 256 // must be a power of two
+#define URING_BUFFER_SIZE  4096
+#define URING_MAX_FDS      1024
+
+// Stream sockets are received with recvmsg so descriptors passed over local sockets are kept,
+// each provided buffer starts with the result header and the control data
+#define URING_CONTROL_SIZE CMSG_SPACE(sizeof(int) * GRACHT_BULK_MAX)
+#define URING_DATA_OFFSET  (sizeof(struct io_uring_recvmsg_out) + URING_CONTROL_SIZE)
+
+// The user data of each request is the generation of the descriptor, the descriptor and the
+// request type, so completions for descriptors that have since been removed can be dropped
+#define URING_DATA(generation, iod, op) (((uint64_t)(generation) << 32) | ((uint64_t)(uint32_t)(iod) << 8) | (uint64_t)(op))
+#define URING_DATA_GENERATION(data)     ((uint32_t)((data) >> 32))
+#define URING_DATA_IOD(data)            ((int)(((data) >> 8) & 0xFFFFFF))
+#define URING_DATA_OP(data)             ((int)((data) & 0xFF))
+#define URING_OP_BIT(op)                (1U << (op))
+
+enum uring_op {
+    URING_OP_NOP,
+    URING_OP_CANCEL,
+    URING_OP_ACCEPT,
+    URING_OP_RECV,
+    URING_OP_POLL_IN,
+    URING_OP_POLL_OUT
+};
+
+enum uring_type {
+    URING_TYPE_NONE,
+    URING_TYPE_POLL,
+    URING_TYPE_LISTEN,
+    URING_TYPE_STREAM
+};
+
+struct uring_entry {
+    uint32_t     generation;
+    int          type;
+    unsigned int events;     // the events the server wants to know about
+    unsigned int active;     // requests that are in flight
+    unsigned int cancelling; // requests that have been asked to cancel
+    unsigned int stamp;      // the wait an IN event was last reported in
+    int          pending;    // requests must be resubmitted on the next wait
+    int          ready;      // an IN event must be reported for received data on the next wait
+    int          data_head;  // received buffers that have not been read yet, -1 if none
+    int          data_tail;
+    int*         accepted;
+    int          accepted_count;
+    int          accepted_capacity;
+    int*         fds;        // descriptors received on the stream socket, in order
+    int          fd_count;
+    int          fd_capacity;
+};
+
+struct uring_buffer {
+    int      next;
+    uint32_t offset;
+    uint32_t length;
+};
+
+struct uring_list {
+    int* iods;
+    int  count;
+    int  capacity;
+};
+
+struct gracht_uring {
+    int   fd;
+    mtx_t lock;
+
+    void*                sq_map;
+    size_t               sq_map_size;
+    void*                cq_map;
+    size_t               cq_map_size;
+    struct io_uring_sqe* sqes;
+    size_t               sqes_size;
+    unsigned int*        sq_head;
+    unsigned int*        sq_tail;
+    unsigned int*        sq_array;
+    unsigned int         sq_mask;
+    unsigned int         sq_entries;
+    unsigned int         sq_queued;
+    unsigned int*        cq_head;
+    unsigned int*        cq_tail;
+    unsigned int         cq_mask;
+    struct io_uring_cqe* cqes;
+
+    struct io_uring_buf_ring* buffer_ring;
+    struct msghdr             recv_template;
+    uint8_t*                  buffer_memory;
+    uint16_t                  buffer_tail;
+    int                       buffers_free;
+    struct uring_buffer       buffers[URING_BUFFER_COUNT];
+
+    struct uring_entry* entries;
+    int                 entry_count;
+    struct uring_list   pending;
+    struct uring_list   pending_spare;
+    struct uring_list   ready;
+    unsigned int        stamp;
+};
+
+static struct {
+    atomic_int           fd; // the descriptor + 1, 0 when the slot is free
+    struct gracht_uring* ring;
+} g_rings[URING_MAX_RINGS];
+
+// The ring the current thread waits on, requests for it are submitted with the next wait
+static __TLS_VAR struct gracht_uring* g_reactorRing = NULL;
+
+static int uring_setup(unsigned int entries, struct io_uring_params* params)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int uring_enter(int fd, unsigned int toSubmit, unsigned int minComplete, unsigned int flags,
+    void* argument, size_t argumentSize)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, argument, argumentSize);
+}
+
+static int uring_register(int fd, unsigned int opcode, void* argument, unsigned int count)
+{
+    return (int)syscall(__NR_io_uring_register, fd, opcode, argument, count);
+}
+
+static struct gracht_uring* ring_get(int fd)
+{
+    int i;
+    for (i = 0; i < URING_MAX_RINGS; i++) {
+        if (atomic_load(&g_rings[i].fd) == fd + 1) {
+            return g_rings[i].ring;
+        }
+    }
+    errno = EBADF;
+    return NULL;
+}
+
+static int ring_track(struct gracht_uring* ring)
+{
+    int i;
+    for (i = 0; i < URING_MAX_RINGS; i++) {
+        int expected = 0;
+
+        // the descriptor is not handed out before this returns, so nobody looks it up meanwhile
+        if (atomic_compare_exchange_strong(&g_rings[i].fd, &expected, ring->fd + 1)) {
+            g_rings[i].ring = ring;
+            return 0;
+        }
+    }
+    errno = EMFILE;
+    return -1;
+}
+
+static void ring_untrack(struct gracht_uring* ring)
+{
+    int i;
+    for (i = 0; i < URING_MAX_RINGS; i++) {
+        if (atomic_load(&g_rings[i].fd) == ring->fd + 1) {
+            atomic_store(&g_rings[i].fd, 0);
+            return;
+        }
+    }
+}
+
+static int list_add(struct uring_list* list, int iod)
+{
+    if (list->count == list->capacity) {
+        int  capacity = list->capacity ? (list->capacity * 2) : 32;
+        int* iods     = realloc(list->iods, sizeof(int) * (size_t)capacity);
+        if (!iods) {
+            return -1;
+        }
+        list->iods     = iods;
+        list->capacity = capacity;
+    }
+    list->iods[list->count++] = iod;
+    return 0;
+}
+
+static struct uring_entry* entry_get(struct gracht_uring* ring, int iod)
+{
+    if (iod < 0 || iod >= ring->entry_count || ring->entries[iod].type == URING_TYPE_NONE) {
+        return NULL;
+    }
+    return &ring->entries[iod];
+}
+
+static struct uring_entry* entry_create(struct gracht_uring* ring, int iod)
+{
+    if (iod < 0 || iod > 0xFFFFFF) {
+        errno = EBADF;
+        return NULL;
+    }
+
+    if (iod >= ring->entry_count) {
+        int                 count   = ring->entry_count ? ring->entry_count : 64;
+        struct uring_entry* entries;
+
+        while (count <= iod) {
+            count *= 2;
+        }
+
+        entries = realloc(ring->entries, sizeof(struct uring_entry) * (size_t)count);
+        if (!entries) {
+            errno = ENOMEM;
+            return NULL;
+        }
+        memset(&entries[ring->entry_count], 0, sizeof(struct uring_entry) * (size_t)(count - ring->entry_count));
+        ring->entries     = entries;
+        ring->entry_count = count;
+    }
+    return &ring->entries[iod];
+}
+
+static void buffer_recycle(struct gracht_uring* ring, int bid)
+{
+    struct io_uring_buf* buffer = &ring->buffer_ring->bufs[ring->buffer_tail & (URING_BUFFER_COUNT - 1)];
+
+    buffer->addr = (uint64_t)(uintptr_t)&ring->buffer_memory[(size_t)bid * URING_BUFFER_SIZE];
+    buffer->len  = URING_BUFFER_SIZE;
+    buffer->bid  = (uint16_t)bid;
+    ring->buffer_tail++;
+    __atomic_store_n(&ring->buffer_ring->tail, ring->buffer_tail, __ATOMIC_RELEASE);
+    ring->buffers_free++;
+}
+
+static void uring_submit(struct gracht_uring* ring)
+{
+    unsigned int count = ring->sq_queued;
+
+    ring->sq_queued = 0;
+    if (count && uring_enter(ring->fd, count, 0, 0, NULL, 0) < 0) {
+        GRERROR(GRSTR("uring_submit failed to submit %u requests: %i"), count, errno);
+    }
+}
+
+// Returns the next free submission entry, the entry is not visible to the kernel before
+// sqe_push is called
+static struct io_uring_sqe* sqe_get(struct gracht_uring* ring)
+{
+    unsigned int         tail = *ring->sq_tail;
+    struct io_uring_sqe* sqe;
+
+    if (tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >= ring->sq_entries) {
+        uring_submit(ring);
+        if (tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >= ring->sq_entries) {
+            errno = EBUSY;
+            return NULL;
+        }
+    }
+
+    sqe = &ring->sqes[tail & ring->sq_mask];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    return sqe;
+}
+
+static void sqe_push(struct gracht_uring* ring)
+{
+    unsigned int tail = *ring->sq_tail;
+
+    ring->sq_array[tail & ring->sq_mask] = tail & ring->sq_mask;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ring->sq_queued++;
+}
+
+static int entry_submit(struct gracht_uring* ring, int iod, struct uring_entry* entry, int op)
+{
+    struct io_uring_sqe* sqe = sqe_get(ring);
+    if (!sqe) {
+        return -1;
+    }
+
+    sqe->fd        = iod;
+    sqe->user_data = URING_DATA(entry->generation, iod, op);
+    switch (op) {
+        case URING_OP_ACCEPT:
+            sqe->opcode = IORING_OP_ACCEPT;
+            sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+            break;
+        case URING_OP_RECV:
+            sqe->opcode    = IORING_OP_RECVMSG;
+            sqe->addr      = (uint64_t)(uintptr_t)&ring->recv_template;
+            sqe->len       = 1;
+            sqe->msg_flags = MSG_CMSG_CLOEXEC;
+            sqe->ioprio    = IORING_RECV_MULTISHOT;
+            sqe->flags     = IOSQE_BUFFER_SELECT;
+            sqe->buf_group = URING_BUFFER_GROUP;
+            break;
+        case URING_OP_POLL_IN:
+            sqe->opcode        = IORING_OP_POLL_ADD;
+            sqe->poll32_events = POLLIN | POLLRDHUP;
+            break;
+        case URING_OP_POLL_OUT:
+            sqe->opcode        = IORING_OP_POLL_ADD;
+            sqe->poll32_events = POLLOUT;
+            break;
+        default:
+            break;
+    }
+    sqe_push(ring);
+    entry->active |= URING_OP_BIT(op);
+    return 0;
+}
+
+static int entry_cancel(struct gracht_uring* ring, int iod, struct uring_entry* entry, int op)
+{
+    struct io_uring_sqe* sqe;
+
+    if (!(entry->active & URING_OP_BIT(op)) || (entry->cancelling & URING_OP_BIT(op))) {
+        return 0;
+    }
+
+    sqe = sqe_get(ring);
+    if (!sqe) {
+        return -1;
+    }
+
+    sqe->opcode    = IORING_OP_ASYNC_CANCEL;
+    sqe->fd        = -1;
+    sqe->addr      = URING_DATA(entry->generation, iod, op);
+    sqe->user_data = URING_DATA(entry->generation, iod, URING_OP_CANCEL);
+    sqe_push(ring);
+    entry->cancelling |= URING_OP_BIT(op);
+    return 0;
+}
+
+static void entry_pending(struct gracht_uring* ring, int iod, struct uring_entry* entry)
+{
+    if (!entry->pending && !list_add(&ring->pending, iod)) {
+        entry->pending = 1;
+    }
+}
+
+// Makes sure the requests in flight for the descriptor match the events the server wants
+static void entry_update(struct gracht_uring* ring, int iod, struct uring_entry* entry)
+{
+    int wantIn  = (entry->events & EPOLLIN) != 0;
+    int wantOut = (entry->events & EPOLLOUT) != 0;
+    int inOp    = URING_OP_POLL_IN;
+
+    if (entry->type == URING_TYPE_LISTEN) {
+        inOp = URING_OP_ACCEPT;
+    }
+    else if (entry->type == URING_TYPE_STREAM) {
+        inOp = URING_OP_RECV;
+
+        // data that was received while the server was not listening is reported right away
+        if (wantIn && entry->data_head != -1 && !entry->ready && !list_add(&ring->ready, iod)) {
+            entry->ready = 1;
+        }
+    }
+
+    if (wantIn && !(entry->active & URING_OP_BIT(inOp))) {
+        // without free buffers the recv would fail right away, retry once they are returned
+        if ((inOp == URING_OP_RECV && !ring->buffers_free) || entry_submit(ring, iod, entry, inOp)) {
+            entry_pending(ring, iod, entry);
+        }
+    }
+    else if (!wantIn && entry_cancel(ring, iod, entry, inOp)) {
+        entry_pending(ring, iod, entry);
+    }
+
+    if (wantOut && !(entry->active & URING_OP_BIT(URING_OP_POLL_OUT))) {
+        if (entry_submit(ring, iod, entry, URING_OP_POLL_OUT)) {
+            entry_pending(ring, iod, entry);
+        }
+    }
+    else if (!wantOut && entry_cancel(ring, iod, entry, URING_OP_POLL_OUT)) {
+        entry_pending(ring, iod, entry);
+    }
+}
+
+static void entry_data_push(struct gracht_uring* ring, struct uring_entry* entry, int bid, uint32_t offset, uint32_t length)
+{
+    ring->buffers[bid].next   = -1;
+    ring->buffers[bid].offset = offset;
+    ring->buffers[bid].length = offset + length;
+    if (entry->data_tail == -1) {
+        entry->data_head = bid;
+    }
+    else {
+        ring->buffers[entry->data_tail].next = bid;
+    }
+    entry->data_tail = bid;
+}
+
+static void entry_reset(struct gracht_uring* ring, struct uring_entry* entry)
+{
+    int i;
+
+    while (entry->data_head != -1) {
+        int bid = entry->data_head;
+        entry->data_head = ring->buffers[bid].next;
+        buffer_recycle(ring, bid);
+    }
+    entry->data_tail = -1;
+
+    for (i = 0; i < entry->accepted_count; i++) {
+        close(entry->accepted[i]);
+    }
+    free(entry->accepted);
+    entry->accepted          = NULL;
+    entry->accepted_count    = 0;
+    entry->accepted_capacity = 0;
+
+    for (i = 0; i < entry->fd_count; i++) {
+        close(entry->fds[i]);
+    }
+    free(entry->fds);
+    entry->fds         = NULL;
+    entry->fd_count    = 0;
+    entry->fd_capacity = 0;
+}
+
+// Queues the descriptors passed along with the received data, or closes them if the entry is
+// gone or has too many queued already
+static void entry_fds_push(struct uring_entry* entry, struct io_uring_recvmsg_out* out)
+{
+    struct msghdr   msg = { 0 };
+    struct cmsghdr* cmsg;
+
+    msg.msg_control    = (uint8_t*)out + sizeof(struct io_uring_recvmsg_out);
+    msg.msg_controllen = out->controllen;
+    for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        int count;
+        int i;
+
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+            continue;
+        }
+
+        count = (int)((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+        for (i = 0; i < count; i++) {
+            int fd;
+            memcpy(&fd, CMSG_DATA(cmsg) + (sizeof(int) * (size_t)i), sizeof(int));
+
+            if (!entry || entry->fd_count == URING_MAX_FDS) {
+                close(fd);
+                continue;
+            }
+
+            if (entry->fd_count == entry->fd_capacity) {
+                int  capacity = entry->fd_capacity ? (entry->fd_capacity * 2) : 8;
+                int* fds      = realloc(entry->fds, sizeof(int) * (size_t)capacity);
+                if (!fds) {
+                    close(fd);
+                    continue;
+                }
+                entry->fds         = fds;
+                entry->fd_capacity = capacity;
+            }
+            entry->fds[entry->fd_count++] = fd;
+        }
+    }
+}
+
+static int add_event(struct epoll_event* event, int iod, unsigned int events)
+{
+    event->events  = events;
+    event->data.fd = iod;
+    return 1;
+}
+
+// Handles a completion, and returns the number of events it produced (0 or 1)
+static int cqe_handle(struct gracht_uring* ring, struct io_uring_cqe* cqe, struct epoll_event* event)
+{
+    uint64_t            data  = cqe->user_data;
+    int                 iod   = URING_DATA_IOD(data);
+    int                 op    = URING_DATA_OP(data);
+    int                 more  = (cqe->flags & IORING_CQE_F_MORE) != 0;
+    int                 bid   = (cqe->flags & IORING_CQE_F_BUFFER) ? (int)(cqe->flags >> IORING_CQE_BUFFER_SHIFT) : -1;
+    struct uring_entry* entry = entry_get(ring, iod);
+
+    if (bid != -1) {
+        ring->buffers_free--;
+    }
+
+    if (op == URING_OP_NOP || op == URING_OP_CANCEL) {
+        return 0;
+    }
+
+    // the descriptor has been removed, or even reused, since the request was queued
+    if (!entry || entry->generation != URING_DATA_GENERATION(data)) {
+        if (bid != -1) {
+            if (op == URING_OP_RECV && cqe->res > 0) {
+                entry_fds_push(NULL, (struct io_uring_recvmsg_out*)&ring->buffer_memory[(size_t)bid * URING_BUFFER_SIZE]);
+            }
+            buffer_recycle(ring, bid);
+        }
+        if (op == URING_OP_ACCEPT && cqe->res >= 0) {
+            close(cqe->res);
+        }
+        return 0;
+    }
+
+    if (!more) {
+        entry->active     &= ~URING_OP_BIT(op);
+        entry->cancelling &= ~URING_OP_BIT(op);
+    }
+
+    switch (op) {
+        case URING_OP_ACCEPT: {
+            if (!more) {
+                entry_pending(ring, iod, entry);
+            }
+            if (cqe->res < 0) {
+                return 0;
+            }
+
+            if (entry->accepted_count == entry->accepted_capacity) {
+                int  capacity = entry->accepted_capacity ? (entry->accepted_capacity * 2) : 8;
+                int* accepted = realloc(entry->accepted, sizeof(int) * (size_t)capacity);
+                if (!accepted) {
+                    close(cqe->res);
+                    return 0;
+                }
+                entry->accepted          = accepted;
+                entry->accepted_capacity = capacity;
+            }
+            entry->accepted[entry->accepted_count++] = cqe->res;
+            return add_event(event, iod, EPOLLIN);
+        }
+
+        case URING_OP_RECV: {
+            struct io_uring_recvmsg_out* out = NULL;
+
+            if (cqe->res > 0 && bid != -1) {
+                out = (struct io_uring_recvmsg_out*)&ring->buffer_memory[(size_t)bid * URING_BUFFER_SIZE];
+                entry_fds_push(entry, out);
+            }
+
+            // the end of the stream is reported as a result without any payload
+            if (out && out->payloadlen) {
+                entry_data_push(ring, entry, bid, URING_DATA_OFFSET, out->payloadlen);
+                if (!more) {
+                    entry_pending(ring, iod, entry);
+                }
+
+                // data that arrives while the server is not listening is reported once it listens again
+                if (!(entry->events & EPOLLIN) || entry->stamp == ring->stamp) {
+                    return 0;
+                }
+                entry->stamp = ring->stamp;
+                return add_event(event, iod, EPOLLIN);
+            }
+
+            if (bid != -1) {
+                buffer_recycle(ring, bid);
+            }
+
+            // out of buffers or cancelled, the recv is requeued if the server is still listening
+            if (cqe->res == -ENOBUFS || cqe->res == -ECANCELED) {
+                entry_pending(ring, iod, entry);
+                return 0;
+            }
+            return add_event(event, iod, EPOLLRDHUP);
+        }
+
+        case URING_OP_POLL_IN:
+        case URING_OP_POLL_OUT: {
+            unsigned int events = 0;
+
+            // polls are single shot, requeue them after the server had a chance to handle the event
+            entry_pending(ring, iod, entry);
+            if (cqe->res <= 0) {
+                return 0;
+            }
+
+            if (cqe->res & POLLIN) {
+                events |= EPOLLIN;
+            }
+            if (cqe->res & POLLOUT) {
+                events |= EPOLLOUT;
+            }
+            if (cqe->res & (POLLRDHUP | POLLHUP | POLLERR)) {
+                events |= EPOLLRDHUP;
+            }
+
+            events &= entry->events | EPOLLRDHUP;
+            return events ? add_event(event, iod, events) : 0;
+        }
+
+        default:
+            return 0;
+    }
+}
+
+static void uring_process_pending(struct gracht_uring* ring)
+{
+    struct uring_list list = ring->pending;
+    int               i;
+
+    ring->pending       = ring->pending_spare;
+    ring->pending.count = 0;
+    for (i = 0; i < list.count; i++) {
+        struct uring_entry* entry = entry_get(ring, list.iods[i]);
+        if (entry && entry->pending) {
+            entry->pending = 0;
+            entry_update(ring, list.iods[i], entry);
+        }
+    }
+    ring->pending_spare       = list;
+    ring->pending_spare.count = 0;
+}
+
+static int uring_collect(struct gracht_uring* ring, struct epoll_event* events, int count)
+{
+    unsigned int head = *ring->cq_head;
+    unsigned int tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    int          eventCount = 0;
+    int          i;
+
+    // report data that was received while the server was not listening first
+    for (i = 0; i < ring->ready.count && eventCount < count; i++) {
+        struct uring_entry* entry = entry_get(ring, ring->ready.iods[i]);
+        if (!entry || !entry->ready) {
+            continue;
+        }
+
+        entry->ready = 0;
+        if ((entry->events & EPOLLIN) && entry->data_head != -1 && entry->stamp != ring->stamp) {
+            entry->stamp = ring->stamp;
+            eventCount += add_event(&events[eventCount], ring->ready.iods[i], EPOLLIN);
+        }
+    }
+    memmove(&ring->ready.iods[0], &ring->ready.iods[i], sizeof(int) * (size_t)(ring->ready.count - i));
+    ring->ready.count -= i;
+
+    while (head != tail && eventCount < count) {
+        eventCount += cqe_handle(ring, &ring->cqes[head & ring->cq_mask], &events[eventCount]);
+        head++;
+    }
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    return eventCount;
+}
+
+int gracht_uring_create(void)
+{
+    struct gracht_uring*   ring;
+    struct io_uring_params params;
+    struct io_uring_buf_reg bufferRegistration;
+    int                    i;
+
+    ring = calloc(1, sizeof(struct gracht_uring));
+    if (!ring) {
+        errno = ENOMEM;
+        return -1;
+    }
+    mtx_init(&ring->lock, mtx_plain);
+
+    memset(&params, 0, sizeof(struct io_uring_params));
+    ring->fd = uring_setup(URING_ENTRIES, &params);
+    if (ring->fd < 0) {
+        GRERROR(GRSTR("gracht_uring_create failed to create io_uring: %i"), errno);
+        goto error;
+    }
+
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_EXT_ARG)) {
+        GRERROR(GRSTR("gracht_uring_create io_uring is missing required features"));
+        errno = ENOTSUP;
+        goto error;
+    }
+
+    // map the submission and completion rings, they share the mapping
+    ring->sq_map_size = params.sq_off.array + (params.sq_entries * sizeof(unsigned int));
+    ring->cq_map_size = params.cq_off.cqes + (params.cq_entries * sizeof(struct io_uring_cqe));
+    if (ring->cq_map_size > ring->sq_map_size) {
+        ring->sq_map_size = ring->cq_map_size;
+    }
+    ring->sq_map = mmap(NULL, ring->sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+        ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_map == MAP_FAILED) {
+        ring->sq_map = NULL;
+        goto error;
+    }
+    ring->cq_map = ring->sq_map;
+
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes      = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+        ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        goto error;
+    }
+
+    ring->sq_head    = (unsigned int*)((uint8_t*)ring->sq_map + params.sq_off.head);
+    ring->sq_tail    = (unsigned int*)((uint8_t*)ring->sq_map + params.sq_off.tail);
+    ring->sq_array   = (unsigned int*)((uint8_t*)ring->sq_map + params.sq_off.array);
+    ring->sq_mask    = *(unsigned int*)((uint8_t*)ring->sq_map + params.sq_off.ring_mask);
+    ring->sq_entries = params.sq_entries;
+    ring->cq_head    = (unsigned int*)((uint8_t*)ring->cq_map + params.cq_off.head);
+    ring->cq_tail    = (unsigned int*)((uint8_t*)ring->cq_map + params.cq_off.tail);
+    ring->cq_mask    = *(unsigned int*)((uint8_t*)ring->cq_map + params.cq_off.ring_mask);
+    ring->cqes       = (struct io_uring_cqe*)((uint8_t*)ring->cq_map + params.cq_off.cqes);
+
+    // setup the provided buffers that stream sockets receive into
+    if (posix_memalign((void**)&ring->buffer_ring, (size_t)sysconf(_SC_PAGESIZE),
+            URING_BUFFER_COUNT * sizeof(struct io_uring_buf))) {
+        ring->buffer_ring = NULL;
+        errno = ENOMEM;
+        goto error;
+    }
+    memset(ring->buffer_ring, 0, URING_BUFFER_COUNT * sizeof(struct io_uring_buf));
+
+    ring->buffer_memory = malloc((size_t)URING_BUFFER_COUNT * URING_BUFFER_SIZE);
+    if (!ring->buffer_memory) {
+        errno = ENOMEM;
+        goto error;
+    }
+
+    memset(&bufferRegistration, 0, sizeof(struct io_uring_buf_reg));
+    bufferRegistration.ring_addr    = (uint64_t)(uintptr_t)ring->buffer_ring;
+    bufferRegistration.ring_entries = URING_BUFFER_COUNT;
+    bufferRegistration.bgid         = URING_BUFFER_GROUP;
+    if (uring_register(ring->fd, IORING_REGISTER_PBUF_RING, &bufferRegistration, 1)) {
+        GRERROR(GRSTR("gracht_uring_create failed to register buffer ring: %i"), errno);
+        goto error;
+    }
+
+    for (i = 0; i < URING_BUFFER_COUNT; i++) {
+        buffer_recycle(ring, i);
+    }
+    ring->recv_template.msg_controllen = URING_CONTROL_SIZE;
+
+    if (ring_track(ring)) {
+        goto error;
+    }
+    return ring->fd;
+
+error:
+    if (ring->sqes) {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if (ring->sq_map) {
+        munmap(ring->sq_map, ring->sq_map_size);
+    }
+    if (ring->fd >= 0) {
+        close(ring->fd);
+    }
+    free(ring->buffer_memory);
+    free(ring->buffer_ring);
+    mtx_destroy(&ring->lock);
+    free(ring);
+    return -1;
+}
+
+void gracht_uring_destroy(int fd)
+{
+    struct gracht_uring* ring = ring_get(fd);
+    int                  i;
+
+    if (!ring) {
+        return;
+    }
+
+    ring_untrack(ring);
+    if (g_reactorRing == ring) {
+        g_reactorRing = NULL;
+    }
+
+    // closing the ring cancels everything in flight
+    munmap(ring->sqes, ring->sqes_size);
+    munmap(ring->sq_map, ring->sq_map_size);
+    close(ring->fd);
+
+    // entries that were never added have no buffer list, and removed ones were reset already
+    for (i = 0; i < ring->entry_count; i++) {
+        if (ring->entries[i].type != URING_TYPE_NONE) {
+            entry_reset(ring, &ring->entries[i]);
+        }
+    }
+    free(ring->entries);
+    free(ring->pending.iods);
+    free(ring->pending_spare.iods);
+    free(ring->ready.iods);
+    free(ring->buffer_memory);
+    free(ring->buffer_ring);
+    mtx_destroy(&ring->lock);
+    free(ring);
+}
+
+int gracht_uring_wait(int fd, struct epoll_event* events, int count, int timeout)
+{
+    struct gracht_uring*          ring = ring_get(fd);
+    struct __kernel_timespec      timespec;
+    struct io_uring_getevents_arg argument;
+    unsigned int                  toSubmit;
+    int                           eventCount;
+
+    if (!ring) {
+        return -1;
+    }
+    g_reactorRing = ring;
+
+    mtx_lock(&ring->lock);
+    ring->stamp++;
+    uring_process_pending(ring);
+    eventCount = uring_collect(ring, events, count);
+    if (eventCount) {
+        uring_submit(ring);
+        mtx_unlock(&ring->lock);
+        return eventCount;
+    }
+
+    // nothing is ready, so submit the queued requests and wait for completions in one go
+    toSubmit        = ring->sq_queued;
+    ring->sq_queued = 0;
+    mtx_unlock(&ring->lock);
+
+    memset(&argument, 0, sizeof(struct io_uring_getevents_arg));
+    argument.sigmask_sz = 8;
+    if (timeout >= 0) {
+        timespec.tv_sec  = timeout / 1000;
+        timespec.tv_nsec = (timeout % 1000) * 1000000LL;
+        argument.ts      = (uint64_t)(uintptr_t)&timespec;
+    }
+
+    if (uring_enter(ring->fd, toSubmit, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+            &argument, sizeof(struct io_uring_getevents_arg)) < 0) {
+        if (errno != ETIME && errno != EINTR && errno != EBUSY) {
+            return -1;
+        }
+    }
+
+    mtx_lock(&ring->lock);
+    eventCount = uring_collect(ring, events, count);
+    uring_submit(ring);
+    mtx_unlock(&ring->lock);
+    return eventCount;
+}
+
+// Requests queued from other threads than the one waiting on the ring are submitted
+// right away. If an event is reported without a completion, the waiter is woken up.
+static void uring_flush(struct gracht_uring* ring, int wakeup)
+{
+    if (g_reactorRing == ring) {
+        return;
+    }
+
+    if (wakeup) {
+        struct io_uring_sqe* sqe = sqe_get(ring);
+        if (sqe) {
+            sqe->opcode    = IORING_OP_NOP;
+            sqe->user_data = URING_DATA(0, 0, URING_OP_NOP);
+            sqe_push(ring);
+        }
+    }
+    uring_submit(ring);
+}
+
+int gracht_uring_add(int fd, int iod)
+{
+    struct gracht_uring* ring = ring_get(fd);
+    struct uring_entry*  entry;
+    int                  type = URING_TYPE_POLL;
+    int                  value;
+    socklen_t            length = sizeof(int);
+
+    if (!ring) {
+        return -1;
+    }
+
+    if (!getsockopt(iod, SOL_SOCKET, SO_ACCEPTCONN, &value, &length) && value) {
+        type = URING_TYPE_LISTEN;
+    }
+    else if (length = sizeof(int), !getsockopt(iod, SOL_SOCKET, SO_TYPE, &value, &length) && value == SOCK_STREAM) {
+        type = URING_TYPE_STREAM;
+    }
+
+    mtx_lock(&ring->lock);
+    entry = entry_create(ring, iod);
+    if (!entry) {
+        mtx_unlock(&ring->lock);
+        return -1;
+    }
+
+    if (entry->type != URING_TYPE_NONE) {
+        mtx_unlock(&ring->lock);
+        errno = EEXIST;
+        return -1;
+    }
+
+    entry->generation++;
+    entry->type       = type;
+    entry->events     = EPOLLIN | EPOLLRDHUP;
+    entry->active     = 0;
+    entry->cancelling = 0;
+    entry->pending    = 0;
+    entry->ready      = 0;
+    entry->data_head  = -1;
+    entry->data_tail  = -1;
+    entry_update(ring, iod, entry);
+    uring_flush(ring, 0);
+    mtx_unlock(&ring->lock);
+    return 0;
+}
+
+int gracht_uring_remove(int fd, int iod)
+{
+    struct gracht_uring* ring = ring_get(fd);
+    struct uring_entry*  entry;
+    int                  op;
+
+    if (!ring) {
+        return -1;
+    }
+
+    mtx_lock(&ring->lock);
+    entry = entry_get(ring, iod);
+    if (!entry) {
+        mtx_unlock(&ring->lock);
+        errno = ENOENT;
+        return -1;
+    }
+
+    // the requests must be cancelled before the descriptor is closed, as they keep it open
+    for (op = URING_OP_ACCEPT; op <= URING_OP_POLL_OUT; op++) {
+        entry_cancel(ring, iod, entry, op);
+    }
+    uring_submit(ring);
+
+    entry_reset(ring, entry);
+    entry->generation++;
+    entry->type    = URING_TYPE_NONE;
+    entry->events  = 0;
+    entry->pending = 0;
+    entry->ready   = 0;
+    mtx_unlock(&ring->lock);
+    return 0;
+}
+
+int gracht_uring_modify(int fd, int iod, unsigned int events)
+{
+    struct gracht_uring* ring = ring_get(fd);
+    struct uring_entry*  entry;
+    int                  ready;
+
+    if (!ring) {
+        return -1;
+    }
+
+    mtx_lock(&ring->lock);
+    entry = entry_get(ring, iod);
+    if (!entry) {
+        mtx_unlock(&ring->lock);
+        errno = ENOENT;
+        return -1;
+    }
+
+    ready         = entry->ready;
+    entry->events = events | EPOLLRDHUP;
+    entry_update(ring, iod, entry);
+    uring_flush(ring, !ready && entry->ready);
+    mtx_unlock(&ring->lock);
+    return 0;
+}
+
+int gracht_uring_accept(int fd, int iod, struct sockaddr* address, socklen_t* addressLength)
+{
+    struct gracht_uring* ring = ring_get(fd);
+    struct uring_entry*  entry;
+    int                  client;
+
+    if (!ring) {
+        return -1;
+    }
+
+    mtx_lock(&ring->lock);
+    entry = entry_get(ring, iod);
+    if (!entry || !entry->accepted_count) {
+        mtx_unlock(&ring->lock);
+        errno = EAGAIN;
+        return -1;
+    }
+
+    client = entry->accepted[0];
+    entry->accepted_count--;
+    memmove(&entry->accepted[0], &entry->accepted[1], sizeof(int) * (size_t)entry->accepted_count);
+    mtx_unlock(&ring->lock);
+
+    if (address && addressLength && getpeername(client, address, addressLength)) {
+        *addressLength = 0;
+    }
+    return client;
+}
+
+int gracht_uring_recv_fds(int fd, int iod, int* fds, int count)
+{
+    struct gracht_uring* ring = ring_get(fd);
+    struct uring_entry*  entry;
+    int                  fdCount = 0;
+
+    if (!ring) {
+        return 0;
+    }
+
+    mtx_lock(&ring->lock);
+    entry = entry_get(ring, iod);
+    if (entry && entry->fd_count) {
+        fdCount = entry->fd_count < count ? entry->fd_count : count;
+        memcpy(fds, &entry->fds[0], sizeof(int) * (size_t)fdCount);
+        entry->fd_count -= fdCount;
+        memmove(&entry->fds[0], &entry->fds[fdCount], sizeof(int) * (size_t)entry->fd_count);
+    }
+    mtx_unlock(&ring->lock);
+    return fdCount;
+}
+
+long gracht_uring_recv(int fd, int iod, void* buffer, size_t length)
+{
+    struct gracht_uring* ring = ring_get(fd);
+    struct uring_entry*  entry;
+    size_t               bytesCopied = 0;
+
+    if (!ring) {
+        return -1;
+    }
+
+    mtx_lock(&ring->lock);
+    entry = entry_get(ring, iod);
+    while (entry && entry->data_head != -1 && bytesCopied < length) {
+        int                  bid      = entry->data_head;
+        struct uring_buffer* received = &ring->buffers[bid];
+        size_t               count    = received->length - received->offset;
+
+        if (count > (length - bytesCopied)) {
+            count = length - bytesCopied;
+        }
+
+        memcpy((uint8_t*)buffer + bytesCopied,
+            &ring->buffer_memory[((size_t)bid * URING_BUFFER_SIZE) + received->offset], count);
+        received->offset += (uint32_t)count;
+        bytesCopied      += count;
+
+        if (received->offset == received->length) {
+            entry->data_head = received->next;
+            if (entry->data_head == -1) {
+                entry->data_tail = -1;
+            }
+            buffer_recycle(ring, bid);
+        }
+    }
+    mtx_unlock(&ring->lock);
+
+    if (!bytesCopied) {
+        errno = EAGAIN;
+        return -1;
+    }
+    return (long)bytesCopied;
+}
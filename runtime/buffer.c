@@ -0,0 +1,132 @@
+/**
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Gracht Send Buffer Implementation
+ * - Growing of the buffers that messages are serialized into
+ */
+
+#include <errno.h>
+#include "buffer.h"
+#include "logging.h"
+#include <stdlib.h>
+
+#define BUFFER_HEADER(data) ((struct gracht_buffer_header*)(data) - 1)
+
+char* gracht_buffer_create(uint32_t size, void* owner)
+{
+    struct gracht_buffer_header* header;
+
+    header = malloc(sizeof(struct gracht_buffer_header) + size);
+    if (!header) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    header->owner = owner;
+    header->size  = size;
+    return (char*)(header + 1);
+}
+
+void gracht_buffer_destroy(char* data)
+{
+    if (!data) {
+        return;
+    }
+    free(BUFFER_HEADER(data));
+}
+
+void* gracht_buffer_owner(const char* data)
+{
+    return BUFFER_HEADER(data)->owner;
+}
+
+void gracht_buffer_open(char* data, uint32_t limit, struct gracht_buffer* buffer)
+{
+    buffer->data     = data;
+    buffer->index    = 0;
+    buffer->capacity = BUFFER_HEADER(data)->size;
+    buffer->limit    = limit;
+}
+
+char* gracht_buffer_close(struct gracht_buffer* buffer)
+{
+    struct gracht_buffer_header* header = BUFFER_HEADER(buffer->data);
+    struct gracht_buffer_header* shrunk;
+
+    // the buffer was grown if the capacity differs, or if it failed to grow any further
+    if (buffer->capacity != header->size) {
+        shrunk = realloc(header, sizeof(struct gracht_buffer_header) + header->size);
+        if (shrunk) {
+            header = shrunk;
+        }
+    }
+    return (char*)(header + 1);
+}
+
+// A buffer that could not be grown is marked by a zero capacity, and a zero limit if the message
+// was too large. The serializers skip anything that does not fit, so nothing is written past the
+// end of the buffer once it has failed.
+int gracht_buffer_grow(gracht_buffer_t* buffer, size_t length)
+{
+    struct gracht_buffer_header* header;
+    uint64_t                     required = (uint64_t)buffer->index + length;
+    uint64_t                     capacity;
+
+    if (!buffer->capacity) {
+        return -1;
+    }
+
+    if (required <= buffer->capacity) {
+        return 0;
+    }
+
+    if (required > buffer->limit) {
+        GRERROR(GRSTR("gracht_buffer_grow message of atleast %llu bytes is larger than the maximum transfer size"),
+            (unsigned long long)required);
+        buffer->capacity = 0;
+        buffer->limit    = 0;
+        errno = EMSGSIZE;
+        return -1;
+    }
+
+    // double the buffer to keep the number of copies low while a large message is serialized
+    capacity = (uint64_t)buffer->capacity * 2;
+    if (capacity < required) {
+        capacity = required;
+    }
+    if (capacity > buffer->limit) {
+        capacity = buffer->limit;
+    }
+
+    header = realloc(BUFFER_HEADER(buffer->data), sizeof(struct gracht_buffer_header) + (size_t)capacity);
+    if (!header) {
+        buffer->capacity = 0;
+        errno = ENOMEM;
+        return -1;
+    }
+    buffer->data     = (char*)(header + 1);
+    buffer->capacity = (uint32_t)capacity;
+    return 0;
+}
+
+int gracht_buffer_check(struct gracht_buffer* buffer)
+{
+    if (!buffer->capacity) {
+        errno = buffer->limit ? ENOMEM : EMSGSIZE;
+        return -1;
+    }
+    return 0;
+}
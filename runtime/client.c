@@ -20,31 +20,49 @@
  *   and functionality, refer to the individual things for descriptions
  */
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // memfd_create
+#endif
+
 #include <errno.h>
 #include "gracht/client.h"
 #include "client_private.h"
-#include "arena.h"
+#include "buffer.h"
+#include "slab.h"
 #include "hashtable.h"
+#include "protocol_table.h"
 #include "logging.h"
 #include "thread_api.h"
 #include "control.h"
+#include "fragment.h"
+#include "gatomic.h"
 #include "utils.h"
 #include <stdbool.h>
 #include <string.h>
 #include <stdlib.h>
+#include <time.h>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 // Memory requirements of the client
 // On sending:
-// 1 shared buffer.
+// 1 buffer per thread invoking at the same time, of the maximum message size. Buffers
+// grow while larger messages are serialized, and shrink back once they have been sent.
 // On recieving:
-// N+M buffers. One for each event received and for each call in air
+// N+M buffers. One for each event received and for each call in air, and one of
+// up to the maximum transfer size for a fragmented message being assembled
 
 struct gracht_message_awaiter {
+    struct gracht_message_awaiter* next; // in the pool of free awaiters
     uint32_t      id;
     unsigned int  flags;
     cnd_t         event;
     mtx_t         mutex;
-    int           current_count;
+    atomic_int    current_count; // read without the mutex while spinning
     int           count;
 };
 
@@ -53,82 +71,281 @@ struct gracht_message_awaiter_entry {
     struct gracht_message_awaiter* awaiter;
 };
 
-// descriptor | message | params
-struct gracht_message_descriptor {
-    uint32_t        id;
-    int             status;
-    uint32_t        awaiter_id;
+// Calls in flight are kept in a ring of slots indexed by the low bits of the message id. The state
+// of a slot holds the remaining bits of the id along with the SLOT_* flags, so a single compare and
+// swap both matches the id and changes the state. Ids whose slot is busy are skipped when invoking.
+#define SLOT_USED      0x1
+#define SLOT_RECEIVING 0x2  // the response is being stored by the receiving thread
+#define SLOT_AWAITED   0x4  // awaiter_id is set
+#define SLOT_QUEUED    0x8  // the cq members are set
+#define SLOT_COMPLETED 0x10
+#define SLOT_ERROR     0x20
+#define SLOT_OPEN      0x40 // a call with streamed parameters whose end has not been sent
+#define SLOT_EXECUTED  (SLOT_COMPLETED | SLOT_ERROR)
+#define SLOT_MIN_COUNT 128  // the flags must fit in the index bits of the id
+
+struct gracht_message_slot {
+    atomic_uint     state;
     gracht_buffer_t buffer;
+
+    // set by those waiting for the message while holding the watch lock
+    uint32_t                       awaiter_id;
+    struct gracht_client_cq*       cq;
+    struct gracht_message_context* cq_context;
+    void*                          cq_tag;
+};
+
+// The completions are kept in a ring that grows when full, so posting does not allocate
+// in the common case
+struct gracht_client_cq {
+    gracht_client_t*                 client;
+    struct gracht_client_completion* completions;
+    int                              capacity;
+    int                              head;
+    int                              count;
+    mtx_t                            lock;
+    cnd_t                            event;
+};
+
+#define GRACHT_CQ_INITIAL_CAPACITY 64
+
+// Messages are serialized in send buffers taken from a pool, so threads invoking through the
+// same client only wait on each other while the message is written to the link
+struct gracht_send_buffer {
+    struct gracht_send_buffer* next;
+    char*                      data;
+    int                        bulk_fds[GRACHT_BULK_MAX]; // attached to the message in the buffer
+    int                        bulk_count;
 };
 
 typedef struct gracht_client {
     gracht_conn_t        iod;
-    uint32_t             current_message_id;
-    uint32_t             current_awaiter_id;
+    atomic_uint          current_message_id;
+    atomic_uint          current_awaiter_id;
+    uint64_t             await_spin_ns;
+    atomic_uint          await_spin_misses; // spins in a row that ran out of time
+    atomic_uint          await_spin_skip;   // awaits left that should not spin
     struct gracht_link*  link;
-    struct gracht_arena* arena;
+    struct gracht_slab*  slab;
     int                  max_message_size;
-    void*                send_buffer;
-    mtx_t                send_buffer_lock;
-    int                  free_send_buffer;
-    gr_hashtable_t       protocols;
-    gr_hashtable_t       messages;
-    mtx_t                messages_lock;
+    int                  max_transfer_size;
+    struct gracht_send_buffer* send_buffers; // the free buffers of the pool
+    struct gracht_send_buffer  provided_buffer; // the buffer of the configuration, the only one if set
+    mtx_t                send_buffers_lock;
+    cnd_t                send_buffers_event;
+    mtx_t                send_lock;
+    struct gracht_assembly assembly; // fragmented message being received, protected by the wait lock
+    gr_protocol_table_t  protocols;
+    struct gracht_message_slot* messages;
+    uint32_t             messages_mask;
+    mtx_t                watch_lock; // orders awaiters and completion queues with the completion of messages
     gr_hashtable_t       awaiters;
+    struct gracht_message_awaiter* free_awaiters; // initialized awaiters that are not in use
     mtx_t                awaiters_lock;
     mtx_t                wait_lock;
 } gracht_client_t;
 
-#define MESSAGE_STATUS_EXECUTED(status) (status == GRACHT_MESSAGE_ERROR || status == GRACHT_MESSAGE_COMPLETED)
+#define SLOT_STATE(client, id, flags) (((id) & ~(client)->messages_mask) | (flags))
+#define SLOT_MATCH(client, state, id) (((state) & SLOT_USED) && ((state) & ~(client)->messages_mask) == ((id) & ~(client)->messages_mask))
+#define SLOT_STATUS(state) (((state) & SLOT_ERROR) ? GRACHT_MESSAGE_ERROR : \
+    (((state) & SLOT_COMPLETED) ? GRACHT_MESSAGE_COMPLETED : GRACHT_MESSAGE_INPROGRESS))
 
 // api we export to generated files
 GRACHTAPI int gracht_client_get_buffer(gracht_client_t*, gracht_buffer_t*);
 GRACHTAPI int gracht_client_get_status_buffer(gracht_client_t*, struct gracht_message_context*, gracht_buffer_t*);
 GRACHTAPI int gracht_client_status_finalize(gracht_client_t* client, struct gracht_buffer*);
 GRACHTAPI int gracht_client_invoke(gracht_client_t*, struct gracht_message_context*, gracht_buffer_t*);
+GRACHTAPI int gracht_client_call_sync(gracht_client_t*, struct gracht_message_context*, gracht_buffer_t*);
+GRACHTAPI int gracht_client_open_stream(gracht_client_t*, struct gracht_message_context*);
+GRACHTAPI int gracht_client_invoke_stream(gracht_client_t*, struct gracht_message_context*, gracht_buffer_t*);
+GRACHTAPI int gracht_client_attach_bulk(gracht_client_t*, gracht_buffer_t*, const void* data, size_t length);
 
 // static methods
 static uint32_t get_message_id(gracht_client_t*);
 static uint32_t get_awaiter_id(gracht_client_t*);
 static void     mark_awaiters(gracht_client_t*, uint32_t);
-static uint64_t message_hash(const void* element);
-static int      message_cmp(const void* element1, const void* element2);
+static void     cq_post(struct gracht_client_cq*, struct gracht_message_context*, void*, int);
+static void     release_bulk(struct gracht_send_buffer*);
+static struct gracht_send_buffer* send_buffer_get(gracht_client_t*);
+static struct gracht_send_buffer* send_buffer_entry(gracht_client_t*, struct gracht_buffer*);
+static void     send_buffer_put(gracht_client_t*, struct gracht_buffer*);
+static int      send_fragmented(gracht_client_t*, struct gracht_buffer*, struct gracht_message_context*,
+                                struct gracht_send_buffer*);
 static uint64_t awaiter_hash(const void* element);
 static int      awaiter_cmp(const void* element1, const void* element2);
 
-static int __add_message(
-        gracht_client_t*                   client,
-        struct gracht_message_context*     context)
+static inline struct gracht_message_slot* __message_slot(gracht_client_t* client, uint32_t messageID)
 {
-    struct gracht_message_descriptor entry = { 0 };
-    if (context == NULL) {
-        errno = EINVAL;
+    return &client->messages[messageID & client->messages_mask];
+}
+
+static int __claim_slot(gracht_client_t* client, uint32_t messageID, unsigned int flags)
+{
+    struct gracht_message_slot* slot  = __message_slot(client, messageID);
+    unsigned int                state = 0;
+
+    if (!atomic_compare_exchange_strong(&slot->state, &state, SLOT_STATE(client, messageID, SLOT_USED | flags))) {
         return -1;
     }
+    slot->buffer.data  = NULL;
+    slot->buffer.index = 0;
+    return 0;
+}
 
-    entry.id = context->message_id;
-    entry.status = GRACHT_MESSAGE_INPROGRESS;
+// Allocates the id for a call that expects a response, skipping ids whose slot is still held
+// by an older call
+static int __claim_message_id(gracht_client_t* client, unsigned int flags, uint32_t* messageIdOut)
+{
+    for (uint32_t i = 0; i <= client->messages_mask; i++) {
+        uint32_t messageID = get_message_id(client);
+        if (!__claim_slot(client, messageID, flags)) {
+            *messageIdOut = messageID;
+            return 0;
+        }
+    }
+
+    GRERROR(GRSTR("gracht_client: too many calls in flight"));
+    errno = EBUSY;
+    return -1;
+}
 
-    mtx_lock(&client->messages_lock);
-    gr_hashtable_set(&client->messages, &entry);
-    mtx_unlock(&client->messages_lock);
+static void __release_slot(gracht_client_t* client, uint32_t messageID)
+{
+    atomic_store(&__message_slot(client, messageID)->state, 0);
+}
+
+// Changes the state of a call with streamed parameters that is still open, the new state is
+// computed from the current one by keeping the bits in keepMask and adding the flags
+static int __update_stream(gracht_client_t* client, uint32_t messageID, unsigned int keepMask, unsigned int flags)
+{
+    struct gracht_message_slot* slot  = __message_slot(client, messageID);
+    unsigned int                state = atomic_load(&slot->state);
+
+    do {
+        if (!SLOT_MATCH(client, state, messageID) || !(state & SLOT_OPEN)) {
+            errno = ENOENT;
+            return -1;
+        }
+    } while (!atomic_compare_exchange_strong(&slot->state, &state, (state & keepMask) | flags));
     return 0;
 }
 
-static void __remove_message(
-        gracht_client_t*                   client,
-        struct gracht_message_context*     context)
+// Marks the message as watched by an awaiter or completion queue. The watch lock must be held,
+// and the members of the slot for the flag are set by the caller when 1 is returned. Returns 0
+// with the status if the message was already executed, or -1 if it does not exist
+static int __watch_message(gracht_client_t* client, uint32_t messageID, unsigned int flag, int* statusOut)
 {
-    if (context == NULL) {
-        return;
+    struct gracht_message_slot* slot  = __message_slot(client, messageID);
+    unsigned int                state = atomic_load(&slot->state);
+
+    while (1) {
+        if (!SLOT_MATCH(client, state, messageID)) {
+            errno = ENOENT;
+            return -1;
+        }
+
+        if (state & SLOT_EXECUTED) {
+            *statusOut = SLOT_STATUS(state);
+            return 0;
+        }
+
+        if (atomic_compare_exchange_strong(&slot->state, &state, state | flag)) {
+            return 1;
+        }
+    }
+}
+
+// Stores the response of the message and notifies those watching it. The slot is marked as
+// receiving first, so it can not be released and claimed again while the buffer is stored
+static int __complete_message(gracht_client_t* client, uint32_t messageID, struct gracht_buffer* buffer, unsigned int flag)
+{
+    struct gracht_message_slot* slot  = __message_slot(client, messageID);
+    unsigned int                state = atomic_load(&slot->state);
+    struct gracht_message_slot  watchers;
+
+    do {
+        if (!SLOT_MATCH(client, state, messageID) || (state & (SLOT_RECEIVING | SLOT_EXECUTED))) {
+            return -1;
+        }
+    } while (!atomic_compare_exchange_strong(&slot->state, &state, state | SLOT_RECEIVING));
+
+    if (buffer) {
+        // copy data over to message, but increase index, so it skips the meta-data
+        slot->buffer.data  = buffer->data;
+        slot->buffer.index = buffer->index + GRACHT_MESSAGE_HEADER_SIZE;
     }
 
-    mtx_lock(&client->messages_lock);
-    gr_hashtable_remove(&client->messages,
-                     &(struct gracht_message_descriptor) {
-        .id = context->message_id
-    });
-    mtx_unlock(&client->messages_lock);
+    // watchers may still be added until the message is marked executed. Once the message is
+    // watched, it is marked executed with the watch lock held, so the watchers are copied before
+    // the owner can see the message as executed and release the slot to another call
+    state |= SLOT_RECEIVING;
+    while (1) {
+        if (state & (SLOT_AWAITED | SLOT_QUEUED)) {
+            mtx_lock(&client->watch_lock);
+            while (!atomic_compare_exchange_strong(&slot->state, &state, (state & ~SLOT_RECEIVING) | flag));
+            watchers = *slot;
+            mtx_unlock(&client->watch_lock);
+            break;
+        }
+
+        if (atomic_compare_exchange_strong(&slot->state, &state, (state & ~SLOT_RECEIVING) | flag)) {
+            break;
+        }
+    }
+
+    if (state & (SLOT_AWAITED | SLOT_QUEUED)) {
+        // iterate awaiters and mark those that contain this message
+        if (state & SLOT_AWAITED) {
+            mark_awaiters(client, watchers.awaiter_id);
+        }
+        if (state & SLOT_QUEUED) {
+            cq_post(watchers.cq, watchers.cq_context, watchers.cq_tag, SLOT_STATUS(flag));
+        }
+    }
+    return 0;
+}
+
+static int __send_message(
+        gracht_client_t*               client,
+        struct gracht_message_context* context,
+        struct gracht_buffer*          message,
+        uint32_t                       messageID)
+{
+    struct gracht_send_buffer* sendBuffer = send_buffer_entry(client, message);
+    int                        status;
+
+    GB_MSG_ID_0(message)  = messageID;
+    GB_MSG_LEN_0(message) = message->index;
+
+    if (sendBuffer->bulk_count) {
+        GB_MSG_FLG_0(message) |= (uint8_t)(sendBuffer->bulk_count << MESSAGE_FLAG_BULK_SHIFT);
+    }
+
+    // the message is not sent if it did not fit in the buffer
+    status = gracht_buffer_check(message);
+    if (!status) {
+        // only the write to the link is ordered with other threads
+        mtx_lock(&client->send_lock);
+        if (message->index > (uint32_t)client->max_message_size) {
+            status = send_fragmented(client, message, context, sendBuffer);
+        }
+        else if (sendBuffer->bulk_count) {
+            status = client->link->ops.client.send_fds(client->link, message, context,
+                &sendBuffer->bulk_fds[0], sendBuffer->bulk_count);
+        }
+        else {
+            status = client->link->ops.client.send(client->link, message, context);
+        }
+        mtx_unlock(&client->send_lock);
+    }
+
+    // the slot of a call is claimed by the caller
+    if (status && MESSAGE_FLAG_TYPE(GB_MSG_FLG_0(message)) == MESSAGE_FLAG_SYNC) {
+        __release_slot(client, messageID);
+    }
+
+    send_buffer_put(client, message);
+    return status;
 }
 
 // allocated => list_header, message_id, output_buffer
@@ -138,7 +355,6 @@ int gracht_client_invoke(
         struct gracht_buffer*          message)
 {
     uint32_t messageID;
-    int      status;
     GRTRACE(GRSTR("gracht_client_invoke()"));
     
     if (!client || !message) {
@@ -146,34 +362,289 @@ int gracht_client_invoke(
         return -1;
     }
     
-    // fill in some message details
-    messageID = get_message_id(client);
-    GB_MSG_ID_0(message)  = messageID;
-    GB_MSG_LEN_0(message) = message->index;
+    // fill in some message details, calls require a slot for the response
+    if (MESSAGE_FLAG_TYPE(GB_MSG_FLG_0(message)) == MESSAGE_FLAG_SYNC) {
+        if (!context) {
+            send_buffer_put(client, message);
+            errno = (EINVAL);
+            return -1;
+        }
+
+        if (__claim_message_id(client, 0, &messageID)) {
+            send_buffer_put(client, message);
+            return -1;
+        }
+    }
+    else {
+        messageID = get_message_id(client);
+    }
 
     // store a copy of the message id if the context was provided.
     if (context) {
         context->message_id = messageID;
     }
-    
-    // require intermediate buffer for sync operations
-    if (MESSAGE_FLAG_TYPE(GB_MSG_FLG_0(message)) == MESSAGE_FLAG_SYNC) {
-        status = __add_message(client, context);
-        if (status) {
-            goto release;
+    return __send_message(client, context, message, messageID);
+}
+
+// Invokes the call and waits for its response, which replaces the message in the buffer. No awaiter
+// is involved, the response is matched by the slot of the call while waiting
+int gracht_client_call_sync(
+        gracht_client_t*               client,
+        struct gracht_message_context* context,
+        struct gracht_buffer*          message)
+{
+    int status;
+    GRTRACE(GRSTR("gracht_client_call_sync()"));
+
+    status = gracht_client_invoke(client, context, message);
+    if (status) {
+        return status;
+    }
+
+    status = gracht_client_wait_message(client, context, GRACHT_MESSAGE_BLOCK);
+    if (status) {
+        int error = errno;
+
+        // the response will not be received now, so do not keep the slot
+        if (gracht_client_get_status_buffer(client, context, message) == GRACHT_MESSAGE_COMPLETED) {
+            gracht_client_status_finalize(client, message);
         }
+        errno = error;
+        return status;
+    }
+    return gracht_client_get_status_buffer(client, context, message);
+}
+
+// Calls with streamed parameters are opened without sending anything, the chunks and the end of
+// the call are then sent with the id of the call. The slot of the call is claimed right away, so
+// sending the end of the call can not fail because too many calls are in flight
+int gracht_client_open_stream(
+        gracht_client_t*               client,
+        struct gracht_message_context* context)
+{
+    GRTRACE(GRSTR("gracht_client_open_stream()"));
+
+    if (!client || !context) {
+        errno = (EINVAL);
+        return -1;
+    }
+
+    return __claim_message_id(client, SLOT_OPEN, &context->message_id);
+}
+
+int gracht_client_abort_stream(
+        gracht_client_t*               client,
+        struct gracht_message_context* context)
+{
+    GRTRACE(GRSTR("gracht_client_abort_stream()"));
+
+    if (!client || !context) {
+        errno = (EINVAL);
+        return -1;
+    }
+    return __update_stream(client, context->message_id, 0, 0);
+}
+
+int gracht_client_invoke_stream(
+        gracht_client_t*               client,
+        struct gracht_message_context* context,
+        struct gracht_buffer*          message)
+{
+    int status;
+    GRTRACE(GRSTR("gracht_client_invoke_stream()"));
+
+    if (!client || !message) {
+        errno = (EINVAL);
+        return -1;
+    }
+
+    if (!context) {
+        send_buffer_put(client, message);
+        errno = (EINVAL);
+        return -1;
+    }
+
+    // chunks can only be sent while the call is open. The end of the call closes it, and the
+    // slot is kept for the response if there is one
+    if (GB_MSG_FLG_0(message) & MESSAGE_FLAG_STREAM) {
+        status = __update_stream(client, context->message_id, ~0u, 0);
+    }
+    else if (MESSAGE_FLAG_TYPE(GB_MSG_FLG_0(message)) == MESSAGE_FLAG_SYNC) {
+        status = __update_stream(client, context->message_id, ~(unsigned int)SLOT_OPEN, 0);
+    }
+    else {
+        status = __update_stream(client, context->message_id, 0, 0);
     }
 
-    status = client->link->ops.client.send(client->link, message, context);
     if (status) {
-        __remove_message(client, context);
+        send_buffer_put(client, message);
+        return -1;
+    }
+    return __send_message(client, context, message, context->message_id);
+}
+
+// Sends the message as a series of frames, the send lock is held meanwhile so the frames are not
+// mixed with those of other messages. The descriptors are sent along with the first frame.
+static int send_fragmented(
+        gracht_client_t*               client,
+        struct gracht_buffer*          message,
+        struct gracht_message_context* context,
+        struct gracht_send_buffer*     sendBuffer)
+{
+    struct gracht_fragmenter fragmenter;
+    struct gracht_buffer     frame;
+    int                      first  = 1;
+    int                      status = 0;
+
+    if (message->index > (uint32_t)client->max_transfer_size) {
+        GRERROR(GRSTR("gracht_client: message of %u bytes is larger than the maximum transfer size"), message->index);
+        errno = EMSGSIZE;
+        return -1;
+    }
+
+    frame.data = malloc((size_t)client->max_message_size);
+    if (!frame.data) {
+        errno = ENOMEM;
+        return -1;
     }
 
-release:
-    mtx_unlock(&client->send_buffer_lock);
+    gracht_fragmenter_init(&fragmenter, message->data, message->index, (uint32_t)client->max_message_size);
+    while (!status && gracht_fragmenter_next(&fragmenter, &frame)) {
+        if (first && sendBuffer->bulk_count) {
+            status = client->link->ops.client.send_fds(client->link, &frame, context,
+                &sendBuffer->bulk_fds[0], sendBuffer->bulk_count);
+        }
+        else {
+            status = client->link->ops.client.send(client->link, &frame, context);
+        }
+        first = 0;
+    }
+    free(frame.data);
     return status;
 }
 
+// Moves the array into a sealed memfd that is sent along with the message in the send buffer,
+// and returns the index of the descriptor in the message. Returns -1 if the array should be
+// copied into the message instead.
+int gracht_client_attach_bulk(
+        gracht_client_t* client,
+        gracht_buffer_t* buffer,
+        const void*      data,
+        size_t           length)
+{
+#if defined(__linux__)
+    struct gracht_send_buffer* sendBuffer = send_buffer_entry(client, buffer);
+    const char*                bytes = data;
+    size_t                     bytesWritten = 0;
+    int                        fd;
+
+    // small arrays are cheaper to copy, even when the message has to be fragmented, unless
+    // they do not fit at all
+    if (!client->link->ops.client.send_fds || sendBuffer->bulk_count == GRACHT_BULK_MAX ||
+        (length < GRACHT_BULK_MIN_SIZE &&
+         buffer->index + sizeof(uint32_t) + length <= (size_t)client->max_transfer_size)) {
+        return -1;
+    }
+
+    fd = memfd_create("gracht-bulk", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0) {
+        return -1;
+    }
+
+    while (bytesWritten < length) {
+        ssize_t count = write(fd, &bytes[bytesWritten], length - bytesWritten);
+        if (count <= 0) {
+            close(fd);
+            return -1;
+        }
+        bytesWritten += (size_t)count;
+    }
+
+    // the server maps the memory, so it must not be able to change underneath it
+    if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL)) {
+        close(fd);
+        return -1;
+    }
+
+    sendBuffer->bulk_fds[sendBuffer->bulk_count] = fd;
+    return sendBuffer->bulk_count++;
+#else
+    (void)client;
+    (void)buffer;
+    (void)data;
+    (void)length;
+    return -1;
+#endif
+}
+
+static void release_bulk(struct gracht_send_buffer* sendBuffer)
+{
+#if defined(__linux__)
+    while (sendBuffer->bulk_count) {
+        close(sendBuffer->bulk_fds[--sendBuffer->bulk_count]);
+    }
+#endif
+}
+
+// Takes a free buffer from the pool, or allocates a new one. The pool grows to the number of
+// threads that invoke at the same time, unless the buffer was provided by the configuration
+static struct gracht_send_buffer* send_buffer_get(gracht_client_t* client)
+{
+    struct gracht_send_buffer* sendBuffer;
+
+    mtx_lock(&client->send_buffers_lock);
+    while (!client->send_buffers && client->provided_buffer.data) {
+        cnd_wait(&client->send_buffers_event, &client->send_buffers_lock);
+    }
+    sendBuffer = client->send_buffers;
+    if (sendBuffer) {
+        client->send_buffers = sendBuffer->next;
+    }
+    mtx_unlock(&client->send_buffers_lock);
+
+    if (!sendBuffer) {
+        sendBuffer = malloc(sizeof(struct gracht_send_buffer));
+        if (!sendBuffer) {
+            errno = ENOMEM;
+            return NULL;
+        }
+
+        sendBuffer->data = gracht_buffer_create((uint32_t)client->max_message_size, sendBuffer);
+        if (!sendBuffer->data) {
+            free(sendBuffer);
+            return NULL;
+        }
+        sendBuffer->bulk_count = 0;
+    }
+    return sendBuffer;
+}
+
+// The pooled buffers know their entry
+static struct gracht_send_buffer* send_buffer_entry(gracht_client_t* client, struct gracht_buffer* buffer)
+{
+    if (buffer->data == client->provided_buffer.data) {
+        return &client->provided_buffer;
+    }
+    return gracht_buffer_owner(buffer->data);
+}
+
+static void send_buffer_put(gracht_client_t* client, struct gracht_buffer* buffer)
+{
+    struct gracht_send_buffer* sendBuffer = send_buffer_entry(client, buffer);
+
+    // the buffer may have been grown for the message, which also moves it
+    if (sendBuffer != &client->provided_buffer) {
+        sendBuffer->data = gracht_buffer_close(buffer);
+    }
+    release_bulk(sendBuffer);
+
+    mtx_lock(&client->send_buffers_lock);
+    sendBuffer->next     = client->send_buffers;
+    client->send_buffers = sendBuffer;
+    cnd_signal(&client->send_buffers_event);
+    mtx_unlock(&client->send_buffers_lock);
+}
+
 static int __invoke_action(gracht_client_t* client, struct gracht_buffer* message)
 {
     gracht_protocol_function_t* function;
@@ -191,40 +662,115 @@ static int __invoke_action(gracht_client_t* client, struct gracht_buffer* messag
     return 0;
 }
 
+// Chunks of streamed responses are delivered to the protocol callback of the function, the
+// call itself is completed by the final response
+static int __invoke_chunk(gracht_client_t* client, struct gracht_buffer* message)
+{
+    gracht_protocol_function_t*   function;
+    struct gracht_message_context context;
+    GRTRACE(GRSTR("__invoke_chunk()"));
+
+    function = get_protocol_action(&client->protocols, GB_MSG_SID(message), GB_MSG_AID(message));
+    if (!function) {
+        return -1;
+    }
+
+    context.message_id = GB_MSG_ID(message);
+    message->index += GRACHT_MESSAGE_HEADER_SIZE;
+    ((client_invoke_chunk_t)function->address)(client, &context, message);
+    return 0;
+}
+
 static int __handle_response(
         gracht_client_t*      client,
         struct gracht_buffer* buffer)
 {
-    struct gracht_message_descriptor* descriptor;
-    uint32_t                          awaiterID;
     GRTRACE(GRSTR("__handle_response()"));
 
-    mtx_lock(&client->messages_lock);
-    descriptor = gr_hashtable_get(
-            &client->messages,
-            &(struct gracht_message_descriptor) {
-                .id = GB_MSG_ID(buffer)
-            }
-    );
-    if (!descriptor) {
-        mtx_unlock(&client->messages_lock);
+    if (__complete_message(client, GB_MSG_ID(buffer), buffer, SLOT_COMPLETED)) {
         // what the heck?
         GRERROR(GRSTR("[gracht_client_wait_message] no-one was listening for message %u"), GB_MSG_ID(buffer));
         return -1;
     }
+    return 0;
+}
 
-    // copy data over to message, but increase index, so it skips the meta-data
-    descriptor->buffer.data  = buffer->data;
-    descriptor->buffer.index = buffer->index + GRACHT_MESSAGE_HEADER_SIZE;
-    descriptor->status = GRACHT_MESSAGE_COMPLETED;
-    awaiterID = descriptor->awaiter_id;
-    mtx_unlock(&client->messages_lock);
+static void __assembly_reset(gracht_client_t* client)
+{
+    if (client->assembly.data) {
+        gracht_slab_free(client->slab, client->assembly.data);
+    }
+    memset(&client->assembly, 0, sizeof(struct gracht_assembly));
+}
 
-    // iterate awaiters and mark those that contain this message
-    mark_awaiters(client, awaiterID);
+// Adds the frame in the buffer to the message being assembled, the frame is consumed. Once the
+// last frame has been received the buffer is replaced by the complete message.
+static int __assemble_frame(
+        gracht_client_t*      client,
+        struct gracht_buffer* buffer)
+{
+    const char* frame = &buffer->data[buffer->index];
+    int         status;
+
+    // the first frame of a message replaces any message that was not completed
+    if (frame[MSG_INDEX_FLG] & MESSAGE_FLAG_FRAGMENT_START) {
+        uint32_t length = gracht_assembly_length(frame);
+
+        __assembly_reset(client);
+        if (!length || length > (uint32_t)client->max_transfer_size) {
+            GRERROR(GRSTR("[gracht_client_wait_message] invalid fragmented message length %u"), length);
+            gracht_slab_free(client->slab, buffer->data);
+            buffer->data = NULL;
+            errno = EMSGSIZE;
+            return -1;
+        }
+
+        client->assembly.data = gracht_slab_allocate(client->slab, length);
+        if (!client->assembly.data) {
+            gracht_slab_free(client->slab, buffer->data);
+            buffer->data = NULL;
+            errno = ENOMEM;
+            return -1;
+        }
+        client->assembly.length = length;
+    }
+    else if (!client->assembly.data) {
+        // the rest of a message we could not assemble
+        gracht_slab_free(client->slab, buffer->data);
+        buffer->data = NULL;
+        return 0;
+    }
+
+    status = gracht_assembly_append(&client->assembly, frame);
+    gracht_slab_free(client->slab, buffer->data);
+    buffer->data = NULL;
+    if (status == 1) {
+        buffer->data  = (char*)client->assembly.data;
+        buffer->index = 0;
+        memset(&client->assembly, 0, sizeof(struct gracht_assembly));
+    }
+    else if (status == -1) {
+        GRERROR(GRSTR("[gracht_client_wait_message] frame of message %u was out of order"), GB_MSG_ID_0(&client->assembly));
+        __assembly_reset(client);
+        return -1;
+    }
     return 0;
 }
 
+// Returns 1 if the message has been executed, 0 if it is in progress or -1 if it does not exist
+static int __message_done(
+        gracht_client_t*               client,
+        struct gracht_message_context* context)
+{
+    unsigned int state = atomic_load(&__message_slot(client, context->message_id)->state);
+
+    if (!SLOT_MATCH(client, state, context->message_id)) {
+        errno = ENOENT;
+        return -1;
+    }
+    return (state & SLOT_EXECUTED) != 0;
+}
+
 int gracht_client_wait_message(
         gracht_client_t*               client,
         struct gracht_message_context* context,
@@ -232,6 +778,7 @@ int gracht_client_wait_message(
 {
     struct gracht_buffer buffer = { 0 };
     uint32_t             messageId = 0;
+    int                  chunk = 0;
     uint8_t              messageFlags;
     int                  status;
     GRTRACE(GRSTR("gracht_client_wait_message()"));
@@ -247,25 +794,10 @@ int gracht_client_wait_message(
 listenForMessage:
     // check message status
     if (context) {
-        struct gracht_message_descriptor* descriptor;
-
-        mtx_lock(&client->messages_lock);
-        descriptor = gr_hashtable_get(
-                &client->messages,
-                &(struct gracht_message_descriptor) {
-                        .id = context->message_id
-                }
-        );
-        if (!descriptor) {
-            mtx_unlock(&client->messages_lock);
-            errno = ENOENT;
-            return -1;
-        }
-        if (descriptor->status != GRACHT_MESSAGE_INPROGRESS) {
-            mtx_unlock(&client->messages_lock);
-            return 0;
+        status = __message_done(client, context);
+        if (status) {
+            return status < 0 ? -1 : 0;
         }
-        mtx_unlock(&client->messages_lock);
     }
 
     if (mtx_trylock(&client->wait_lock) != thrd_success) {
@@ -279,8 +811,17 @@ listenForMessage:
         }
     }
 
+    // the thread that listened before us may have received the message we are waiting for
+    if (context) {
+        status = __message_done(client, context);
+        if (status) {
+            mtx_unlock(&client->wait_lock);
+            return status < 0 ? -1 : 0;
+        }
+    }
+
     // initialize buffer, after this point NO returning, only jump to listenOrExit
-    buffer.data = gracht_arena_allocate(client->arena, NULL, client->max_message_size);
+    buffer.data = gracht_slab_allocate(client->slab, client->max_message_size);
     buffer.index = client->max_message_size;
 
     if (!buffer.data) {
@@ -292,12 +833,21 @@ listenForMessage:
     }
 
     status = client->link->ops.client.recv(client->link, &buffer, flags);
-    mtx_unlock(&client->wait_lock);
+    if (!status && (GB_MSG_FLG(&buffer) & MESSAGE_FLAG_FRAGMENT)) {
+        status = __assemble_frame(client, &buffer);
+    }
     if (status) {
+        mtx_unlock(&client->wait_lock);
         // In case of any recieving errors we must exit immediately
         goto listenOrExit;
     }
 
+    // the frame was consumed, but the message it is part of is not complete yet
+    if (!buffer.data) {
+        mtx_unlock(&client->wait_lock);
+        goto listenForMessage;
+    }
+
     messageFlags = GB_MSG_FLG(&buffer);
 
     // If the message is not an event, then do not invoke any actions. In any case if a context is provided
@@ -306,10 +856,19 @@ listenForMessage:
     GRTRACE(GRSTR("[gracht] [client] message received %u - %u:%u"),
             messageFlags, GB_MSG_SID(&buffer), GB_MSG_AID(&buffer));
     if (MESSAGE_FLAG_TYPE(messageFlags) == MESSAGE_FLAG_EVENT) {
+        mtx_unlock(&client->wait_lock);
         status = __invoke_action(client, &buffer);
+    } else if (MESSAGE_FLAG_TYPE(messageFlags) == MESSAGE_FLAG_RESPONSE && (messageFlags & MESSAGE_FLAG_STREAM)) {
+        mtx_unlock(&client->wait_lock);
+        status = __invoke_chunk(client, &buffer);
+        chunk  = !status;
     } else if (MESSAGE_FLAG_TYPE(messageFlags) == MESSAGE_FLAG_RESPONSE) {
+        // the response is stored before the next thread listens, as it checks whether the message
+        // it waits for has been received by us
         status = __handle_response(client, &buffer);
+        mtx_unlock(&client->wait_lock);
         if (status) {
+            gracht_slab_free(client->slab, buffer.data);
             goto listenForMessage;
         }
 
@@ -319,18 +878,21 @@ listenForMessage:
         // zero the buffer pointer, so it does not get freed, freeing is now handled by
         // the awaiter
         buffer.data = NULL;
+    } else {
+        mtx_unlock(&client->wait_lock);
     }
 
 listenOrExit:
     if (buffer.data) {
-        gracht_arena_free(client->arena, buffer.data, 0);
+        gracht_slab_free(client->slab, buffer.data);
     }
 
     if (context) {
         // In case a context was provided the meaning is that we should wait
         // for a specific message. Make sure that the message we've handled were
-        // the one that was requested.
-        if (messageId != 0 && context->message_id != messageId) {
+        // the one that was requested. Chunks of a streamed response do not complete it.
+        if ((messageId != 0 && context->message_id != messageId) || chunk) {
+            chunk = 0;
             goto listenForMessage;
         }
     }
@@ -344,20 +906,40 @@ static struct gracht_message_awaiter* __awaiter_new(
 {
     struct gracht_message_awaiter* awaiter;
 
-    awaiter = malloc(sizeof(struct gracht_message_awaiter));
+    // reuse an awaiter if possible, so awaiting does not allocate once the pool
+    // holds an awaiter for each thread that awaits at the same time
+    mtx_lock(&client->awaiters_lock);
+    awaiter = client->free_awaiters;
+    if (awaiter) {
+        client->free_awaiters = awaiter->next;
+    }
+    mtx_unlock(&client->awaiters_lock);
+
     if (!awaiter) {
-        return NULL;
+        awaiter = malloc(sizeof(struct gracht_message_awaiter));
+        if (!awaiter) {
+            errno = ENOMEM;
+            return NULL;
+        }
+        cnd_init(&awaiter->event);
+        mtx_init(&awaiter->mutex, mtx_plain);
     }
 
     awaiter->id            = get_awaiter_id(client);
     awaiter->flags         = flags;
     awaiter->count         = contextCount;
-    awaiter->current_count = 0;
-    cnd_init(&awaiter->event);
-    mtx_init(&awaiter->mutex, mtx_plain);
+    atomic_store(&awaiter->current_count, 0);
     return awaiter;
 }
 
+static void __awaiter_free(
+        struct gracht_message_awaiter* awaiter)
+{
+    cnd_destroy(&awaiter->event);
+    mtx_destroy(&awaiter->mutex);
+    free(awaiter);
+}
+
 static inline void __await_add(
         gracht_client_t*               client,
         struct gracht_message_awaiter* awaiter)
@@ -370,41 +952,131 @@ static inline void __await_add(
     mtx_unlock(&client->awaiters_lock);
 }
 
+// Removes the awaiter if it was added, and returns it to the pool
 static inline void __await_remove(
         gracht_client_t*               client,
-        struct gracht_message_awaiter* awaiter)
+        struct gracht_message_awaiter* awaiter,
+        bool                           added)
 {
     mtx_lock(&client->awaiters_lock);
-    gr_hashtable_remove(&client->awaiters, &(struct gracht_message_awaiter_entry) {
-            .id = awaiter->id
-    });
+    if (added) {
+        gr_hashtable_remove(&client->awaiters, &(struct gracht_message_awaiter_entry) {
+                .id = awaiter->id
+        });
+    }
+    awaiter->next = client->free_awaiters;
+    client->free_awaiters = awaiter;
     mtx_unlock(&client->awaiters_lock);
 }
 
-static inline void __await_loop(
-        gracht_client_t*                client,
-        struct gracht_message_context** contexts,
-        struct gracht_message_awaiter*  awaiter)
-{
-    while (awaiter->current_count < awaiter->count) {
-        gracht_client_wait_message(client, NULL, GRACHT_MESSAGE_BLOCK);
-
-        // update status
-        mtx_lock(&client->messages_lock);
-        awaiter->current_count = 0;
-        for (int i = 0; i < awaiter->count; i++) {
-            struct gracht_message_descriptor* descriptor = gr_hashtable_get(
-                    &client->messages,
-                    &(struct gracht_message_descriptor) {
-                            .id = contexts[i]->message_id
-                    }
-            );
-            if (descriptor == NULL || MESSAGE_STATUS_EXECUTED(descriptor->status)) {
-                awaiter->current_count++;
+static inline int __awaiter_done(
+        struct gracht_message_awaiter* awaiter)
+{
+    if (awaiter->flags & GRACHT_AWAIT_ALL) {
+        return atomic_load(&awaiter->current_count) >= awaiter->count;
+    }
+    return atomic_load(&awaiter->current_count) > 0;
+}
+
+static inline int __await_loop(
+        gracht_client_t*               client,
+        struct gracht_message_awaiter* awaiter)
+{
+    // the awaiter is counted by the thread that handles the responses, so
+    // each received message costs the same regardless of how many we await
+    while (1) {
+        int done;
+
+        mtx_lock(&awaiter->mutex);
+        done = __awaiter_done(awaiter);
+        mtx_unlock(&awaiter->mutex);
+        if (done) {
+            return 0;
+        }
+
+        if (gracht_client_wait_message(client, NULL, GRACHT_MESSAGE_BLOCK)) {
+            return -1;
+        }
+    }
+}
+
+static inline uint64_t __time_ns(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+static int __cpu_count(void)
+{
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+    return (int)sysconf(_SC_NPROCESSORS_ONLN);
+#else
+    return 2;
+#endif
+}
+
+static inline void __cpu_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield");
+#elif defined(_MSC_VER)
+    YieldProcessor();
+#endif
+}
+
+// Spins for the awaiter to complete before the caller blocks, which avoids the sleep and wakeup
+// when the responses arrive within a few microseconds. Each time the budget runs out the client
+// spins for fewer of the following awaits, so spinning stops if the responses are usually slower.
+// Returns 1 if the awaiter completed.
+static int __await_spin(
+        gracht_client_t*               client,
+        struct gracht_message_awaiter* awaiter)
+{
+    unsigned int pauses = 1;
+    unsigned int misses;
+    unsigned int skip;
+    uint64_t     start;
+
+    if (!client->await_spin_ns) {
+        return 0;
+    }
+
+    // awaiting threads race for the skips, so never let the counter drop below zero
+    skip = atomic_load(&client->await_spin_skip);
+    while (skip) {
+        if (atomic_compare_exchange_strong(&client->await_spin_skip, &skip, skip - 1)) {
+            return 0;
+        }
+    }
+
+    start = __time_ns();
+    while (!__awaiter_done(awaiter)) {
+        if (__time_ns() - start >= client->await_spin_ns) {
+            misses = atomic_load(&client->await_spin_misses);
+            if (misses < 10) {
+                atomic_store(&client->await_spin_misses, misses + 1);
             }
+            atomic_store(&client->await_spin_skip, (1u << misses) - 1);
+            return 0;
+        }
+
+        // back off, so we leave the core to the sibling thread that handles the responses
+        for (unsigned int i = 0; i < pauses; i++) {
+            __cpu_relax();
+        }
+        if (pauses < 64) {
+            pauses <<= 1;
         }
-        mtx_unlock(&client->messages_lock);
     }
+    atomic_store(&client->await_spin_misses, 0);
+    return 1;
 }
 
 int gracht_client_await_multiple(
@@ -415,6 +1087,7 @@ int gracht_client_await_multiple(
 {
     struct gracht_message_awaiter* awaiter;
     int                            i;
+    int                            status = 0;
     bool                           bail;
     GRTRACE(GRSTR("gracht_client_await_multiple()"));
     
@@ -429,38 +1102,29 @@ int gracht_client_await_multiple(
         return -1;
     }
 
-    // first step is to get a status of all messages we are awaiting
-    mtx_lock(&client->messages_lock);
+    // first step is to get a status of all messages we are awaiting, those that were already
+    // executed, or in theory have dissappeared, are counted right away
+    mtx_lock(&client->watch_lock);
     for (i = 0; i < contextCount; i++) {
-        struct gracht_message_descriptor* descriptor = gr_hashtable_get(
-                &client->messages,
-                &(struct gracht_message_descriptor) {
-                    .id = contexts[i]->message_id
-                }
-        );
-        if (!descriptor) {
-            // we were waiting for a non-existant message, in theory it could
-            // have dissappeared?
-            awaiter->current_count++;
-            continue;
+        int messageStatus;
+        if (__watch_message(client, contexts[i]->message_id, SLOT_AWAITED, &messageStatus) == 1) {
+            __message_slot(client, contexts[i]->message_id)->awaiter_id = awaiter->id;
         }
-
-        descriptor->awaiter_id = awaiter->id;
-        if (MESSAGE_STATUS_EXECUTED(descriptor->status)) {
-            awaiter->current_count++;
+        else {
+            atomic_fetch_add(&awaiter->current_count, 1);
         }
     }
 
     // calculate here whether we can bail early, so we can skip time
     // not adding the awaiter
-    bail = (!(flags & GRACHT_AWAIT_ALL) && awaiter->current_count > 0) || awaiter->current_count == awaiter->count;
+    bail = __awaiter_done(awaiter);
 
     // add the awaiter while we hold the message lock to avoid a data-race
     // between those
     if (!bail) {
         __await_add(client, awaiter);
     }
-    mtx_unlock(&client->messages_lock);
+    mtx_unlock(&client->watch_lock);
 
     // early bail?
     if (bail) {
@@ -470,22 +1134,158 @@ int gracht_client_await_multiple(
     // in async bail mode we expect another thread to do the event pumping,
     // and thus we should just use the awaiter
     if (flags & GRACHT_AWAIT_ASYNC) {
-        mtx_lock(&awaiter->mutex);
-        cnd_wait(&awaiter->event, &awaiter->mutex);
-        mtx_unlock(&awaiter->mutex);
+        if (!__await_spin(client, awaiter)) {
+            mtx_lock(&awaiter->mutex);
+            while (!__awaiter_done(awaiter)) {
+                cnd_wait(&awaiter->event, &awaiter->mutex);
+            }
+            mtx_unlock(&awaiter->mutex);
+        }
     } else {
         // otherwise we are a single threaded application (maybe) and we should also
         // handle the pumping of messages.
-        __await_loop(client, contexts, awaiter);
+        status = __await_loop(client, awaiter);
     }
-    __await_remove(client, awaiter);
 
 cleanup:
-    // cleanup the awaiter
-    free(awaiter);
+    __await_remove(client, awaiter, !bail);
+    return status;
+}
+
+int gracht_client_cq_create(gracht_client_t* client, gracht_client_cq_t** cqOut)
+{
+    struct gracht_client_cq* cq;
+
+    if (!client || !cqOut) {
+        errno = (EINVAL);
+        return -1;
+    }
+
+    cq = malloc(sizeof(struct gracht_client_cq));
+    if (!cq) {
+        errno = (ENOMEM);
+        return -1;
+    }
+
+    cq->completions = malloc(sizeof(struct gracht_client_completion) * GRACHT_CQ_INITIAL_CAPACITY);
+    if (!cq->completions) {
+        free(cq);
+        errno = (ENOMEM);
+        return -1;
+    }
+
+    cq->client   = client;
+    cq->capacity = GRACHT_CQ_INITIAL_CAPACITY;
+    cq->head     = 0;
+    cq->count    = 0;
+    mtx_init(&cq->lock, mtx_plain);
+    cnd_init(&cq->event);
+    *cqOut = cq;
     return 0;
 }
 
+void gracht_client_cq_destroy(gracht_client_cq_t* cq)
+{
+    if (!cq) {
+        return;
+    }
+
+    mtx_destroy(&cq->lock);
+    cnd_destroy(&cq->event);
+    free(cq->completions);
+    free(cq);
+}
+
+int gracht_client_cq_add(gracht_client_cq_t* cq, struct gracht_message_context* context, void* tag)
+{
+    int watching;
+    int status;
+
+    if (!cq || !context) {
+        errno = (EINVAL);
+        return -1;
+    }
+
+    // the message is marked while holding the watch lock, so the response is either posted
+    // by the thread that receives it, or it had already been received and we post it
+    mtx_lock(&cq->client->watch_lock);
+    watching = __watch_message(cq->client, context->message_id, SLOT_QUEUED, &status);
+    if (watching == 1) {
+        struct gracht_message_slot* slot = __message_slot(cq->client, context->message_id);
+        slot->cq         = cq;
+        slot->cq_context = context;
+        slot->cq_tag     = tag;
+    }
+    mtx_unlock(&cq->client->watch_lock);
+
+    if (watching < 0) {
+        return -1;
+    }
+
+    if (!watching) {
+        cq_post(cq, context, tag, status);
+    }
+    return 0;
+}
+
+int gracht_client_cq_poll(gracht_client_cq_t* cq, struct gracht_client_completion* completions, int count, unsigned int flags)
+{
+    int taken = 0;
+
+    if (!cq || !completions || count <= 0) {
+        errno = (EINVAL);
+        return -1;
+    }
+
+    mtx_lock(&cq->lock);
+    while (!cq->count && (flags & GRACHT_MESSAGE_BLOCK)) {
+        cnd_wait(&cq->event, &cq->lock);
+    }
+
+    while (cq->count && taken < count) {
+        completions[taken++] = cq->completions[cq->head];
+        cq->head = (cq->head + 1) % cq->capacity;
+        cq->count--;
+    }
+    mtx_unlock(&cq->lock);
+    return taken;
+}
+
+static void cq_post(struct gracht_client_cq* cq, struct gracht_message_context* context, void* tag, int status)
+{
+    struct gracht_client_completion* completion;
+
+    mtx_lock(&cq->lock);
+    if (cq->count == cq->capacity) {
+        struct gracht_client_completion* completions;
+
+        completions = malloc(sizeof(struct gracht_client_completion) * cq->capacity * 2);
+        if (!completions) {
+            mtx_unlock(&cq->lock);
+            GRERROR(GRSTR("gracht_client: failed to grow the completion queue, completion of %u was lost"),
+                context->message_id);
+            return;
+        }
+
+        // unwrap the ring while copying, so it starts at the beginning of the new storage
+        for (int i = 0; i < cq->count; i++) {
+            completions[i] = cq->completions[(cq->head + i) % cq->capacity];
+        }
+        free(cq->completions);
+        cq->completions = completions;
+        cq->capacity   *= 2;
+        cq->head        = 0;
+    }
+
+    completion = &cq->completions[(cq->head + cq->count) % cq->capacity];
+    completion->context = context;
+    completion->tag     = tag;
+    completion->status  = status;
+    cq->count++;
+    cnd_signal(&cq->event);
+    mtx_unlock(&cq->lock);
+}
+
 int gracht_client_await(gracht_client_t* client, struct gracht_message_context* context, unsigned int flags)
 {
     GRTRACE(GRSTR("gracht_client_await()"));
@@ -494,14 +1294,26 @@ int gracht_client_await(gracht_client_t* client, struct gracht_message_context*
 
 int gracht_client_get_buffer(gracht_client_t* client, gracht_buffer_t* buffer)
 {
+    struct gracht_send_buffer* sendBuffer;
     GRTRACE(GRSTR("gracht_client_get_buffer()"));
     if (!client) {
         return -1;
     }
 
-    mtx_lock(&client->send_buffer_lock);
-    buffer->data = client->send_buffer;
-    buffer->index = 0;
+    sendBuffer = send_buffer_get(client);
+    if (!sendBuffer) {
+        return -1;
+    }
+
+    // the provided buffer can not be grown, it must hold messages up to the maximum transfer size
+    if (sendBuffer == &client->provided_buffer) {
+        buffer->data     = sendBuffer->data;
+        buffer->index    = 0;
+        buffer->capacity = (uint32_t)client->max_transfer_size;
+        buffer->limit    = (uint32_t)client->max_transfer_size;
+        return 0;
+    }
+    gracht_buffer_open(sendBuffer->data, (uint32_t)client->max_transfer_size, buffer);
     return 0;
 }
 
@@ -510,8 +1322,9 @@ int gracht_client_get_status_buffer(
         struct gracht_message_context* context,
         struct gracht_buffer*          buffer)
 {
-    struct gracht_message_descriptor* descriptor;
-    int                               status;
+    struct gracht_message_slot* slot;
+    unsigned int                state;
+    int                         status;
     GRTRACE(GRSTR("gracht_client_get_status_buffer()"));
     
     if (!client || !context || !buffer) {
@@ -519,29 +1332,31 @@ int gracht_client_get_status_buffer(
         return -1;
     }
     
-    // guard against already checked
-    mtx_lock(&client->messages_lock);
-    descriptor = gr_hashtable_remove(
-            &client->messages,
-            &(struct gracht_message_descriptor) {
-                    .id = context->message_id
-            }
-    );
-    if (!descriptor) {
-        mtx_unlock(&client->messages_lock);
-        errno = (ENOENT);
-        return -1;
-    }
-    
-    status = descriptor->status;
-    buffer->data = descriptor->buffer.data;
-    buffer->index = descriptor->buffer.index;
-    mtx_unlock(&client->messages_lock);
+    // guard against already checked, the slot is released by whoever gets to it first
+    slot  = __message_slot(client, context->message_id);
+    state = atomic_load(&slot->state);
+    do {
+        if (!SLOT_MATCH(client, state, context->message_id)) {
+            errno = (ENOENT);
+            return -1;
+        }
+
+        // the response is being stored right now
+        if (state & SLOT_RECEIVING) {
+            state = atomic_load(&slot->state);
+            continue;
+        }
+
+        status = SLOT_STATUS(state);
+        buffer->data = slot->buffer.data;
+        buffer->index = slot->buffer.index;
+    } while (!atomic_compare_exchange_strong(&slot->state, &state, 0));
 
     // immediately cleanup the buffer if an error has ocurred
-    if (descriptor->status == GRACHT_MESSAGE_ERROR) {
-        if (descriptor->buffer.data) {
-            gracht_arena_free(client->arena, descriptor->buffer.data, 0);
+    if (status == GRACHT_MESSAGE_ERROR) {
+        if (buffer->data) {
+            gracht_slab_free(client->slab, buffer->data);
+            buffer->data = NULL;
         }
     }
     return status;
@@ -557,7 +1372,7 @@ int gracht_client_status_finalize(gracht_client_t* client, struct gracht_buffer*
     }
 
     if (buffer->data) {
-        gracht_arena_free(client->arena, buffer->data, 0);
+        gracht_slab_free(client->slab, buffer->data);
     }
     return 0;
 }
@@ -565,8 +1380,9 @@ int gracht_client_status_finalize(gracht_client_t* client, struct gracht_buffer*
 int gracht_client_create(gracht_client_configuration_t* config, gracht_client_t** clientOut)
 {
     gracht_client_t* client;
+    uint32_t         slotCount;
     int              status;
-    int              arenaSize;
+    int              memoryLimit;
     
     if (!config || !config->link || !clientOut) {
         GRERROR(GRSTR("[gracht] [client] config or config link was null"));
@@ -582,43 +1398,63 @@ int gracht_client_create(gracht_client_configuration_t* config, gracht_client_t*
     }
     
     memset(client, 0, sizeof(gracht_client_t));
-    mtx_init(&client->send_buffer_lock, mtx_plain);
+    mtx_init(&client->send_buffers_lock, mtx_plain);
+    cnd_init(&client->send_buffers_event);
+    mtx_init(&client->send_lock, mtx_plain);
     mtx_init(&client->wait_lock, mtx_plain);
-    mtx_init(&client->messages_lock, mtx_plain);
+    mtx_init(&client->watch_lock, mtx_plain);
     mtx_init(&client->awaiters_lock, mtx_plain);
-    gr_hashtable_construct(&client->protocols, 0, sizeof(struct gracht_protocol), protocol_hash, protocol_cmp);
-    gr_hashtable_construct(&client->messages, 0, sizeof(struct gracht_message_descriptor), message_hash, message_cmp);
+    gr_protocol_table_construct(&client->protocols);
     gr_hashtable_construct(&client->awaiters, 0, sizeof(struct gracht_message_awaiter_entry), awaiter_hash, awaiter_cmp);
 
     client->link = config->link;
     client->iod = GRACHT_CONN_INVALID;
-    client->current_awaiter_id = 1;
-    client->current_message_id = 1;
+    atomic_store(&client->current_awaiter_id, 1);
+    atomic_store(&client->current_message_id, 1);
 
     // handle memory sizes
     client->max_message_size = config->max_message_size;
-    if (client->max_message_size <= 0) {
+    if (client->max_message_size <= GRACHT_MESSAGE_HEADER_SIZE) {
         client->max_message_size = GRACHT_DEFAULT_MESSAGE_SIZE;
     }
+
+    client->max_transfer_size = config->max_transfer_size;
+    if (client->max_transfer_size < client->max_message_size) {
+        client->max_transfer_size = client->max_message_size;
+    }
+
+    // spinning can only pay off if the responses are received on another core
+    if (config->await_spin_us > 0 && __cpu_count() > 1) {
+        client->await_spin_ns = (uint64_t)config->await_spin_us * 1000;
+    }
+
+    // the slot of a call is found from the low bits of its id
+    slotCount = SLOT_MIN_COUNT;
+    while (slotCount < (uint32_t)config->max_calls_in_flight) {
+        slotCount <<= 1;
+    }
+    client->messages_mask = slotCount - 1;
+    client->messages = calloc(slotCount, sizeof(struct gracht_message_slot));
+    if (!client->messages) {
+        GRERROR(GRSTR("gracht_client: failed to allocate memory for calls in flight"));
+        errno = (ENOMEM);
+        goto error;
+    }
     
-    arenaSize = config->recv_buffer_size;
-    if (arenaSize < (client->max_message_size * 2)) {
-        arenaSize = client->max_message_size * 2;
+    // make room for a fragmented message being assembled
+    memoryLimit = config->recv_buffer_size;
+    if (memoryLimit < (client->max_message_size * 2)) {
+        memoryLimit = client->max_message_size * 2;
     }
+    memoryLimit += client->max_transfer_size - client->max_message_size;
 
-    // handle send buffer configuration
-    client->send_buffer = config->send_buffer;
-    if (!client->send_buffer) {
-        client->send_buffer = malloc(client->max_message_size);
-        if (!client->send_buffer) {
-            GRERROR(GRSTR("gracht_client: failed to allocate memory for send buffer"));
-            errno = (ENOMEM);
-            goto error;
-        }
-        client->free_send_buffer = 1;
+    // handle send buffer configuration, a provided buffer is shared by all threads
+    if (config->send_buffer) {
+        client->provided_buffer.data = config->send_buffer;
+        client->send_buffers         = &client->provided_buffer;
     }
     
-    status = gracht_arena_create((size_t)arenaSize, &client->arena);
+    status = gracht_slab_create((size_t)client->max_message_size, (size_t)memoryLimit, &client->slab);
     if (status) {
         GRERROR(GRSTR("gracht_client: failed to create the memory pool"));
         errno = (ENOMEM);
@@ -669,20 +1505,34 @@ void gracht_client_shutdown(gracht_client_t* client)
         client->link->ops.client.destroy(client->link);
     }
 
-    if (client->free_send_buffer) {
-        free(client->send_buffer);
+    // all buffers are back in the pool once no threads are invoking
+    while (client->send_buffers) {
+        struct gracht_send_buffer* sendBuffer = client->send_buffers;
+        client->send_buffers = sendBuffer->next;
+        if (sendBuffer != &client->provided_buffer) {
+            gracht_buffer_destroy(sendBuffer->data);
+            free(sendBuffer);
+        }
     }
 
-    if (client->arena) { 
-        gracht_arena_destroy(client->arena);
+    if (client->slab) {
+        __assembly_reset(client);
+        gracht_slab_destroy(client->slab);
     }
     
+    while (client->free_awaiters) {
+        struct gracht_message_awaiter* awaiter = client->free_awaiters;
+        client->free_awaiters = awaiter->next;
+        __awaiter_free(awaiter);
+    }
     gr_hashtable_destroy(&client->awaiters);
-    gr_hashtable_destroy(&client->messages);
-    gr_hashtable_destroy(&client->protocols);
+    free(client->messages);
+    gr_protocol_table_destroy(&client->protocols);
     mtx_destroy(&client->wait_lock);
-    mtx_destroy(&client->send_buffer_lock);
-    mtx_destroy(&client->messages_lock);
+    mtx_destroy(&client->send_buffers_lock);
+    cnd_destroy(&client->send_buffers_event);
+    mtx_destroy(&client->send_lock);
+    mtx_destroy(&client->watch_lock);
     mtx_destroy(&client->awaiters_lock);
     free(client);
 }
@@ -703,7 +1553,14 @@ int gracht_client_register_protocol(gracht_client_t* client, gracht_protocol_t*
         return -1;
     }
     
-    gr_hashtable_set(&client->protocols, protocol);
+    // registering a protocol again replaces the previous registration
+    if (gr_protocol_table_add(&client->protocols, protocol)) {
+        if (errno != EEXIST) {
+            return -1;
+        }
+        gr_protocol_table_remove(&client->protocols, protocol->id);
+        return gr_protocol_table_add(&client->protocols, protocol);
+    }
     return 0;
 }
 
@@ -714,7 +1571,7 @@ void gracht_client_unregister_protocol(gracht_client_t* client, gracht_protocol_
         return;
     }
     
-    gr_hashtable_remove(&client->protocols, protocol);
+    gr_protocol_table_remove(&client->protocols, protocol->id);
 }
 
 static void mark_awaiters(gracht_client_t* client, uint32_t awaiterID)
@@ -731,69 +1588,37 @@ static void mark_awaiters(gracht_client_t* client, uint32_t awaiterID)
         mtx_unlock(&client->awaiters_lock);
         return;
     }
-    awaiter = entry->awaiter;
-    mtx_unlock(&client->awaiters_lock);
 
-    awaiter->current_count++;
-    if (awaiter->flags & GRACHT_AWAIT_ALL) {
-        if (awaiter->current_count == awaiter->count) {
-            cnd_signal(&awaiter->event);
-        }
-    } else {
+    // keep the awaiters lock while counting, the awaiter is freed as soon as it
+    // has been removed
+    awaiter = entry->awaiter;
+    mtx_lock(&awaiter->mutex);
+    atomic_fetch_add(&awaiter->current_count, 1);
+    if (__awaiter_done(awaiter)) {
         cnd_signal(&awaiter->event);
     }
+    mtx_unlock(&awaiter->mutex);
+    mtx_unlock(&client->awaiters_lock);
 }
 
 static uint32_t get_message_id(gracht_client_t* client)
 {
-    return client->current_message_id++;
+    return atomic_fetch_add(&client->current_message_id, 1);
 }
 
 static uint32_t get_awaiter_id(gracht_client_t* client)
 {
-    return client->current_awaiter_id++;
+    return atomic_fetch_add(&client->current_awaiter_id, 1);
 }
 
 void gracht_control_error_invocation(gracht_client_t* client, const uint32_t messageId, const int errorCode)
 {
-    struct gracht_message_descriptor* descriptor;
-    uint32_t                          awaiterID;
     (void)errorCode;
 
-    mtx_lock(&client->messages_lock);
-    descriptor = gr_hashtable_get(
-            &client->messages,
-            &(struct gracht_message_descriptor) {
-                .id = messageId
-            }
-    );
-    if (!descriptor) {
-        mtx_unlock(&client->messages_lock);
+    if (__complete_message(client, messageId, NULL, SLOT_ERROR)) {
         // what the heck?
         GRERROR(GRSTR("gracht_control_error_invocation no-one was listening for message %u"), messageId);
-        return;
     }
-    
-    // set status
-    descriptor->status = GRACHT_MESSAGE_ERROR;
-    awaiterID = descriptor->awaiter_id;
-    mtx_unlock(&client->messages_lock);
-    
-    // iterate awaiters and mark those that contain this message
-    mark_awaiters(client, awaiterID);
-}
-
-static uint64_t message_hash(const void* element)
-{
-    const struct gracht_message_descriptor* message = element;
-    return message->id;
-}
-
-static int message_cmp(const void* element1, const void* element2)
-{
-    const struct gracht_message_descriptor* message1 = element1;
-    const struct gracht_message_descriptor* message2 = element2;
-    return message1->id == message2->id ? 0 : 1;
 }
 
 static uint64_t awaiter_hash(const void* element)
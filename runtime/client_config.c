@@ -25,7 +25,9 @@ void gracht_client_configuration_init(gracht_client_configuration_t* config)
 {
     memset(config, 0, sizeof(gracht_client_configuration_t));
     config->max_message_size = GRACHT_DEFAULT_MESSAGE_SIZE;
+    config->max_transfer_size = GRACHT_DEFAULT_TRANSFER_SIZE;
     config->recv_buffer_size = 16 * GRACHT_DEFAULT_MESSAGE_SIZE;
+    config->max_calls_in_flight = GRACHT_DEFAULT_CALLS_IN_FLIGHT;
 }
 
 void gracht_client_configuration_set_link(gracht_client_configuration_t* config, struct gracht_link* link)
@@ -48,3 +50,18 @@ void gracht_client_configuration_set_max_msg_size(gracht_client_configuration_t*
 {
     config->max_message_size = maxMessageSize;
 }
+
+void gracht_client_configuration_set_max_transfer_size(gracht_client_configuration_t* config, int maxTransferSize)
+{
+    config->max_transfer_size = maxTransferSize;
+}
+
+void gracht_client_configuration_set_max_calls_in_flight(gracht_client_configuration_t* config, int maxCallsInFlight)
+{
+    config->max_calls_in_flight = maxCallsInFlight;
+}
+
+void gracht_client_configuration_set_await_spin(gracht_client_configuration_t* config, int spinMicroseconds)
+{
+    config->await_spin_us = spinMicroseconds;
+}
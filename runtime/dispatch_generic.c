@@ -32,37 +32,40 @@ enum gracht_worker_state {
     WORKER_SHUTDOWN
 };
 
+// Each worker has its own lock-free job queue that the reactors push into, and
+// workers that run out of jobs steal from the queues of the other workers. The mutex
+// and condition are only used to park idle workers.
 struct gracht_worker {
-    thrd_t          id;
-    mtx_t           sync_object;
-    struct gr_queue job_queue;
-    cnd_t           signal;
-    int             state;
-};
-
-struct gracht_worker_context {
-    struct gracht_worker* worker;
-    struct gracht_server* server;
+    thrd_t                     id;
+    mtx_t                      sync_object;
+    cnd_t                      signal;
+    struct gr_mpmc_queue       job_queue;
+    atomic_int                 sleeping;
+    atomic_int                 state;
+    int                        index;
+    struct gracht_worker_pool* pool;
 };
 
 struct gracht_worker_pool {
+    struct gracht_server* server;
     struct gracht_worker* workers;
     int                   worker_count;
-    int                   rr_index; // no loadbalancing atm
+    atomic_uint           rr_index;
+    atomic_int            sleepers;
 };
 
 static int  worker_dowork(void*);
-static void initialize_worker(struct gracht_server*, struct gracht_worker*);
+static int  initialize_worker(struct gracht_worker_pool*, struct gracht_worker*, int);
 static void cleanup_worker(struct gracht_worker*);
 
-int gracht_worker_pool_create(struct gracht_server* server, int numberOfWorkers, struct gracht_worker_pool** poolOut)
+int gracht_worker_pool_create(struct gracht_server* server, int numberOfWorkers, int queueCapacity, struct gracht_worker_pool** poolOut)
 {
     struct gracht_worker_pool* pool;
     struct gracht_worker*      workers;
     size_t                     allocSize;
     int                        i;
 
-    if (!poolOut || numberOfWorkers < 0) {
+    if (!poolOut || numberOfWorkers <= 0 || queueCapacity <= 0) {
         errno = EINVAL;
         return -1;
     }
@@ -81,21 +84,48 @@ int gracht_worker_pool_create(struct gracht_server* server, int numberOfWorkers,
         return -1;
     }
 
+    pool->server = server;
     pool->workers = workers;
     pool->worker_count = numberOfWorkers;
-    pool->rr_index = 0;
+    atomic_store(&pool->rr_index, 0);
+    atomic_store(&pool->sleepers, 0);
+
+    // the queues must all exist before any worker starts stealing from them
     for (i = 0; i < numberOfWorkers; i++) {
-        initialize_worker(server, &pool->workers[i]);
+        if (gr_mpmc_queue_construct(&pool->workers[i].job_queue, (unsigned int)queueCapacity)) {
+            while (i--) {
+                gr_mpmc_queue_destroy(&pool->workers[i].job_queue);
+            }
+            free(workers);
+            free(pool);
+            return -1;
+        }
+    }
+
+    for (i = 0; i < numberOfWorkers; i++) {
+        if (initialize_worker(pool, &pool->workers[i], i)) {
+            GRERROR(GRSTR("gracht_worker_pool_create: failed to create worker %i"), i);
+        }
     }
 
     *poolOut = pool;
     return 0;
 }
 
+static void worker_wake(struct gracht_worker* worker)
+{
+    // taking the lock makes sure the worker is either waiting or will see the job
+    // when it rechecks the queues
+    mtx_lock(&worker->sync_object);
+    cnd_signal(&worker->signal);
+    mtx_unlock(&worker->sync_object);
+}
+
 void gracht_worker_pool_destroy(struct gracht_worker_pool* pool)
 {
-    int exitCode;
-    int i;
+    struct gracht_message* job;
+    int                    exitCode;
+    int                    i;
 
     if (!pool) {
         return;
@@ -103,11 +133,27 @@ void gracht_worker_pool_destroy(struct gracht_worker_pool* pool)
 
     // destroy pool of workers
     for (i = 0; i < pool->worker_count; i++) {
-        pool->workers[i].state = WORKER_SHUTDOWN_REQUEST;
+        if (atomic_load(&pool->workers[i].state) == WORKER_SHUTDOWN) {
+            continue;
+        }
+
+        mtx_lock(&pool->workers[i].sync_object);
+        atomic_store(&pool->workers[i].state, WORKER_SHUTDOWN_REQUEST);
         cnd_signal(&pool->workers[i].signal);
+        mtx_unlock(&pool->workers[i].sync_object);
 
         // wait for cleanup
         thrd_join(pool->workers[i].id, &exitCode);
+    }
+
+    // any jobs left over are cleaned up once all workers are gone, as they could
+    // otherwise be stolen while we clean up
+    for (i = 0; i < pool->worker_count; i++) {
+        job = gr_mpmc_queue_dequeue(&pool->workers[i].job_queue);
+        while (job) {
+            server_cleanup_message(pool->server, job);
+            job = gr_mpmc_queue_dequeue(&pool->workers[i].job_queue);
+        }
         cleanup_worker(&pool->workers[i]);
     }
 
@@ -116,101 +162,139 @@ void gracht_worker_pool_destroy(struct gracht_worker_pool* pool)
     free(pool);
 }
 
-void gracht_worker_pool_dispatch(struct gracht_worker_pool* pool, struct gracht_message* recvMessage)
+int gracht_worker_pool_dispatch(struct gracht_worker_pool* pool, struct gracht_message* recvMessage)
 {
-    struct gracht_worker* worker;
+    struct gracht_worker* worker = NULL;
+    unsigned int          start;
+    int                   i;
 
     if (!pool || !recvMessage) {
-        return;
+        errno = EINVAL;
+        return -1;
     }
 
-    worker = &pool->workers[pool->rr_index];
-    mtx_lock(&worker->sync_object);
-    gr_queue_enqueue(&worker->job_queue, recvMessage);
-    mtx_unlock(&worker->sync_object);
-    cnd_signal(&worker->signal);
-
-    // increase round robin index and handle limit
-    pool->rr_index++;
-    if (pool->rr_index == pool->worker_count) {
-        pool->rr_index = 0;
+    // spread the jobs over the worker queues, if the queue is full then move on to
+    // the next worker
+    start = atomic_fetch_add(&pool->rr_index, 1);
+    for (i = 0; i < pool->worker_count; i++) {
+        struct gracht_worker* target = &pool->workers[(start + i) % pool->worker_count];
+        if (!gr_mpmc_queue_enqueue(&target->job_queue, recvMessage)) {
+            worker = target;
+            break;
+        }
     }
-}
-
-static void initialize_worker(struct gracht_server* server, struct gracht_worker* worker)
-{
-    struct gracht_worker_context* context;
 
-    context = malloc(sizeof(struct gracht_worker_context));
-    if (!context) {
-        GRERROR(GRSTR("initialize_worker: failed to allocate memory for worker context"));
-        return;
+    if (!worker) {
+        errno = EBUSY;
+        return -1;
     }
 
-    context->worker = worker;
-    context->server = server;
+    // wake up the owner of the queue if it sleeps, otherwise wake up any sleeping worker
+    // so it can steal the job in case the owner is busy with a long running job
+    if (atomic_load(&worker->sleeping)) {
+        worker_wake(worker);
+    }
+    else if (atomic_load(&pool->sleepers)) {
+        for (i = 0; i < pool->worker_count; i++) {
+            if (atomic_load(&pool->workers[i].sleeping)) {
+                worker_wake(&pool->workers[i]);
+                break;
+            }
+        }
+    }
+    return 0;
+}
 
-    gr_queue_construct(&worker->job_queue, SERVER_WORKER_DEFAULT_QUEUE_SIZE);
+static int initialize_worker(struct gracht_worker_pool* pool, struct gracht_worker* worker, int index)
+{
     mtx_init(&worker->sync_object, mtx_plain);
     cnd_init(&worker->signal);
-    worker->state = WORKER_STARTUP;
+    atomic_store(&worker->sleeping, 0);
+    atomic_store(&worker->state, WORKER_STARTUP);
+    worker->index = index;
+    worker->pool  = pool;
 
-    if (thrd_create(&worker->id, worker_dowork, context) != thrd_success) {
-        GRERROR(GRSTR("initialize_worker: failed to create worker-thread"));
+    if (thrd_create(&worker->id, worker_dowork, worker) != thrd_success) {
+        atomic_store(&worker->state, WORKER_SHUTDOWN);
+        return -1;
     }
+    return 0;
 }
 
 static void cleanup_worker(struct gracht_worker* worker)
 {
     mtx_destroy(&worker->sync_object);
     cnd_destroy(&worker->signal);
-    gr_queue_destroy(&worker->job_queue);
+    gr_mpmc_queue_destroy(&worker->job_queue);
+}
+
+static struct gracht_message* worker_next_job(struct gracht_worker* worker)
+{
+    struct gracht_worker_pool* pool = worker->pool;
+    struct gracht_message*     job;
+    int                        i;
+
+    job = gr_mpmc_queue_dequeue(&worker->job_queue);
+    if (job) {
+        return job;
+    }
+
+    // steal from the other workers, start with our neighbour to spread out the thieves
+    for (i = 1; i < pool->worker_count; i++) {
+        struct gracht_worker* victim = &pool->workers[(worker->index + i) % pool->worker_count];
+        job = gr_mpmc_queue_dequeue(&victim->job_queue);
+        if (job) {
+            return job;
+        }
+    }
+    return NULL;
+}
+
+static struct gracht_message* worker_wait_job(struct gracht_worker* worker)
+{
+    struct gracht_message* job;
+
+    mtx_lock(&worker->sync_object);
+    atomic_store(&worker->sleeping, 1);
+    atomic_fetch_add(&worker->pool->sleepers, 1);
+
+    // check the queues again after announcing that we go to sleep, otherwise a job
+    // could be queued in between without anyone waking us up
+    job = worker_next_job(worker);
+    if (!job && atomic_load(&worker->state) == WORKER_ALIVE) {
+        cnd_wait(&worker->signal, &worker->sync_object);
+    }
+
+    atomic_fetch_sub(&worker->pool->sleepers, 1);
+    atomic_store(&worker->sleeping, 0);
+    mtx_unlock(&worker->sync_object);
+    return job;
 }
 
 static int worker_dowork(void* context)
 {
-    struct gracht_worker_context* workerContext = context;
-    struct gracht_message*        job;
-    struct gracht_worker*         worker;
+    struct gracht_worker*  worker = context;
+    struct gracht_message* job;
+    int                    expected = WORKER_STARTUP;
     GRTRACE(GRSTR("worker_dowork: running"));
 
-    worker = workerContext->worker;
-    worker->state = WORKER_ALIVE;
-    while (1) {
-        mtx_lock(&worker->sync_object);
-        job = gr_queue_dequeue(&worker->job_queue);
+    // the state may already have been changed by a shutdown request
+    atomic_compare_exchange_strong(&worker->state, &expected, WORKER_ALIVE);
+    while (atomic_load(&worker->state) == WORKER_ALIVE) {
+        job = worker_next_job(worker);
         if (!job) {
-            cnd_wait(&worker->signal, &worker->sync_object);
-            if (worker->state == WORKER_SHUTDOWN_REQUEST) {
-                worker->state = WORKER_SHUTDOWN;
-                mtx_unlock(&worker->sync_object);
-                break;
+            job = worker_wait_job(worker);
+            if (!job) {
+                continue;
             }
-
-            job = gr_queue_dequeue(&worker->job_queue);
-            // assert(job_header != NULL);
         }
-        mtx_unlock(&worker->sync_object);
 
         // handle the job
         GRTRACE(GRSTR("worker_dowork: handling message"));
-        server_invoke_action(workerContext->server, job);
-        server_cleanup_message(workerContext->server, job);
-
-        // check again at exit of iteration
-        if (worker->state == WORKER_SHUTDOWN_REQUEST) {
-            worker->state = WORKER_SHUTDOWN;
-            break;
-        }
+        server_handle_message(worker->pool->server, job);
     }
     GRTRACE(GRSTR("worker_dowork: shutting down"));
 
-    job = gr_queue_dequeue(&worker->job_queue);
-    while (job) {
-        server_cleanup_message(workerContext->server, job);
-        job = gr_queue_dequeue(&worker->job_queue);
-    }
-
-    free(workerContext);
+    atomic_store(&worker->state, WORKER_SHUTDOWN);
     return 0;
 }
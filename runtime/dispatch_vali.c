@@ -34,10 +34,11 @@ struct gracht_worker_pool {
     struct gracht_server*  server;
 };
 
-int gracht_worker_pool_create(struct gracht_server* server, int numberOfWorkers, struct gracht_worker_pool** poolOut)
+int gracht_worker_pool_create(struct gracht_server* server, int numberOfWorkers, int queueCapacity, struct gracht_worker_pool** poolOut)
 {
     struct gracht_worker_pool* pool;
     _CRT_UNUSED(numberOfWorkers);
+    _CRT_UNUSED(queueCapacity);
 
     pool = malloc(sizeof(struct gracht_worker_pool));
     if (pool == NULL) {
@@ -68,8 +69,7 @@ static void __handle_message(void* context, void* cancellationToken)
         return;
     }
 
-    server_invoke_action(handleContext->server, handleContext->message);
-    server_cleanup_message(handleContext->server, handleContext->message);
+    server_handle_message(handleContext->server, handleContext->message);
     free(handleContext);
 }
 
@@ -86,10 +86,21 @@ static struct handle_context* __handle_context_new(struct gracht_server* server,
     return context;
 }
 
-void gracht_worker_pool_dispatch(struct gracht_worker_pool* pool, struct gracht_message* recvMessage)
+int gracht_worker_pool_dispatch(struct gracht_worker_pool* pool, struct gracht_message* recvMessage)
 {
+    struct handle_context* context;
+
     if (!pool || !recvMessage) {
-        return;
+        errno = EINVAL;
+        return -1;
     }
-    usched_job_queue(__handle_message, __handle_context_new(pool->server, recvMessage));
+
+    // the usched job queue is unbounded, so the only failure is running out of memory
+    context = __handle_context_new(pool->server, recvMessage);
+    if (!context) {
+        errno = EBUSY;
+        return -1;
+    }
+    usched_job_queue(__handle_message, context);
+    return 0;
 }
@@ -0,0 +1,104 @@
+/**
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Gracht Message Fragmentation Implementation
+ * - Splitting of large messages into frames, and assembling them again
+ */
+
+#include <errno.h>
+#include "fragment.h"
+#include "utils.h"
+#include <string.h>
+
+void gracht_fragmenter_init(struct gracht_fragmenter* fragmenter, const void* message, uint32_t length, uint32_t frameSize)
+{
+    fragmenter->message    = message;
+    fragmenter->length     = length;
+    fragmenter->offset     = 0;
+    fragmenter->frame_size = frameSize;
+}
+
+int gracht_fragmenter_next(struct gracht_fragmenter* fragmenter, struct gracht_buffer* frame)
+{
+    uint32_t chunkLength = fragmenter->frame_size - GRACHT_MESSAGE_HEADER_SIZE;
+    uint8_t  flags       = fragmenter->message[MSG_INDEX_FLG];
+
+    if (fragmenter->offset == fragmenter->length) {
+        return 0;
+    }
+
+    if (chunkLength > fragmenter->length - fragmenter->offset) {
+        chunkLength = fragmenter->length - fragmenter->offset;
+    }
+
+    // the first frame keeps all flags of the message, as descriptors are sent along with it
+    if (!fragmenter->offset) {
+        flags |= MESSAGE_FLAG_FRAGMENT | MESSAGE_FLAG_FRAGMENT_START;
+    }
+    else {
+        flags = MESSAGE_FLAG_TYPE(flags) | MESSAGE_FLAG_FRAGMENT;
+    }
+
+    GB_MSG_ID_0(frame)  = *((const uint32_t*)&fragmenter->message[MSG_INDEX_ID]);
+    GB_MSG_LEN_0(frame) = GRACHT_MESSAGE_HEADER_SIZE + chunkLength;
+    GB_MSG_SID_0(frame) = fragmenter->message[MSG_INDEX_SID];
+    GB_MSG_AID_0(frame) = fragmenter->message[MSG_INDEX_AID];
+    GB_MSG_FLG_0(frame) = flags;
+    memcpy(&frame->data[GRACHT_MESSAGE_HEADER_SIZE], &fragmenter->message[fragmenter->offset], chunkLength);
+
+    frame->index        = GRACHT_MESSAGE_HEADER_SIZE + chunkLength;
+    fragmenter->offset += chunkLength;
+    return 1;
+}
+
+uint32_t gracht_assembly_length(const void* frame)
+{
+    const uint8_t* bytes       = frame;
+    uint32_t       frameLength = *((const uint32_t*)&bytes[MSG_INDEX_LEN]);
+    uint32_t       length;
+
+    // the header of the message itself must be in the first frame
+    if (!(bytes[MSG_INDEX_FLG] & MESSAGE_FLAG_FRAGMENT_START) ||
+        frameLength < (2 * GRACHT_MESSAGE_HEADER_SIZE)) {
+        return 0;
+    }
+
+    length = *((const uint32_t*)&bytes[GRACHT_MESSAGE_HEADER_SIZE + MSG_INDEX_LEN]);
+    if (length < frameLength - GRACHT_MESSAGE_HEADER_SIZE) {
+        return 0;
+    }
+    return length;
+}
+
+int gracht_assembly_append(struct gracht_assembly* assembly, const void* frame)
+{
+    const uint8_t* bytes       = frame;
+    uint32_t       chunkLength = *((const uint32_t*)&bytes[MSG_INDEX_LEN]) - GRACHT_MESSAGE_HEADER_SIZE;
+    int            start       = (bytes[MSG_INDEX_FLG] & MESSAGE_FLAG_FRAGMENT_START) != 0;
+
+    // frames of a message are never mixed with those of others, so anything out of order
+    // means frames were lost
+    if (start != (assembly->offset == 0) || chunkLength > assembly->length - assembly->offset ||
+        (!start && memcmp(&bytes[MSG_INDEX_ID], &assembly->data[MSG_INDEX_ID], sizeof(uint32_t)))) {
+        errno = EPROTO;
+        return -1;
+    }
+
+    memcpy(&assembly->data[assembly->offset], &bytes[GRACHT_MESSAGE_HEADER_SIZE], chunkLength);
+    assembly->offset += chunkLength;
+    return assembly->offset == assembly->length;
+}
@@ -0,0 +1,270 @@
+/**
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Gracht Shared Memory Link Type Definitions & Structures
+ * - This header describes the base link-structure, prototypes
+ *   and functionality, refer to the individual things for descriptions
+ */
+
+#if !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // POLLRDHUP
+#endif
+
+#include <errno.h>
+#include "logging.h"
+#include "private.h"
+#include <poll.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static void drain_doorbell(int eventfd)
+{
+    uint64_t value;
+    (void)read(eventfd, &value, sizeof(uint64_t));
+}
+
+// The server is woken up by writing to the connection socket, which it has in its aio set
+static void notify_server(struct gracht_link_shm* link)
+{
+    uint8_t value = 0;
+    (void)send(link->control, &value, 1, MSG_DONTWAIT | MSG_NOSIGNAL);
+}
+
+// Waits for the doorbell, returns -1 with EPIPE if the server has gone away
+static int wait_doorbell(struct gracht_link_shm* link, int doorbell)
+{
+    struct pollfd fds[2] = {
+        { .fd = doorbell,      .events = POLLIN },
+        { .fd = link->control, .events = POLLRDHUP }
+    };
+
+    if (poll(&fds[0], 2, -1) < 0) {
+        return errno == EINTR ? 0 : -1;
+    }
+
+    if (fds[1].revents & (POLLRDHUP | POLLHUP | POLLERR)) {
+        errno = EPIPE;
+        return -1;
+    }
+    drain_doorbell(doorbell);
+    return 0;
+}
+
+static int shm_link_send(struct gracht_link_shm* link,
+    struct gracht_buffer* message, void* messageContext)
+{
+    uint32_t offset = 0;
+    (void)messageContext;
+
+    if (message->index > link->send_ring->size) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+
+    // messages larger than the free space are written in parts as the server consumes them
+    while (1) {
+        offset += shm_ring_write(link->send_ring, &message->data[offset], message->index - offset);
+        if (shm_ring_wake_consumer(link->send_ring)) {
+            notify_server(link);
+        }
+
+        if (offset == message->index) {
+            break;
+        }
+
+        if (!shm_ring_wait_space(link->send_ring) && wait_doorbell(link, link->space_doorbell)) {
+            GRERROR(GRSTR("link_client: failed to send message, bytes sent: %u, expected: %u (%i)"),
+                offset, message->index, errno);
+            errno = EPIPE;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int shm_link_recv(struct gracht_link_shm* link,
+    struct gracht_buffer* message, unsigned int flags)
+{
+    uint32_t length;
+
+    while (!shm_ring_has_message(link->recv_ring)) {
+        length = shm_ring_message_length(link->recv_ring);
+        if (length > link->recv_ring->size) {
+            break;
+        }
+
+        // reset the doorbell before checking the ring one last time, so a wakeup
+        // for what is written after the check is not lost
+        drain_doorbell(link->base.connection);
+        if (shm_ring_wait_message(link->recv_ring)) {
+            break;
+        }
+
+        if (!(flags & GRACHT_MESSAGE_BLOCK)) {
+            errno = ENODATA;
+            return -1;
+        }
+
+        if (wait_doorbell(link, link->base.connection)) {
+            return -1;
+        }
+    }
+
+    length = shm_ring_message_length(link->recv_ring);
+    if (length < GRACHT_MESSAGE_HEADER_SIZE || length > message->index) {
+        GRERROR(GRSTR("[gracht_connection_recv_message] invalid message length %u"), length);
+        errno = EPIPE;
+        return -1;
+    }
+
+    shm_ring_peek(link->recv_ring, 0, &message->data[0], length);
+    shm_ring_consume(link->recv_ring, length);
+    if (shm_ring_wake_producer(link->recv_ring)) {
+        notify_server(link);
+    }
+
+    message->index = 0;
+    return 0;
+}
+
+static int recv_handshake(struct gracht_link_shm* link)
+{
+    struct shm_link_handshake handshake;
+    struct msghdr             msg = { 0 };
+    struct iovec              iov = { &handshake, sizeof(struct shm_link_handshake) };
+    union {
+        char           buffer[CMSG_SPACE(3 * sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    struct cmsghdr* cmsg;
+    int             fds[3];
+    ssize_t         bytesRead;
+
+    msg.msg_iov        = &iov;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = control.buffer;
+    msg.msg_controllen = sizeof(control.buffer);
+
+    bytesRead = recvmsg(link->control, &msg, MSG_CMSG_CLOEXEC);
+    cmsg      = CMSG_FIRSTHDR(&msg);
+    if (!cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS ||
+        cmsg->cmsg_len != CMSG_LEN(3 * sizeof(int))) {
+        errno = EPROTO;
+        return -1;
+    }
+    memcpy(&fds[0], CMSG_DATA(cmsg), sizeof(fds));
+
+    link->base.connection = fds[1];
+    link->space_doorbell  = fds[2];
+    if (bytesRead != (ssize_t)sizeof(struct shm_link_handshake) ||
+        handshake.magic != SHM_LINK_MAGIC || handshake.ring_size < SHM_LINK_MIN_RING_SIZE ||
+        (handshake.ring_size & (handshake.ring_size - 1))) {
+        close(fds[0]);
+        errno = EPROTO;
+        return -1;
+    }
+
+    link->ring_size   = handshake.ring_size;
+    link->memory_size = shm_memory_size(handshake.ring_size);
+    link->memory      = mmap(NULL, link->memory_size, PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0);
+    close(fds[0]);
+    if (link->memory == MAP_FAILED) {
+        link->memory = NULL;
+        return -1;
+    }
+
+    link->send_ring = shm_ring_get(link->memory, link->ring_size, 0);
+    link->recv_ring = shm_ring_get(link->memory, link->ring_size, 1);
+    return 0;
+}
+
+static void shm_link_close(struct gracht_link_shm* link)
+{
+    if (link->memory) {
+        munmap(link->memory, link->memory_size);
+        link->memory = NULL;
+    }
+    if (link->base.connection != GRACHT_CONN_INVALID) {
+        close(link->base.connection);
+        link->base.connection = GRACHT_CONN_INVALID;
+    }
+    if (link->space_doorbell >= 0) {
+        close(link->space_doorbell);
+        link->space_doorbell = -1;
+    }
+    if (link->control >= 0) {
+        close(link->control);
+        link->control = -1;
+    }
+}
+
+static gracht_conn_t shm_link_connect(struct gracht_link_shm* link)
+{
+    int status;
+
+    if (link->loopback) {
+        link->control = shm_loopback_connect(link);
+        if (link->control < 0) {
+            GRERROR(GRSTR("link_client: failed to connect to %s"), link->address.sun_path);
+            return GRACHT_CONN_INVALID;
+        }
+    }
+    else {
+        link->control = socket(AF_LOCAL, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        if (link->control < 0) {
+            GRERROR(GRSTR("link_client: failed to create socket"));
+            return GRACHT_CONN_INVALID;
+        }
+
+        status = connect(link->control, (const struct sockaddr*)&link->address, sizeof(struct sockaddr_un));
+        if (status) {
+            GRERROR(GRSTR("link_client: failed to connect to %s"), link->address.sun_path);
+            shm_link_close(link);
+            return GRACHT_CONN_INVALID;
+        }
+    }
+
+    // the server sets up the shared memory when it accepts us
+    status = recv_handshake(link);
+    if (status) {
+        GRERROR(GRSTR("link_client: failed to map shared memory: %i"), errno);
+        shm_link_close(link);
+        return GRACHT_CONN_INVALID;
+    }
+
+    // the data doorbell is the descriptor to wait on for incoming messages
+    return link->base.connection;
+}
+
+static void shm_link_destroy(struct gracht_link_shm* link)
+{
+    if (!link) {
+        return;
+    }
+
+    shm_link_close(link);
+    free(link);
+}
+
+void gracht_link_client_shm_api(struct gracht_link_shm* link)
+{
+    link->base.ops.client.connect = (client_link_connect_fn)shm_link_connect;
+    link->base.ops.client.recv    = (client_link_recv_fn)shm_link_recv;
+    link->base.ops.client.send    = (client_link_send_fn)shm_link_send;
+    link->base.ops.client.destroy = (client_link_destroy_fn)shm_link_destroy;
+}
@@ -0,0 +1,166 @@
+/**
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Gracht Loopback Link Type Definitions & Structures
+ * - The loopback link is the shared memory link with the unix socket rendezvous replaced by an
+ *   in-process one. Listening links are registered by name, and connecting clients hand them
+ *   one end of a socket pair. The eventfd of the listening link counts the pending connections.
+ */
+
+#include <errno.h>
+#include <gracht/link/loopback.h>
+#include "logging.h"
+#include "private.h"
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+// protects the list of listening links and their pending connections
+static atomic_flag             g_loopbackLock      = ATOMIC_FLAG_INIT;
+static struct gracht_link_shm* g_loopbackListeners = NULL;
+
+static void loopback_lock(void)
+{
+    while (atomic_flag_test_and_set_explicit(&g_loopbackLock, memory_order_acquire));
+}
+
+static void loopback_unlock(void)
+{
+    atomic_flag_clear_explicit(&g_loopbackLock, memory_order_release);
+}
+
+static struct gracht_link_shm* loopback_find(const char* name)
+{
+    struct gracht_link_shm* link = g_loopbackListeners;
+    while (link && strcmp(link->address.sun_path, name)) {
+        link = link->loopback_next;
+    }
+    return link;
+}
+
+gracht_conn_t shm_loopback_listen(struct gracht_link_shm* link)
+{
+    int listener = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK | EFD_SEMAPHORE);
+    if (listener < 0) {
+        return GRACHT_CONN_INVALID;
+    }
+
+    loopback_lock();
+    if (loopback_find(link->address.sun_path)) {
+        loopback_unlock();
+        GRERROR(GRSTR("shm_loopback_listen %s is already in use"), link->address.sun_path);
+        close(listener);
+        errno = EADDRINUSE;
+        return GRACHT_CONN_INVALID;
+    }
+    link->pending_count = 0;
+    link->loopback_next = g_loopbackListeners;
+    g_loopbackListeners = link;
+    loopback_unlock();
+    return listener;
+}
+
+void shm_loopback_unlisten(struct gracht_link_shm* link)
+{
+    struct gracht_link_shm** itr;
+
+    loopback_lock();
+    for (itr = &g_loopbackListeners; *itr; itr = &(*itr)->loopback_next) {
+        if (*itr == link) {
+            *itr = link->loopback_next;
+            break;
+        }
+    }
+
+    // clients that are waiting for the handshake see the connection close
+    while (link->pending_count) {
+        close(link->pending[--link->pending_count]);
+    }
+    loopback_unlock();
+}
+
+int shm_loopback_accept(struct gracht_link_shm* link)
+{
+    uint64_t value;
+    int      connection;
+
+    // each read takes one pending connection, as the eventfd is a semaphore
+    if (read(link->base.connection, &value, sizeof(uint64_t)) != sizeof(uint64_t)) {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    loopback_lock();
+    connection = link->pending[0];
+    link->pending_count--;
+    memmove(&link->pending[0], &link->pending[1], sizeof(int) * (size_t)link->pending_count);
+    loopback_unlock();
+    return connection;
+}
+
+int shm_loopback_connect(struct gracht_link_shm* link)
+{
+    struct gracht_link_shm* listener;
+    uint64_t                value = 1;
+    int                     fds[2];
+
+    if (socketpair(AF_LOCAL, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds)) {
+        return -1;
+    }
+
+    loopback_lock();
+    listener = loopback_find(link->address.sun_path);
+    if (!listener || listener->pending_count == SHM_LOOPBACK_BACKLOG) {
+        loopback_unlock();
+        close(fds[0]);
+        close(fds[1]);
+        errno = ECONNREFUSED;
+        return -1;
+    }
+    listener->pending[listener->pending_count++] = fds[1];
+    (void)write(listener->base.connection, &value, sizeof(uint64_t));
+    loopback_unlock();
+    return fds[0];
+}
+
+int gracht_link_loopback_create(struct gracht_link_loopback** linkOut)
+{
+    struct gracht_link_shm* link;
+
+    if (gracht_link_shm_create(&link)) {
+        return -1;
+    }
+
+    link->loopback = 1;
+    *linkOut = (struct gracht_link_loopback*)link;
+    return 0;
+}
+
+void gracht_link_loopback_set_listen(struct gracht_link_loopback* link, int listen)
+{
+    gracht_link_shm_set_listen((struct gracht_link_shm*)link, listen);
+}
+
+void gracht_link_loopback_set_name(struct gracht_link_loopback* link, const char* name)
+{
+    gracht_link_shm_set_path((struct gracht_link_shm*)link, name);
+}
+
+void gracht_link_loopback_set_ring_size(struct gracht_link_loopback* link, size_t size)
+{
+    gracht_link_shm_set_ring_size((struct gracht_link_shm*)link, size);
+}
@@ -0,0 +1,242 @@
+/**
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Gracht Shared Memory Link Type Definitions & Structures
+ * - Each client gets a memfd from the server that holds two single producer, single consumer
+ *   byte rings, one in each direction. The side that waits on an empty or a full ring marks
+ *   itself as waiting, and only then does the other side ring its doorbell. The client waits
+ *   on eventfds, while the doorbell of the server is the connection socket of the client, as
+ *   that gives the server disconnect events through its aio set like any other socket.
+ */
+
+#ifndef __GRACHT_SHM_PRIVATE_H__
+#define __GRACHT_SHM_PRIVATE_H__
+
+#include "config.h"
+#include "gatomic.h"
+#include <gracht/link/shm.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <utils.h>
+
+#if defined(GRACHT_AIO_URING)
+#include "aio_uring.h"
+
+#define shm_aio_add(aio, iod)                            gracht_uring_add(aio, iod)
+#define shm_aio_remove(aio, iod)                         gracht_uring_remove(aio, iod)
+#define shm_aio_accept(aio, iod, address, addressLength) gracht_uring_accept(aio, iod, address, addressLength)
+#else
+#include <sys/epoll.h>
+
+static int shm_aio_add(int aio, int iod) {
+    struct epoll_event event = {
+        .events = EPOLLIN | EPOLLRDHUP,
+        .data.fd = iod
+    };
+    return epoll_ctl(aio, EPOLL_CTL_ADD, iod, &event);
+}
+
+#define shm_aio_remove(aio, iod)                         epoll_ctl(aio, EPOLL_CTL_DEL, iod, NULL)
+#define shm_aio_accept(aio, iod, address, addressLength) accept(iod, address, addressLength)
+#endif
+
+#define SHM_LINK_MAGIC         0x4D485347 // GSHM
+#define SHM_LINK_MIN_RING_SIZE (64 * 1024)
+#define SHM_LOOPBACK_BACKLOG   16
+
+// The server sends this to the client together with the memfd, and the data and space
+// doorbells of the client, in that order
+struct shm_link_handshake {
+    uint32_t magic;
+    uint32_t ring_size;
+};
+
+// Head and tail are free running byte counters. The consumer owns the head and the producer
+// the tail, they are kept on seperate cache lines.
+struct shm_ring {
+    atomic_uint head;
+    atomic_int  consumer_waiting;
+    uint8_t     consumer_padding[56];
+    atomic_uint tail;
+    atomic_int  producer_waiting;
+    uint8_t     producer_padding[56];
+    uint32_t    size;
+    uint8_t     padding[60];
+    uint8_t     data[];
+};
+
+struct gracht_link_shm {
+    struct gracht_link base;
+    int                listen;
+    struct sockaddr_un address;
+    uint32_t           ring_size;
+    gracht_handle_t    set_handle;
+
+    // loopback links connect in-process, the name is kept in the address
+    int                     loopback;
+    struct gracht_link_shm* loopback_next;
+    int                     pending[SHM_LOOPBACK_BACKLOG];
+    int                     pending_count;
+
+    // client side of the link
+    void*            memory;
+    size_t           memory_size;
+    int              control;
+    int              space_doorbell;
+    struct shm_ring* send_ring;
+    struct shm_ring* recv_ring;
+};
+
+// loopback.c, the in-process replacement for listen, accept and connect. The connection is
+// a socket pair, so the shm handshake and disconnect events work the same way.
+gracht_conn_t shm_loopback_listen(struct gracht_link_shm* link);
+void          shm_loopback_unlisten(struct gracht_link_shm* link);
+int           shm_loopback_accept(struct gracht_link_shm* link);
+int           shm_loopback_connect(struct gracht_link_shm* link);
+
+static inline size_t shm_memory_size(uint32_t ringSize)
+{
+    return 2 * (sizeof(struct shm_ring) + ringSize);
+}
+
+// The first ring carries messages from the client to the server
+static inline struct shm_ring* shm_ring_get(void* memory, uint32_t ringSize, int index)
+{
+    return (struct shm_ring*)((uint8_t*)memory + ((size_t)index * (sizeof(struct shm_ring) + ringSize)));
+}
+
+static inline uint32_t shm_ring_used(struct shm_ring* ring)
+{
+    return atomic_load_explicit(&ring->tail, memory_order_acquire) -
+        atomic_load_explicit(&ring->head, memory_order_relaxed);
+}
+
+static inline uint32_t shm_ring_free(struct shm_ring* ring)
+{
+    return ring->size - (atomic_load_explicit(&ring->tail, memory_order_relaxed) -
+        atomic_load_explicit(&ring->head, memory_order_acquire));
+}
+
+// Copies data at the given offset from the head without consuming it
+static inline void shm_ring_peek(struct shm_ring* ring, uint32_t offset, void* data, uint32_t length)
+{
+    uint32_t index = (atomic_load_explicit(&ring->head, memory_order_relaxed) + offset) & (ring->size - 1);
+    uint32_t first = ring->size - index;
+
+    if (first >= length) {
+        memcpy(data, &ring->data[index], length);
+    }
+    else {
+        memcpy(data, &ring->data[index], first);
+        memcpy((uint8_t*)data + first, &ring->data[0], length - first);
+    }
+}
+
+static inline void shm_ring_consume(struct shm_ring* ring, uint32_t length)
+{
+    atomic_fetch_add_explicit(&ring->head, length, memory_order_release);
+}
+
+// Returns the length of the message at the head, or 0 if not even the header is there yet
+static inline uint32_t shm_ring_message_length(struct shm_ring* ring)
+{
+    uint32_t length;
+
+    if (shm_ring_used(ring) < GRACHT_MESSAGE_HEADER_SIZE) {
+        return 0;
+    }
+    shm_ring_peek(ring, 4, &length, sizeof(uint32_t));
+    return length;
+}
+
+static inline int shm_ring_has_message(struct shm_ring* ring)
+{
+    uint32_t length = shm_ring_message_length(ring);
+    return length && shm_ring_used(ring) >= length;
+}
+
+// Writes as much of the data as there is room for, and returns the number of bytes written
+static inline uint32_t shm_ring_write(struct shm_ring* ring, const void* data, uint32_t length)
+{
+    uint32_t tail  = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t space = shm_ring_free(ring);
+    uint32_t index = tail & (ring->size - 1);
+    uint32_t first = ring->size - index;
+
+    if (length > space) {
+        length = space;
+    }
+
+    if (first >= length) {
+        memcpy(&ring->data[index], data, length);
+    }
+    else {
+        memcpy(&ring->data[index], data, first);
+        memcpy(&ring->data[0], (const uint8_t*)data + first, length - first);
+    }
+    atomic_store_explicit(&ring->tail, tail + length, memory_order_release);
+    return length;
+}
+
+// Marks the consumer as waiting for data, and returns non-zero if a complete message arrived
+// meanwhile. Otherwise the producer rings the doorbell when it writes more.
+static inline int shm_ring_wait_message(struct shm_ring* ring)
+{
+    atomic_store(&ring->consumer_waiting, 1);
+    atomic_thread_fence(memory_order_seq_cst);
+    return shm_ring_has_message(ring);
+}
+
+// Marks the producer as waiting for space, and returns non-zero if space was made meanwhile.
+// Otherwise the consumer rings the doorbell when it consumes more.
+static inline int shm_ring_wait_space(struct shm_ring* ring)
+{
+    atomic_store(&ring->producer_waiting, 1);
+    atomic_thread_fence(memory_order_seq_cst);
+    return shm_ring_free(ring) != 0;
+}
+
+// Returns non-zero if the consumer must be woken up after the producer wrote to the ring
+static inline int shm_ring_wake_consumer(struct shm_ring* ring)
+{
+    atomic_thread_fence(memory_order_seq_cst);
+    return atomic_load_explicit(&ring->consumer_waiting, memory_order_relaxed) &&
+        atomic_exchange(&ring->consumer_waiting, 0);
+}
+
+// Returns non-zero if the producer must be woken up after the consumer consumed from the ring
+static inline int shm_ring_wake_producer(struct shm_ring* ring)
+{
+    atomic_thread_fence(memory_order_seq_cst);
+    return atomic_load_explicit(&ring->producer_waiting, memory_order_relaxed) &&
+        atomic_exchange(&ring->producer_waiting, 0);
+}
+
+static inline void shm_ring_init(struct shm_ring* ring, uint32_t size)
+{
+    atomic_store(&ring->head, 0);
+    atomic_store(&ring->tail, 0);
+    atomic_store(&ring->producer_waiting, 0);
+
+    // nobody is reading yet, so the first message must ring the doorbell
+    atomic_store(&ring->consumer_waiting, 1);
+    ring->size = size;
+}
+
+#endif // !__GRACHT_SHM_PRIVATE_H__
@@ -0,0 +1,467 @@
+/**
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Gracht Shared Memory Link Type Definitions & Structures
+ * - This header describes the base link-structure, prototypes
+ *   and functionality, refer to the individual things for descriptions
+ */
+
+#if !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // memfd_create, POLLRDHUP
+#endif
+
+#include <errno.h>
+#include "logging.h"
+#include "private.h"
+#include "server_private.h"
+#include <poll.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+struct shm_link_client {
+    struct gracht_server_client base;
+    gracht_conn_t               link;
+    void*                       memory;
+    size_t                      memory_size;
+    struct shm_ring*            recv_ring;
+    struct shm_ring*            send_ring;
+    int                         data_doorbell;
+    int                         space_doorbell;
+};
+
+static void ring_doorbell(int eventfd)
+{
+    uint64_t value = 1;
+    (void)write(eventfd, &value, sizeof(uint64_t));
+}
+
+// Messages that are too small to hold the header, or too large for the server to receive
+// can not be recovered from, as the rest of the ring can no longer be trusted.
+static int shm_link_recv_client(struct shm_link_client* client,
+    struct gracht_message* context, unsigned int flags)
+{
+    uint32_t length;
+    (void)flags;
+
+    if (!shm_ring_has_message(client->recv_ring)) {
+        shm_ring_wait_message(client->recv_ring);
+    }
+
+    length = shm_ring_message_length(client->recv_ring);
+    if (length && (length < GRACHT_MESSAGE_HEADER_SIZE || length > context->index ||
+        length > client->recv_ring->size)) {
+        GRERROR(GRSTR("shm_link_recv_client invalid message length %u"), length);
+        errno = EFAULT;
+        return -1;
+    }
+
+    if (!length || shm_ring_used(client->recv_ring) < length) {
+        errno = ENODATA;
+        return -1;
+    }
+
+    shm_ring_peek(client->recv_ring, 0, &context->payload[0], length);
+    shm_ring_consume(client->recv_ring, length);
+    if (shm_ring_wake_producer(client->recv_ring)) {
+        ring_doorbell(client->space_doorbell);
+    }
+
+    // ->server is set by server
+    context->link   = client->link;
+    context->client = client->base.handle;
+    context->index  = 0;
+    context->size   = length;
+    return 0;
+}
+
+static int shm_link_pending_client(struct shm_link_client* client)
+{
+    return shm_ring_has_message(client->recv_ring);
+}
+
+// The doorbell of the server is the connection socket, so it must be emptied on each read
+// event. What is written to it does not matter, the rings are checked afterwards.
+static int shm_link_writable_client(struct shm_link_client* client)
+{
+    uint8_t buffer[64];
+
+    while (recv(client->base.handle, &buffer[0], sizeof(buffer), MSG_DONTWAIT) > 0);
+    return shm_ring_free(client->send_ring) != 0 || shm_ring_wait_space(client->send_ring);
+}
+
+// Returns non-zero if the client has gone away
+static int client_disconnected(struct shm_link_client* client)
+{
+    struct pollfd fds = { .fd = client->base.handle, .events = POLLRDHUP };
+    return poll(&fds, 1, 0) > 0 && (fds.revents & (POLLRDHUP | POLLHUP | POLLERR));
+}
+
+// Waits for the client to make room in the ring, the doorbell of the server is handled by
+// the reactor so this polls the ring instead.
+static int wait_space(struct shm_link_client* client)
+{
+    struct timespec ts = { .tv_sec = 0, .tv_nsec = 50000 };
+
+    while (!shm_ring_free(client->send_ring)) {
+        if (client_disconnected(client)) {
+            errno = EPIPE;
+            return -1;
+        }
+        nanosleep(&ts, NULL);
+    }
+    return 0;
+}
+
+static int shm_link_send_client_vec(struct shm_link_client* client,
+    struct gracht_buffer* messages, int count, unsigned int flags, size_t* bytesWrittenOut)
+{
+    struct shm_ring* ring = client->send_ring;
+    int              status = 0;
+    int              i;
+
+    *bytesWrittenOut = 0;
+    for (i = 0; i < count; i++) {
+        uint32_t offset = 0;
+
+        if (messages[i].index > ring->size) {
+            errno = EMSGSIZE;
+            status = -1;
+            break;
+        }
+
+        // the ring is a byte stream, so messages can be written in parts
+        while (offset < messages[i].index) {
+            offset += shm_ring_write(ring, &messages[i].data[offset], messages[i].index - offset);
+            if (offset == messages[i].index) {
+                break;
+            }
+
+            // let the client start on what has been written while we wait
+            if (shm_ring_wake_consumer(ring)) {
+                ring_doorbell(client->data_doorbell);
+            }
+
+            if (shm_ring_wait_space(ring)) {
+                continue;
+            }
+
+            if (!(flags & GRACHT_MESSAGE_BLOCK)) {
+                break;
+            }
+
+            if (wait_space(client)) {
+                status = -1;
+                break;
+            }
+        }
+
+        *bytesWrittenOut += offset;
+        if (offset != messages[i].index) {
+            break;
+        }
+    }
+
+    if (*bytesWrittenOut && shm_ring_wake_consumer(ring)) {
+        ring_doorbell(client->data_doorbell);
+    }
+    return status;
+}
+
+static int shm_link_send_client(struct shm_link_client* client,
+    struct gracht_buffer* message, unsigned int flags)
+{
+    size_t bytesWritten;
+
+    // without the vectored variant a message is either written completely or not at all
+    if (!(flags & GRACHT_MESSAGE_BLOCK) && shm_ring_free(client->send_ring) < message->index &&
+        shm_ring_wait_space(client->send_ring) && shm_ring_free(client->send_ring) < message->index) {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    if (shm_link_send_client_vec(client, message, 1, flags, &bytesWritten)) {
+        return -1;
+    }
+    if (bytesWritten != message->index) {
+        errno = EAGAIN;
+        return -1;
+    }
+    return 0;
+}
+
+static int shm_link_create_client(struct gracht_link_shm* link, struct gracht_message* message,
+    struct shm_link_client** clientOut)
+{
+    (void)link;
+    (void)message;
+    (void)clientOut;
+    errno = ENOSYS;
+    return -1;
+}
+
+static int shm_link_destroy_client(struct shm_link_client* client, gracht_handle_t set_handle)
+{
+    int status;
+
+    if (!client) {
+        errno = (EINVAL);
+        return -1;
+    }
+
+    status = shm_aio_remove(set_handle, client->base.handle);
+    if (status) {
+        GRWARNING(GRSTR("shm_link_destroy_client failed to remove client socket from set_handle"));
+    }
+
+    if (client->memory) {
+        munmap(client->memory, client->memory_size);
+    }
+    if (client->data_doorbell >= 0) {
+        close(client->data_doorbell);
+    }
+    if (client->space_doorbell >= 0) {
+        close(client->space_doorbell);
+    }
+    status = close(client->base.handle);
+    free(client);
+    return status;
+}
+
+// Creates the shared memory of the client, and sends it together with the doorbells of the
+// client over the connection socket.
+static int send_handshake(struct gracht_link_shm* link, struct shm_link_client* client)
+{
+    struct shm_link_handshake handshake = { SHM_LINK_MAGIC, link->ring_size };
+    struct msghdr             msg       = { 0 };
+    struct iovec              iov       = { &handshake, sizeof(struct shm_link_handshake) };
+    union {
+        char           buffer[CMSG_SPACE(3 * sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    struct cmsghdr* cmsg;
+    int             fds[3];
+    int             memfd;
+    int             status = -1;
+
+    memfd = memfd_create("gracht-shm", MFD_CLOEXEC);
+    if (memfd < 0) {
+        return -1;
+    }
+
+    client->memory_size = shm_memory_size(link->ring_size);
+    if (ftruncate(memfd, (off_t)client->memory_size)) {
+        goto exit;
+    }
+
+    client->memory = mmap(NULL, client->memory_size, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+    if (client->memory == MAP_FAILED) {
+        client->memory = NULL;
+        goto exit;
+    }
+
+    client->recv_ring = shm_ring_get(client->memory, link->ring_size, 0);
+    client->send_ring = shm_ring_get(client->memory, link->ring_size, 1);
+    shm_ring_init(client->recv_ring, link->ring_size);
+    shm_ring_init(client->send_ring, link->ring_size);
+
+    client->data_doorbell  = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    client->space_doorbell = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (client->data_doorbell < 0 || client->space_doorbell < 0) {
+        goto exit;
+    }
+
+    fds[0] = memfd;
+    fds[1] = client->data_doorbell;
+    fds[2] = client->space_doorbell;
+
+    memset(&control, 0, sizeof(control));
+    msg.msg_iov        = &iov;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = control.buffer;
+    msg.msg_controllen = sizeof(control.buffer);
+    cmsg               = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level   = SOL_SOCKET;
+    cmsg->cmsg_type    = SCM_RIGHTS;
+    cmsg->cmsg_len     = CMSG_LEN(3 * sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fds[0], sizeof(fds));
+
+    if (sendmsg(client->base.handle, &msg, MSG_NOSIGNAL) == (ssize_t)sizeof(struct shm_link_handshake)) {
+        status = 0;
+    }
+
+exit:
+    close(memfd);
+    return status;
+}
+
+static int shm_link_accept(struct gracht_link_shm* link, gracht_handle_t set_handle,
+    struct shm_link_client** clientOut)
+{
+    struct shm_link_client* client;
+    int                     status;
+    GRTRACE(GRSTR("shm_link_accept"));
+
+    client = (struct shm_link_client*)malloc(sizeof(struct shm_link_client));
+    if (!client) {
+        GRERROR(GRSTR("shm_link_accept failed to allocate data for link"));
+        errno = (ENOMEM);
+        return -1;
+    }
+
+    memset(client, 0, sizeof(struct shm_link_client));
+    client->link           = link->base.connection;
+    client->data_doorbell  = -1;
+    client->space_doorbell = -1;
+
+    // the listen socket belongs to the set it was setup with, which is not necessarily
+    // the one the client is added to
+    if (link->loopback) {
+        client->base.handle = shm_loopback_accept(link);
+    }
+    else {
+        client->base.handle = shm_aio_accept(link->set_handle, link->base.connection, NULL, NULL);
+    }
+    if (client->base.handle < 0) {
+        GRERROR(GRSTR("shm_link_accept failed to accept client: %i"), errno);
+        free(client);
+        return -1;
+    }
+
+    if (send_handshake(link, client)) {
+        GRERROR(GRSTR("shm_link_accept failed to setup shared memory for client: %i"), errno);
+        client->base.handle = (close(client->base.handle), -1);
+        if (client->memory) {
+            munmap(client->memory, client->memory_size);
+        }
+        if (client->data_doorbell >= 0) {
+            close(client->data_doorbell);
+        }
+        if (client->space_doorbell >= 0) {
+            close(client->space_doorbell);
+        }
+        free(client);
+        return -1;
+    }
+
+    status = shm_aio_add(set_handle, client->base.handle);
+    if (status) {
+        GRWARNING(GRSTR("shm_link_accept failed to add socket to set_handle"));
+    }
+
+    *clientOut = client;
+    return 0;
+}
+
+static int shm_link_recv(struct gracht_link_shm* link, struct gracht_message* context, unsigned int flags)
+{
+    (void)link;
+    (void)context;
+    (void)flags;
+    errno = ENOSYS;
+    return -1;
+}
+
+static int shm_link_send(struct gracht_link_shm* link,
+    struct gracht_message* messageContext, struct gracht_buffer* message)
+{
+    (void)link;
+    (void)messageContext;
+    (void)message;
+    errno = ENOSYS;
+    return -1;
+}
+
+static gracht_conn_t socket_listen(struct gracht_link_shm* link)
+{
+    gracht_conn_t connection;
+
+    connection = socket(AF_LOCAL, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (connection == GRACHT_CONN_INVALID) {
+        return GRACHT_CONN_INVALID;
+    }
+
+    if (bind(connection, (const struct sockaddr*)&link->address, sizeof(struct sockaddr_un))) {
+        GRERROR(GRSTR("shm_link_setup failed to bind to %s: %i"), link->address.sun_path, errno);
+        close(connection);
+        return GRACHT_CONN_INVALID;
+    }
+
+    if (listen(connection, SHM_LOOPBACK_BACKLOG)) {
+        close(connection);
+        return GRACHT_CONN_INVALID;
+    }
+    return connection;
+}
+
+static gracht_conn_t shm_link_setup(struct gracht_link_shm* link, gracht_handle_t set_handle)
+{
+    int status;
+
+    link->set_handle      = set_handle;
+    link->base.connection = link->loopback ? shm_loopback_listen(link) : socket_listen(link);
+    if (link->base.connection == GRACHT_CONN_INVALID) {
+        return GRACHT_CONN_INVALID;
+    }
+
+    status = shm_aio_add(set_handle, link->base.connection);
+    if (status) {
+        GRWARNING(GRSTR("shm_link_setup failed to add socket to set_handle"));
+    }
+    return link->base.connection;
+}
+
+static void shm_link_destroy(struct gracht_link_shm* link, gracht_handle_t set_handle)
+{
+    if (!link) {
+        return;
+    }
+
+    if (link->base.connection != GRACHT_CONN_INVALID) {
+        int status = shm_aio_remove(set_handle, link->base.connection);
+        if (status) {
+            GRWARNING(GRSTR("shm_link_destroy failed to remove link socket from set_handle"));
+        }
+
+        if (link->loopback) {
+            shm_loopback_unlisten(link);
+        }
+        close(link->base.connection);
+    }
+    free(link);
+}
+
+void gracht_link_server_shm_api(struct gracht_link_shm* link)
+{
+    link->base.ops.server.accept_client  = (server_accept_client_fn)shm_link_accept;
+    link->base.ops.server.create_client  = (server_create_client_fn)shm_link_create_client;
+    link->base.ops.server.destroy_client = (server_destroy_client_fn)shm_link_destroy_client;
+
+    link->base.ops.server.recv_client     = (server_recv_client_fn)shm_link_recv_client;
+    link->base.ops.server.send_client     = (server_send_client_fn)shm_link_send_client;
+    link->base.ops.server.send_client_vec = (server_send_client_vec_fn)shm_link_send_client_vec;
+    link->base.ops.server.pending_client  = (server_pending_client_fn)shm_link_pending_client;
+    link->base.ops.server.writable_client = (server_writable_client_fn)shm_link_writable_client;
+
+    link->base.ops.server.recv = (server_link_recv_fn)shm_link_recv;
+    link->base.ops.server.send = (server_link_send_fn)shm_link_send;
+
+    link->base.ops.server.setup   = (server_link_setup_fn)shm_link_setup;
+    link->base.ops.server.destroy = (server_link_destroy_fn)shm_link_destroy;
+}
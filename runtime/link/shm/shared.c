@@ -0,0 +1,78 @@
+/**
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Gracht Shared Memory Link Type Definitions & Structures
+ * - This header describes the base link-structure, prototypes
+ *   and functionality, refer to the individual things for descriptions
+ */
+
+#include "private.h"
+#include <errno.h>
+#include <stdlib.h>
+
+// extern functions, this is the interfaces described in client.c/server.c
+extern void gracht_link_client_shm_api(struct gracht_link_shm* link);
+extern void gracht_link_server_shm_api(struct gracht_link_shm* link);
+
+int gracht_link_shm_create(struct gracht_link_shm** linkOut)
+{
+    struct gracht_link_shm* link;
+
+    link = (struct gracht_link_shm*)malloc(sizeof(struct gracht_link_shm));
+    if (!link) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    memset(link, 0, sizeof(struct gracht_link_shm));
+    gracht_link_client_shm_api(link);
+    link->base.type          = gracht_link_stream_based;
+    link->base.connection    = GRACHT_CONN_INVALID;
+    link->address.sun_family = AF_LOCAL;
+    link->ring_size          = GRACHT_LINK_SHM_DEFAULT_RING_SIZE;
+    link->control            = -1;
+    link->space_doorbell     = -1;
+
+    *linkOut = link;
+    return 0;
+}
+
+void gracht_link_shm_set_listen(struct gracht_link_shm* link, int listen)
+{
+    link->listen = listen;
+    if (listen) {
+        gracht_link_server_shm_api(link);
+    }
+    else {
+        gracht_link_client_shm_api(link);
+    }
+}
+
+void gracht_link_shm_set_path(struct gracht_link_shm* link, const char* path)
+{
+    strncpy(link->address.sun_path, path, sizeof(link->address.sun_path) - 1);
+}
+
+void gracht_link_shm_set_ring_size(struct gracht_link_shm* link, size_t size)
+{
+    uint32_t ringSize = SHM_LINK_MIN_RING_SIZE;
+
+    while (ringSize < size && ringSize < 0x80000000U) {
+        ringSize <<= 1;
+    }
+    link->ring_size = ringSize;
+}
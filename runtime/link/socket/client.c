@@ -79,6 +79,43 @@ static int socket_link_recv_stream(struct gracht_link_socket* link,
     return 0;
 }
 
+#if defined(__linux__)
+// Local stream sockets can pass descriptors, they are sent with the first byte of the message
+static int socket_link_send_fds(struct gracht_link_socket* link,
+    struct gracht_buffer* message, void* messageContext, const int* fds, int count)
+{
+    struct msghdr msg = { 0 };
+    struct iovec  iov = { &message->data[0], message->index };
+    union {
+        char           buffer[CMSG_SPACE(GRACHT_BULK_MAX * sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    struct cmsghdr* cmsg;
+    intmax_t        byteCount;
+    (void)messageContext;
+
+    memset(&control, 0, sizeof(control));
+    msg.msg_iov        = &iov;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = control.buffer;
+    msg.msg_controllen = CMSG_SPACE((size_t)count * sizeof(int));
+    cmsg               = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level   = SOL_SOCKET;
+    cmsg->cmsg_type    = SCM_RIGHTS;
+    cmsg->cmsg_len     = CMSG_LEN((size_t)count * sizeof(int));
+    memcpy(CMSG_DATA(cmsg), fds, (size_t)count * sizeof(int));
+
+    byteCount = sendmsg(link->base.connection, &msg, MSG_NOSIGNAL);
+    if (byteCount < 0 || (uint32_t)byteCount != message->index) {
+        GRERROR(GRSTR("link_client: failed to send message, bytes sent: %li, expected: %u (%i)"),
+              (long)byteCount, message->index, errno);
+        errno = (EPIPE);
+        return -1;
+    }
+    return 0;
+}
+#endif
+
 static int socket_link_send_packet(struct gracht_link_socket* link, struct gracht_buffer* message)
 {
     intmax_t byteCount;
@@ -140,6 +177,12 @@ static gracht_conn_t socket_link_connect(struct gracht_link_socket* link)
         link->base.connection = GRACHT_CONN_INVALID;
         return status;
     }
+
+#if defined(__linux__)
+    if (link->domain == AF_LOCAL && type == SOCK_STREAM) {
+        link->base.ops.client.send_fds = (client_link_send_fds_fn)socket_link_send_fds;
+    }
+#endif
     return link->base.connection;
 }
 
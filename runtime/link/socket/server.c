@@ -20,6 +20,10 @@
  *   and functionality, refer to the individual things for descriptions
  */
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // sendmmsg
+#endif
+
 #include <assert.h>
 #include <errno.h>
 #include "gracht/link/socket.h"
@@ -31,17 +35,35 @@
 
 #include "socket_os.h"
 
+// Stream clients read as much as is available into their receive buffer, so a single recv
+// can return many small messages. The buffer grows while a larger message is received.
+#define SOCKET_LINK_RECV_BUFFER_SIZE (16 * 1024)
+
+// Descriptors passed by local clients are queued until the message they were sent with is
+// received. A client that passes more than this without sending the messages is disconnected.
+#define SOCKET_LINK_MAX_FDS 1024
+
 struct socket_link_client {
     struct gracht_server_client base;
     struct sockaddr_storage     address;
     gracht_conn_t               socket;
     gracht_conn_t               link;
+    socklen_t                   link_address_length;
     int                         streaming;
 #ifdef _WIN32
     WSABUF                      waitbuf;
     uint8_t                     headerbuf[GRACHT_MESSAGE_HEADER_SIZE];
     DWORD                       flags;
     WSAOVERLAPPED               overlapped;
+#else
+    gracht_handle_t             set_handle;
+    uint8_t*                    recv_buffer;
+    size_t                      recv_capacity;
+    size_t                      recv_head;
+    size_t                      recv_tail;
+    int*                        fds;
+    int                         fd_count;
+    int                         fd_capacity;
 #endif
 };
 
@@ -110,25 +132,105 @@ static int socket_link_send_client(struct socket_link_client* client,
 #endif
 
     GRTRACE(GRSTR("[socket_link_send] sending message"));
-    bytesWritten = send(client->base.handle, &message->data[0], message->index, socketFlags);
+    if (client->streaming) {
+        bytesWritten = send(client->base.handle, &message->data[0], message->index, socketFlags);
+    }
+    else {
+        bytesWritten = sendto(client->socket, &message->data[0], message->index, socketFlags,
+            (const struct sockaddr*)&client->address, client->link_address_length);
+    }
     if (bytesWritten != message->index) {
         return -1;
     }
     return 0;
 }
 
+#if defined(__linux__)
+#define SOCKET_LINK_MAX_VEC 64
+
+static int socket_link_send_client_vec(struct socket_link_client* client,
+    struct gracht_buffer* messages, int count, unsigned int flags, size_t* bytesWrittenOut)
+{
+    unsigned int socketFlags = get_socket_flags(flags);
+    struct iovec iov[SOCKET_LINK_MAX_VEC];
+    int          i;
+
+    if (count > SOCKET_LINK_MAX_VEC) {
+        count = SOCKET_LINK_MAX_VEC;
+    }
+
+    for (i = 0; i < count; i++) {
+        iov[i].iov_base = &messages[i].data[0];
+        iov[i].iov_len  = messages[i].index;
+    }
+
+    *bytesWrittenOut = 0;
+    if (client->streaming) {
+        struct msghdr msg = { 0 };
+        intmax_t      bytesWritten;
+
+        msg.msg_iov    = &iov[0];
+        msg.msg_iovlen = (size_t)count;
+        bytesWritten   = sendmsg(client->base.handle, &msg, socketFlags);
+        if (bytesWritten < 0) {
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+        }
+        *bytesWrittenOut = (size_t)bytesWritten;
+    }
+    else {
+        // each message is its own datagram to the same destination
+        struct mmsghdr msgs[SOCKET_LINK_MAX_VEC];
+        int            sent;
+
+        memset(&msgs[0], 0, sizeof(struct mmsghdr) * (size_t)count);
+        for (i = 0; i < count; i++) {
+            msgs[i].msg_hdr.msg_name    = &client->address;
+            msgs[i].msg_hdr.msg_namelen = client->link_address_length;
+            msgs[i].msg_hdr.msg_iov     = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen  = 1;
+        }
+
+        sent = sendmmsg(client->socket, &msgs[0], (unsigned int)count, socketFlags);
+        if (sent < 0) {
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+        }
+
+        for (i = 0; i < sent; i++) {
+            *bytesWrittenOut += messages[i].index;
+        }
+    }
+    return 0;
+}
+#else
+static int socket_link_send_client_vec(struct socket_link_client* client,
+    struct gracht_buffer* messages, int count, unsigned int flags, size_t* bytesWrittenOut)
+{
+    int i;
+
+    // no vectored io available, fall back to sending message by message
+    *bytesWrittenOut = 0;
+    for (i = 0; i < count; i++) {
+        if (socket_link_send_client(client, &messages[i], flags)) {
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+        }
+        *bytesWrittenOut += messages[i].index;
+    }
+    return 0;
+}
+#endif
+
+#ifdef _WIN32
 static int socket_link_recv_client(struct socket_link_client* client,
     struct gracht_message* context, unsigned int flags)
 {
-    unsigned int socketFlags = get_socket_flags(flags);
-    intmax_t     bytesRead;
-    uint32_t     missingData;
+    DWORD    overlappedFlags;
+    DWORD    overlappedLength;
+    BOOL     status;
+    intmax_t bytesRead;
+    uint32_t missingData;
+    (void)flags;
     
     GRTRACE(GRSTR("socket_link_recv_client reading message header"));
-#ifdef _WIN32
-    DWORD overlappedFlags;
-    DWORD overlappedLength;
-    BOOL  status;
 
     // extract the number of bytes received
     status = WSAGetOverlappedResult(client->socket, &client->overlapped, &overlappedLength, FALSE, &overlappedFlags);
@@ -153,15 +255,6 @@ static int socket_link_recv_client(struct socket_link_client* client,
             return -1;
         }
     }
-#else
-    bytesRead = recv(client->base.handle, &context->payload[0], GRACHT_MESSAGE_HEADER_SIZE, socketFlags);
-    if (bytesRead != GRACHT_MESSAGE_HEADER_SIZE) {
-        if (bytesRead == 0) {
-            errno = ENODATA;
-        }
-        return -1;
-    }
-#endif
     
     GRTRACE(GRSTR("socket_link_recv_client message id %u, length of message %u"), 
         *((uint32_t*)&context->payload[0]), *((uint32_t*)&context->payload[4]));
@@ -185,7 +278,6 @@ static int socket_link_recv_client(struct socket_link_client* client,
     context->index  = 0;
     context->size   = *((uint32_t*)&context->payload[4]);
 
-#ifdef _WIN32
     // queue up another read
     status = WSARecv(client->socket, &client->waitbuf, 1, NULL, &client->flags, &client->overlapped, NULL);
     if (status == SOCKET_ERROR) {
@@ -194,9 +286,191 @@ static int socket_link_recv_client(struct socket_link_client* client,
             GRERROR(GRSTR("socket_link_recv_client failed to queue up a read on the client socket: %u"), reason);
         }
     }
-#endif
     return 0;
 }
+#else
+// Returns the length of the message at the front of the receive buffer, or 0 if
+// not even the header has been received yet.
+static uint32_t recv_buffer_message_length(struct socket_link_client* client)
+{
+    if ((client->recv_tail - client->recv_head) < GRACHT_MESSAGE_HEADER_SIZE) {
+        return 0;
+    }
+    return *((uint32_t*)&client->recv_buffer[client->recv_head + 4]);
+}
+
+static int recv_buffer_has_message(struct socket_link_client* client)
+{
+    uint32_t length = recv_buffer_message_length(client);
+    return length && (client->recv_tail - client->recv_head) >= length;
+}
+
+// Messages that are too small to hold the header, or too large for the server to receive
+// can not be recovered from, as the rest of the stream can no longer be trusted.
+static int recv_buffer_validate(uint32_t length, uint32_t maxLength)
+{
+    if (length && (length < GRACHT_MESSAGE_HEADER_SIZE || length > maxLength)) {
+        GRERROR(GRSTR("socket_link_recv_client invalid message length %u"), length);
+        errno = EFAULT;
+        return -1;
+    }
+    return 0;
+}
+
+// Moves whatever is left of a partially received message to the front of the buffer, and
+// resizes the buffer to the given capacity
+static int recv_buffer_resize(struct socket_link_client* client, size_t capacity)
+{
+    uint8_t* buffer;
+
+    if (client->recv_head) {
+        memmove(&client->recv_buffer[0], &client->recv_buffer[client->recv_head],
+            client->recv_tail - client->recv_head);
+        client->recv_tail -= client->recv_head;
+        client->recv_head  = 0;
+    }
+
+    if (capacity == client->recv_capacity) {
+        return 0;
+    }
+
+    buffer = realloc(client->recv_buffer, capacity);
+    if (!buffer) {
+        errno = ENOMEM;
+        return -1;
+    }
+    client->recv_buffer   = buffer;
+    client->recv_capacity = capacity;
+    return 0;
+}
+
+static int recv_fds_push(struct socket_link_client* client, const int* fds, int count)
+{
+    int i;
+
+    if (client->fd_count + count > client->fd_capacity) {
+        int  capacity = client->fd_capacity ? (client->fd_capacity * 2) : 8;
+        int* queue;
+
+        while (capacity < client->fd_count + count) {
+            capacity *= 2;
+        }
+
+        queue = capacity <= SOCKET_LINK_MAX_FDS ? realloc(client->fds, sizeof(int) * (size_t)capacity) : NULL;
+        if (!queue) {
+            GRERROR(GRSTR("socket_link_recv_client too many descriptors queued by client"));
+            for (i = 0; i < count; i++) {
+                close(fds[i]);
+            }
+            errno = EFAULT;
+            return -1;
+        }
+        client->fds         = queue;
+        client->fd_capacity = capacity;
+    }
+
+    memcpy(&client->fds[client->fd_count], fds, sizeof(int) * (size_t)count);
+    client->fd_count += count;
+    return 0;
+}
+
+// Reads as much as the socket has available into the receive buffer, this never blocks
+// unless asked to.
+static int recv_buffer_fill(struct socket_link_client* client, unsigned int flags)
+{
+    intmax_t bytesRead;
+    int      fds[GRACHT_BULK_MAX];
+    int      fdCount;
+
+    bytesRead = socket_aio_recv_fds(client->set_handle, client->base.handle, &client->recv_buffer[client->recv_tail],
+        client->recv_capacity - client->recv_tail, get_socket_flags(flags), &fds[0], &fdCount);
+    if (fdCount && recv_fds_push(client, &fds[0], fdCount)) {
+        return -1;
+    }
+
+    if (bytesRead <= 0) {
+        if (bytesRead == 0) {
+            errno = ENODATA;
+        }
+        return -1;
+    }
+    client->recv_tail += (size_t)bytesRead;
+    return 0;
+}
+
+// Returns the next message received from the client. Messages are assembled in the receive
+// buffer of the client across read events, so a client that sends a message slowly never
+// holds up the reactor. Until a message is complete ENODATA is returned.
+static int socket_link_recv_client(struct socket_link_client* client,
+    struct gracht_message* context, unsigned int flags)
+{
+    uint32_t length = recv_buffer_message_length(client);
+
+    if (recv_buffer_validate(length, context->index)) {
+        return -1;
+    }
+
+    // only go to the socket once the buffered messages have been consumed. The buffer is grown
+    // temporarily for messages that are larger than it
+    if (!recv_buffer_has_message(client)) {
+        size_t capacity = length > client->recv_capacity ? length : client->recv_capacity;
+        if (recv_buffer_resize(client, capacity) || recv_buffer_fill(client, flags)) {
+            return -1;
+        }
+
+        length = recv_buffer_message_length(client);
+        if (recv_buffer_validate(length, context->index)) {
+            return -1;
+        }
+
+        if (!recv_buffer_has_message(client)) {
+            // the rest of the message is carried over to the next read event
+            errno = ENODATA;
+            return -1;
+        }
+    }
+
+    GRTRACE(GRSTR("socket_link_recv_client message id %u, length of message %u"),
+        *((uint32_t*)&client->recv_buffer[client->recv_head]), length);
+    memcpy(&context->payload[0], &client->recv_buffer[client->recv_head], length);
+    client->recv_head += length;
+
+    // shrink the buffer again once a large message has been consumed
+    if (client->recv_head == client->recv_tail) {
+        client->recv_head = 0;
+        client->recv_tail = 0;
+        if (client->recv_capacity > SOCKET_LINK_RECV_BUFFER_SIZE) {
+            (void)recv_buffer_resize(client, SOCKET_LINK_RECV_BUFFER_SIZE);
+        }
+    }
+
+    // ->server is set by server
+    context->link   = client->link;
+    context->client = client->socket;
+    context->index  = 0;
+    context->size   = length;
+    return 0;
+}
+
+static int socket_link_pending_client(struct socket_link_client* client)
+{
+    return client->recv_buffer && recv_buffer_has_message(client);
+}
+
+// Takes the descriptors the last received message was sent with
+static int socket_link_recv_client_fds(struct socket_link_client* client, int* fds, int count)
+{
+    int fdCount = client->fd_count < count ? client->fd_count : count;
+
+    if (fdCount) {
+        memcpy(fds, client->fds, sizeof(int) * (size_t)fdCount);
+        client->fd_count -= fdCount;
+        memmove(client->fds, &client->fds[fdCount], sizeof(int) * (size_t)client->fd_count);
+    }
+    return fdCount + socket_aio_take_fds(client->set_handle, client->base.handle,
+        &fds[fdCount], count - fdCount);
+}
+#endif
 
 static int socket_link_create_client(struct gracht_link_socket* link, struct gracht_message* message,
     struct socket_link_client** clientOut)
@@ -218,7 +492,8 @@ static int socket_link_create_client(struct gracht_link_socket* link, struct gra
     memset(client, 0, sizeof(struct socket_link_client));
     client->base.handle = message->client;
     client->socket      = link->base.connection;
-    client->streaming   = 0;
+    client->streaming           = 0;
+    client->link_address_length = link->address_length;
 
     address = (struct sockaddr_storage*)&message->payload[0];
     memcpy(&client->address, address, (size_t)link->address_length);
@@ -244,6 +519,13 @@ static int socket_link_destroy_client(struct socket_link_client* client, gracht_
         }
     }
     status = close(client->base.handle);
+#ifndef _WIN32
+    while (client->fd_count) {
+        close(client->fds[--client->fd_count]);
+    }
+    free(client->fds);
+    free(client->recv_buffer);
+#endif
     free(client);
     return status;
 }
@@ -252,6 +534,7 @@ static gracht_conn_t socket_link_setup(struct gracht_link_socket* link, gracht_h
 {
     int status;
     
+    link->set_handle = set_handle;
     if (link->base.type == gracht_link_packet_based) {
         // Create a new socket for listening to events. They are all
         // delivered to fixed sockets on the local system.
@@ -407,14 +690,28 @@ static int socket_link_accept(
 
     memset(client, 0, sizeof(struct socket_link_client));
 
-    client->socket = accept(link->base.connection, (struct sockaddr*)&client->address, &address_length);
+    client->recv_buffer = malloc(SOCKET_LINK_RECV_BUFFER_SIZE);
+    if (!client->recv_buffer) {
+        GRERROR(GRSTR("socket_link_accept failed to allocate data for link"));
+        free(client);
+        errno = (ENOMEM);
+        return -1;
+    }
+    client->recv_capacity = SOCKET_LINK_RECV_BUFFER_SIZE;
+
+    // the listen socket belongs to the set it was setup with, which is not necessarily
+    // the one the client is added to
+    client->socket = socket_aio_accept(link->set_handle, link->base.connection,
+        (struct sockaddr*)&client->address, &address_length);
     if (client->socket < 0) {
         GRERROR(GRSTR("socket_link_accept failed to accept client: %i - %i"), client->socket, errno);
+        free(client->recv_buffer);
         free(client);
         return -1;
     }
     client->base.handle = client->socket;
     client->streaming   = 1;
+    client->set_handle  = set_handle;
     
     status = socket_aio_add(set_handle, client->socket);
     if (status) {
@@ -552,6 +849,11 @@ void gracht_link_server_socket_api(struct gracht_link_socket* link)
 
     link->base.ops.server.recv_client = (server_recv_client_fn)socket_link_recv_client;
     link->base.ops.server.send_client = (server_send_client_fn)socket_link_send_client;
+    link->base.ops.server.send_client_vec = (server_send_client_vec_fn)socket_link_send_client_vec;
+#ifndef _WIN32
+    link->base.ops.server.pending_client  = (server_pending_client_fn)socket_link_pending_client;
+    link->base.ops.server.recv_client_fds = (server_recv_client_fds_fn)socket_link_recv_client_fds;
+#endif
 
     link->base.ops.server.recv    = (server_link_recv_fn)socket_link_recv_packet;
     link->base.ops.server.send    = (server_link_send_fn)socket_link_send_packet;
@@ -23,6 +23,7 @@
 #ifndef __GRACHT_SOCKET_OS_H__
 #define __GRACHT_SOCKET_OS_H__
 
+#include "config.h"
 #include "utils.h"
 
 #if defined(MOLLENOS)
@@ -39,8 +40,30 @@ static int socket_aio_add(int aio, int iod) {
 }
 
 #define socket_aio_remove(aio, iod) ioset_ctrl(aio, IOSET_DEL, iod, NULL);
+#define socket_aio_accept(aio, iod, address, addressLength) accept(iod, address, addressLength)
+#define socket_aio_recv(aio, iod, buffer, length, flags)    recv(iod, buffer, length, flags)
+#define socket_aio_recv_fds(aio, iod, buffer, length, flags, fds, fdCount) \
+    (*(fdCount) = 0, recv(iod, buffer, length, flags))
+#define socket_aio_take_fds(aio, iod, fds, count)           0
+
+#elif defined(__linux__) && defined(GRACHT_AIO_URING)
+#include <unistd.h>
+#include "aio_uring.h"
+
+// Connections and data are received by the ring before the events are reported, so
+// accepting and receiving must go through the ring the socket was added to.
+#define socket_aio_add(aio, iod)                            gracht_uring_add(aio, iod)
+#define socket_aio_remove(aio, iod)                         gracht_uring_remove(aio, iod)
+#define socket_aio_accept(aio, iod, address, addressLength) gracht_uring_accept(aio, iod, address, addressLength)
+#define socket_aio_recv(aio, iod, buffer, length, flags)    ((void)(flags), gracht_uring_recv(aio, iod, buffer, length))
+
+// The ring keeps the descriptors passed with the data, they are taken when a message needs them
+#define socket_aio_recv_fds(aio, iod, buffer, length, flags, fds, fdCount) \
+    (*(fdCount) = 0, socket_aio_recv(aio, iod, buffer, length, flags))
+#define socket_aio_take_fds(aio, iod, fds, count)           gracht_uring_recv_fds(aio, iod, fds, count)
 
 #elif defined(__linux__)
+#include <string.h>
 #include <unistd.h>
 #include <sys/epoll.h>
 #include <sys/socket.h>
@@ -54,6 +77,46 @@ static int socket_aio_add(int aio, int iod) {
 }
 
 #define socket_aio_remove(aio, iod) epoll_ctl(aio, EPOLL_CTL_DEL, iod, NULL)
+#define socket_aio_accept(aio, iod, address, addressLength) accept(iod, address, addressLength)
+#define socket_aio_recv(aio, iod, buffer, length, flags)    recv(iod, buffer, length, flags)
+#define socket_aio_take_fds(aio, iod, fds, count)           0
+
+// Receives data like recv, but keeps any descriptors passed along with it. A single call never
+// returns data of more than one sendmsg that passed descriptors, so room for the descriptors
+// of one message is enough.
+static long socket_aio_recv_fds(int aio, int iod, void* buffer, size_t length, unsigned int flags,
+    int* fds, int* fdCount)
+{
+    struct msghdr msg = { 0 };
+    struct iovec  iov = { buffer, length };
+    union {
+        char           buffer[CMSG_SPACE(sizeof(int) * GRACHT_BULK_MAX)];
+        struct cmsghdr align;
+    } control;
+    struct cmsghdr* cmsg;
+    ssize_t         bytesRead;
+    (void)aio;
+
+    msg.msg_iov        = &iov;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = control.buffer;
+    msg.msg_controllen = sizeof(control.buffer);
+
+    *fdCount  = 0;
+    bytesRead = recvmsg(iod, &msg, (int)flags | MSG_CMSG_CLOEXEC);
+    if (bytesRead < 0) {
+        return -1;
+    }
+
+    for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            int count = (int)((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+            memcpy(&fds[*fdCount], CMSG_DATA(cmsg), sizeof(int) * (size_t)count);
+            *fdCount += count;
+        }
+    }
+    return (long)bytesRead;
+}
 
 #elif defined(_WIN32)
 #include <windows.h>
@@ -150,6 +213,7 @@ struct gracht_link_socket {
     int                     domain;
     struct sockaddr_storage address;
     socklen_t               address_length;
+    gracht_handle_t         set_handle;
 #ifdef _WIN32
     WSABUF                  waitbuf;
     DWORD                   recvFlags;
@@ -0,0 +1,216 @@
+/**
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Gracht Outbound Queue Implementation
+ * - Per client queues of reference counted payloads
+ */
+
+#include <errno.h>
+#include "outbound.h"
+#include "utils.h"
+#include <stdlib.h>
+#include <string.h>
+
+struct gracht_payload* gracht_payload_create(const char* data, uint32_t length)
+{
+    struct gracht_payload* payload;
+
+    payload = malloc(sizeof(struct gracht_payload) + length);
+    if (!payload) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    atomic_store(&payload->references, 1);
+    payload->length = length;
+    memcpy(&payload->data[0], data, length);
+    return payload;
+}
+
+void gracht_payload_acquire(struct gracht_payload* payload)
+{
+    atomic_fetch_add(&payload->references, 1);
+}
+
+void gracht_payload_release(struct gracht_payload* payload)
+{
+    if (atomic_fetch_sub(&payload->references, 1) == 1) {
+        free(payload);
+    }
+}
+
+int gracht_outbound_construct(struct gracht_outbound* outbound, unsigned int capacity)
+{
+    if (!outbound) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (gr_queue_construct(&outbound->queue, capacity)) {
+        return -1;
+    }
+
+    mtx_init(&outbound->lock, mtx_plain);
+    outbound->offset       = 0;
+    outbound->queued_bytes = 0;
+    return 0;
+}
+
+void gracht_outbound_destroy(struct gracht_outbound* outbound)
+{
+    if (!outbound) {
+        return;
+    }
+
+    gracht_outbound_clear(outbound);
+    gr_queue_destroy(&outbound->queue);
+    mtx_destroy(&outbound->lock);
+}
+
+void gracht_outbound_clear(struct gracht_outbound* outbound)
+{
+    struct gracht_payload* payload;
+
+    payload = gr_queue_dequeue(&outbound->queue);
+    while (payload) {
+        gracht_payload_release(payload);
+        payload = gr_queue_dequeue(&outbound->queue);
+    }
+    outbound->offset       = 0;
+    outbound->queued_bytes = 0;
+}
+
+static int outbound_grow(struct gracht_outbound* outbound)
+{
+    struct gr_queue queue;
+    void*           element;
+
+    if (gr_queue_construct(&queue, outbound->queue.capacity * 2)) {
+        return -1;
+    }
+
+    element = gr_queue_dequeue(&outbound->queue);
+    while (element) {
+        gr_queue_enqueue(&queue, element);
+        element = gr_queue_dequeue(&outbound->queue);
+    }
+    gr_queue_destroy(&outbound->queue);
+    outbound->queue = queue;
+    return 0;
+}
+
+int gracht_outbound_reserve(struct gracht_outbound* outbound, unsigned int count)
+{
+    while ((outbound->queue.capacity - gr_queue_count(&outbound->queue)) < count) {
+        if (outbound_grow(outbound)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int gracht_outbound_push(struct gracht_outbound* outbound, struct gracht_payload* payload)
+{
+    if (gr_queue_count(&outbound->queue) == outbound->queue.capacity && outbound_grow(outbound)) {
+        return -1;
+    }
+
+    gr_queue_enqueue(&outbound->queue, payload);
+    gracht_payload_acquire(payload);
+    outbound->queued_bytes += payload->length;
+    return 0;
+}
+
+// Removes all the bytes written from the head of the queue
+static void outbound_consume(struct gracht_outbound* outbound, size_t bytesWritten)
+{
+    outbound->queued_bytes -= bytesWritten;
+    while (bytesWritten) {
+        struct gracht_payload* payload   = gr_queue_peek(&outbound->queue, 0);
+        size_t                 remaining = payload->length - outbound->offset;
+
+        if (bytesWritten < remaining) {
+            outbound->offset += (uint32_t)bytesWritten;
+            return;
+        }
+
+        bytesWritten -= remaining;
+        outbound->offset = 0;
+        gr_queue_dequeue(&outbound->queue);
+        gracht_payload_release(payload);
+    }
+}
+
+// Links that do not support vectored writes send one message at the time, and those
+// never write partial messages.
+static int outbound_flush_single(struct gracht_outbound* outbound, struct gracht_link* link,
+    struct gracht_server_client* client, unsigned int flags)
+{
+    while (!gracht_outbound_empty(outbound)) {
+        struct gracht_payload* payload = gr_queue_peek(&outbound->queue, 0);
+        struct gracht_buffer   buffer  = { .data = &payload->data[0], .index = payload->length };
+
+        if (link->ops.server.send_client(client, &buffer, flags)) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return 1;
+            }
+            return -1;
+        }
+        outbound_consume(outbound, payload->length);
+    }
+    return 0;
+}
+
+int gracht_outbound_flush(struct gracht_outbound* outbound, struct gracht_link* link,
+    struct gracht_server_client* client, unsigned int flags)
+{
+    struct gracht_buffer buffers[GRACHT_OUTBOUND_MAX_BATCH];
+
+    if (!link->ops.server.send_client_vec) {
+        return outbound_flush_single(outbound, link, client, flags);
+    }
+
+    while (!gracht_outbound_empty(outbound)) {
+        unsigned int count = gr_queue_count(&outbound->queue);
+        size_t       total = 0;
+        size_t       bytesWritten = 0;
+        unsigned int i;
+
+        if (count > GRACHT_OUTBOUND_MAX_BATCH) {
+            count = GRACHT_OUTBOUND_MAX_BATCH;
+        }
+
+        for (i = 0; i < count; i++) {
+            struct gracht_payload* payload = gr_queue_peek(&outbound->queue, i);
+            uint32_t               offset  = i == 0 ? outbound->offset : 0;
+
+            buffers[i].data  = &payload->data[offset];
+            buffers[i].index = payload->length - offset;
+            total += buffers[i].index;
+        }
+
+        if (link->ops.server.send_client_vec(client, &buffers[0], (int)count, flags, &bytesWritten)) {
+            return -1;
+        }
+
+        outbound_consume(outbound, bytesWritten);
+        if (bytesWritten != total) {
+            return 1;
+        }
+    }
+    return 0;
+}
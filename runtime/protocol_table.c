@@ -0,0 +1,120 @@
+/**
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Gracht Protocol Table Implementation
+ * - Direct indexed protocol/action lookup
+ */
+
+#include <errno.h>
+#include "protocol_table.h"
+#include <stdlib.h>
+#include <string.h>
+
+int gr_protocol_table_construct(gr_protocol_table_t* table)
+{
+    int i;
+
+    if (!table) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    mtx_init(&table->lock, mtx_plain);
+    for (i = 0; i < GR_PROTOCOL_TABLE_SIZE; i++) {
+        atomic_store(&table->protocols[i], 0);
+    }
+    table->retired = NULL;
+    return 0;
+}
+
+void gr_protocol_table_destroy(gr_protocol_table_t* table)
+{
+    struct gr_protocol_entry* entry;
+    int                       i;
+
+    if (!table) {
+        return;
+    }
+
+    for (i = 0; i < GR_PROTOCOL_TABLE_SIZE; i++) {
+        free((void*)atomic_load(&table->protocols[i]));
+    }
+
+    entry = table->retired;
+    while (entry) {
+        struct gr_protocol_entry* next = entry->retired_link;
+        free(entry);
+        entry = next;
+    }
+    mtx_destroy(&table->lock);
+}
+
+int gr_protocol_table_add(gr_protocol_table_t* table, gracht_protocol_t* protocol)
+{
+    struct gr_protocol_entry* entry;
+    int                       i;
+
+    if (!table || !protocol) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // build the action table before taking the lock, it is not visible to anyone yet
+    entry = malloc(sizeof(struct gr_protocol_entry));
+    if (!entry) {
+        errno = ENOMEM;
+        return -1;
+    }
+    memset(entry, 0, sizeof(struct gr_protocol_entry));
+
+    entry->protocol = protocol;
+    for (i = 0; i < protocol->num_functions; i++) {
+        entry->actions[protocol->functions[i].id] = &protocol->functions[i];
+    }
+
+    mtx_lock(&table->lock);
+    if (atomic_load(&table->protocols[protocol->id])) {
+        mtx_unlock(&table->lock);
+        free(entry);
+        errno = EEXIST;
+        return -1;
+    }
+    atomic_store(&table->protocols[protocol->id], (uintptr_t)entry);
+    mtx_unlock(&table->lock);
+    return 0;
+}
+
+void gr_protocol_table_remove(gr_protocol_table_t* table, uint8_t protocolId)
+{
+    struct gr_protocol_entry* entry;
+
+    if (!table) {
+        errno = EINVAL;
+        return;
+    }
+
+    mtx_lock(&table->lock);
+    entry = (struct gr_protocol_entry*)atomic_load(&table->protocols[protocolId]);
+    if (entry) {
+        atomic_store(&table->protocols[protocolId], 0);
+
+        // readers may still be looking at the entry, keep it around until we are destroyed
+        entry->retired_link = table->retired;
+        table->retired      = entry;
+    }
+    mtx_unlock(&table->lock);
+}
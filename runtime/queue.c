@@ -94,3 +94,138 @@ void* gr_queue_dequeue(struct gr_queue* queue)
     index = (queue->dequeue_index++) % queue->capacity;    
     return (void*)queue->elements[index];
 }
+
+void* gr_queue_peek(struct gr_queue* queue, unsigned int index)
+{
+    if (!queue) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    if (index >= (queue->queue_index - queue->dequeue_index)) {
+        errno = ENOENT;
+        return NULL;
+    }
+    return (void*)queue->elements[(queue->dequeue_index + index) % queue->capacity];
+}
+
+int gr_mpmc_queue_construct(struct gr_mpmc_queue* queue, unsigned int capacity)
+{
+    size_t size = 2;
+    size_t i;
+
+    if (!queue || !capacity) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    while (size < capacity) {
+        size <<= 1;
+    }
+
+    queue->cells = malloc(sizeof(struct gr_mpmc_cell) * size);
+    if (!queue->cells) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    for (i = 0; i < size; i++) {
+        atomic_store(&queue->cells[i].sequence, i);
+        queue->cells[i].element = 0;
+    }
+
+    queue->mask = size - 1;
+    atomic_store(&queue->enqueue_index, 0);
+    atomic_store(&queue->dequeue_index, 0);
+    return 0;
+}
+
+void gr_mpmc_queue_destroy(struct gr_mpmc_queue* queue)
+{
+    if (!queue) {
+        return;
+    }
+
+    free(queue->cells);
+}
+
+int gr_mpmc_queue_enqueue(struct gr_mpmc_queue* queue, void* pointer)
+{
+    struct gr_mpmc_cell* cell;
+    size_t               index;
+
+    if (!queue || !pointer) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    index = atomic_load(&queue->enqueue_index);
+    while (1) {
+        size_t   sequence;
+        intptr_t difference;
+
+        cell       = &queue->cells[index & queue->mask];
+        sequence   = atomic_load(&cell->sequence);
+        difference = (intptr_t)sequence - (intptr_t)index;
+
+        // the cell is free for this index, try to claim it
+        if (difference == 0) {
+            if (atomic_compare_exchange_strong(&queue->enqueue_index, &index, index + 1)) {
+                break;
+            }
+        }
+        // the cell still holds an element from the previous lap, so the queue is full
+        else if (difference < 0) {
+            errno = ENOENT;
+            return -1;
+        }
+        else {
+            index = atomic_load(&queue->enqueue_index);
+        }
+    }
+
+    cell->element = (uintptr_t)pointer;
+    atomic_store(&cell->sequence, index + 1);
+    return 0;
+}
+
+void* gr_mpmc_queue_dequeue(struct gr_mpmc_queue* queue)
+{
+    struct gr_mpmc_cell* cell;
+    uintptr_t            element;
+    size_t               index;
+
+    if (!queue) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    index = atomic_load(&queue->dequeue_index);
+    while (1) {
+        size_t   sequence;
+        intptr_t difference;
+
+        cell       = &queue->cells[index & queue->mask];
+        sequence   = atomic_load(&cell->sequence);
+        difference = (intptr_t)sequence - (intptr_t)(index + 1);
+
+        // the cell has been filled for this index, try to claim it
+        if (difference == 0) {
+            if (atomic_compare_exchange_strong(&queue->dequeue_index, &index, index + 1)) {
+                break;
+            }
+        }
+        // the cell has not been filled yet, so the queue is empty
+        else if (difference < 0) {
+            errno = ENOENT;
+            return NULL;
+        }
+        else {
+            index = atomic_load(&queue->dequeue_index);
+        }
+    }
+
+    element = cell->element;
+    atomic_store(&cell->sequence, index + queue->mask + 1);
+    return (void*)element;
+}
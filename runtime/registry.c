@@ -0,0 +1,331 @@
+/**
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Read-mostly registry implementation
+ * - Open addressed table of element pointers with linear probing. Slots are only
+ *   ever modified by writers (serialized by the registry lock), and readers just load
+ *   them atomically. Memory that readers might still be looking at (removed elements
+ *   and replaced tables) is only released once all readers that entered before the
+ *   change have left their read section again.
+ */
+
+#include <errno.h>
+#include "registry.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SLOT_EMPTY     ((uintptr_t)0)
+#define SLOT_TOMBSTONE ((uintptr_t)1)
+
+struct registry_table {
+    size_t           capacity;
+    unsigned int     shift;
+    atomic_uintptr_t slots[];
+};
+
+static atomic_uint      g_readerSlotIndex = 0;
+static __TLS_VAR int    g_readerSlot      = -1;
+
+static struct registry_table* table_new(size_t capacity)
+{
+    struct registry_table* table;
+    unsigned int           bits = 0;
+    size_t                 i;
+
+    table = malloc(sizeof(struct registry_table) + (sizeof(atomic_uintptr_t) * capacity));
+    if (!table) {
+        return NULL;
+    }
+
+    while (((size_t)1 << bits) < capacity) {
+        bits++;
+    }
+
+    table->capacity = capacity;
+    table->shift    = 64 - bits;
+    for (i = 0; i < capacity; i++) {
+        atomic_store(&table->slots[i], SLOT_EMPTY);
+    }
+    return table;
+}
+
+static inline size_t table_index(struct registry_table* table, uint64_t key)
+{
+    // fibonacci hashing, handles are usually sequential so spread them out
+    return (size_t)((key * 11400714819323198485ull) >> table->shift);
+}
+
+static inline struct gr_registry_reader* get_reader(gr_registry_t* registry)
+{
+    if (g_readerSlot < 0) {
+        g_readerSlot = (int)(atomic_fetch_add(&g_readerSlotIndex, 1) % GR_REGISTRY_READER_SLOTS);
+    }
+    return &registry->readers[g_readerSlot];
+}
+
+// Starts a new epoch and waits for all readers of the previous epoch to leave. Must be
+// called with the registry lock held.
+static void registry_synchronize(gr_registry_t* registry)
+{
+    unsigned int epoch = atomic_load(&registry->epoch);
+    int          i;
+
+    atomic_store(&registry->epoch, epoch + 1);
+    for (i = 0; i < GR_REGISTRY_READER_SLOTS; i++) {
+        while (atomic_load(&registry->readers[i].count[epoch & 1])) {
+            thrd_yield();
+        }
+    }
+}
+
+// Rebuilds the table to fit the current number of elements, this gets rid of any
+// tombstones. Must be called with the registry lock held.
+static int registry_rebuild(gr_registry_t* registry, size_t elementCount)
+{
+    struct registry_table* oldTable = (struct registry_table*)atomic_load(&registry->table);
+    struct registry_table* newTable;
+    size_t                 capacity = GR_REGISTRY_MINIMUM_CAPACITY;
+    size_t                 i;
+
+    // keep the load below 50% after a rebuild
+    while (capacity < (elementCount * 2)) {
+        capacity <<= 1;
+    }
+
+    newTable = table_new(capacity);
+    if (!newTable) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    for (i = 0; i < oldTable->capacity; i++) {
+        uintptr_t slot = atomic_load(&oldTable->slots[i]);
+        size_t    index;
+
+        if (slot == SLOT_EMPTY || slot == SLOT_TOMBSTONE) {
+            continue;
+        }
+
+        index = table_index(newTable, registry->key((void*)slot));
+        while (atomic_load(&newTable->slots[index]) != SLOT_EMPTY) {
+            index = (index + 1) & (newTable->capacity - 1);
+        }
+        atomic_store(&newTable->slots[index], slot);
+    }
+
+    atomic_store(&registry->table, (uintptr_t)newTable);
+    registry->used_count = registry->element_count;
+
+    // readers might still be probing the old table
+    registry_synchronize(registry);
+    free(oldTable);
+    return 0;
+}
+
+int gr_registry_construct(gr_registry_t* registry, gr_registry_keyfn keyFunction)
+{
+    struct registry_table* table;
+    int                    i;
+
+    if (!registry || !keyFunction) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    table = table_new(GR_REGISTRY_MINIMUM_CAPACITY);
+    if (!table) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    mtx_init(&registry->lock, mtx_plain);
+    atomic_store(&registry->epoch, 0);
+    atomic_store(&registry->table, (uintptr_t)table);
+    registry->element_count = 0;
+    registry->used_count    = 0;
+    registry->key           = keyFunction;
+    for (i = 0; i < GR_REGISTRY_READER_SLOTS; i++) {
+        atomic_store(&registry->readers[i].count[0], 0);
+        atomic_store(&registry->readers[i].count[1], 0);
+    }
+    return 0;
+}
+
+void gr_registry_destroy(gr_registry_t* registry)
+{
+    if (!registry) {
+        return;
+    }
+
+    free((void*)atomic_load(&registry->table));
+    mtx_destroy(&registry->lock);
+}
+
+unsigned int gr_registry_read_lock(gr_registry_t* registry)
+{
+    struct gr_registry_reader* reader = get_reader(registry);
+    unsigned int               epoch;
+
+    while (1) {
+        epoch = atomic_load(&registry->epoch);
+        atomic_fetch_add(&reader->count[epoch & 1], 1);
+
+        // if a writer started a new epoch in between it may not have seen us, so
+        // back out and register in the new epoch instead
+        if (atomic_load(&registry->epoch) == epoch) {
+            break;
+        }
+        atomic_fetch_sub(&reader->count[epoch & 1], 1);
+    }
+    return epoch & 1;
+}
+
+void gr_registry_read_unlock(gr_registry_t* registry, unsigned int token)
+{
+    struct gr_registry_reader* reader = get_reader(registry);
+    atomic_fetch_sub(&reader->count[token & 1], 1);
+}
+
+void* gr_registry_get(gr_registry_t* registry, uint64_t key)
+{
+    struct registry_table* table = (struct registry_table*)atomic_load(&registry->table);
+    size_t                 index = table_index(table, key);
+    size_t                 i;
+
+    for (i = 0; i < table->capacity; i++) {
+        uintptr_t slot = atomic_load(&table->slots[index]);
+        if (slot == SLOT_EMPTY) {
+            break;
+        }
+
+        if (slot != SLOT_TOMBSTONE && registry->key((void*)slot) == key) {
+            return (void*)slot;
+        }
+        index = (index + 1) & (table->capacity - 1);
+    }
+    return NULL;
+}
+
+int gr_registry_add(gr_registry_t* registry, void* element)
+{
+    struct registry_table* table;
+    uint64_t               key;
+    size_t                 index;
+    size_t                 target = (size_t)-1;
+    size_t                 i;
+
+    if (!registry || !element) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    key = registry->key(element);
+    mtx_lock(&registry->lock);
+
+    // grow (or clean up) the table when we exceed 75% load including tombstones
+    table = (struct registry_table*)atomic_load(&registry->table);
+    if (((registry->used_count + 1) * 4) > (table->capacity * 3)) {
+        if (registry_rebuild(registry, registry->element_count + 1)) {
+            mtx_unlock(&registry->lock);
+            return -1;
+        }
+        table = (struct registry_table*)atomic_load(&registry->table);
+    }
+
+    index = table_index(table, key);
+    for (i = 0; i < table->capacity; i++) {
+        uintptr_t slot = atomic_load(&table->slots[index]);
+        if (slot == SLOT_EMPTY) {
+            if (target == (size_t)-1) {
+                target = index;
+                registry->used_count++;
+            }
+            break;
+        }
+
+        if (slot == SLOT_TOMBSTONE) {
+            if (target == (size_t)-1) {
+                target = index;
+            }
+        } else if (registry->key((void*)slot) == key) {
+            mtx_unlock(&registry->lock);
+            errno = EEXIST;
+            return -1;
+        }
+        index = (index + 1) & (table->capacity - 1);
+    }
+
+    atomic_store(&table->slots[target], (uintptr_t)element);
+    registry->element_count++;
+    mtx_unlock(&registry->lock);
+    return 0;
+}
+
+void* gr_registry_remove(gr_registry_t* registry, uint64_t key)
+{
+    struct registry_table* table;
+    void*                  element = NULL;
+    size_t                 index;
+    size_t                 i;
+
+    if (!registry) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    mtx_lock(&registry->lock);
+    table = (struct registry_table*)atomic_load(&registry->table);
+    index = table_index(table, key);
+    for (i = 0; i < table->capacity; i++) {
+        uintptr_t slot = atomic_load(&table->slots[index]);
+        if (slot == SLOT_EMPTY) {
+            break;
+        }
+
+        if (slot != SLOT_TOMBSTONE && registry->key((void*)slot) == key) {
+            atomic_store(&table->slots[index], SLOT_TOMBSTONE);
+            registry->element_count--;
+            element = (void*)slot;
+            break;
+        }
+        index = (index + 1) & (table->capacity - 1);
+    }
+
+    // the element is not safe to release before all current readers are done
+    if (element) {
+        registry_synchronize(registry);
+    }
+    mtx_unlock(&registry->lock);
+    return element;
+}
+
+void gr_registry_enumerate(gr_registry_t* registry, gr_registry_enumfn enumFunction, void* context)
+{
+    struct registry_table* table;
+    size_t                 i;
+
+    if (!registry || !enumFunction) {
+        return;
+    }
+
+    table = (struct registry_table*)atomic_load(&registry->table);
+    for (i = 0; i < table->capacity; i++) {
+        uintptr_t slot = atomic_load(&table->slots[i]);
+        if (slot != SLOT_EMPTY && slot != SLOT_TOMBSTONE) {
+            enumFunction((void*)slot, context);
+        }
+    }
+}
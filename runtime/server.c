@@ -20,9 +20,15 @@
  *   and functionality, refer to the individual things for descriptions
  */
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // F_GET_SEALS
+#endif
+
 #include <errno.h>
 #include "aio.h"
-#include "arena.h"
+#include "buffer.h"
+#include "slab.h"
+#include "gatomic.h"
 #include "logging.h"
 #include "gracht/server.h"
 #include "thread_api.h"
@@ -30,36 +36,121 @@
 #include "utils.h"
 #include "server_private.h"
 #include "hashtable.h"
+#include "outbound.h"
+#include "protocol_table.h"
+#include "registry.h"
 #include "stack.h"
 #include "control.h"
+#include "fragment.h"
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #define GRACHT_SERVER_MAX_LINKS 4
 
+// Reactors that do not own the set descriptor the application provided wait with a
+// timeout, so they can detect the shutdown of the server.
+#define GRACHT_SERVER_REACTOR_TIMEOUT 250
+
+// The initial number of messages that can be queued for a client, the queue grows as needed
+#define GRACHT_SERVER_OUTBOUND_CAPACITY 64
+
 #define GRACHT_CLIENT_FLAG_STREAM  0x1
 #define GRACHT_CLIENT_FLAG_CLEANUP 0x2
 
+// Protocol id 0xFF is used by the control protocol to (un)subscribe to all protocols
+#define GRACHT_PROTOCOL_ALL         0xFF
+#define GRACHT_SERVER_MAX_PROTOCOLS 256
+
 struct client_wrapper {
+    atomic_int                   references; // the registry holds one, see client_get
     gracht_conn_t                handle;
+    gracht_handle_t              set_handle;
     struct gracht_link*          link;
     struct gracht_server_client* client;
+    struct gracht_outbound       outbound;
+    unsigned int                 aio_events;
+    int                          reading;
+    int                          paused;
+    int                          flush_pending;
+    int                          subscribed_all;
+    int                          subscribed_default;
+    int                          detached;
+    int                          stalled;
+    struct gracht_message*       stalled_message;
+    struct gracht_message*       assembled; // fragmented message being received
+    struct gracht_assembly       assembly;
+};
+
+// Entry in the subscriber index. Clients that are subscribed to all protocols are kept
+// in a seperate table, otherwise a client is present in the table of each protocol it
+// has subscribed to.
+struct subscriber {
+    gracht_conn_t          handle;
+    struct client_wrapper* entry;
+};
+
+struct gracht_reactor {
+    struct gracht_server* server;
+    thrd_t                id;
+    gracht_handle_t       set_handle;
+    void*                 recvBuffer;
 };
 
 struct broadcast_context {
-    struct gracht_buffer* message;
-    unsigned int          flags;
+    struct gracht_server*   server;
+    struct gracht_payload** payloads; // the frames of the event if it had to be fragmented
+    int                     count;
+    uint8_t                 protocol;
+    unsigned int            flags;
+};
+
+// Clients that have data queued by message handlers are flushed when the handler
+// returns, this way events broadcast back-to-back are written in one go.
+struct flush_batch {
+    gracht_conn_t* handles;
+    int            count;
+    int            capacity;
+};
+
+// The chunks of a streamed call, and the message that ends it, are handled one at a time
+// in the order they were received. The first one is dispatched to the workers, the ones
+// that follow wait here until the worker that handles the one before picks them up.
+struct call_entry {
+    gracht_conn_t          client;
+    uint32_t               message_id;
+    struct gracht_message* running;
+    struct gr_queue        pending;
+};
+
+// Clients and links that we stopped reading from because the workers could not keep up,
+// they are resumed in the order they were stalled.
+struct stalled_list {
+    gracht_conn_t* handles;
+    int            count;
+    int            capacity;
 };
 
 struct server_operations {
-    void                   (*dispatch)(struct gracht_server*, struct gracht_message*);
-    struct gracht_message* (*get_incoming_buffer)(struct gracht_server*);
+    int                    (*dispatch)(struct gracht_server*, struct gracht_message*);
+    struct gracht_message* (*get_incoming_buffer)(struct gracht_server*, struct gracht_reactor*);
     void                   (*put_message)(struct gracht_server*, struct gracht_message*);
 };
 
+// A link is stalled by the primary reactor and resumed by whichever thread drains the workers.
+// The stalled message is only touched by the side that owns the link at that moment, and ownership
+// is handed over through the stalled flag, which is only changed after the message has been updated.
 struct link_table {
-    gracht_conn_t       handles[GRACHT_SERVER_MAX_LINKS];
-    struct gracht_link* links[GRACHT_SERVER_MAX_LINKS];
+    gracht_conn_t          handles[GRACHT_SERVER_MAX_LINKS];
+    struct gracht_link*    links[GRACHT_SERVER_MAX_LINKS];
+    atomic_int             stalled[GRACHT_SERVER_MAX_LINKS];
+    struct gracht_message* stalled_messages[GRACHT_SERVER_MAX_LINKS];
 };
 
 enum server_state {
@@ -75,14 +166,31 @@ typedef struct gracht_server {
     struct gracht_worker_pool*     worker_pool;
     struct stack                   bufferStack;
     size_t                         allocationSize;
-    void*                          recvBuffer;
+    uint32_t                       max_message_size;
+    uint32_t                       max_transfer_size;
     gracht_handle_t                set_handle;
     int                            set_handle_provided;
-    struct gracht_arena*           arena;
-    gr_hashtable_t                 protocols;
-    struct rwlock                  protocols_lock;
-    gr_hashtable_t                 clients;
-    struct rwlock                  clients_lock;
+    struct gracht_reactor*         reactors;
+    int                            reactor_count;
+    int                            reactors_started;
+    atomic_uint                    reactor_index;
+    struct gracht_slab*            slab;
+    gr_protocol_table_t            protocols;
+    gr_registry_t                  clients;
+    size_t                         outbound_low;
+    size_t                         outbound_high;
+    gr_hashtable_t*                subscribers[GRACHT_SERVER_MAX_PROTOCOLS];
+    gr_hashtable_t                 subscribers_all;
+    struct rwlock                  subscribers_lock;
+    mtx_t                          stalled_lock;
+    struct stalled_list            stalled;
+    atomic_int                     stalled_count;
+    uint64_t                       stalls;
+    uint64_t                       resumes;
+    mtx_t                          calls_lock;
+    gr_hashtable_t                 calls;
+    atomic_int                     calls_active;
+    unsigned int                   call_capacity;
     struct link_table              link_table;
 } gracht_server_t;
 
@@ -91,10 +199,13 @@ GRACHTAPI int gracht_server_get_buffer(gracht_server_t*, gracht_buffer_t*);
 GRACHTAPI int gracht_server_respond(struct gracht_message*, gracht_buffer_t*);
 GRACHTAPI int gracht_server_send_event(gracht_server_t*, gracht_conn_t client, gracht_buffer_t*, unsigned int flags);
 GRACHTAPI int gracht_server_broadcast_event(gracht_server_t*, gracht_buffer_t*, unsigned int flags);
+GRACHTAPI const void* gracht_server_map_bulk(struct gracht_message*, uint32_t index, size_t length);
+GRACHTAPI int gracht_server_message_is_chunk(struct gracht_message*);
+GRACHTAPI void gracht_server_unmap_bulk(const void* data, size_t length);
 
-static struct gracht_message* get_in_buffer_st(struct gracht_server*);
+static struct gracht_message* get_in_buffer_st(struct gracht_server*, struct gracht_reactor*);
 static void                   put_message_st(struct gracht_server*, struct gracht_message*);
-static void                   dispatch_st(struct gracht_server*, struct gracht_message*);
+static int                    dispatch_st(struct gracht_server*, struct gracht_message*);
 
 static struct server_operations g_stOperations = {
     dispatch_st,
@@ -102,9 +213,9 @@ static struct server_operations g_stOperations = {
     put_message_st
 };
 
-static struct gracht_message* get_in_buffer_mt(struct gracht_server*);
+static struct gracht_message* get_in_buffer_mt(struct gracht_server*, struct gracht_reactor*);
 static void                   put_message_mt(struct gracht_server*, struct gracht_message*);
-static void                   dispatch_mt(struct gracht_server*, struct gracht_message*);
+static int                    dispatch_mt(struct gracht_server*, struct gracht_message*);
 
 static struct server_operations g_mtOperations = {
     dispatch_mt,
@@ -112,15 +223,47 @@ static struct server_operations g_mtOperations = {
     put_message_mt
 };
 
+static int  reactor_main(void*);
+static int  gracht_server_shutdown(gracht_server_t*);
 static void client_destroy(struct gracht_server*, gracht_conn_t);
 static void client_subscribe(struct gracht_server_client*, uint8_t);
 static void client_unsubscribe(struct gracht_server_client*, uint8_t);
 static int  client_is_subscribed(struct gracht_server_client*, uint8_t);
 
-static uint64_t client_hash(const void*);
-static int      client_cmp(const void*, const void*);
-static void     client_enum_destroy(int index, const void* element, void* userContext);
-static void     client_enum_broadcast(int index, const void* element, void* userContext);
+static __TLS_VAR struct flush_batch* g_flushBatch = NULL;
+
+static void server_subscribe(struct gracht_server*, struct client_wrapper*, uint8_t);
+static void server_unsubscribe(struct gracht_server*, struct client_wrapper*, uint8_t);
+static void server_detach(struct gracht_server*, struct client_wrapper*);
+
+static struct client_wrapper* client_create(struct gracht_link*, struct gracht_server_client*, gracht_conn_t, gracht_handle_t);
+static struct client_wrapper* client_get(struct gracht_server*, gracht_conn_t);
+static void client_put(struct gracht_server*, struct client_wrapper*);
+static int  client_send(struct gracht_server*, struct client_wrapper*, struct gracht_buffer*, unsigned int, int);
+static void client_queue(struct gracht_server*, struct client_wrapper*, struct gracht_payload**, int, unsigned int);
+static void client_flush(struct gracht_server*, struct client_wrapper*);
+static void client_release(struct gracht_server*, struct client_wrapper*);
+static void client_discard_assembly(struct gracht_server*, struct client_wrapper*);
+static void flush_batch_complete(struct gracht_server*, struct flush_batch*);
+static void client_update_events(struct gracht_server*, struct client_wrapper*);
+static void client_stall(struct gracht_server*, struct client_wrapper*, struct gracht_message*);
+static struct gracht_message* stalled_message_compact(struct gracht_server*, struct gracht_message*);
+static void message_take_bulk(struct gracht_server*, struct gracht_link*, struct gracht_server_client*, struct gracht_message*);
+static void message_strip_bulk(struct gracht_message*);
+static void message_release_bulk(struct gracht_message*);
+static uint8_t* message_bulk_fds(struct gracht_message*);
+
+static void server_stall(struct gracht_server*, gracht_conn_t);
+static void server_resume_stalled(struct gracht_server*);
+
+static uint64_t client_key(const void*);
+static void     client_enum_destroy(void* element, void* userContext);
+static uint64_t subscriber_hash(const void*);
+static int      subscriber_cmp(const void*, const void*);
+static void     subscriber_enum_broadcast(int index, const void* element, void* userContext);
+static uint64_t call_hash(const void*);
+static int      call_cmp(const void*, const void*);
+static void     call_enum_destroy(int index, const void* element, void* userContext);
 
 
 static int configure_server(struct gracht_server*, gracht_server_configuration_t*);
@@ -151,10 +294,13 @@ int gracht_server_create(gracht_server_configuration_t* config, gracht_server_t*
     }
 
     // initialize static members of the instance
-    rwlock_init(&server->protocols_lock);
-    rwlock_init(&server->clients_lock);
-    gr_hashtable_construct(&server->protocols, 0, sizeof(struct gracht_protocol), protocol_hash, protocol_cmp);
-    gr_hashtable_construct(&server->clients, 0, sizeof(struct client_wrapper), client_hash, client_cmp);
+    gr_protocol_table_construct(&server->protocols);
+    gr_registry_construct(&server->clients, client_key);
+    rwlock_init(&server->subscribers_lock);
+    mtx_init(&server->stalled_lock, mtx_plain);
+    gr_hashtable_construct(&server->subscribers_all, 0, sizeof(struct subscriber), subscriber_hash, subscriber_cmp);
+    mtx_init(&server->calls_lock, mtx_plain);
+    gr_hashtable_construct(&server->calls, 0, sizeof(struct call_entry), call_hash, call_cmp);
     stack_construct(&server->bufferStack, 8);
 
     // everything is set up - update state before registering control protocol
@@ -162,19 +308,94 @@ int gracht_server_create(gracht_server_configuration_t* config, gracht_server_t*
 
     gracht_server_register_protocol(server, &gracht_control_server_protocol);
 
+    // start the additional reactors now that the server is running, the primary reactor
+    // is run by the application either through main_loop or handle_event
+    for (int i = 1; i < server->reactor_count; i++) {
+        status = thrd_create(&server->reactors[i].id, reactor_main, &server->reactors[i]);
+        if (status != thrd_success) {
+            GRERROR(GRSTR("gracht_server_create: failed to create reactor-thread"));
+            gracht_server_shutdown(server);
+            errno = status == thrd_nomem ? ENOMEM : EAGAIN;
+            return -1;
+        }
+        server->reactors_started++;
+    }
+
     *serverOut = server;
     return 0;
 }
 
+static int configure_reactors(struct gracht_server* server, gracht_server_configuration_t* configuration)
+{
+    int reactorCount = configuration->server_reactors > 1 ? configuration->server_reactors : 1;
+    int i;
+
+    server->reactors = malloc(sizeof(struct gracht_reactor) * reactorCount);
+    if (!server->reactors) {
+        GRERROR(GRSTR("configure_reactors: failed to allocate memory for reactors"));
+        return -1;
+    }
+    memset(server->reactors, 0, sizeof(struct gracht_reactor) * reactorCount);
+    server->reactor_count = reactorCount;
+
+    for (i = 0; i < reactorCount; i++) {
+        struct gracht_reactor* reactor = &server->reactors[i];
+
+        reactor->server = server;
+        if (i == 0) {
+            // the primary reactor uses the set descriptor of the server
+            reactor->set_handle = server->set_handle;
+        } else {
+            reactor->set_handle = gracht_aio_create();
+            if (reactor->set_handle == GRACHT_HANDLE_INVALID) {
+                GRERROR(GRSTR("configure_reactors: failed to create aio handle"));
+                return -1;
+            }
+        }
+
+        // single-threaded servers handle messages on the reactor thread, straight from
+        // the receive buffer of the reactor
+        if (!server->worker_pool) {
+            reactor->recvBuffer = malloc(server->allocationSize);
+            if (!reactor->recvBuffer) {
+                GRERROR(GRSTR("configure_reactors: failed to allocate memory for incoming messages"));
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
 static int configure_server(struct gracht_server* server, gracht_server_configuration_t* configuration)
 {
-    size_t arenaSize;
+    size_t memoryLimit;
+    int    maxMessageSize;
+    int    queueCapacity;
+    int    reactorCount;
     int    status;
 
+    // additional reactors handle messages on their own threads, which is only supported when
+    // the messages are handed to the workers. Otherwise the handlers (and the control protocol)
+    // would be run concurrently without the server being configured for it.
+    if (configuration->server_reactors > 1 && configuration->server_workers <= 1) {
+        GRERROR(GRSTR("gracht_server: multiple reactors require the server to use workers"));
+        errno = EINVAL;
+        return -1;
+    }
+
     // set the configuration params that are just transfer
     memcpy(&server->callbacks, &configuration->callbacks, sizeof(struct gracht_server_callbacks));
 
     // handle the aio descriptor
+#ifdef GRACHT_AIO_URING
+    // the io_uring backend receives on behalf of the links, which it can only do for
+    // rings it created itself
+    if (configuration->set_descriptor_provided) {
+        GRERROR(GRSTR("gracht_server: an aio descriptor can not be provided when built with io_uring"));
+        errno = ENOTSUP;
+        return -1;
+    }
+#endif
     if (configuration->set_descriptor_provided) {
         server->set_handle          = configuration->set_descriptor;
         server->set_handle_provided = 1;
@@ -186,14 +407,34 @@ static int configure_server(struct gracht_server* server, gracht_server_configur
         }
     }
 
+    // configure the outbound limits, fall back to defaults for invalid values
+    server->outbound_high = configuration->outbound_high_watermark;
+    server->outbound_low  = configuration->outbound_low_watermark;
+    if (!server->outbound_high) {
+        server->outbound_high = GRACHT_DEFAULT_OUTBOUND_HIGH_WATERMARK;
+    }
+    if (server->outbound_low > server->outbound_high) {
+        server->outbound_low = server->outbound_high;
+    }
+
     // configure the allocation size, we use the max message size and add
-    // 512 bytes for context data
-    server->allocationSize = configuration->max_message_size + 512;
+    // 512 bytes for context data. Messages above the max message size are received
+    // in frames, and only allocated at their full size while they are assembled
+    maxMessageSize = configuration->max_message_size > GRACHT_MESSAGE_HEADER_SIZE ?
+        configuration->max_message_size : GRACHT_DEFAULT_MESSAGE_SIZE;
+    server->allocationSize    = maxMessageSize + 512;
+    server->max_message_size  = (uint32_t)maxMessageSize;
+    server->max_transfer_size = (uint32_t)configuration->max_transfer_size;
+    if (server->max_transfer_size < server->max_message_size) {
+        server->max_transfer_size = server->max_message_size;
+    }
 
     // handle the worker count, if the worker count is not provided we do not use
     // the dispatcher, but instead handle single-threaded.
+    queueCapacity = configuration->queue_capacity > 0 ? configuration->queue_capacity : GRACHT_DEFAULT_QUEUE_CAPACITY;
+    server->call_capacity = (unsigned int)queueCapacity;
     if (configuration->server_workers > 1) {
-        status = gracht_worker_pool_create(server, configuration->server_workers, &server->worker_pool);
+        status = gracht_worker_pool_create(server, configuration->server_workers, queueCapacity, &server->worker_pool);
         if (status) {
             GRERROR(GRSTR("configure_server: failed to create the worker pool"));
             return -1;
@@ -203,22 +444,33 @@ static int configure_server(struct gracht_server* server, gracht_server_configur
         server->ops = &g_stOperations;
     }
 
-    // handle the max message size override, otherwise we default to our default value.
+    // handle the max message size override, otherwise we default to our default value. The
+    // slab is limited to the queued messages, those being handled and a receive buffer per reactor.
+    // Single-threaded servers receive into the buffer of the reactor, and only use the slab for
+    // fragmented messages, which leaves room for a message of the maximum transfer size per reactor
+    reactorCount = configuration->server_reactors > 1 ? configuration->server_reactors : 1;
+    memoryLimit  = reactorCount * (size_t)server->max_transfer_size;
     if (configuration->server_workers > 1) {
-        arenaSize = configuration->server_workers * server->allocationSize * 32;
-        status    = gracht_arena_create(arenaSize, &server->arena);
-        if (status) {
-            GRERROR(GRSTR("configure_server: failed to create the memory pool"));
-            return -1;
-        }
-    } else {
-        server->recvBuffer = malloc(server->allocationSize);
-        if (!server->recvBuffer) {
-            GRERROR(GRSTR("configure_server: failed to allocate memory for incoming messages"));
-            return -1;
-        }
+        memoryLimit += ((configuration->server_workers * (queueCapacity + 1)) + reactorCount) * server->allocationSize;
     }
-    return 0;
+    status = gracht_slab_create(server->allocationSize, memoryLimit, &server->slab);
+    if (status) {
+        GRERROR(GRSTR("configure_server: failed to create the memory pool"));
+        return -1;
+    }
+    return configure_reactors(server, configuration);
+}
+
+static struct gracht_reactor* select_reactor(struct gracht_server* server)
+{
+    unsigned int index;
+
+    if (server->reactor_count == 1) {
+        return &server->reactors[0];
+    }
+
+    index = atomic_fetch_add(&server->reactor_index, 1);
+    return &server->reactors[index % server->reactor_count];
 }
 
 int gracht_server_add_link(gracht_server_t* server, struct gracht_link* link)
@@ -262,25 +514,35 @@ int gracht_server_add_link(gracht_server_t* server, struct gracht_link* link)
 static int handle_connection(struct gracht_server* server, struct gracht_link* link)
 {
     struct gracht_server_client* client;
+    struct client_wrapper*       entry;
+    struct gracht_reactor*       reactor = select_reactor(server);
 
-    int status = link->ops.server.accept_client(link, server->set_handle, &client);
+    int status = link->ops.server.accept_client(link, reactor->set_handle, &client);
     if (status) {
         GRERROR(GRSTR("gracht_server: failed to accept client"));
         return status;
     }
 
-    // this is a streaming client, which means we handle them differently if they should
-    // unsubscribe to certain protocols. Streaming clients are subscribed to all from start
+    entry = client_create(link, client, client->handle, reactor->set_handle);
+    if (!entry) {
+        GRERROR(GRSTR("gracht_server: failed to allocate memory for client"));
+        link->ops.server.destroy_client(client, reactor->set_handle);
+        errno = ENOMEM;
+        return -1;
+    }
     client->flags |= GRACHT_CLIENT_FLAG_STREAM;
-    memset(&client->subscriptions[0], 0xFF, sizeof(client->subscriptions));
-    
-    rwlock_w_lock(&server->clients_lock);
-    gr_hashtable_set(&server->clients, &(struct client_wrapper) { 
-        .handle = client->handle,
-        .link = link,
-        .client = client
-    });
-    rwlock_w_unlock(&server->clients_lock);
+
+    // this is a streaming client, which means we handle them differently if they should
+    // unsubscribe to certain protocols. Streaming clients are subscribed to all from start,
+    // until they subscribe to a protocol themselves
+    server_subscribe(server, entry, GRACHT_PROTOCOL_ALL);
+    entry->subscribed_default = 1;
+    if (gr_registry_add(&server->clients, entry)) {
+        GRERROR(GRSTR("gracht_server: failed to register client"));
+        server_detach(server, entry);
+        client_release(server, entry);
+        return -1;
+    }
 
     // invoke the new client callback at last
     if (server->callbacks.clientConnected) {
@@ -289,9 +551,9 @@ static int handle_connection(struct gracht_server* server, struct gracht_link* l
     return 0;
 }
 
-static struct gracht_message* get_in_buffer_st(struct gracht_server* server)
+static struct gracht_message* get_in_buffer_st(struct gracht_server* server, struct gracht_reactor* reactor)
 {
-    struct gracht_message* message = (struct gracht_message*)server->recvBuffer;
+    struct gracht_message* message = (struct gracht_message*)reactor->recvBuffer;
     message->server = server;
     message->index  = server->allocationSize;
     return message;
@@ -304,34 +566,119 @@ static void put_message_st(struct gracht_server* server, struct gracht_message*
     // no op
 }
 
-static void dispatch_st(struct gracht_server* server, struct gracht_message* message)
+static int dispatch_st(struct gracht_server* server, struct gracht_message* message)
 {
     server_invoke_action(server, message);
+    return 0;
+}
+
+// The workers do not keep the order of the messages, so the messages of a streamed call are
+// kept in the queue of the call while one of them is being handled. A message that is not a
+// chunk only joins a call that is in progress, which is how the end of the call follows its chunks.
+static int dispatch_worker(struct gracht_server* server, struct gracht_message* message)
+{
+    uint8_t           flags = *((uint8_t*)&message->payload[message->index + MSG_INDEX_FLG]);
+    struct call_entry call  = { message->client, gracht_server_message_id(message), message, { 0 } };
+    struct call_entry* entry;
+    int                status;
+
+    if (!(flags & MESSAGE_FLAG_STREAM) && !atomic_load(&server->calls_active)) {
+        return gracht_worker_pool_dispatch(server->worker_pool, message);
+    }
+
+    mtx_lock(&server->calls_lock);
+    entry = gr_hashtable_get(&server->calls, &call);
+    if (entry) {
+        status = gr_queue_enqueue(&entry->pending, message);
+    }
+    else if (!(flags & MESSAGE_FLAG_STREAM)) {
+        status = gracht_worker_pool_dispatch(server->worker_pool, message);
+    }
+    else {
+        // the call is counted before the message is dispatched, and registered while holding
+        // the lock, so the worker can not complete the message without finding the call
+        status = gr_queue_construct(&call.pending, server->call_capacity);
+        if (!status) {
+            atomic_fetch_add(&server->calls_active, 1);
+            status = gracht_worker_pool_dispatch(server->worker_pool, message);
+            if (!status) {
+                gr_hashtable_set(&server->calls, &call);
+            }
+            else {
+                atomic_fetch_sub(&server->calls_active, 1);
+                gr_queue_destroy(&call.pending);
+            }
+        }
+    }
+    mtx_unlock(&server->calls_lock);
+
+    // the message stays with the caller if it can not be queued, so it can be dispatched again later
+    if (status) {
+        errno = EBUSY;
+    }
+    return status;
+}
+
+// Returns the next message of the call the message belongs to, the caller then takes over
+// handling the call. The call is removed when there are no more messages queued.
+static struct gracht_message* dispatch_call_next(struct gracht_server* server, struct gracht_message* message)
+{
+    struct call_entry      call = { message->client, gracht_server_message_id(message), NULL, { 0 } };
+    struct call_entry*     entry;
+    struct gracht_message* next = NULL;
+
+    if (!atomic_load(&server->calls_active)) {
+        return NULL;
+    }
+
+    mtx_lock(&server->calls_lock);
+    entry = gr_hashtable_get(&server->calls, &call);
+    if (entry && entry->running == message) {
+        next = gr_queue_dequeue(&entry->pending);
+        if (next) {
+            entry->running = next;
+        }
+        else {
+            gr_queue_destroy(&entry->pending);
+            gr_hashtable_remove(&server->calls, &call);
+            atomic_fetch_sub(&server->calls_active, 1);
+        }
+    }
+    mtx_unlock(&server->calls_lock);
+    return next;
 }
 
-static void dispatch_mt(struct gracht_server* server, struct gracht_message* message)
+static int dispatch_mt(struct gracht_server* server, struct gracht_message* message)
 {
     uint8_t protocol = *((uint8_t*)&message->payload[message->index + MSG_INDEX_SID]);
 
     // due to the fact that the control protocol modifies state on the server, especially
-    // client state - we want to ensure that these methods are run on orchestrator thread.
+    // client state - we want to ensure that these methods are run on the reactor thread.
     if (protocol == 0) {
         server_invoke_action(server, message);
         server_cleanup_message(server, message);
+        return 0;
     }
-    else {
-        uint32_t messageLength  = *((uint32_t*)&message->payload[message->index + MSG_INDEX_LEN]);
-        uint32_t metaDatalength = sizeof(struct gracht_message) + message->index;
 
-        gracht_arena_free(server->arena, message, server->allocationSize - messageLength - metaDatalength);
-        gracht_worker_pool_dispatch(server->worker_pool, message);
+    // the message stays with the caller if the workers can not take it, so it can
+    // be dispatched again later. While others are stalled we queue up behind them, so
+    // clients that keep sending do not starve the stalled ones
+    if (atomic_load(&server->stalled_count)) {
+        errno = EBUSY;
+        return -1;
     }
+    return dispatch_worker(server, message);
 }
 
-static struct gracht_message* get_in_buffer_mt(struct gracht_server* server)
+static struct gracht_message* get_in_buffer_mt(struct gracht_server* server, struct gracht_reactor* reactor)
 {
     struct gracht_message* message;
-    message = gracht_arena_allocate(server->arena, NULL, server->allocationSize);
+    (void)reactor;
+
+    message = gracht_slab_allocate(server->slab, server->allocationSize);
+    if (!message) {
+        return NULL;
+    }
     message->server = server;
     message->index  = server->allocationSize;
     return message;
@@ -339,16 +686,60 @@ static struct gracht_message* get_in_buffer_mt(struct gracht_server* server)
 
 static void put_message_mt(struct gracht_server* server, struct gracht_message* message)
 {
-    gracht_arena_free(server->arena, message, server->allocationSize);
+    gracht_slab_free(server->slab, message);
+}
+
+static int get_link_index(struct gracht_server* server, gracht_conn_t connection)
+{
+    for (int i = 0; i < GRACHT_SERVER_MAX_LINKS; i++) {
+        if (server->link_table.links[i] && server->link_table.handles[i] == connection) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Stops reading from the link until the workers have room for the message again, or until
+// memory is available again when no message is provided. If the aio backend can not stop
+// listening on the link, the message is handled right away.
+static void link_stall(struct gracht_server* server, gracht_conn_t handle, struct gracht_message* message)
+{
+    int index = get_link_index(server, handle);
+
+    if (gracht_aio_modify(server->set_handle, handle, 0)) {
+        if (message) {
+            server_invoke_action(server, message);
+            server_cleanup_message(server, message);
+        }
+        return;
+    }
+
+    if (message) {
+        message = stalled_message_compact(server, message);
+    }
+
+    server->link_table.stalled_messages[index] = message;
+    atomic_store(&server->link_table.stalled[index], 1);
+    server_stall(server, handle);
 }
 
-static int handle_packet(struct gracht_server* server, struct gracht_link* link)
+static int handle_packet(struct gracht_server* server, struct gracht_link* link, gracht_conn_t handle)
 {
     int status;
     GRTRACE(GRSTR("handle_packet"));
-    
+
+    // the link is disabled until the workers have caught up
+    if (atomic_load(&server->link_table.stalled[get_link_index(server, handle)])) {
+        return 0;
+    }
+
     while (1) {
-        struct gracht_message* message = server->ops->get_incoming_buffer(server);
+        struct gracht_message* message = server->ops->get_incoming_buffer(server, &server->reactors[0]);
+        if (!message) {
+            GRTRACE(GRSTR("handle_packet ran out of receiving buffers"));
+            link_stall(server, handle, NULL);
+            return 0;
+        }
 
         status = link->ops.server.recv(link, message, 0);
         if (status) {
@@ -359,7 +750,22 @@ static int handle_packet(struct gracht_server* server, struct gracht_link* link)
             break;
         }
 
-        server->ops->dispatch(server, message);
+        // connection-less links can not pass descriptors, and as there is no state kept for
+        // their clients, they can not send fragmented messages either
+        message_strip_bulk(message);
+        if (message->payload[message->index + MSG_INDEX_FLG] & MESSAGE_FLAG_FRAGMENT) {
+            if (message->payload[message->index + MSG_INDEX_FLG] & MESSAGE_FLAG_FRAGMENT_START) {
+                gracht_control_event_error_single(server, message->client,
+                    *((uint32_t*)&message->payload[message->index + MSG_INDEX_ID]), EMSGSIZE);
+            }
+            server->ops->put_message(server, message);
+            continue;
+        }
+
+        if (server->ops->dispatch(server, message)) {
+            link_stall(server, handle, message);
+            return 0;
+        }
     }
     
     return status;
@@ -375,52 +781,166 @@ static struct gracht_link* get_link_by_conn(struct gracht_server* server, gracht
     return NULL;
 }
 
-static int handle_client_event(struct gracht_server* server, gracht_conn_t handle, uint32_t events)
+static void client_discard_assembly(struct gracht_server* server, struct client_wrapper* entry)
 {
-    int status;
+    if (entry->assembled) {
+        // the header of the message is there as soon as the first frame has been added
+        message_release_bulk(entry->assembled);
+        gracht_slab_free(server->slab, entry->assembled);
+        entry->assembled = NULL;
+    }
+}
+
+// Adds the frame to the message the client is sending in frames, the frame is consumed. Returns
+// the complete message once the last frame has been received, which has the descriptors of the
+// first frame stored after it.
+static struct gracht_message* client_assemble(struct gracht_server* server, struct client_wrapper* entry,
+    struct gracht_message* frame)
+{
+    const uint8_t*         data     = &frame->payload[frame->index];
+    int                    count    = MESSAGE_FLAG_BULK_COUNT(data[MSG_INDEX_FLG]);
+    struct gracht_message* message  = NULL;
+    uint32_t               frameId  = *((const uint32_t*)&data[MSG_INDEX_ID]);
+    int                    status;
+
+    // the first frame of a message replaces any message that was not completed
+    if (data[MSG_INDEX_FLG] & MESSAGE_FLAG_FRAGMENT_START) {
+        uint32_t length = gracht_assembly_length(data);
+
+        client_discard_assembly(server, entry);
+        if (!length || length > server->max_transfer_size) {
+            GRWARNING(GRSTR("client_assemble message of %u bytes from %" F_CONN_T " is too large"), length, entry->handle);
+            message_release_bulk(frame);
+            server->ops->put_message(server, frame);
+            gracht_control_event_error_single(server, entry->handle, frameId, EMSGSIZE);
+            return NULL;
+        }
+
+        entry->assembled = gracht_slab_allocate(server->slab,
+            sizeof(struct gracht_message) + length + (sizeof(int) * GRACHT_BULK_MAX));
+        if (!entry->assembled) {
+            message_release_bulk(frame);
+            server->ops->put_message(server, frame);
+            gracht_control_event_error_single(server, entry->handle, frameId, ENOMEM);
+            return NULL;
+        }
+        memcpy(entry->assembled, frame, sizeof(struct gracht_message));
+        entry->assembled->size  = length;
+        entry->assembled->index = 0;
+        entry->assembly.data    = &entry->assembled->payload[0];
+        entry->assembly.length  = length;
+        entry->assembly.offset  = 0;
+
+        // only the first frame carries descriptors, which are stored after the message
+        memcpy(&entry->assembled->payload[length], message_bulk_fds(frame), sizeof(int) * (size_t)count);
+    }
+    else if (!entry->assembled) {
+        // the rest of a message we could not assemble
+        server->ops->put_message(server, frame);
+        return NULL;
+    }
+
+    status = gracht_assembly_append(&entry->assembly, data);
+    server->ops->put_message(server, frame);
+    if (status == 1) {
+        message          = entry->assembled;
+        entry->assembled = NULL;
+    }
+    else if (status == -1) {
+        GRWARNING(GRSTR("client_assemble frame of message %u from %" F_CONN_T " was out of order"),
+            frameId, entry->handle);
+        client_discard_assembly(server, entry);
+    }
+    return message;
+}
+
+static int handle_client_event(struct gracht_server* server, struct gracht_reactor* reactor,
+    gracht_conn_t handle, uint32_t events)
+{
+    struct client_wrapper* entry;
+    int                    status;
     GRTRACE(GRSTR("handle_client_event %" F_CONN_T ", 0x%x"), handle, events);
     
     // Check for control event. On non-passive sockets, control event is the
     // disconnect event.
     if (events & GRACHT_AIO_EVENT_DISCONNECT) {
         client_destroy(server, handle);
+        return 0;
     }
-    else if ((events & GRACHT_AIO_EVENT_IN) || !events) {
-        struct client_wrapper* entry;
-        
-        rwlock_r_lock(&server->clients_lock);
-        entry = gr_hashtable_get(&server->clients, &(struct client_wrapper){ .handle = handle });
-        while (entry) {
-            struct gracht_message* message = server->ops->get_incoming_buffer(server);
+
+    if (events && !(events & (GRACHT_AIO_EVENT_IN | GRACHT_AIO_EVENT_OUT))) {
+        return 0;
+    }
+
+    // the client is pinned instead of staying in a read section of the registry, as
+    // single-threaded servers run the message handlers from here
+    entry = client_get(server, handle);
+    if (!entry) {
+        return 0;
+    }
+
+    // the client can receive again, write out whatever is queued for it. Links whose client
+    // handle never reports being writable raise a read event instead
+    if (entry->link->ops.server.writable_client ?
+        ((events & GRACHT_AIO_EVENT_IN) && entry->link->ops.server.writable_client(entry->client)) :
+        (events & GRACHT_AIO_EVENT_OUT) != 0) {
+        mtx_lock(&entry->outbound.lock);
+        client_flush(server, entry);
+        mtx_unlock(&entry->outbound.lock);
+    }
+
+    // write events also bring us back to messages the link has read ahead, see client_update_events.
+    // Stop reading when the client has too much data queued, reading is resumed once the client
+    // has caught up. The same goes for when the workers are busy
+    while (!entry->paused && !entry->stalled) {
+        struct gracht_message* message = server->ops->get_incoming_buffer(server, reactor);
+        if (!message) {
+            GRTRACE(GRSTR("handle_client_event ran out of receiving buffers"));
+            client_stall(server, entry, NULL);
+            break;
+        }
+
+        status = entry->link->ops.server.recv_client(entry->client, message, 0);
+        if (status) {
+            server->ops->put_message(server, message);
+
+            // silence the three below error codes, those are expected
+            if (errno != ENODATA && errno != EAGAIN && errno != EFAULT) {
+                GRERROR(GRSTR("handle_client_event server_object.link->recv_client returned %i"), errno);
+            }
+
+            // detect cases of disconnection or transmission failures that are fatal.
+            // in these cases we expect the underlying link to specify EFAULT
+            if (errno == EFAULT) {
+                GRTRACE(GRSTR("handle_client_event client disconnected, cleaning up"));
+                client_destroy(server, handle);
+            }
+            client_put(server, entry);
+            return 0;
+        }
+
+        message_take_bulk(server, entry->link, entry->client, message);
+        if (message->payload[message->index + MSG_INDEX_FLG] & MESSAGE_FLAG_FRAGMENT) {
+            message = client_assemble(server, entry, message);
             if (!message) {
-                GRERROR(GRSTR("handle_client_event ran out of receiving buffers"));
-                errno = ENOMEM;
-                return -1;
+                continue;
             }
-            
-            status = entry->link->ops.server.recv_client(entry->client, message, 0);
-            if (status) {
-                server->ops->put_message(server, message);
-                rwlock_r_unlock(&server->clients_lock);
-
-                // silence the three below error codes, those are expected
-                if (errno != ENODATA && errno != EAGAIN && errno != EFAULT) {
-                    GRERROR(GRSTR("handle_client_event server_object.link->recv_client returned %i"), errno);
-                }
-
-                // detect cases of disconnection or transmission failures that are fatal.
-                // in these cases we expect the underlying link to specify EFAULT
-                if (errno == EFAULT) {
-                    GRTRACE(GRSTR("handle_client_event client disconnected, cleaning up"));
-                    client_destroy(server, handle);
-                }
-                return 0;
+
+            // single-threaded servers handle the message right away, and do not free them as they
+            // are otherwise received into the buffer of the reactor
+            if (!server->worker_pool) {
+                server->ops->dispatch(server, message);
+                gracht_slab_free(server->slab, message);
+                continue;
             }
+        }
 
-            server->ops->dispatch(server, message);
+        if (server->ops->dispatch(server, message)) {
+            client_stall(server, entry, message);
+            break;
         }
-        rwlock_r_unlock(&server->clients_lock);
     }
+    client_put(server, entry);
     return 0;
 }
 
@@ -435,16 +955,24 @@ static int gracht_server_shutdown(gracht_server_t* server)
         return -1;
     }
     server->state = SHUTDOWN;
+
+    // wait for the additional reactors to exit, they will detect the state change
+    for (i = 1; i <= server->reactors_started; i++) {
+        int exitCode;
+        thrd_join(server->reactors[i].id, &exitCode);
+    }
     
     // destroy all our workers
     if (server->worker_pool) {
         gracht_worker_pool_destroy(server->worker_pool);
     }
 
-    // start out by destroying all our clients
-    rwlock_w_lock(&server->clients_lock);
-    gr_hashtable_enumerate(&server->clients, client_enum_destroy, server);
-    rwlock_w_unlock(&server->clients_lock);
+    // messages that were waiting for their call to progress are never going to be handled
+    gr_hashtable_enumerate(&server->calls, call_enum_destroy, server);
+
+    // start out by destroying all our clients, at this point no one else is
+    // accessing the registry anymore
+    gr_registry_enumerate(&server->clients, client_enum_destroy, server);
 
     // destroy all our links
     for (i = 0; i < GRACHT_SERVER_MAX_LINKS; i++) {
@@ -462,24 +990,38 @@ static int gracht_server_shutdown(gracht_server_t* server)
     // iterate all our serializer buffers and destroy them
     buffer = stack_pop(&server->bufferStack);
     while (buffer) {
-        free(buffer);
+        gracht_buffer_destroy(buffer);
         buffer = stack_pop(&server->bufferStack);
     }
 
     // destroy all our allocated resources
-    if (server->arena) {
-        gracht_arena_destroy(server->arena);
+    if (server->slab) {
+        gracht_slab_destroy(server->slab);
     }
     
-    if (server->recvBuffer) {
-        free(server->recvBuffer);
+    for (i = 0; i < server->reactor_count; i++) {
+        if (i != 0 && server->reactors[i].set_handle != GRACHT_HANDLE_INVALID) {
+            gracht_aio_destroy(server->reactors[i].set_handle);
+        }
+        free(server->reactors[i].recvBuffer);
     }
+    free(server->reactors);
 
     stack_destroy(&server->bufferStack);
-    gr_hashtable_destroy(&server->protocols);
-    gr_hashtable_destroy(&server->clients);
-    rwlock_destroy(&server->protocols_lock);
-    rwlock_destroy(&server->clients_lock);
+    gr_protocol_table_destroy(&server->protocols);
+    gr_registry_destroy(&server->clients);
+    for (i = 0; i < GRACHT_SERVER_MAX_PROTOCOLS; i++) {
+        if (server->subscribers[i]) {
+            gr_hashtable_destroy(server->subscribers[i]);
+            free(server->subscribers[i]);
+        }
+    }
+    gr_hashtable_destroy(&server->subscribers_all);
+    rwlock_destroy(&server->subscribers_lock);
+    mtx_destroy(&server->stalled_lock);
+    gr_hashtable_destroy(&server->calls);
+    mtx_destroy(&server->calls_lock);
+    free(server->stalled.handles);
     free(server);
     return 0;
 }
@@ -499,10 +1041,71 @@ void gracht_server_request_shutdown(gracht_server_t* server)
     server->state = SHUTDOWN_REQUESTED;
 }
 
+// The descriptors a message carries are stored right after it in the receive buffer
+static uint8_t* message_bulk_fds(struct gracht_message* message)
+{
+    uint32_t messageLength = *((uint32_t*)&message->payload[message->index + MSG_INDEX_LEN]);
+    return &message->payload[message->index + messageLength];
+}
+
+static void message_strip_bulk(struct gracht_message* message)
+{
+    message->payload[message->index + MSG_INDEX_FLG] &= ~(uint8_t)(GRACHT_BULK_MAX << MESSAGE_FLAG_BULK_SHIFT);
+}
+
+// Takes the descriptors the message was sent with from the link. Descriptors that are
+// missing are stored as -1, so mapping them fails.
+static void message_take_bulk(struct gracht_server* server, struct gracht_link* link,
+    struct gracht_server_client* client, struct gracht_message* message)
+{
+    int count = MESSAGE_FLAG_BULK_COUNT(message->payload[message->index + MSG_INDEX_FLG]);
+    int fds[GRACHT_BULK_MAX];
+    int received = 0;
+
+    if (!count) {
+        return;
+    }
+
+    if (client && link->ops.server.recv_client_fds) {
+        received = link->ops.server.recv_client_fds(client, &fds[0], count);
+    }
+
+    if ((size_t)(message_bulk_fds(message) - (uint8_t*)message) + (sizeof(int) * (size_t)count) >
+        server->allocationSize) {
+        while (received) {
+            close(fds[--received]);
+        }
+        message_strip_bulk(message);
+        return;
+    }
+
+    while (received < count) {
+        fds[received++] = -1;
+    }
+    memcpy(message_bulk_fds(message), &fds[0], sizeof(int) * (size_t)count);
+}
+
+static void message_release_bulk(struct gracht_message* message)
+{
+    int count = MESSAGE_FLAG_BULK_COUNT(message->payload[message->index + MSG_INDEX_FLG]);
+    int fds[GRACHT_BULK_MAX];
+    int i;
+
+    memcpy(&fds[0], message_bulk_fds(message), sizeof(int) * (size_t)count);
+    for (i = 0; i < count; i++) {
+        if (fds[i] >= 0) {
+            close(fds[i]);
+        }
+    }
+    message_strip_bulk(message);
+}
+
 void server_invoke_action(struct gracht_server* server, struct gracht_message* recvMessage)
 {
     gracht_protocol_function_t* function;
     gracht_buffer_t             buffer = { .data = (char*)&recvMessage->payload[0], .index = recvMessage->index };
+    struct flush_batch          batch  = { NULL, 0, 0 };
+    struct flush_batch*         previousBatch;
     uint32_t                    messageId;
     uint8_t                     protocol;
     uint8_t                     action;
@@ -512,18 +1115,108 @@ void server_invoke_action(struct gracht_server* server, struct gracht_message* r
     action    = GB_MSG_AID(&buffer);
     GRTRACE(GRSTR("server_invoke_action %u: %u/%u"), messageId, protocol, action);
 
-    rwlock_r_lock(&server->protocols_lock);
     function = get_protocol_action(&server->protocols, protocol, action);
-    rwlock_r_unlock(&server->protocols_lock);
     if (!function) {
         GRWARNING(GRSTR("server_invoke_action failed to invoke server action"));
         gracht_control_event_error_single(server, recvMessage->client, messageId, ENOENT);
+        message_release_bulk(recvMessage);
         return;
     }
 
-    // skip the message header when invoking
+    // skip the message header when invoking, and collect the clients that get data
+    // queued by the handler so they can be flushed once it returns
     buffer.index += GRACHT_MESSAGE_HEADER_SIZE;
+    previousBatch = g_flushBatch;
+    g_flushBatch  = &batch;
     ((server_invoke_t)function->address)(recvMessage, &buffer);
+    g_flushBatch  = previousBatch;
+    flush_batch_complete(server, &batch);
+
+    // the handler has mapped what it needs of the shared memory
+    message_release_bulk(recvMessage);
+}
+
+// The chunks of a call with streamed parameters carry the id of the call, as does the end of it
+uint32_t gracht_server_message_id(struct gracht_message* message)
+{
+    return *((uint32_t*)&message->payload[message->index + MSG_INDEX_ID]);
+}
+
+// The chunks of a call with streamed parameters are invoked on the same protocol function as the
+// end of the call, which is told apart by this
+int gracht_server_message_is_chunk(struct gracht_message* message)
+{
+    return (message->payload[message->index + MSG_INDEX_FLG] & MESSAGE_FLAG_STREAM) != 0;
+}
+
+// Maps the shared memory the array was moved to by the client as a read-only view. The memory
+// is only accepted if it has been sealed against changes, and holds atleast the array.
+const void* gracht_server_map_bulk(struct gracht_message* message, uint32_t index, size_t length)
+{
+#if defined(__linux__)
+    int         count = MESSAGE_FLAG_BULK_COUNT(message->payload[message->index + MSG_INDEX_FLG]);
+    int         requiredSeals = F_SEAL_SHRINK | F_SEAL_WRITE;
+    int         fd;
+    int         seals;
+    struct stat stats;
+    void*       data;
+
+    if (index >= (uint32_t)count || !length) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    memcpy(&fd, message_bulk_fds(message) + (sizeof(int) * index), sizeof(int));
+    if (fd < 0) {
+        errno = EBADF;
+        return NULL;
+    }
+
+    seals = fcntl(fd, F_GET_SEALS);
+    if (seals == -1 || (seals & requiredSeals) != requiredSeals ||
+        fstat(fd, &stats) || (uint64_t)stats.st_size < (uint64_t)length) {
+        GRWARNING(GRSTR("gracht_server_map_bulk client sent memory that can not be mapped safely"));
+        errno = EACCES;
+        return NULL;
+    }
+
+    data = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        return NULL;
+    }
+    return data;
+#else
+    (void)message;
+    (void)index;
+    (void)length;
+    errno = ENOTSUP;
+    return NULL;
+#endif
+}
+
+void gracht_server_unmap_bulk(const void* data, size_t length)
+{
+#if defined(__linux__)
+    if (data) {
+        munmap((void*)data, length);
+    }
+#else
+    (void)data;
+    (void)length;
+#endif
+}
+
+void server_handle_message(struct gracht_server* server, struct gracht_message* recvMessage)
+{
+    struct gracht_message* next;
+
+    // keep handling the call the message belongs to, until no more of its messages are waiting
+    while (recvMessage) {
+        server_invoke_action(server, recvMessage);
+        next = dispatch_call_next(server, recvMessage);
+        server_cleanup_message(server, recvMessage);
+        recvMessage = next;
+    }
 }
 
 void server_cleanup_message(struct gracht_server* server, struct gracht_message* recvMessage)
@@ -531,7 +1224,12 @@ void server_cleanup_message(struct gracht_server* server, struct gracht_message*
     if (!server || !recvMessage) {
         return;
     }
-    gracht_arena_free(server->arena, recvMessage, 0);
+    gracht_slab_free(server->slab, recvMessage);
+
+    // a worker just finished a message, so there might be room for the stalled ones
+    if (atomic_load(&server->stalled_count) && server->state == RUNNING) {
+        server_resume_stalled(server);
+    }
 }
 
 int gracht_server_handle_event(gracht_server_t* server, gracht_conn_t handle, unsigned int events)
@@ -554,14 +1252,14 @@ int gracht_server_handle_event(gracht_server_t* server, gracht_conn_t handle, un
 
     link = get_link_by_conn(server, handle);
     if (!link) {
-        return handle_client_event(server, handle, events);
+        return handle_client_event(server, &server->reactors[0], handle, events);
     }
 
     if (link->type == gracht_link_stream_based) {
         return handle_connection(server, link);
     }
     else if (link->type == gracht_link_packet_based) {
-        return handle_packet(server, link);
+        return handle_packet(server, link, handle);
     }
     return -1;
 }
@@ -583,7 +1281,11 @@ int gracht_server_main_loop(gracht_server_t* server)
 
     GRTRACE(GRSTR("gracht_server: started..."));
     while (server->state == RUNNING) {
-        int num_events = gracht_io_wait(server->set_handle, &events[0], 32);
+        // with multiple reactors the shutdown request may very well arrive on another reactor
+        // so make sure we wake up once in a while to check the state
+        int num_events = server->reactor_count > 1 ?
+            gracht_io_wait_timeout(server->set_handle, &events[0], 32, GRACHT_SERVER_REACTOR_TIMEOUT) :
+            gracht_io_wait(server->set_handle, &events[0], 32);
         GRTRACE(GRSTR("gracht_server: %i events received!"), num_events);
         for (i = 0; i < num_events; i++) {
             gracht_conn_t handle = gracht_aio_event_handle(&events[i]);
@@ -600,32 +1302,76 @@ int gracht_server_main_loop(gracht_server_t* server)
     return gracht_server_shutdown(server);
 }
 
-int gracht_server_get_buffer(gracht_server_t* server, gracht_buffer_t* buffer)
+static int reactor_main(void* context)
 {
-    void* data;
-    if (!server) {
-        errno = EINVAL;
-        return -1;
-    }
+    struct gracht_reactor* reactor = context;
+    struct gracht_server*  server  = reactor->server;
+    gracht_aio_event_t     events[32];
+    int                    i;
+    GRTRACE(GRSTR("reactor_main: running"));
+
+    // the additional reactors only ever contain stream-based clients, and never initiate
+    // the shutdown themselves, this is left to the primary reactor.
+    while (server->state == RUNNING) {
+        int num_events = gracht_io_wait_timeout(reactor->set_handle, &events[0], 32, GRACHT_SERVER_REACTOR_TIMEOUT);
+        for (i = 0; i < num_events && server->state == RUNNING; i++) {
+            gracht_conn_t handle = gracht_aio_event_handle(&events[i]);
+            uint32_t      flags  = gracht_aio_event_events(&events[i]);
 
-    data = stack_pop(&server->bufferStack);
-    if (!data) {
-        data = malloc(server->allocationSize);
-        if (!data) {
-            errno = ENOMEM;
-            return -1;
+            GRTRACE(GRSTR("reactor_main: event %u from %" F_CONN_T), flags, handle);
+            handle_client_event(server, reactor, handle, flags);
         }
     }
-
-    // this should always return a safe buffer to use for the request
-    buffer->data  = data;
-    buffer->index = 0;
+    GRTRACE(GRSTR("reactor_main: shutting down"));
     return 0;
 }
 
-int gracht_server_respond(struct gracht_message* messageContext, gracht_buffer_t* message)
+int gracht_server_get_overload_stats(gracht_server_t* server, struct gracht_server_overload_stats* stats)
+{
+    if (!server || !stats) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    mtx_lock(&server->stalled_lock);
+    stats->stalls  = server->stalls;
+    stats->resumes = server->resumes;
+    stats->stalled = (uint32_t)server->stalled.count;
+    mtx_unlock(&server->stalled_lock);
+    return 0;
+}
+
+int gracht_server_get_buffer(gracht_server_t* server, gracht_buffer_t* buffer)
+{
+    void* data;
+    if (!server) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // the buffers are grown for messages above the maximum message size, up to the maximum
+    // transfer size, and those are sent in frames
+    data = stack_pop(&server->bufferStack);
+    if (!data) {
+        data = gracht_buffer_create(server->max_message_size, NULL);
+        if (!data) {
+            return -1;
+        }
+    }
+    gracht_buffer_open(data, server->max_transfer_size, buffer);
+    return 0;
+}
+
+// Returns the borrowed buffer to the stack, at the size it was handed out with
+static void server_put_buffer(struct gracht_server* server, gracht_buffer_t* buffer)
+{
+    stack_push(&server->bufferStack, gracht_buffer_close(buffer));
+}
+
+int gracht_server_respond(struct gracht_message* messageContext, gracht_buffer_t* message)
 {
     struct client_wrapper* entry;
+    unsigned int           token;
     int                    status;
 
     if (!messageContext || !message) {
@@ -634,33 +1380,61 @@ int gracht_server_respond(struct gracht_message* messageContext, gracht_buffer_t
         return -1;
     }
 
+    // the message is not sent if it did not fit in the buffer
+    if (gracht_buffer_check(message)) {
+        server_put_buffer(messageContext->server, message);
+        return -1;
+    }
+
     // update message header
     GB_MSG_ID_0(message)  = *((uint32_t*)&messageContext->payload[messageContext->index]);
     GB_MSG_LEN_0(message) = message->index;
 
-    rwlock_r_lock(&messageContext->server->clients_lock);
-    entry = gr_hashtable_get(&messageContext->server->clients, &(struct client_wrapper){ .handle = messageContext->client });
+    token = gr_registry_read_lock(&messageContext->server->clients);
+    entry = gr_registry_get(&messageContext->server->clients, (uint64_t)messageContext->client);
     if (!entry) {
         struct gracht_link* link;
         
-        rwlock_r_unlock(&messageContext->server->clients_lock);
+        gr_registry_read_unlock(&messageContext->server->clients, token);
         link = get_link_by_conn(messageContext->server, messageContext->link);
         if (!link) {
             errno = ENODEV;
             return -1;
         }
+
+        // frames could be mixed with those of other responses to the client, as nothing is
+        // kept for connection-less clients that are not subscribed
+        if (message->index > messageContext->server->max_message_size) {
+            GRERROR(GRSTR("gracht_server_respond response of %u bytes is too large for a connection-less client"),
+                message->index);
+            server_put_buffer(messageContext->server, message);
+            errno = EMSGSIZE;
+            return -1;
+        }
         status = link->ops.server.send(link, messageContext, message);
     }
     else {
-        status = entry->link->ops.server.send_client(entry->client, message, GRACHT_MESSAGE_BLOCK);
-        rwlock_r_unlock(&messageContext->server->clients_lock);
+        // responses are never dropped, but they are not allowed to block the caller either
+        status = client_send(messageContext->server, entry, message, 0, 0);
+        gr_registry_read_unlock(&messageContext->server->clients, token);
     }
 
     // return the borrowed buffer to the stack
-    stack_push(&messageContext->server->bufferStack, message->data);
+    server_put_buffer(messageContext->server, message);
     return status;
 }
 
+// Fails the call the message belongs to, the client receives the error instead of a response
+int gracht_server_respond_error(struct gracht_message* messageContext, int errorCode)
+{
+    if (!messageContext) {
+        errno = EINVAL;
+        return -1;
+    }
+    return gracht_control_event_error_single(messageContext->server, messageContext->client,
+        gracht_server_message_id(messageContext), errorCode);
+}
+
 int gracht_server_send_event(gracht_server_t* server, gracht_conn_t client, gracht_buffer_t* message, unsigned int flags)
 {
     struct client_wrapper* clientEntry;
@@ -671,47 +1445,131 @@ int gracht_server_send_event(gracht_server_t* server, gracht_conn_t client, grac
         return -1;
     }
 
+    if (gracht_buffer_check(message)) {
+        server_put_buffer(server, message);
+        return -1;
+    }
+
     // update message header
     GB_MSG_LEN_0(message) = message->index;
 
-    rwlock_r_lock(&server->clients_lock);
-    clientEntry = gr_hashtable_get(&server->clients, &(struct client_wrapper){ .handle = client });
+    // the send may block, so pin the client instead of staying in a read section
+    clientEntry = client_get(server, client);
     if (!clientEntry) {
-        rwlock_r_unlock(&server->clients_lock);
         errno = ENOENT;
         return -1;
     }
    
     // When sending target specific events - we do not care about subscriptions
-    status = clientEntry->link->ops.server.send_client(clientEntry->client, message, flags);
-    rwlock_r_unlock(&server->clients_lock);
+    status = client_send(server, clientEntry, message, flags, 1);
+    client_put(server, clientEntry);
 
     // return the borrowed buffer to the stack
-    stack_push(&server->bufferStack, message->data);
+    server_put_buffer(server, message);
     return status;
 }
 
+// Splits the message into frames that are each stored in a payload of their own
+static struct gracht_payload** payloads_create_fragmented(struct gracht_server* server,
+    struct gracht_buffer* message, int* countOut)
+{
+    struct gracht_fragmenter fragmenter;
+    struct gracht_buffer     frame;
+    struct gracht_payload**  payloads;
+    uint32_t                 chunkLength = server->max_message_size - GRACHT_MESSAGE_HEADER_SIZE;
+    int                      count       = 0;
+
+    if (message->index > server->max_transfer_size) {
+        GRERROR(GRSTR("payloads_create_fragmented message of %u bytes is larger than the maximum transfer size"),
+            message->index);
+        errno = EMSGSIZE;
+        return NULL;
+    }
+
+    payloads   = malloc(sizeof(struct gracht_payload*) * ((message->index + chunkLength - 1) / chunkLength));
+    frame.data = malloc(server->max_message_size);
+    if (!payloads || !frame.data) {
+        free(payloads);
+        free(frame.data);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    gracht_fragmenter_init(&fragmenter, message->data, message->index, server->max_message_size);
+    while (gracht_fragmenter_next(&fragmenter, &frame)) {
+        payloads[count] = gracht_payload_create(frame.data, frame.index);
+        if (!payloads[count]) {
+            while (count) {
+                gracht_payload_release(payloads[--count]);
+            }
+            free(payloads);
+            payloads = NULL;
+            break;
+        }
+        count++;
+    }
+    free(frame.data);
+    *countOut = count;
+    return payloads;
+}
+
 int gracht_server_broadcast_event(gracht_server_t* server, gracht_buffer_t* message, unsigned int flags)
 {
-    struct broadcast_context context = {
-        .message = message,
-        .flags   = flags
-    };
+    struct broadcast_context context;
+    struct gracht_payload*   payload;
+    uint8_t                  protocol;
+    int                      i;
 
     if (!server || !message) {
         errno = EINVAL;
         return -1;
     }
 
+    if (gracht_buffer_check(message)) {
+        server_put_buffer(server, message);
+        return -1;
+    }
+
     // update message header
     GB_MSG_LEN_0(message) = message->index;
+    protocol = GB_MSG_SID_0(message);
 
-    rwlock_r_lock(&server->clients_lock);
-    gr_hashtable_enumerate(&server->clients, client_enum_broadcast, &context);
-    rwlock_r_unlock(&server->clients_lock);
+    // serialize the event once, each subscriber then holds a reference to the
+    // same payload(s) until it has been written to them
+    if (message->index > server->max_message_size) {
+        context.payloads = payloads_create_fragmented(server, message, &context.count);
+    }
+    else {
+        payload          = gracht_payload_create(message->data, message->index);
+        context.payloads = payload ? &payload : NULL;
+        context.count    = 1;
+    }
+
+    if (!context.payloads) {
+        server_put_buffer(server, message);
+        return -1;
+    }
+    context.server   = server;
+    context.protocol = protocol;
+    context.flags    = flags;
+
+    // only visit the clients that are actually subscribed to the protocol, clients in the
+    // subscribed to all table must still be checked in case they opted out of this one
+    rwlock_r_lock(&server->subscribers_lock);
+    if (server->subscribers[protocol]) {
+        gr_hashtable_enumerate(server->subscribers[protocol], subscriber_enum_broadcast, &context);
+    }
+    gr_hashtable_enumerate(&server->subscribers_all, subscriber_enum_broadcast, &context);
+    rwlock_r_unlock(&server->subscribers_lock);
+    for (i = 0; i < context.count; i++) {
+        gracht_payload_release(context.payloads[i]);
+    }
+    if (context.payloads != &payload) {
+        free(context.payloads);
+    }
 
     // return the borrowed buffer to the stack
-    stack_push(&server->bufferStack, message->data);
+    server_put_buffer(server, message);
     return 0;
 }
 
@@ -727,15 +1585,8 @@ int gracht_server_register_protocol(gracht_server_t* server, gracht_protocol_t*
         return -1;
     }
 
-    rwlock_w_lock(&server->protocols_lock);
-    if (gr_hashtable_get(&server->protocols, protocol)) {
-        rwlock_w_unlock(&server->protocols_lock);
-        errno = EEXIST;
-        return -1;
-    }
-    gr_hashtable_set(&server->protocols, protocol);
-    rwlock_w_unlock(&server->protocols_lock);
-    return 0;
+    // fails with EEXIST if the protocol is already registered
+    return gr_protocol_table_add(&server->protocols, protocol);
 }
 
 void gracht_server_unregister_protocol(gracht_server_t* server, gracht_protocol_t* protocol)
@@ -750,9 +1601,7 @@ void gracht_server_unregister_protocol(gracht_server_t* server, gracht_protocol_
         return;
     }
     
-    rwlock_w_lock(&server->protocols_lock);
-    gr_hashtable_remove(&server->protocols, protocol);
-    rwlock_w_unlock(&server->protocols_lock);
+    gr_protocol_table_remove(&server->protocols, protocol->id);
 }
 
 gracht_handle_t gracht_server_get_aio_handle(gracht_server_t* server)
@@ -777,23 +1626,521 @@ void gracht_server_defer_message(struct gracht_message* in, struct gracht_messag
     }
 
     memcpy(out, in, GRACHT_MESSAGE_DEFERRABLE_SIZE(in));
+
+    // the shared memory of the message is released once the handler returns
+    message_strip_bulk(out);
 }
 
 // Client helpers
+static struct client_wrapper* client_create(struct gracht_link* link, struct gracht_server_client* client,
+    gracht_conn_t handle, gracht_handle_t setHandle)
+{
+    struct client_wrapper* entry;
+
+    entry = malloc(sizeof(struct client_wrapper));
+    if (!entry) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    if (gracht_outbound_construct(&entry->outbound, GRACHT_SERVER_OUTBOUND_CAPACITY)) {
+        free(entry);
+        return NULL;
+    }
+
+    atomic_store(&entry->references, 1);
+    entry->handle         = handle;
+    entry->set_handle     = setHandle;
+    entry->link           = link;
+    entry->client         = client;
+    entry->aio_events     = GRACHT_AIO_EVENT_IN;
+    entry->reading        = 1;
+    entry->paused         = 0;
+    entry->flush_pending  = 0;
+    entry->subscribed_all = 0;
+    entry->subscribed_default = 0;
+    entry->detached       = 0;
+    entry->stalled        = 0;
+    entry->stalled_message = NULL;
+    entry->assembled      = NULL;
+    memset(&entry->assembly, 0, sizeof(struct gracht_assembly));
+    return entry;
+}
+
+// Looks up the client and takes a reference on it, which keeps the client alive outside of
+// a read section of the registry. The reference is released again with client_put.
+static struct client_wrapper* client_get(struct gracht_server* server, gracht_conn_t handle)
+{
+    struct client_wrapper* entry;
+    unsigned int           token;
+
+    token = gr_registry_read_lock(&server->clients);
+    entry = gr_registry_get(&server->clients, (uint64_t)handle);
+    if (entry) {
+        atomic_fetch_add(&entry->references, 1);
+    }
+    gr_registry_read_unlock(&server->clients, token);
+    return entry;
+}
+
+static void client_put(struct gracht_server* server, struct client_wrapper* entry)
+{
+    if (atomic_fetch_sub(&entry->references, 1) == 1) {
+        client_release(server, entry);
+    }
+}
+
+static void client_release(struct gracht_server* server, struct client_wrapper* entry)
+{
+    if (entry->stalled_message) {
+        message_release_bulk(entry->stalled_message);
+        gracht_slab_free(server->slab, entry->stalled_message);
+    }
+    client_discard_assembly(server, entry);
+    entry->link->ops.server.destroy_client(entry->client, entry->set_handle);
+    gracht_outbound_destroy(&entry->outbound);
+    free(entry);
+}
+
+static int flush_batch_add(struct flush_batch* batch, gracht_conn_t handle)
+{
+    if (batch->count == batch->capacity) {
+        int            capacity = batch->capacity ? (batch->capacity * 2) : 16;
+        gracht_conn_t* handles  = realloc(batch->handles, sizeof(gracht_conn_t) * (size_t)capacity);
+        if (!handles) {
+            return -1;
+        }
+        batch->handles  = handles;
+        batch->capacity = capacity;
+    }
+    batch->handles[batch->count++] = handle;
+    return 0;
+}
+
+static void flush_batch_complete(struct gracht_server* server, struct flush_batch* batch)
+{
+    int i;
+
+    for (i = 0; i < batch->count; i++) {
+        struct client_wrapper* entry;
+        unsigned int           token;
+
+        token = gr_registry_read_lock(&server->clients);
+        entry = gr_registry_get(&server->clients, (uint64_t)batch->handles[i]);
+        if (entry) {
+            mtx_lock(&entry->outbound.lock);
+            entry->flush_pending = 0;
+            client_flush(server, entry);
+            mtx_unlock(&entry->outbound.lock);
+        }
+        gr_registry_read_unlock(&server->clients, token);
+    }
+    free(batch->handles);
+}
+
+// Updates the events the client handle is listening for, must be called with the outbound lock
+// held. Reading from the client is paused while it has too much data queued, and we listen for the
+// client becoming writable while anything is queued.
+static void client_update_events(struct gracht_server* server, struct client_wrapper* entry)
+{
+    unsigned int events = 0;
+    int          reading;
+
+    // connection-less clients share the link handle, so we can not be told when one of them is
+    // writable again. Whatever the link did not accept is dropped like any other lost datagram,
+    // otherwise it would stay queued until something else is sent to the client
+    if (!(entry->client->flags & GRACHT_CLIENT_FLAG_STREAM)) {
+        if (!gracht_outbound_empty(&entry->outbound)) {
+            GRTRACE(GRSTR("client_update_events dropping %u bytes for connection-less client %" F_CONN_T),
+                (unsigned int)entry->outbound.queued_bytes, entry->handle);
+            gracht_outbound_clear(&entry->outbound);
+        }
+        return;
+    }
+
+    if (entry->paused && entry->outbound.queued_bytes <= server->outbound_low) {
+        entry->paused = 0;
+    }
+
+    reading = !entry->paused && !entry->stalled;
+    if (reading) {
+        events |= GRACHT_AIO_EVENT_IN;
+
+        // messages the link already read ahead do not make the client readable again, so
+        // ask for a write event to get back to them when reading is resumed
+        if (!entry->reading && entry->link->ops.server.pending_client &&
+            entry->link->ops.server.pending_client(entry->client)) {
+            events |= GRACHT_AIO_EVENT_OUT;
+        }
+    }
+    if (!gracht_outbound_empty(&entry->outbound)) {
+        events |= entry->link->ops.server.writable_client ? GRACHT_AIO_EVENT_IN : GRACHT_AIO_EVENT_OUT;
+    }
+
+    if (events != entry->aio_events) {
+        if (gracht_aio_modify(entry->set_handle, entry->handle, events)) {
+            // not supported by the aio backend, we will not be told when the client is ready
+            // so write the remaining data blocking instead
+            gracht_outbound_flush(&entry->outbound, entry->link, entry->client, GRACHT_MESSAGE_BLOCK);
+            entry->paused = 0;
+            return;
+        }
+        entry->aio_events = events;
+    }
+    entry->reading = reading;
+}
+
+// Writes what the client accepts without blocking, must be called with the outbound lock held.
+static void client_flush(struct gracht_server* server, struct client_wrapper* entry)
+{
+    if (gracht_outbound_flush(&entry->outbound, entry->link, entry->client, 0) < 0) {
+        GRTRACE(GRSTR("client_flush failed to write to client %" F_CONN_T ": %i"), entry->handle, errno);
+    }
+    client_update_events(server, entry);
+}
+
+// Queues the payloads (the frames of a fragmented event, or the event itself) for the client.
+// When invoked from a message handler the flush is deferred until the handler returns, otherwise
+// the queue is flushed immediately. Events are dropped for clients that are above the high watermark.
+static void client_queue(struct gracht_server* server, struct client_wrapper* entry,
+    struct gracht_payload** payloads, int count, unsigned int flags)
+{
+    int i;
+
+    mtx_lock(&entry->outbound.lock);
+    if (entry->outbound.queued_bytes >= server->outbound_high) {
+        GRTRACE(GRSTR("client_queue dropping event for slow client %" F_CONN_T), entry->handle);
+        mtx_unlock(&entry->outbound.lock);
+        return;
+    }
+
+    // the frames of an event are queued as a whole, the client could not assemble the event
+    // from only some of them
+    if (gracht_outbound_reserve(&entry->outbound, (unsigned int)count)) {
+        GRWARNING(GRSTR("client_queue failed to queue message for client %" F_CONN_T), entry->handle);
+        mtx_unlock(&entry->outbound.lock);
+        return;
+    }
+
+    for (i = 0; i < count; i++) {
+        gracht_outbound_push(&entry->outbound, payloads[i]);
+    }
+
+    if (entry->flush_pending) {
+        mtx_unlock(&entry->outbound.lock);
+        return;
+    }
+
+    if (g_flushBatch && !flush_batch_add(g_flushBatch, entry->handle)) {
+        entry->flush_pending = 1;
+    }
+    else if (flags & GRACHT_MESSAGE_BLOCK) {
+        gracht_outbound_flush(&entry->outbound, entry->link, entry->client, flags);
+        client_update_events(server, entry);
+    }
+    else {
+        client_flush(server, entry);
+    }
+    mtx_unlock(&entry->outbound.lock);
+}
+
+// Writes the message to the client, must be called with the outbound lock held. Messages are
+// only queued if the client already has data queued or the link could only write part of the
+// message. Non-droppable messages (responses) that take the client above the high watermark
+// make us stop reading requests from the client until it catches up.
+static int client_write(struct gracht_server* server, struct client_wrapper* entry,
+    struct gracht_buffer* message, unsigned int flags, int droppable)
+{
+    struct gracht_payload* payload;
+    size_t                 bytesWritten = 0;
+    int                    status;
+
+    if (gracht_outbound_empty(&entry->outbound)) {
+        if (!entry->link->ops.server.send_client_vec) {
+            return entry->link->ops.server.send_client(entry->client, message, flags);
+        }
+
+        status = entry->link->ops.server.send_client_vec(entry->client, message, 1, flags, &bytesWritten);
+        if (status || bytesWritten == message->index) {
+            return status;
+        }
+    }
+
+    payload = gracht_payload_create(message->data, message->index);
+    if (!payload) {
+        return -1;
+    }
+
+    status = gracht_outbound_push(&entry->outbound, payload);
+    gracht_payload_release(payload);
+    if (status) {
+        return -1;
+    }
+
+    // the message was partially written, account for the bytes already sent. This can
+    // only happen when the queue was empty, so the message is the head of the queue
+    if (bytesWritten) {
+        entry->outbound.offset        = (uint32_t)bytesWritten;
+        entry->outbound.queued_bytes -= bytesWritten;
+    }
+
+    status = gracht_outbound_flush(&entry->outbound, entry->link, entry->client, flags);
+    if (!droppable && entry->outbound.queued_bytes >= server->outbound_high) {
+        entry->paused = 1;
+    }
+    client_update_events(server, entry);
+    return status < 0 ? -1 : 0;
+}
+
+// Writes the message as a series of frames, the outbound lock is held meanwhile so the frames are
+// not mixed with those of other messages. Once the first frame is out the rest can not be dropped.
+static int client_write_fragmented(struct gracht_server* server, struct client_wrapper* entry,
+    struct gracht_buffer* message, unsigned int flags, int droppable)
+{
+    struct gracht_fragmenter fragmenter;
+    struct gracht_buffer     frame;
+    int                      status = 0;
+
+    if (message->index > server->max_transfer_size) {
+        GRERROR(GRSTR("client_write_fragmented message of %u bytes is larger than the maximum transfer size"),
+            message->index);
+        errno = EMSGSIZE;
+        return -1;
+    }
+
+    frame.data = malloc(server->max_message_size);
+    if (!frame.data) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    gracht_fragmenter_init(&fragmenter, message->data, message->index, server->max_message_size);
+    while (!status && gracht_fragmenter_next(&fragmenter, &frame)) {
+        status = client_write(server, entry, &frame, flags, droppable);
+        droppable = 0;
+    }
+    free(frame.data);
+    return status;
+}
+
+// Sends the message to the client. Droppable messages (events) are refused when the client is
+// above the high watermark, other messages (responses) are always queued.
+static int client_send(struct gracht_server* server, struct client_wrapper* entry,
+    struct gracht_buffer* message, unsigned int flags, int droppable)
+{
+    int status;
+
+    mtx_lock(&entry->outbound.lock);
+    if (droppable && entry->outbound.queued_bytes >= server->outbound_high) {
+        mtx_unlock(&entry->outbound.lock);
+        errno = ENOBUFS;
+        return -1;
+    }
+
+    if (message->index > server->max_message_size) {
+        status = client_write_fragmented(server, entry, message, flags, droppable);
+    }
+    else {
+        status = client_write(server, entry, message, flags, droppable);
+    }
+    mtx_unlock(&entry->outbound.lock);
+    return status;
+}
 static void client_destroy(struct gracht_server* server, gracht_conn_t client)
 {
     struct client_wrapper* entry;
+    unsigned int           token;
 
     if (server->callbacks.clientDisconnected) {
         server->callbacks.clientDisconnected(client);
     }
 
-    rwlock_w_lock(&server->clients_lock);
-    entry = gr_hashtable_remove(&server->clients, &(struct client_wrapper){ .handle = client });
+    // the subscriber index is not covered by the registry, so remove the client from
+    // it before the entry is removed and freed
+    token = gr_registry_read_lock(&server->clients);
+    entry = gr_registry_get(&server->clients, (uint64_t)client);
+    if (entry) {
+        server_detach(server, entry);
+    }
+    gr_registry_read_unlock(&server->clients, token);
+
+    // once removed no one can look up the entry anymore, so drop the reference of the
+    // registry. The entry is released when the last one pinning it is done with it
+    entry = gr_registry_remove(&server->clients, (uint64_t)client);
+    if (entry) {
+        client_put(server, entry);
+    }
+}
+
+// Stops reading from the client until the workers have room for the message again, or until
+// memory is available again when no message is provided. If the aio backend can not stop
+// listening on the client, the message is handled right away.
+static void client_stall(struct gracht_server* server, struct client_wrapper* entry, struct gracht_message* message)
+{
+    if (message) {
+        message = stalled_message_compact(server, message);
+    }
+
+    mtx_lock(&entry->outbound.lock);
+    entry->stalled         = 1;
+    entry->stalled_message = message;
+    client_update_events(server, entry);
+    if (entry->reading) {
+        entry->stalled         = 0;
+        entry->stalled_message = NULL;
+        mtx_unlock(&entry->outbound.lock);
+        if (message) {
+            server_invoke_action(server, message);
+            server_cleanup_message(server, message);
+        }
+        return;
+    }
+    mtx_unlock(&entry->outbound.lock);
+    server_stall(server, entry->handle);
+}
+
+static int stalled_add(struct stalled_list* list, gracht_conn_t handle)
+{
+    if (list->count == list->capacity) {
+        int            capacity = list->capacity ? (list->capacity * 2) : 16;
+        gracht_conn_t* handles  = realloc(list->handles, sizeof(gracht_conn_t) * (size_t)capacity);
+        if (!handles) {
+            return -1;
+        }
+        list->handles  = handles;
+        list->capacity = capacity;
+    }
+    list->handles[list->count++] = handle;
+    return 0;
+}
+
+static void server_stall(struct gracht_server* server, gracht_conn_t handle)
+{
+    GRTRACE(GRSTR("server_stall workers are busy, pausing %" F_CONN_T), handle);
+    mtx_lock(&server->stalled_lock);
+    if (stalled_add(&server->stalled, handle)) {
+        GRERROR(GRSTR("server_stall failed to track %" F_CONN_T), handle);
+    }
+    server->stalls++;
+    atomic_fetch_add(&server->stalled_count, 1);
+    mtx_unlock(&server->stalled_lock);
+
+    // the workers might have drained their queues before we were added to the list, and
+    // in that case no one would resume us
+    server_resume_stalled(server);
+}
+
+// Messages are received into buffers of the maximum message size, so the message of a stalled
+// client or link is moved to the smallest size class that fits it, as it might be held for a while.
+static struct gracht_message* stalled_message_compact(struct gracht_server* server, struct gracht_message* message)
+{
+    uint32_t               messageLength = *((uint32_t*)&message->payload[message->index + MSG_INDEX_LEN]);
+    int                    bulkCount     = MESSAGE_FLAG_BULK_COUNT(message->payload[message->index + MSG_INDEX_FLG]);
+    size_t                 length        = sizeof(struct gracht_message) + message->index + messageLength +
+        (sizeof(int) * (size_t)bulkCount);
+    struct gracht_message* compacted;
+
+    // assembled messages are allocated at their size already
+    if (length > server->allocationSize) {
+        return message;
+    }
+
+    compacted = gracht_slab_allocate(server->slab, length);
+    if (!compacted) {
+        return message;
+    }
+    memcpy(compacted, message, length);
+    gracht_slab_free(server->slab, message);
+    return compacted;
+}
+
+// Clients and links that were stalled because we ran out of receive buffers are only
+// resumed when a receive buffer is available again.
+static int stalled_memory_available(struct gracht_server* server)
+{
+    void* buffer = gracht_slab_allocate(server->slab, server->allocationSize);
+    if (!buffer) {
+        errno = ENOMEM;
+        return 0;
+    }
+    gracht_slab_free(server->slab, buffer);
+    return 1;
+}
+
+// Hands the stalled message (if any) of the client or link to the workers, and resumes reading
+// from it if they took it. Returns -1 with errno set to EBUSY if the workers are still busy, or
+// ENOMEM if no receive buffers are available yet.
+static int stalled_resume(struct gracht_server* server, gracht_conn_t handle)
+{
+    struct client_wrapper* entry;
+    unsigned int           token;
+    int                    status = 0;
+    int                    index;
+
+    index = get_link_index(server, handle);
+    if (index != -1) {
+        struct gracht_message* message = server->link_table.stalled_messages[index];
+        if (message ? dispatch_worker(server, message) : !stalled_memory_available(server)) {
+            return -1;
+        }
+        server->link_table.stalled_messages[index] = NULL;
+        atomic_store(&server->link_table.stalled[index], 0);
+        gracht_aio_modify(server->set_handle, handle, GRACHT_AIO_EVENT_IN);
+        return 0;
+    }
+
+    // the client may have disconnected in the meantime, then there is nothing to resume
+    token = gr_registry_read_lock(&server->clients);
+    entry = gr_registry_get(&server->clients, (uint64_t)handle);
     if (entry) {
-        entry->link->ops.server.destroy_client(entry->client, server->set_handle);
+        mtx_lock(&entry->outbound.lock);
+        if (entry->stalled_message) {
+            status = dispatch_worker(server, entry->stalled_message);
+        }
+        else if (entry->stalled && !stalled_memory_available(server)) {
+            status = -1;
+        }
+        if (entry->stalled && !status) {
+            entry->stalled         = 0;
+            entry->stalled_message = NULL;
+            client_update_events(server, entry);
+        }
+        mtx_unlock(&entry->outbound.lock);
+    }
+    gr_registry_read_unlock(&server->clients, token);
+    return status;
+}
+
+// Resumes stalled clients and links in the order they were stalled, until the workers are full
+// again. Those waiting for receive buffers are skipped so they do not hold up the others, as
+// the messages of the others might be what is keeping the receive buffers occupied.
+static void server_resume_stalled(struct gracht_server* server)
+{
+    int remaining = 0;
+    int resumed   = 0;
+    int i;
+
+    mtx_lock(&server->stalled_lock);
+    for (i = 0; i < server->stalled.count; i++) {
+        if (stalled_resume(server, server->stalled.handles[i])) {
+            server->stalled.handles[remaining++] = server->stalled.handles[i];
+            if (errno == EBUSY) {
+                i++;
+                break;
+            }
+            continue;
+        }
+        resumed++;
+    }
+
+    if (resumed) {
+        memmove(&server->stalled.handles[remaining], &server->stalled.handles[i],
+            sizeof(gracht_conn_t) * (size_t)(server->stalled.count - i));
+        server->stalled.count -= resumed;
+        server->resumes       += resumed;
+        atomic_fetch_sub(&server->stalled_count, resumed);
     }
-    rwlock_w_unlock(&server->clients_lock);
+    mtx_unlock(&server->stalled_lock);
 }
 
 // Client subscription helpers
@@ -802,7 +2149,7 @@ static void client_subscribe(struct gracht_server_client* client, uint8_t id)
     int block  = id / 32;
     int offset = id % 32;
 
-    if (id == 0xFF) {
+    if (id == GRACHT_PROTOCOL_ALL) {
         // subscribe to all
         memset(&client->subscriptions[0], 0xFF, sizeof(client->subscriptions));
         return;
@@ -816,7 +2163,7 @@ static void client_unsubscribe(struct gracht_server_client* client, uint8_t id)
     int block  = id / 32;
     int offset = id % 32;
 
-    if (id == 0xFF) {
+    if (id == GRACHT_PROTOCOL_ALL) {
         // unsubscribe to all
         memset(&client->subscriptions[0], 0, sizeof(client->subscriptions));
         return;
@@ -832,121 +2179,273 @@ static int client_is_subscribed(struct gracht_server_client* client, uint8_t id)
     return (client->subscriptions[block] & (1 << offset)) != 0;
 }
 
+// Subscriber index helpers, these must be called with the subscribers lock held
+static void subscribers_add(gr_hashtable_t* table, struct client_wrapper* entry)
+{
+    struct subscriber subscriber = { .handle = entry->handle, .entry = entry };
+    gr_hashtable_set(table, &subscriber);
+}
+
+static void subscribers_remove(gr_hashtable_t* table, struct client_wrapper* entry)
+{
+    struct subscriber subscriber = { .handle = entry->handle };
+    if (table) {
+        gr_hashtable_remove(table, &subscriber);
+    }
+}
+
+static gr_hashtable_t* subscribers_get_table(struct gracht_server* server, uint8_t protocol)
+{
+    if (!server->subscribers[protocol]) {
+        gr_hashtable_t* table = malloc(sizeof(gr_hashtable_t));
+        if (!table) {
+            return NULL;
+        }
+
+        if (gr_hashtable_construct(table, 0, sizeof(struct subscriber), subscriber_hash, subscriber_cmp)) {
+            free(table);
+            return NULL;
+        }
+        server->subscribers[protocol] = table;
+    }
+    return server->subscribers[protocol];
+}
+
+static void subscribers_remove_all(struct gracht_server* server, struct client_wrapper* entry)
+{
+    int i;
+
+    if (entry->subscribed_all) {
+        subscribers_remove(&server->subscribers_all, entry);
+        entry->subscribed_all = 0;
+        return;
+    }
+
+    // when not subscribed to all, the client is present in every table of the
+    // protocols it has subscribed to
+    for (i = 0; i < GRACHT_PROTOCOL_ALL; i++) {
+        if (client_is_subscribed(entry->client, (uint8_t)i)) {
+            subscribers_remove(server->subscribers[i], entry);
+        }
+    }
+}
+
+static void server_subscribe(struct gracht_server* server, struct client_wrapper* entry, uint8_t protocol)
+{
+    rwlock_w_lock(&server->subscribers_lock);
+    if (entry->detached) {
+        rwlock_w_unlock(&server->subscribers_lock);
+        return;
+    }
+
+    if (protocol == GRACHT_PROTOCOL_ALL) {
+        if (!entry->subscribed_all) {
+            subscribers_remove_all(server, entry);
+            subscribers_add(&server->subscribers_all, entry);
+            entry->subscribed_all = 1;
+        }
+        entry->subscribed_default = 0;
+    }
+    else {
+        // the first protocol a streaming client subscribes to replaces the subscription to all
+        // it had from start, so it is only indexed under the protocols it asked for and
+        // broadcasts of other protocols do not have to visit it
+        if (entry->subscribed_default) {
+            subscribers_remove_all(server, entry);
+            client_unsubscribe(entry->client, GRACHT_PROTOCOL_ALL);
+            entry->subscribed_default = 0;
+        }
+
+        if (!entry->subscribed_all && !client_is_subscribed(entry->client, protocol)) {
+            gr_hashtable_t* table = subscribers_get_table(server, protocol);
+            if (!table) {
+                GRERROR(GRSTR("server_subscribe failed to allocate subscriber table"));
+                rwlock_w_unlock(&server->subscribers_lock);
+                return;
+            }
+            subscribers_add(table, entry);
+        }
+    }
+    client_subscribe(entry->client, protocol);
+    rwlock_w_unlock(&server->subscribers_lock);
+}
+
+static void server_unsubscribe(struct gracht_server* server, struct client_wrapper* entry, uint8_t protocol)
+{
+    rwlock_w_lock(&server->subscribers_lock);
+    if (protocol == GRACHT_PROTOCOL_ALL) {
+        subscribers_remove_all(server, entry);
+        entry->subscribed_default = 0;
+    }
+    else if (!entry->subscribed_all && client_is_subscribed(entry->client, protocol)) {
+        subscribers_remove(server->subscribers[protocol], entry);
+    }
+    client_unsubscribe(entry->client, protocol);
+    rwlock_w_unlock(&server->subscribers_lock);
+}
+
+static void server_detach(struct gracht_server* server, struct client_wrapper* entry)
+{
+    rwlock_w_lock(&server->subscribers_lock);
+    subscribers_remove_all(server, entry);
+    client_unsubscribe(entry->client, GRACHT_PROTOCOL_ALL);
+    entry->detached = 1;
+    rwlock_w_unlock(&server->subscribers_lock);
+}
+
 // Server control protocol implementation
 void gracht_control_subscribe_invocation(const struct gracht_message* message, const uint8_t protocol)
 {
-    struct client_wrapper* entry;
-    struct client_wrapper  newEntry;
+    struct client_wrapper*       entry;
+    struct gracht_server_client* client;
+    struct gracht_link*          link;
+    unsigned int                 token;
     
     // When dealing with connectionless clients, they aren't really created in the client register. To deal
     // with this, we actually create a record for them, so we can support connection-less events. This means
     // that connection-less clients aren't considered connected unless they subscribe to some protocol - even
     // if they actually use the functions provided by the protocol. It is also possible to receive targetted
     // events that come in response to a function call even without subscribing.
-    rwlock_r_lock(&message->server->clients_lock);
-    entry = gr_hashtable_get(&message->server->clients, &(struct client_wrapper){ .handle = message->client });
+    token = gr_registry_read_lock(&message->server->clients);
+    entry = gr_registry_get(&message->server->clients, (uint64_t)message->client);
     if (!entry) {
         // So, client did not have a record, at this point we then know this message was received on a 
-        // connection-less stream, meaning we do not currently hold another _read_lock on this thread, thus we can
-        // release our reader lock and acqurie the write-lock
-        rwlock_r_unlock(&message->server->clients_lock);
+        // connection-less stream, meaning we are not currently inside another read section on this thread,
+        // thus we can leave our read section and modify the registry
+        gr_registry_read_unlock(&message->server->clients, token);
 
         // lookup the connection as the client wasn't recorded on a specific link
-        newEntry.link = get_link_by_conn(message->server, message->link);
-        if (newEntry.link->ops.server.create_client(newEntry.link, (struct gracht_message*)message, &newEntry.client)) {
+        link = get_link_by_conn(message->server, message->link);
+        if (link->ops.server.create_client(link, (struct gracht_message*)message, &client)) {
             GRERROR(GRSTR("gracht_control_subscribe_invocation server_object.link->create_client returned error"));
             return;
         }
 
-        newEntry.handle = message->client;
-
-        // this does not have to be serialized with the above read lock due to the fact that all
-        // write-locks are only acquired by this thread. So any changes made are only the ones we make
-        // right now
-        rwlock_w_lock(&message->server->clients_lock);
-        gr_hashtable_set(&message->server->clients, &newEntry);
-        rwlock_w_unlock(&message->server->clients_lock);
+        entry = client_create(link, client, message->client, message->server->set_handle);
+        if (!entry) {
+            GRERROR(GRSTR("gracht_control_subscribe_invocation failed to allocate memory for client"));
+            link->ops.server.destroy_client(client, message->server->set_handle);
+            return;
+        }
 
-        if (message->server->callbacks.clientConnected) {
+        // should another worker have beaten us to it, then just use their record instead
+        if (gr_registry_add(&message->server->clients, entry)) {
+            int error = errno;
+            client_release(message->server, entry);
+            if (error != EEXIST) {
+                return;
+            }
+        }
+        else if (message->server->callbacks.clientConnected) {
             message->server->callbacks.clientConnected(message->client);
         }
 
-        // not really neccessary but for correctness
-        rwlock_r_lock(&message->server->clients_lock);
-        
-        // set the entry pointer
-        entry = &newEntry;
-    } else {
-        // make sure if they were marked cleanup that we remove that
-        entry->client->flags &= ~(GRACHT_CLIENT_FLAG_CLEANUP);
+        token = gr_registry_read_lock(&message->server->clients);
+        entry = gr_registry_get(&message->server->clients, (uint64_t)message->client);
+        if (!entry) {
+            gr_registry_read_unlock(&message->server->clients, token);
+            return;
+        }
     }
-
-    client_subscribe(entry->client, protocol);
-    rwlock_r_unlock(&message->server->clients_lock);
+    
+    // make sure if they were marked cleanup that we remove that
+    entry->client->flags &= ~(GRACHT_CLIENT_FLAG_CLEANUP);
+    server_subscribe(message->server, entry, protocol);
+    gr_registry_read_unlock(&message->server->clients, token);
 }
 
 void gracht_control_unsubscribe_invocation(const struct gracht_message* message, const uint8_t protocol)
 {
     struct client_wrapper* entry;
+    unsigned int           token;
     int                    cleanup = 0;
     
-    rwlock_r_lock(&message->server->clients_lock);
-    entry = gr_hashtable_get(&message->server->clients, &(struct client_wrapper){ .handle = message->client });
+    token = gr_registry_read_lock(&message->server->clients);
+    entry = gr_registry_get(&message->server->clients, (uint64_t)message->client);
     if (!entry) {
-        rwlock_r_unlock(&message->server->clients_lock);
+        gr_registry_read_unlock(&message->server->clients, token);
         return;
     }
 
-    client_unsubscribe(entry->client, protocol);
+    server_unsubscribe(message->server, entry, protocol);
     
     // cleanup the client if we unsubscribe, but do not do it from here as the client
     // structure will be reffered later on
-    if (protocol == 0xFF) {
+    if (protocol == GRACHT_PROTOCOL_ALL) {
         if (!(entry->client->flags & GRACHT_CLIENT_FLAG_STREAM)) {
             entry->client->flags |= GRACHT_CLIENT_FLAG_CLEANUP; // this flag is not needed
             cleanup = 1;
         }
     }
-    rwlock_r_unlock(&message->server->clients_lock);
+    gr_registry_read_unlock(&message->server->clients, token);
 
     // when receiving unsubscribe events on connection-less links we must check
     // after handling messages whether a client has been marked for cleanup
-    // in this case we do not hold the lock and can therefore actually take the write-lock
+    // in this case we are not inside a read section and can therefore actually remove it
     if (cleanup) {
         client_destroy(message->server, message->client);
     }
 }
 
-static uint64_t client_hash(const void* element)
+static uint64_t client_key(const void* element)
 {
     const struct client_wrapper* client = element;
     return (uint64_t)client->handle;
 }
 
-static int client_cmp(const void* element1, const void* element2)
+static uint64_t subscriber_hash(const void* element)
+{
+    const struct subscriber* subscriber = element;
+    return (uint64_t)subscriber->handle;
+}
+
+static int subscriber_cmp(const void* element1, const void* element2)
+{
+    const struct subscriber* subscriber1 = element1;
+    const struct subscriber* subscriber2 = element2;
+    return subscriber1->handle == subscriber2->handle ? 0 : -1;
+}
+
+static uint64_t call_hash(const void* element)
 {
-    const struct client_wrapper* client1 = element1;
-    const struct client_wrapper* client2 = element2;
-    return client1->handle == client2->handle ? 0 : 1;
+    const struct call_entry* call = element;
+    return ((uint64_t)call->client << 32) ^ call->message_id;
 }
 
-static void client_enum_broadcast(int index, const void* element, void* userContext)
+static int call_cmp(const void* element1, const void* element2)
 {
-    const struct client_wrapper* entry   = element;
-    struct broadcast_context*    context = userContext;
-    uint8_t                      protocol = GB_MSG_SID_0(context->message);
+    const struct call_entry* call1 = element1;
+    const struct call_entry* call2 = element2;
+    return call1->client == call2->client && call1->message_id == call2->message_id ? 0 : -1;
+}
+
+static void call_enum_destroy(int index, const void* element, void* userContext)
+{
+    struct call_entry*     call   = (struct call_entry*)element;
+    struct gracht_server*  server = userContext;
+    struct gracht_message* message;
     (void)index;
 
-    if (client_is_subscribed(entry->client, protocol)) {
-        entry->link->ops.server.send_client(entry->client, context->message, context->flags);
+    message = gr_queue_dequeue(&call->pending);
+    while (message) {
+        gracht_slab_free(server->slab, message);
+        message = gr_queue_dequeue(&call->pending);
     }
+    gr_queue_destroy(&call->pending);
 }
 
-static void client_enum_destroy(int index, const void* element, void* userContext)
+static void subscriber_enum_broadcast(int index, const void* element, void* userContext)
 {
-    const struct client_wrapper* entry  = element;
-    struct gracht_server*        server = userContext;
+    const struct subscriber*  subscriber = element;
+    struct broadcast_context* context    = userContext;
     (void)index;
-    (void)userContext;
-    entry->link->ops.server.destroy_client(entry->client, server->set_handle);
+
+    if (client_is_subscribed(subscriber->entry->client, context->protocol)) {
+        client_queue(context->server, subscriber->entry, context->payloads, context->count, context->flags);
+    }
+}
+
+static void client_enum_destroy(void* element, void* userContext)
+{
+    client_release(userContext, element);
 }
@@ -25,7 +25,12 @@ void gracht_server_configuration_init(gracht_server_configuration_t* config)
 {
     memset(config, 0, sizeof(gracht_server_configuration_t));
     config->server_workers = 1;
+    config->server_reactors = 1;
     config->max_message_size = GRACHT_DEFAULT_MESSAGE_SIZE;
+    config->max_transfer_size = GRACHT_DEFAULT_TRANSFER_SIZE;
+    config->outbound_low_watermark = GRACHT_DEFAULT_OUTBOUND_LOW_WATERMARK;
+    config->outbound_high_watermark = GRACHT_DEFAULT_OUTBOUND_HIGH_WATERMARK;
+    config->queue_capacity = GRACHT_DEFAULT_QUEUE_CAPACITY;
 }
 
 void gracht_server_configuration_set_aio_descriptor(gracht_server_configuration_t* config, gracht_handle_t descriptor)
@@ -39,7 +44,28 @@ void gracht_server_configuration_set_num_workers(gracht_server_configuration_t*
     config->server_workers = workerCount;
 }
 
+void gracht_server_configuration_set_num_reactors(gracht_server_configuration_t* config, int reactorCount)
+{
+    config->server_reactors = reactorCount;
+}
+
 void gracht_server_configuration_set_max_msg_size(gracht_server_configuration_t* config, int maxMessageSize)
 {
     config->max_message_size = maxMessageSize;
 }
+
+void gracht_server_configuration_set_max_transfer_size(gracht_server_configuration_t* config, int maxTransferSize)
+{
+    config->max_transfer_size = maxTransferSize;
+}
+
+void gracht_server_configuration_set_outbound_watermarks(gracht_server_configuration_t* config, size_t lowWatermark, size_t highWatermark)
+{
+    config->outbound_low_watermark = lowWatermark;
+    config->outbound_high_watermark = highWatermark;
+}
+
+void gracht_server_configuration_set_queue_capacity(gracht_server_configuration_t* config, int queueCapacity)
+{
+    config->queue_capacity = queueCapacity;
+}
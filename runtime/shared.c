@@ -21,34 +21,23 @@
  */
 
 #include "gracht/types.h"
-#include "hashtable.h"
+#include "protocol_table.h"
 #include "logging.h"
 #include "utils.h"
 #include <errno.h>
 #include <stdlib.h>
 
-gracht_protocol_function_t* get_protocol_action(gr_hashtable_t* protocols,
+gracht_protocol_function_t* get_protocol_action(gr_protocol_table_t* protocols,
     uint8_t protocol_id, uint8_t action_id)
 {
-    int                i;
-    gracht_protocol_t* protocol;
-    
-    protocol = gr_hashtable_get(protocols, &(gracht_protocol_t) { .id = protocol_id });
-    if (!protocol) {
-        GRERROR(GRSTR("get_protocol_action(p=%u, a=%u) protocol was not implemented"), protocol_id, action_id);
+    gracht_protocol_function_t* function;
+
+    function = gr_protocol_table_get(protocols, protocol_id, action_id);
+    if (!function) {
+        GRERROR(GRSTR("get_protocol_action(p=%u, a=%u) protocol or action was not implemented"), protocol_id, action_id);
         errno = ENOTSUP;
-        return NULL;
-    }
-    
-    for (i = 0; i < protocol->num_functions; i++) {
-        if (protocol->functions[i].id == action_id) {
-            return &protocol->functions[i];
-        }
     }
-
-    GRERROR(GRSTR("get_protocol_action(p=%u, a=%u) action was not implemented"), protocol_id, action_id);
-    errno = ENOTSUP;
-    return NULL;
+    return function;
 }
 
 gracht_conn_t gracht_link_get_handle(struct gracht_link* link)
@@ -0,0 +1,396 @@
+/**
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Gracht Slab Allocator Implementation
+ * - Objects are carved from chunks and never returned to the system before the slab
+ *   is destroyed. Free objects move between the thread caches and the depot of their
+ *   size class in batches of half a cache, which keeps the depot locks cold.
+ */
+
+#include <errno.h>
+#include "gatomic.h"
+#include "slab.h"
+#include "thread_api.h"
+#include <stdint.h>
+#include <stdlib.h>
+
+// Each thread can cache objects for this many slabs at once, a thread that uses
+// more slabs than this evicts the least recently added cache
+#define SLAB_THREAD_CACHES 4
+
+#define SLAB_CHUNK_SIZE  (64 * 1024)
+#define SLAB_CLASS_LARGE 0xFFFFFFFF
+
+// The header in front of every object, the size is the requested size which is what
+// counts towards the limit. It is 16 bytes to keep the objects aligned.
+struct slab_header {
+    uint32_t size_class;
+    uint32_t reserved;
+    uint64_t size;
+};
+
+struct slab_chunk {
+    struct slab_chunk* link;
+    uint64_t           reserved;
+};
+
+// Free objects are linked through their first word
+struct slab_class {
+    mtx_t  lock;
+    void*  free_list;
+    size_t object_size;
+};
+
+struct gracht_slab {
+    unsigned int        id;
+    struct gracht_slab* link;
+    int                 class_count;
+    size_t              limit;
+    atomic_size_t       allocated;
+    mtx_t               chunks_lock;
+    struct slab_chunk*  chunks;
+    struct slab_class   classes[GRACHT_SLAB_MAX_CLASSES];
+};
+
+struct slab_magazine {
+    int   count;
+    void* objects[GRACHT_SLAB_CACHE_SIZE];
+};
+
+struct slab_thread_cache {
+    unsigned int         id;
+    struct slab_magazine magazines[GRACHT_SLAB_MAX_CLASSES];
+};
+
+static __TLS_VAR struct slab_thread_cache g_threadCaches[SLAB_THREAD_CACHES];
+static __TLS_VAR unsigned int             g_threadCacheVictim = 0;
+
+// Live slabs are tracked so thread caches can tell whether the slab they belong to
+// still exists when they are evicted. Ids are never reused, 0 marks an unused cache.
+static atomic_uint         g_slabId    = 1;
+static atomic_int          g_slabsLock = 0;
+static struct gracht_slab* g_slabs     = NULL;
+
+static void slabs_lock(void)
+{
+    int expected = 0;
+    while (!atomic_compare_exchange_strong(&g_slabsLock, &expected, 1)) {
+        expected = 0;
+        thrd_yield();
+    }
+}
+
+static void slabs_unlock(void)
+{
+    atomic_store(&g_slabsLock, 0);
+}
+
+static inline struct slab_header* get_header(void* memory)
+{
+    return (struct slab_header*)memory - 1;
+}
+
+static inline size_t class_size(int index)
+{
+    return (size_t)GRACHT_SLAB_MIN_SIZE << index;
+}
+
+static int size_to_class(size_t size)
+{
+    int index = 0;
+
+    while (index < GRACHT_SLAB_MAX_CLASSES && class_size(index) < size) {
+        index++;
+    }
+    return index;
+}
+
+int gracht_slab_create(size_t maxObjectSize, size_t limit, struct gracht_slab** slabOut)
+{
+    struct gracht_slab* slab;
+    int                 i;
+
+    if (!slabOut) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    slab = malloc(sizeof(struct gracht_slab));
+    if (!slab) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    slab->id          = atomic_fetch_add(&g_slabId, 1);
+    slab->class_count = size_to_class(maxObjectSize) + 1;
+    slab->limit       = limit;
+    slab->chunks      = NULL;
+    if (slab->class_count > GRACHT_SLAB_MAX_CLASSES) {
+        slab->class_count = GRACHT_SLAB_MAX_CLASSES;
+    }
+    atomic_store(&slab->allocated, 0);
+    mtx_init(&slab->chunks_lock, mtx_plain);
+
+    for (i = 0; i < slab->class_count; i++) {
+        mtx_init(&slab->classes[i].lock, mtx_plain);
+        slab->classes[i].free_list   = NULL;
+        slab->classes[i].object_size = class_size(i);
+    }
+
+    slabs_lock();
+    slab->link = g_slabs;
+    g_slabs    = slab;
+    slabs_unlock();
+
+    *slabOut = slab;
+    return 0;
+}
+
+void gracht_slab_destroy(struct gracht_slab* slab)
+{
+    struct gracht_slab** itr;
+    struct slab_chunk*   chunk;
+    int                  i;
+
+    if (!slab) {
+        return;
+    }
+
+    slabs_lock();
+    for (itr = &g_slabs; *itr; itr = &(*itr)->link) {
+        if (*itr == slab) {
+            *itr = slab->link;
+            break;
+        }
+    }
+    slabs_unlock();
+
+    // caches of other threads are dropped the next time they are evicted
+    for (i = 0; i < SLAB_THREAD_CACHES; i++) {
+        if (g_threadCaches[i].id == slab->id) {
+            g_threadCaches[i].id = 0;
+        }
+    }
+
+    chunk = slab->chunks;
+    while (chunk) {
+        struct slab_chunk* next = chunk->link;
+        free(chunk);
+        chunk = next;
+    }
+
+    for (i = 0; i < slab->class_count; i++) {
+        mtx_destroy(&slab->classes[i].lock);
+    }
+    mtx_destroy(&slab->chunks_lock);
+    free(slab);
+}
+
+// Carves a new chunk into objects for the size class, must be called with the class lock held
+static int depot_grow(struct gracht_slab* slab, int index)
+{
+    struct slab_class* sizeClass = &slab->classes[index];
+    struct slab_chunk* chunk;
+    size_t             stride = sizeof(struct slab_header) + sizeClass->object_size;
+    size_t             count  = SLAB_CHUNK_SIZE / stride;
+    char*              itr;
+    size_t             i;
+
+    if (count < GRACHT_SLAB_CACHE_SIZE) {
+        count = GRACHT_SLAB_CACHE_SIZE;
+    }
+
+    chunk = malloc(sizeof(struct slab_chunk) + (stride * count));
+    if (!chunk) {
+        return -1;
+    }
+
+    mtx_lock(&slab->chunks_lock);
+    chunk->link  = slab->chunks;
+    slab->chunks = chunk;
+    mtx_unlock(&slab->chunks_lock);
+
+    itr = (char*)(chunk + 1);
+    for (i = 0; i < count; i++, itr += stride) {
+        struct slab_header* header = (struct slab_header*)itr;
+        void*               object = header + 1;
+
+        header->size_class   = (uint32_t)index;
+        *(void**)object      = sizeClass->free_list;
+        sizeClass->free_list = object;
+    }
+    return 0;
+}
+
+// Refills the magazine with half a cache worth of objects from the depot
+static void depot_take(struct gracht_slab* slab, int index, struct slab_magazine* magazine)
+{
+    struct slab_class* sizeClass = &slab->classes[index];
+
+    mtx_lock(&sizeClass->lock);
+    if (!sizeClass->free_list && depot_grow(slab, index)) {
+        mtx_unlock(&sizeClass->lock);
+        return;
+    }
+
+    while (sizeClass->free_list && magazine->count < (GRACHT_SLAB_CACHE_SIZE / 2)) {
+        void* object = sizeClass->free_list;
+        sizeClass->free_list = *(void**)object;
+        magazine->objects[magazine->count++] = object;
+    }
+    mtx_unlock(&sizeClass->lock);
+}
+
+static void depot_put(struct gracht_slab* slab, int index, void** objects, int count)
+{
+    struct slab_class* sizeClass = &slab->classes[index];
+    int                i;
+
+    mtx_lock(&sizeClass->lock);
+    for (i = 0; i < count; i++) {
+        *(void**)objects[i]  = sizeClass->free_list;
+        sizeClass->free_list = objects[i];
+    }
+    mtx_unlock(&sizeClass->lock);
+}
+
+static void cache_evict(struct slab_thread_cache* cache)
+{
+    struct gracht_slab* slab;
+    int                 i;
+
+    // hold the list lock while flushing, so the slab can not be destroyed meanwhile
+    slabs_lock();
+    for (slab = g_slabs; slab; slab = slab->link) {
+        if (slab->id == cache->id) {
+            break;
+        }
+    }
+
+    for (i = 0; slab && i < slab->class_count; i++) {
+        depot_put(slab, i, &cache->magazines[i].objects[0], cache->magazines[i].count);
+    }
+    slabs_unlock();
+    cache->id = 0;
+}
+
+static struct slab_thread_cache* get_cache(struct gracht_slab* slab)
+{
+    struct slab_thread_cache* cache = NULL;
+    int                       i;
+
+    for (i = 0; i < SLAB_THREAD_CACHES; i++) {
+        if (g_threadCaches[i].id == slab->id) {
+            return &g_threadCaches[i];
+        }
+        if (!cache && !g_threadCaches[i].id) {
+            cache = &g_threadCaches[i];
+        }
+    }
+
+    if (!cache) {
+        cache = &g_threadCaches[g_threadCacheVictim++ % SLAB_THREAD_CACHES];
+        cache_evict(cache);
+    }
+
+    cache->id = slab->id;
+    for (i = 0; i < GRACHT_SLAB_MAX_CLASSES; i++) {
+        cache->magazines[i].count = 0;
+    }
+    return cache;
+}
+
+void* gracht_slab_allocate(struct gracht_slab* slab, size_t size)
+{
+    struct slab_magazine* magazine;
+    struct slab_header*   header;
+    void*                 object;
+    int                   index;
+
+    if (!slab || !size) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    index = size_to_class(size);
+    if (slab->limit) {
+        size_t allocated = atomic_fetch_add(&slab->allocated, size);
+        if ((allocated + size) > slab->limit) {
+            atomic_fetch_sub(&slab->allocated, size);
+            errno = ENOMEM;
+            return NULL;
+        }
+    }
+
+    if (index >= slab->class_count) {
+        header = malloc(sizeof(struct slab_header) + size);
+        if (!header) {
+            goto error;
+        }
+        header->size_class = SLAB_CLASS_LARGE;
+        header->size       = size;
+        return header + 1;
+    }
+
+    magazine = &get_cache(slab)->magazines[index];
+    if (!magazine->count) {
+        depot_take(slab, index, magazine);
+        if (!magazine->count) {
+            goto error;
+        }
+    }
+    object = magazine->objects[--magazine->count];
+    get_header(object)->size = size;
+    return object;
+
+error:
+    if (slab->limit) {
+        atomic_fetch_sub(&slab->allocated, size);
+    }
+    errno = ENOMEM;
+    return NULL;
+}
+
+void gracht_slab_free(struct gracht_slab* slab, void* memory)
+{
+    struct slab_magazine* magazine;
+    struct slab_header*   header;
+
+    if (!slab || !memory) {
+        return;
+    }
+
+    header = get_header(memory);
+    if (slab->limit) {
+        atomic_fetch_sub(&slab->allocated, (size_t)header->size);
+    }
+
+    if (header->size_class == SLAB_CLASS_LARGE) {
+        free(header);
+        return;
+    }
+
+    // return half of the cache to the depot when it is full, so objects flow back to the
+    // threads that allocate them
+    magazine = &get_cache(slab)->magazines[header->size_class];
+    if (magazine->count == GRACHT_SLAB_CACHE_SIZE) {
+        depot_put(slab, (int)header->size_class, &magazine->objects[GRACHT_SLAB_CACHE_SIZE / 2],
+            GRACHT_SLAB_CACHE_SIZE / 2);
+        magazine->count = GRACHT_SLAB_CACHE_SIZE / 2;
+    }
+    magazine->objects[magazine->count++] = memory;
+}
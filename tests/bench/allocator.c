@@ -0,0 +1,225 @@
+/**
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Gracht Benchmark Suite
+ * - Message buffer allocation, compares the first-fit arena against the slab allocator
+ *   used by the server and client. The local pattern allocates and frees a batch of
+ *   messages on the same thread, the handoff pattern allocates on producer threads and
+ *   frees on consumer threads the same way the reactor and the workers do.
+ */
+
+#include "arena.h"
+#include "gatomic.h"
+#include "gracht/types.h"
+#include "queue.h"
+#include "slab.h"
+#include "thread_api.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// the default message size and the context data the server adds to it
+#define MESSAGE_SIZE          (GRACHT_DEFAULT_MESSAGE_SIZE + 512)
+#define MESSAGES_IN_FLIGHT    64
+#define BATCH_SIZE            8
+#define OPERATIONS_PER_THREAD 500000
+
+struct allocator {
+    const char* name;
+    void*       context;
+    void*       (*allocate)(void* context);
+    void        (*free)(void* context, void* memory);
+};
+
+static struct gr_mpmc_queue g_handoff;
+static atomic_int           g_start;
+static atomic_int           g_producersDone;
+static int                  g_producerCount;
+
+static void* arena_allocate(void* context)
+{
+    return gracht_arena_allocate(context, NULL, MESSAGE_SIZE);
+}
+
+static void arena_free(void* context, void* memory)
+{
+    gracht_arena_free(context, memory, 0);
+}
+
+static void* slab_allocate(void* context)
+{
+    return gracht_slab_allocate(context, MESSAGE_SIZE);
+}
+
+static void slab_free(void* context, void* memory)
+{
+    gracht_slab_free(context, memory);
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ((uint64_t)ts.tv_sec * 1000000000ull) + (uint64_t)ts.tv_nsec;
+}
+
+static int local_worker(void* context)
+{
+    struct allocator* allocator = context;
+    void*             batch[BATCH_SIZE];
+    int               i, j;
+
+    while (!atomic_load(&g_start)) {
+        thrd_yield();
+    }
+
+    for (i = 0; i < OPERATIONS_PER_THREAD; i += BATCH_SIZE) {
+        for (j = 0; j < BATCH_SIZE; j++) {
+            batch[j] = allocator->allocate(allocator->context);
+            if (!batch[j]) {
+                return -1;
+            }
+            *(volatile char*)batch[j] = (char)j;
+        }
+        for (j = 0; j < BATCH_SIZE; j++) {
+            allocator->free(allocator->context, batch[j]);
+        }
+    }
+    return 0;
+}
+
+static int producer_worker(void* context)
+{
+    struct allocator* allocator = context;
+    int               i;
+
+    while (!atomic_load(&g_start)) {
+        thrd_yield();
+    }
+
+    for (i = 0; i < OPERATIONS_PER_THREAD; i++) {
+        void* memory = allocator->allocate(allocator->context);
+        while (!memory) {
+            thrd_yield();
+            memory = allocator->allocate(allocator->context);
+        }
+
+        *(volatile char*)memory = (char)i;
+        while (gr_mpmc_queue_enqueue(&g_handoff, memory)) {
+            thrd_yield();
+        }
+    }
+    atomic_fetch_add(&g_producersDone, 1);
+    return 0;
+}
+
+static int consumer_worker(void* context)
+{
+    struct allocator* allocator = context;
+
+    while (!atomic_load(&g_start)) {
+        thrd_yield();
+    }
+
+    for (;;) {
+        void* memory = gr_mpmc_queue_dequeue(&g_handoff);
+        if (memory) {
+            allocator->free(allocator->context, memory);
+            continue;
+        }
+
+        if (atomic_load(&g_producersDone) == g_producerCount && !gr_mpmc_queue_count(&g_handoff)) {
+            break;
+        }
+        thrd_yield();
+    }
+    return 0;
+}
+
+static int run(const char* pattern, struct allocator* allocator, int threadCount, int handoff)
+{
+    thrd_t   threads[16];
+    uint64_t start, end;
+    int      operations;
+    int      failed = 0;
+    int      i;
+
+    g_producerCount = threadCount / 2;
+    atomic_store(&g_start, 0);
+    atomic_store(&g_producersDone, 0);
+    for (i = 0; i < threadCount; i++) {
+        thrd_start_t worker = local_worker;
+        if (handoff) {
+            worker = (i % 2) ? consumer_worker : producer_worker;
+        }
+
+        if (thrd_create(&threads[i], worker, allocator) != thrd_success) {
+            fprintf(stderr, "failed to create worker thread\n");
+            return -1;
+        }
+    }
+
+    start = now_ns();
+    atomic_store(&g_start, 1);
+    for (i = 0; i < threadCount; i++) {
+        int result;
+        thrd_join(threads[i], &result);
+        failed |= result;
+    }
+    end = now_ns();
+
+    operations = handoff ? (threadCount / 2) * OPERATIONS_PER_THREAD : threadCount * OPERATIONS_PER_THREAD;
+    printf("%-8s %-6s threads=%2i  %8.2f ns/op  %8.2f Mops/s\n", pattern, allocator->name, threadCount,
+        (double)(end - start) / operations, ((double)operations * 1000.0) / (double)(end - start));
+    return failed;
+}
+
+int main(void)
+{
+    struct allocator allocators[2] = {
+        { "arena", NULL, arena_allocate, arena_free },
+        { "slab",  NULL, slab_allocate,  slab_free }
+    };
+    int threadCounts[] = { 1, 2, 4 };
+    int status = 0;
+    int i, j;
+
+    // size both like the server does for its queued messages
+    if (gracht_arena_create(MESSAGES_IN_FLIGHT * 4 * MESSAGE_SIZE, (struct gracht_arena**)&allocators[0].context) ||
+        gracht_slab_create(MESSAGE_SIZE, MESSAGES_IN_FLIGHT * 4 * MESSAGE_SIZE, (struct gracht_slab**)&allocators[1].context) ||
+        gr_mpmc_queue_construct(&g_handoff, MESSAGES_IN_FLIGHT)) {
+        fprintf(stderr, "failed to create the allocators\n");
+        return -1;
+    }
+
+    for (i = 0; i < (int)(sizeof(threadCounts) / sizeof(int)); i++) {
+        for (j = 0; j < 2; j++) {
+            status |= run("local", &allocators[j], threadCounts[i], 0);
+        }
+    }
+
+    for (i = 1; i < (int)(sizeof(threadCounts) / sizeof(int)); i++) {
+        for (j = 0; j < 2; j++) {
+            status |= run("handoff", &allocators[j], threadCounts[i], 1);
+        }
+    }
+
+    gr_mpmc_queue_destroy(&g_handoff);
+    gracht_slab_destroy(allocators[1].context);
+    gracht_arena_destroy(allocators[0].context);
+    return status;
+}
@@ -26,7 +26,6 @@
 #include <errno.h>
 #include "thread_api.h"
 #include "logging.h"
-#include "server_private.h"
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
@@ -117,6 +116,16 @@ static inline void move_header(struct gracht_header* header, long byteCount)
     memmove(target, header, HEADER_SIZE);
 }
 
+// Returns the header following the given one, or NULL if the header is the last in the arena
+static inline struct gracht_header* get_next_header(struct gracht_arena* arena, struct gracht_header* header)
+{
+    struct gracht_header* next = GET_NEXT_HEADER(header);
+    if ((char*)next >= ((char*)arena->base + arena->length)) {
+        return NULL;
+    }
+    return next;
+}
+
 static inline struct gracht_header* find_free_header(struct gracht_arena* arena, uint32_t size)
 {
     struct gracht_header* itr    = arena->base;
@@ -125,15 +134,25 @@ static inline struct gracht_header* find_free_header(struct gracht_arena* arena,
     GRTRACE(GRSTR("find_free_header(arena=0x%p, size=%u)"), arena, size);
     while (length < arena->length) {
         GRTRACE(GRSTR("header: at=0x%p length=%u, allocated=%i"), itr, itr->length, itr->allocated);
-        if (!itr->allocated && itr->length >= size) {
-            return itr;
+        if (!itr->allocated) {
+            // blocks are only merged forward when freed, so merge any free blocks
+            // that follow while we are here
+            struct gracht_header* next = get_next_header(arena, itr);
+            while (next && !next->allocated) {
+                itr->length += HEADER_SIZE + next->length;
+                next = get_next_header(arena, itr);
+            }
+
+            if (itr->length >= size) {
+                return itr;
+            }
         }
 
         if (!itr->length) {
             break;
         }
 
-        length += itr->length;
+        length += HEADER_SIZE + itr->length;
         itr = GET_NEXT_HEADER(itr);
     }
     return NULL;
@@ -152,17 +171,19 @@ void* gracht_arena_allocate(struct gracht_arena* arena, void* allocation, size_t
     mtx_lock(&arena->mutex);
     if (allocation) {
         struct gracht_header* header     = GET_HEADER(allocation);
-        struct gracht_header* nextHeader = GET_NEXT_HEADER(header);
+        struct gracht_header* nextHeader = get_next_header(arena, header);
 
-        if (!nextHeader || nextHeader->allocated) {
+        if (!nextHeader || nextHeader->allocated || nextHeader->length < correctedSize) {
             // we must reallocate the memory space to somewhere else
             correctedSize += header->length;
 
             allocHeader = find_free_header(arena, correctedSize);
-            memcpy(&allocHeader->payload[0], &header->payload[0], header->length);
+            if (allocHeader) {
+                memcpy(&allocHeader->payload[0], &header->payload[0], header->length);
 
-            // what consequences could this call have
-            gracht_arena_free(arena, allocation, header->length);
+                // what consequences could this call have
+                gracht_arena_free(arena, allocation, header->length);
+            }
         }
         else {
             // we are able to safely extend the current allocation
@@ -214,7 +235,7 @@ void gracht_arena_free(struct gracht_arena* arena, void* memory, size_t size)
 
     mtx_lock(&arena->mutex);
     header     = GET_HEADER(memory);
-    nextHeader = GET_NEXT_HEADER(header);
+    nextHeader = get_next_header(arena, header);
 
     // currently we only merge in forward direction, to merge in backwards
     // direction without iterating we need to add an allocation footer
@@ -231,7 +252,7 @@ void gracht_arena_free(struct gracht_arena* arena, void* memory, size_t size)
 
         // either we must adjust the header link or create a new
         // based on whether its free or not
-        if (!nextHeader->allocated) {
+        if (nextHeader && !nextHeader->allocated) {
             long negated = 0 - (long)allocLength;
             GRTRACE(GRSTR("%p=moving by %li bytes"), nextHeader, negated);
 
@@ -246,7 +267,7 @@ void gracht_arena_free(struct gracht_arena* arena, void* memory, size_t size)
     }
     else {
         header->allocated = 0;
-        if (!nextHeader->allocated) {
+        if (nextHeader && !nextHeader->allocated) {
             header->length += nextHeader->length + HEADER_SIZE;
         }
     }
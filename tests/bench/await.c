@@ -0,0 +1,98 @@
+/**
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Gracht Benchmark Suite
+ * - Cost of awaiting a batch of parallel calls with gracht_client_await_multiple, the time
+ *   per call should stay flat as the batch grows. A batch of one is the common synchronous call.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench_utils.h"
+#include "bench_perf_service_client.h"
+
+#define BATCH_MAX    400 // the client keeps responses in its receive buffer until they are read
+#define BATCH_ROUNDS 1000
+
+static struct gracht_message_context  g_contexts[BATCH_MAX];
+static struct gracht_message_context* g_contextPointers[BATCH_MAX];
+static uint64_t                       g_samples[BATCH_ROUNDS];
+
+static int run_batches(gracht_client_t* client, int batchSize)
+{
+    char name[32];
+    int  failed = 0;
+    int  round;
+    int  i;
+
+    for (round = 0; round < BATCH_ROUNDS; round++) {
+        uint64_t start = bench_now_ns();
+        int      count;
+
+        for (count = 0; count < batchSize; count++) {
+            g_contextPointers[count] = &g_contexts[count];
+            if (bench_perf_work(client, &g_contexts[count], 0, 0)) {
+                failed += batchSize - count;
+                break;
+            }
+        }
+
+        if (count && gracht_client_await_multiple(client, &g_contextPointers[0], count, GRACHT_AWAIT_ALL)) {
+            failed += count;
+        }
+        g_samples[round] = (bench_now_ns() - start) / (uint64_t)batchSize;
+
+        for (i = 0; i < count; i++) {
+            int result = -1;
+            bench_perf_work_result(client, &g_contexts[i], &result);
+            if (result != 0) {
+                failed++;
+            }
+        }
+    }
+
+    snprintf(&name[0], sizeof(name), "batch %i, per call", batchSize);
+    bench_print_percentiles(&name[0], &g_samples[0], BATCH_ROUNDS);
+    return failed;
+}
+
+int main(void)
+{
+    struct gracht_server_configuration config;
+    gracht_client_t*                   client;
+    int                                failed = 0;
+
+    gracht_server_configuration_init(&config);
+    if (bench_server_start(&config)) {
+        return -1;
+    }
+
+    if (!bench_client_create(&client)) {
+        failed += run_batches(client, 1);
+        failed += run_batches(client, 10);
+        failed += run_batches(client, 100);
+        failed += run_batches(client, BATCH_MAX);
+        gracht_client_shutdown(client);
+    }
+    else {
+        failed++;
+    }
+
+    printf("await: failed %i\n", failed);
+    bench_server_stop();
+    return failed != 0;
+}
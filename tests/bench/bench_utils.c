@@ -0,0 +1,235 @@
+/**
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Gracht Benchmark Suite
+ * - Shared helpers for benchmarks that run a server and its clients in the same process
+ */
+
+#include <errno.h>
+#include <gracht/link/socket.h>
+#if defined(GRACHT_C_LINK_SHM)
+#include <gracht/link/loopback.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bench_utils.h"
+#include "thread_api.h"
+#include "bench_perf_service_client.h"
+#include "bench_perf_service_server.h"
+
+static const char*      g_benchPath = "/tmp/g_bench";
+static const char*      g_benchName = "g_bench";
+static gracht_server_t* g_server    = NULL;
+static thrd_t           g_serverThread;
+
+uint64_t bench_now_ns(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ((uint64_t)ts.tv_sec * 1000000000ull) + (uint64_t)ts.tv_nsec;
+}
+
+void bench_sleep_us(unsigned int microseconds)
+{
+    struct timespec ts = {
+        .tv_sec  = microseconds / 1000000,
+        .tv_nsec = (long)(microseconds % 1000000) * 1000
+    };
+    nanosleep(&ts, NULL);
+}
+
+static int sample_cmp(const void* lh, const void* rh)
+{
+    uint64_t a = *(const uint64_t*)lh;
+    uint64_t b = *(const uint64_t*)rh;
+    return a < b ? -1 : (a > b ? 1 : 0);
+}
+
+void bench_print_percentiles(const char* name, uint64_t* samples, size_t count)
+{
+    if (!count) {
+        printf("%-24s no samples\n", name);
+        return;
+    }
+
+    qsort(samples, count, sizeof(uint64_t), sample_cmp);
+    printf("%-24s n=%-8zu p50 %9.1f us  p99 %9.1f us  max %9.1f us\n", name, count,
+        (double)samples[count / 2] / 1000.0,
+        (double)samples[(count * 99) / 100] / 1000.0,
+        (double)samples[count - 1] / 1000.0);
+}
+
+static void init_link_address(struct gracht_link_socket* link)
+{
+    struct sockaddr_un addr = { 0 };
+
+    addr.sun_family = AF_LOCAL;
+    strncpy(addr.sun_path, g_benchPath, sizeof(addr.sun_path));
+    addr.sun_path[sizeof(addr.sun_path) - 1] = '\0';
+
+    gracht_link_socket_set_type(link, gracht_link_stream_based);
+    gracht_link_socket_set_address(link, (const struct sockaddr_storage*)&addr, sizeof(struct sockaddr_un));
+    gracht_link_socket_set_domain(link, AF_LOCAL);
+}
+
+void bench_perf_work_invocation(struct gracht_message* message, const int microseconds, const int blocking)
+{
+    if (blocking) {
+        bench_sleep_us((unsigned int)microseconds);
+    }
+    else {
+        uint64_t end = bench_now_ns() + ((uint64_t)microseconds * 1000);
+        while (bench_now_ns() < end);
+    }
+    bench_perf_work_response(message, microseconds);
+}
+
+void bench_perf_shutdown_invocation(struct gracht_message* message)
+{
+    gracht_server_request_shutdown(message->server);
+}
+
+static int server_main(void* context)
+{
+    (void)context;
+    return gracht_server_main_loop(g_server);
+}
+
+int bench_server_start(gracht_server_configuration_t* config)
+{
+    struct gracht_link_socket* link;
+    int                        status;
+
+    status = gracht_server_create(config, &g_server);
+    if (status) {
+        fprintf(stderr, "bench_server_start: failed to create server %i\n", errno);
+        return status;
+    }
+
+    unlink(g_benchPath);
+    gracht_link_socket_create(&link);
+    init_link_address(link);
+    gracht_link_socket_set_listen(link, 1);
+    status = gracht_server_add_link(g_server, (struct gracht_link*)link);
+    if (status) {
+        fprintf(stderr, "bench_server_start: failed to add link %i\n", errno);
+        return status;
+    }
+
+#if defined(GRACHT_C_LINK_SHM)
+    {
+        struct gracht_link_loopback* loopback;
+        gracht_link_loopback_create(&loopback);
+        gracht_link_loopback_set_name(loopback, g_benchName);
+        gracht_link_loopback_set_listen(loopback, 1);
+        status = gracht_server_add_link(g_server, (struct gracht_link*)loopback);
+        if (status) {
+            fprintf(stderr, "bench_server_start: failed to add loopback link %i\n", errno);
+            return status;
+        }
+    }
+#endif
+
+    gracht_server_register_protocol(g_server, &bench_perf_server_protocol);
+    if (thrd_create(&g_serverThread, server_main, NULL) != thrd_success) {
+        return -1;
+    }
+    return 0;
+}
+
+void bench_server_stop(void)
+{
+    gracht_client_t* client;
+    int              exitCode;
+
+    // the server main loop only wakes up on events, so ask for shutdown through the protocol
+    if (!bench_client_create(&client)) {
+        struct gracht_message_context context;
+        bench_perf_shutdown(client, &context);
+        bench_sleep_us(1000);
+        gracht_client_shutdown(client);
+    }
+    thrd_join(g_serverThread, &exitCode);
+}
+
+gracht_server_t* bench_server(void)
+{
+    return g_server;
+}
+
+static int client_create(struct gracht_link* link, gracht_client_configuration_t* config, gracht_client_t** clientOut)
+{
+    struct gracht_client_configuration defaultConfig;
+    gracht_client_t*                   client;
+    int                                status;
+
+    if (!config) {
+        gracht_client_configuration_init(&defaultConfig);
+        config = &defaultConfig;
+    }
+    gracht_client_configuration_set_link(config, link);
+
+    status = gracht_client_create(config, &client);
+    if (status) {
+        fprintf(stderr, "bench_client_create: failed to create client %i\n", errno);
+        return status;
+    }
+
+    status = gracht_client_connect(client);
+    if (status) {
+        fprintf(stderr, "bench_client_create: failed to connect client %i\n", errno);
+        gracht_client_shutdown(client);
+        return status;
+    }
+
+    *clientOut = client;
+    return 0;
+}
+
+int bench_client_create(gracht_client_t** clientOut)
+{
+    return bench_client_create_config(NULL, clientOut);
+}
+
+int bench_client_create_config(gracht_client_configuration_t* config, gracht_client_t** clientOut)
+{
+    struct gracht_link_socket* link;
+
+    gracht_link_socket_create(&link);
+    init_link_address(link);
+    return client_create((struct gracht_link*)link, config, clientOut);
+}
+
+int bench_client_create_loopback(gracht_client_t** clientOut)
+{
+#if defined(GRACHT_C_LINK_SHM)
+    struct gracht_link_loopback* link;
+
+    gracht_link_loopback_create(&link);
+    gracht_link_loopback_set_name(link, g_benchName);
+    return client_create((struct gracht_link*)link, NULL, clientOut);
+#else
+    (void)clientOut;
+    errno = ENOTSUP;
+    return -1;
+#endif
+}
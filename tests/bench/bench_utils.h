@@ -0,0 +1,60 @@
+/**
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Gracht Benchmark Suite
+ * - Shared helpers for benchmarks that run a server and its clients in the same process
+ */
+
+#ifndef __BENCH_UTILS_H__
+#define __BENCH_UTILS_H__
+
+#include <gracht/client.h>
+#include <gracht/server.h>
+#include <stdint.h>
+#include <stddef.h>
+
+uint64_t bench_now_ns(void);
+void     bench_sleep_us(unsigned int microseconds);
+
+/**
+ * Sorts the samples and prints the p50, p99 and maximum values of them in microseconds.
+ */
+void bench_print_percentiles(const char* name, uint64_t* samples, size_t count);
+
+/**
+ * Starts a server with the bench protocol on a seperate thread, the configuration can
+ * be tweaked by the benchmark before calling.
+ */
+int              bench_server_start(gracht_server_configuration_t* config);
+void             bench_server_stop(void);
+gracht_server_t* bench_server(void);
+
+int bench_client_create(gracht_client_t** clientOut);
+
+/**
+ * Creates a client over a socket with the configuration tweaked by the benchmark, the link
+ * of the configuration is set by this function.
+ */
+int bench_client_create_config(gracht_client_configuration_t* config, gracht_client_t** clientOut);
+
+/**
+ * Creates a client that is connected to the server over the loopback link instead of a
+ * socket, this is only supported where the loopback link is built.
+ */
+int bench_client_create_loopback(gracht_client_t** clientOut);
+
+#endif //!__BENCH_UTILS_H__
@@ -0,0 +1,102 @@
+/**
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Gracht Benchmark Suite
+ * - Round-trip latency of a synchronous call made with the fused *_call_sync function, compared
+ *   to invoking, awaiting and reading the result as three steps.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench_utils.h"
+#include "bench_perf_service_client.h"
+
+#define REQUEST_COUNT 20000
+
+static uint64_t g_samples[REQUEST_COUNT];
+
+static int call_three_step(gracht_client_t* client)
+{
+    struct gracht_message_context context;
+    int                           result = -1;
+
+    if (bench_perf_work(client, &context, 0, 0)) {
+        return -1;
+    }
+    gracht_client_await(client, &context, GRACHT_AWAIT_ALL);
+    bench_perf_work_result(client, &context, &result);
+    return result;
+}
+
+static int call_fused(gracht_client_t* client)
+{
+    int result = -1;
+
+    if (bench_perf_work_call_sync(client, 0, 0, &result)) {
+        return -1;
+    }
+    return result;
+}
+
+static int run_calls(const char* name, gracht_client_t* client, int (*call)(gracht_client_t*))
+{
+    uint64_t start, end;
+    int      failed = 0;
+    int      i;
+
+    start = bench_now_ns();
+    for (i = 0; i < REQUEST_COUNT; i++) {
+        uint64_t sent = bench_now_ns();
+
+        if (call(client) != 0) {
+            failed++;
+        }
+        g_samples[i] = bench_now_ns() - sent;
+    }
+    end = bench_now_ns();
+
+    printf("%s: failed %i, %.0f calls/s\n", name, failed,
+        ((double)REQUEST_COUNT * 1000000000.0) / (double)(end - start));
+    bench_print_percentiles(name, &g_samples[0], REQUEST_COUNT);
+    return failed;
+}
+
+int main(void)
+{
+    struct gracht_server_configuration config;
+    gracht_client_t*                   client;
+    int                                failed = 0;
+
+    gracht_server_configuration_init(&config);
+    if (bench_server_start(&config)) {
+        return -1;
+    }
+
+    if (!bench_client_create(&client)) {
+        failed += run_calls("three-step", client, call_three_step);
+        failed += run_calls("call_sync", client, call_fused);
+        failed += run_calls("three-step", client, call_three_step);
+        failed += run_calls("call_sync", client, call_fused);
+        gracht_client_shutdown(client);
+    }
+    else {
+        failed++;
+    }
+
+    bench_server_stop();
+    return failed != 0;
+}
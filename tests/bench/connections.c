@@ -0,0 +1,150 @@
+/**
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Gracht Benchmark Suite
+ * - Many connections, a number of threads each drive several clients that pipeline small
+ *   requests at the server. This stresses the aio backend of the server rather than the
+ *   workers, build with GRACHT_AIO_URING on and off to compare io_uring against epoll.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench_utils.h"
+#include "bench_perf_service_client.h"
+#include "config.h"
+#include "gatomic.h"
+#include "thread_api.h"
+
+#define THREAD_COUNT       8
+#define CLIENTS_PER_THREAD 8
+#define PIPELINE_DEPTH     8
+#define ROUND_COUNT        250
+#define REACTOR_COUNT      2
+
+#define REQUEST_COUNT (THREAD_COUNT * CLIENTS_PER_THREAD * PIPELINE_DEPTH * ROUND_COUNT)
+
+static atomic_int g_answered;
+static atomic_int g_failed;
+static atomic_int g_start;
+static uint64_t   g_samples[REQUEST_COUNT];
+static atomic_int g_sampleCount;
+
+static int connection_thread(void* context)
+{
+    struct gracht_message_context contexts[CLIENTS_PER_THREAD][PIPELINE_DEPTH];
+    uint64_t                      sent[CLIENTS_PER_THREAD][PIPELINE_DEPTH];
+    gracht_client_t*              clients[CLIENTS_PER_THREAD];
+    int                           round, i, j;
+    (void)context;
+
+    for (i = 0; i < CLIENTS_PER_THREAD; i++) {
+        if (bench_client_create(&clients[i])) {
+            atomic_fetch_add(&g_failed, PIPELINE_DEPTH * ROUND_COUNT * (CLIENTS_PER_THREAD - i));
+            while (i--) {
+                gracht_client_shutdown(clients[i]);
+            }
+            return -1;
+        }
+    }
+
+    while (!atomic_load(&g_start)) {
+        thrd_yield();
+    }
+
+    // every round queues a full pipeline on each of the clients before any of the responses
+    // are read, so the server always has many connections with data ready at once
+    for (round = 0; round < ROUND_COUNT; round++) {
+        for (i = 0; i < CLIENTS_PER_THREAD; i++) {
+            for (j = 0; j < PIPELINE_DEPTH; j++) {
+                sent[i][j] = bench_now_ns();
+                if (bench_perf_work(clients[i], &contexts[i][j], 0, 0)) {
+                    sent[i][j] = 0;
+                    atomic_fetch_add(&g_failed, 1);
+                }
+            }
+        }
+
+        for (i = 0; i < CLIENTS_PER_THREAD; i++) {
+            for (j = 0; j < PIPELINE_DEPTH; j++) {
+                int result = -1;
+                if (!sent[i][j]) {
+                    continue;
+                }
+
+                gracht_client_wait_message(clients[i], &contexts[i][j], GRACHT_MESSAGE_BLOCK);
+                bench_perf_work_result(clients[i], &contexts[i][j], &result);
+                if (result == 0) {
+                    atomic_fetch_add(&g_answered, 1);
+                    g_samples[atomic_fetch_add(&g_sampleCount, 1)] = bench_now_ns() - sent[i][j];
+                }
+                else {
+                    atomic_fetch_add(&g_failed, 1);
+                }
+            }
+        }
+    }
+
+    for (i = 0; i < CLIENTS_PER_THREAD; i++) {
+        gracht_client_shutdown(clients[i]);
+    }
+    return 0;
+}
+
+int main(void)
+{
+    struct gracht_server_configuration config;
+    thrd_t                             threads[THREAD_COUNT];
+    uint64_t                           start, end;
+    int                                exitCode;
+    int                                i;
+
+    gracht_server_configuration_init(&config);
+    gracht_server_configuration_set_num_workers(&config, 2);
+    gracht_server_configuration_set_num_reactors(&config, REACTOR_COUNT);
+    if (bench_server_start(&config)) {
+        return -1;
+    }
+
+    for (i = 0; i < THREAD_COUNT; i++) {
+        thrd_create(&threads[i], connection_thread, NULL);
+    }
+
+    // give the clients time to connect, so only the requests are measured
+    bench_sleep_us(200000);
+    start = bench_now_ns();
+    atomic_store(&g_start, 1);
+    for (i = 0; i < THREAD_COUNT; i++) {
+        thrd_join(threads[i], &exitCode);
+    }
+    end = bench_now_ns();
+
+#ifdef GRACHT_AIO_URING
+    printf("connections: io_uring backend, ");
+#else
+    printf("connections: epoll backend, ");
+#endif
+    printf("%i reactors, %i connections, pipeline depth %i\n",
+        REACTOR_COUNT, THREAD_COUNT * CLIENTS_PER_THREAD, PIPELINE_DEPTH);
+    printf("answered %i, failed %i, %.0f requests/s\n",
+        atomic_load(&g_answered), atomic_load(&g_failed),
+        ((double)atomic_load(&g_answered) * 1000000000.0) / (double)(end - start));
+    bench_print_percentiles("request latency", &g_samples[0], (size_t)atomic_load(&g_sampleCount));
+
+    bench_server_stop();
+    return atomic_load(&g_failed) != 0;
+}
@@ -0,0 +1,146 @@
+/**
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Gracht Benchmark Suite
+ * - Worker dispatch under a mixed load. A number of clients keep the server busy
+ *   with slow (10ms) requests, while another set of clients issue fast (1us) requests
+ *   and measure the round-trip latency of those. Fast requests that are queued behind
+ *   a slow one show up in the tail of the latency distribution.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench_utils.h"
+#include "bench_perf_service_client.h"
+#include "gatomic.h"
+#include "thread_api.h"
+
+#define WORKER_COUNT      4
+#define SLOW_CLIENTS      2
+#define FAST_CLIENTS      4
+#define SLOW_REQUEST_US   10000
+#define FAST_REQUEST_US   1
+#define FAST_REQUESTS     2000
+
+static atomic_int g_fastRunning;
+static uint64_t   g_samples[FAST_CLIENTS * FAST_REQUESTS];
+static atomic_int g_sampleCount;
+
+static int bench_work(gracht_client_t* client, int microseconds, int blocking)
+{
+    struct gracht_message_context context;
+    int                           result = 0;
+    int                           status;
+
+    status = bench_perf_work(client, &context, microseconds, blocking);
+    if (status) {
+        return status;
+    }
+
+    gracht_client_wait_message(client, &context, GRACHT_MESSAGE_BLOCK);
+    bench_perf_work_result(client, &context, &result);
+    return result == microseconds ? 0 : -1;
+}
+
+static int slow_client(void* context)
+{
+    gracht_client_t* client;
+    (void)context;
+
+    if (bench_client_create(&client)) {
+        return -1;
+    }
+
+    // slow handlers block instead of spinning, so they tie up the worker without
+    // taking the cpu from everybody else on small machines
+    while (atomic_load(&g_fastRunning)) {
+        if (bench_work(client, SLOW_REQUEST_US, 1)) {
+            break;
+        }
+    }
+    gracht_client_shutdown(client);
+    return 0;
+}
+
+static int fast_client(void* context)
+{
+    gracht_client_t* client;
+    int              i;
+    (void)context;
+
+    if (bench_client_create(&client)) {
+        atomic_fetch_sub(&g_fastRunning, 1);
+        return -1;
+    }
+
+    for (i = 0; i < FAST_REQUESTS; i++) {
+        uint64_t start = bench_now_ns();
+        if (bench_work(client, FAST_REQUEST_US, 0)) {
+            fprintf(stderr, "fast_client: request failed\n");
+            break;
+        }
+        g_samples[atomic_fetch_add(&g_sampleCount, 1)] = bench_now_ns() - start;
+    }
+
+    atomic_fetch_sub(&g_fastRunning, 1);
+    gracht_client_shutdown(client);
+    return 0;
+}
+
+int main(void)
+{
+    struct gracht_server_configuration config;
+    thrd_t                             slowThreads[SLOW_CLIENTS];
+    thrd_t                             fastThreads[FAST_CLIENTS];
+    uint64_t                           start;
+    int                                exitCode;
+    int                                i;
+
+    gracht_server_configuration_init(&config);
+    gracht_server_configuration_set_num_workers(&config, WORKER_COUNT);
+    if (bench_server_start(&config)) {
+        return -1;
+    }
+
+    atomic_store(&g_fastRunning, FAST_CLIENTS);
+    for (i = 0; i < SLOW_CLIENTS; i++) {
+        thrd_create(&slowThreads[i], slow_client, NULL);
+    }
+
+    // let the slow clients get going before measuring
+    bench_sleep_us(50000);
+
+    start = bench_now_ns();
+    for (i = 0; i < FAST_CLIENTS; i++) {
+        thrd_create(&fastThreads[i], fast_client, NULL);
+    }
+    for (i = 0; i < FAST_CLIENTS; i++) {
+        thrd_join(fastThreads[i], &exitCode);
+    }
+    for (i = 0; i < SLOW_CLIENTS; i++) {
+        thrd_join(slowThreads[i], &exitCode);
+    }
+
+    printf("dispatch: %i workers, %i slow clients (%ius), %i fast clients (%ius), %.1f ms\n",
+        WORKER_COUNT, SLOW_CLIENTS, SLOW_REQUEST_US, FAST_CLIENTS, FAST_REQUEST_US,
+        (double)(bench_now_ns() - start) / 1000000.0);
+    bench_print_percentiles("fast request latency", &g_samples[0], (size_t)atomic_load(&g_sampleCount));
+
+    bench_server_stop();
+    return 0;
+}
@@ -0,0 +1,89 @@
+/**
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Gracht Benchmark Suite
+ * - Round-trip latency of a single client that issues empty requests one at a time, over a
+ *   local socket and over the loopback link. The loopback numbers are mostly the overhead of
+ *   the runtime itself, as the kernel is only involved when one of the sides has to sleep.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench_utils.h"
+#include "bench_perf_service_client.h"
+
+#define REQUEST_COUNT 20000
+
+static uint64_t g_samples[REQUEST_COUNT];
+
+static int run_requests(const char* name, gracht_client_t* client)
+{
+    struct gracht_message_context context;
+    uint64_t                      start, end;
+    int                           failed = 0;
+    int                           i;
+
+    start = bench_now_ns();
+    for (i = 0; i < REQUEST_COUNT; i++) {
+        uint64_t sent   = bench_now_ns();
+        int      result = -1;
+
+        if (bench_perf_work(client, &context, 0, 0)) {
+            failed++;
+            continue;
+        }
+
+        gracht_client_wait_message(client, &context, GRACHT_MESSAGE_BLOCK);
+        bench_perf_work_result(client, &context, &result);
+        g_samples[i] = bench_now_ns() - sent;
+        if (result != 0) {
+            failed++;
+        }
+    }
+    end = bench_now_ns();
+
+    printf("%s: failed %i, %.0f requests/s\n", name, failed,
+        ((double)REQUEST_COUNT * 1000000000.0) / (double)(end - start));
+    bench_print_percentiles(name, &g_samples[0], REQUEST_COUNT);
+    return failed;
+}
+
+int main(void)
+{
+    struct gracht_server_configuration config;
+    gracht_client_t*                   client;
+    int                                failed = 0;
+
+    gracht_server_configuration_init(&config);
+    if (bench_server_start(&config)) {
+        return -1;
+    }
+
+    if (!bench_client_create(&client)) {
+        failed += run_requests("socket", client);
+        gracht_client_shutdown(client);
+    }
+
+    if (!bench_client_create_loopback(&client)) {
+        failed += run_requests("loopback", client);
+        gracht_client_shutdown(client);
+    }
+
+    bench_server_stop();
+    return failed != 0;
+}
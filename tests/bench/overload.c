@@ -0,0 +1,118 @@
+/**
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Gracht Benchmark Suite
+ * - Worker overload, a number of clients send bursts of requests at a server with
+ *   very small worker queues. Every request must be answered, the server is expected
+ *   to stop reading from the clients while the workers catch up.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench_utils.h"
+#include "bench_perf_service_client.h"
+#include "gatomic.h"
+#include "thread_api.h"
+
+#define WORKER_COUNT   2
+#define QUEUE_CAPACITY 2
+#define CLIENT_COUNT   8
+#define BURST_SIZE     12 // the client keeps responses in its receive buffer until they are read
+#define BURST_COUNT    32
+#define REQUEST_US     100
+
+static atomic_int g_answered;
+static atomic_int g_failed;
+static uint64_t   g_samples[CLIENT_COUNT * BURST_SIZE * BURST_COUNT];
+static atomic_int g_sampleCount;
+
+static int burst_client(void* context)
+{
+    struct gracht_message_context contexts[BURST_SIZE];
+    uint64_t                      start;
+    gracht_client_t*              client;
+    int                           burst;
+    int                           count;
+    int                           i;
+    (void)context;
+
+    if (bench_client_create(&client)) {
+        atomic_fetch_add(&g_failed, BURST_SIZE * BURST_COUNT);
+        return -1;
+    }
+
+    for (burst = 0; burst < BURST_COUNT; burst++) {
+        start = bench_now_ns();
+        for (count = 0; count < BURST_SIZE; count++) {
+            if (bench_perf_work(client, &contexts[count], REQUEST_US, 1)) {
+                atomic_fetch_add(&g_failed, BURST_SIZE - count);
+                break;
+            }
+        }
+
+        for (i = 0; i < count; i++) {
+            int result = 0;
+            gracht_client_wait_message(client, &contexts[i], GRACHT_MESSAGE_BLOCK);
+            bench_perf_work_result(client, &contexts[i], &result);
+            if (result == REQUEST_US) {
+                atomic_fetch_add(&g_answered, 1);
+            }
+            else {
+                atomic_fetch_add(&g_failed, 1);
+            }
+        }
+        g_samples[atomic_fetch_add(&g_sampleCount, 1)] = bench_now_ns() - start;
+    }
+
+    gracht_client_shutdown(client);
+    return 0;
+}
+
+int main(void)
+{
+    struct gracht_server_configuration  config;
+    struct gracht_server_overload_stats stats;
+    thrd_t                              threads[CLIENT_COUNT];
+    int                                 exitCode;
+    int                                 i;
+
+    gracht_server_configuration_init(&config);
+    gracht_server_configuration_set_num_workers(&config, WORKER_COUNT);
+    gracht_server_configuration_set_queue_capacity(&config, QUEUE_CAPACITY);
+    if (bench_server_start(&config)) {
+        return -1;
+    }
+
+    for (i = 0; i < CLIENT_COUNT; i++) {
+        thrd_create(&threads[i], burst_client, NULL);
+    }
+    for (i = 0; i < CLIENT_COUNT; i++) {
+        thrd_join(threads[i], &exitCode);
+    }
+
+    gracht_server_get_overload_stats(bench_server(), &stats);
+    printf("overload: %i workers (queue %i), %i clients, %i bursts of %i requests\n",
+        WORKER_COUNT, QUEUE_CAPACITY, CLIENT_COUNT, BURST_COUNT, BURST_SIZE);
+    printf("answered %i, failed %i, stalls %llu, resumes %llu, still stalled %u\n",
+        atomic_load(&g_answered), atomic_load(&g_failed),
+        (unsigned long long)stats.stalls, (unsigned long long)stats.resumes, stats.stalled);
+    bench_print_percentiles("burst latency", &g_samples[0], (size_t)atomic_load(&g_sampleCount));
+
+    bench_server_stop();
+    return atomic_load(&g_failed) != 0;
+}
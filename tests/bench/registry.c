@@ -0,0 +1,175 @@
+/**
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Gracht Benchmark Suite
+ * - Client lookup contention, compares the old rwlock + hashtable lookup path
+ *   against the registry used by the server. Each worker thread does a number of
+ *   lookups the same way the respond path does (lock, get, unlock).
+ */
+
+#include "gatomic.h"
+#include "hashtable.h"
+#include "registry.h"
+#include "rwlock.h"
+#include "thread_api.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define CLIENT_COUNT      256
+#define LOOKUPS_PER_WORKER 2000000
+
+struct bench_client {
+    int      handle;
+    uint64_t hits;
+};
+
+static struct bench_client g_clients[CLIENT_COUNT];
+static gr_hashtable_t      g_hashtable;
+static struct rwlock       g_lock;
+static gr_registry_t       g_registry;
+static atomic_int          g_start;
+
+static uint64_t client_hash(const void* element)
+{
+    const struct bench_client* client = element;
+    return (uint64_t)client->handle;
+}
+
+static int client_cmp(const void* element1, const void* element2)
+{
+    const struct bench_client* client1 = element1;
+    const struct bench_client* client2 = element2;
+    return client1->handle == client2->handle ? 0 : -1;
+}
+
+static uint64_t client_key(const void* element)
+{
+    const struct bench_client* client = element;
+    return (uint64_t)client->handle;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ((uint64_t)ts.tv_sec * 1000000000ull) + (uint64_t)ts.tv_nsec;
+}
+
+static int hashtable_worker(void* context)
+{
+    unsigned int seed = (unsigned int)(uintptr_t)context;
+    uint64_t     hits = 0;
+    int          i;
+
+    while (!atomic_load(&g_start)) {
+        thrd_yield();
+    }
+
+    for (i = 0; i < LOOKUPS_PER_WORKER; i++) {
+        struct bench_client  key = { .handle = (int)((seed + i) % CLIENT_COUNT) };
+        struct bench_client* client;
+
+        rwlock_r_lock(&g_lock);
+        client = gr_hashtable_get(&g_hashtable, &key);
+        if (client) {
+            hits++;
+        }
+        rwlock_r_unlock(&g_lock);
+    }
+    return hits == LOOKUPS_PER_WORKER ? 0 : -1;
+}
+
+static int registry_worker(void* context)
+{
+    unsigned int seed = (unsigned int)(uintptr_t)context;
+    uint64_t     hits = 0;
+    int          i;
+
+    while (!atomic_load(&g_start)) {
+        thrd_yield();
+    }
+
+    for (i = 0; i < LOOKUPS_PER_WORKER; i++) {
+        struct bench_client* client;
+        unsigned int         token;
+
+        token  = gr_registry_read_lock(&g_registry);
+        client = gr_registry_get(&g_registry, (uint64_t)((seed + i) % CLIENT_COUNT));
+        if (client) {
+            hits++;
+        }
+        gr_registry_read_unlock(&g_registry, token);
+    }
+    return hits == LOOKUPS_PER_WORKER ? 0 : -1;
+}
+
+static int run(const char* name, thrd_start_t worker, int workerCount)
+{
+    thrd_t   threads[16];
+    uint64_t start, end;
+    int      failed = 0;
+    int      i;
+
+    atomic_store(&g_start, 0);
+    for (i = 0; i < workerCount; i++) {
+        if (thrd_create(&threads[i], worker, (void*)(uintptr_t)(i * 7919)) != thrd_success) {
+            fprintf(stderr, "failed to create worker thread\n");
+            return -1;
+        }
+    }
+
+    start = now_ns();
+    atomic_store(&g_start, 1);
+    for (i = 0; i < workerCount; i++) {
+        int result;
+        thrd_join(threads[i], &result);
+        failed |= result;
+    }
+    end = now_ns();
+
+    printf("%-10s workers=%2i  %8.2f ns/lookup  %8.2f Mlookups/s\n", name, workerCount,
+        (double)(end - start) / LOOKUPS_PER_WORKER,
+        ((double)LOOKUPS_PER_WORKER * workerCount * 1000.0) / (double)(end - start));
+    return failed;
+}
+
+int main(void)
+{
+    int workerCounts[] = { 1, 4, 16 };
+    int status = 0;
+    int i;
+
+    rwlock_init(&g_lock);
+    gr_hashtable_construct(&g_hashtable, 0, sizeof(struct bench_client), client_hash, client_cmp);
+    gr_registry_construct(&g_registry, client_key);
+    for (i = 0; i < CLIENT_COUNT; i++) {
+        g_clients[i].handle = i;
+        gr_hashtable_set(&g_hashtable, &g_clients[i]);
+        gr_registry_add(&g_registry, &g_clients[i]);
+    }
+
+    for (i = 0; i < (int)(sizeof(workerCounts) / sizeof(int)); i++) {
+        status |= run("rwlock", hashtable_worker, workerCounts[i]);
+        status |= run("registry", registry_worker, workerCounts[i]);
+    }
+
+    gr_registry_destroy(&g_registry);
+    gr_hashtable_destroy(&g_hashtable);
+    rwlock_destroy(&g_lock);
+    return status;
+}
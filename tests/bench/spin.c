@@ -0,0 +1,120 @@
+/**
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Gracht Benchmark Suite
+ * - Round-trip latency of calls awaited with GRACHT_AWAIT_ASYNC while another thread receives
+ *   the responses, with and without spinning before the awaiting thread sleeps.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "bench_utils.h"
+#include "bench_perf_service_client.h"
+#include "gatomic.h"
+#include "thread_api.h"
+
+#define REQUEST_COUNT 20000
+#define SPIN_US       50
+
+static gracht_client_t* g_client;
+static atomic_int       g_pumping;
+static uint64_t         g_samples[REQUEST_COUNT];
+
+static int pump_thread(void* context)
+{
+    (void)context;
+    while (atomic_load(&g_pumping)) {
+        if (gracht_client_wait_message(g_client, NULL, GRACHT_MESSAGE_BLOCK)) {
+            break;
+        }
+    }
+    return 0;
+}
+
+static int run_requests(const char* name, int spinUs)
+{
+    struct gracht_client_configuration config;
+    struct gracht_message_context      context;
+    thrd_t                             pump;
+    uint64_t                           start, end;
+    int                                result;
+    int                                failed = 0;
+    int                                i;
+
+    gracht_client_configuration_init(&config);
+    gracht_client_configuration_set_await_spin(&config, spinUs);
+    if (bench_client_create_config(&config, &g_client)) {
+        return REQUEST_COUNT;
+    }
+
+    atomic_store(&g_pumping, 1);
+    thrd_create(&pump, pump_thread, NULL);
+
+    start = bench_now_ns();
+    for (i = 0; i < REQUEST_COUNT; i++) {
+        uint64_t sent = bench_now_ns();
+
+        result = -1;
+        if (bench_perf_work(g_client, &context, 0, 0)) {
+            failed++;
+            continue;
+        }
+
+        gracht_client_await(g_client, &context, GRACHT_AWAIT_ASYNC);
+        bench_perf_work_result(g_client, &context, &result);
+        g_samples[i] = bench_now_ns() - sent;
+        if (result != 0) {
+            failed++;
+        }
+    }
+    end = bench_now_ns();
+
+    printf("%s: failed %i, %.0f requests/s\n", name, failed,
+        ((double)REQUEST_COUNT * 1000000000.0) / (double)(end - start));
+    bench_print_percentiles(name, &g_samples[0], REQUEST_COUNT);
+
+    // the pump thread is blocked receiving, so make one last call to let it see that it must stop
+    atomic_store(&g_pumping, 0);
+    if (!bench_perf_work(g_client, &context, 0, 0)) {
+        gracht_client_await(g_client, &context, GRACHT_AWAIT_ASYNC);
+        bench_perf_work_result(g_client, &context, &result);
+    }
+    thrd_join(pump, NULL);
+
+    gracht_client_shutdown(g_client);
+    return failed;
+}
+
+int main(void)
+{
+    struct gracht_server_configuration config;
+    int                                failed = 0;
+
+    gracht_server_configuration_init(&config);
+    if (bench_server_start(&config)) {
+        return -1;
+    }
+
+    // the client never spins on a single core, both runs then block
+    printf("spin: %li cpus online, spinning for up to %i us\n", sysconf(_SC_NPROCESSORS_ONLN), SPIN_US);
+    failed += run_requests("blocking", 0);
+    failed += run_requests("spinning", SPIN_US);
+
+    bench_server_stop();
+    return failed != 0;
+}
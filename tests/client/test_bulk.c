@@ -0,0 +1,115 @@
+/**
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Gracht Bulk Transfer Test
+ * - Sends an array that is far larger than the maximum message size, which is passed to the
+ *   server as shared memory, and a small one that is sent inline.
+ */
+
+#include <errno.h>
+#include <gracht/client.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test_utils_service_client.h"
+
+extern int init_client_with_socket_link(gracht_client_t** clientOut);
+
+void test_utils_event_myevent_invocation(gracht_client_t* client, const int n)
+{
+    (void)client;
+    (void)n;
+}
+
+void test_utils_event_transfer_status_invocation(gracht_client_t* client, const struct test_transfer_status* transfer_status)
+{
+    (void)client;
+    (void)transfer_status;
+}
+
+static uint32_t __checksum(const uint8_t* data, uint32_t length)
+{
+    uint32_t result = 0;
+    for (uint32_t i = 0; i < length; i++) {
+        result = (result * 31) + data[i];
+    }
+    return result;
+}
+
+static int __test_checksum(gracht_client_t* client, uint32_t length)
+{
+    struct gracht_message_context context;
+    uint8_t*                      data;
+    uint32_t                      result = 0;
+    int                           code;
+
+    data = malloc(length);
+    if (!data) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < length; i++) {
+        data[i] = (uint8_t)((i * 7) + (i >> 12));
+    }
+
+    code = test_utils_checksum(client, &context, data, length);
+    if (code) {
+        free(data);
+        return code;
+    }
+
+    gracht_client_wait_message(client, &context, GRACHT_MESSAGE_BLOCK);
+    test_utils_checksum_result(client, &context, &result);
+    printf("gracht_client: checksum of %u bytes: %u, expected %u\n", length, result, __checksum(data, length));
+    if (result != __checksum(data, length)) {
+        errno = EINVAL;
+        code = -1;
+    }
+    free(data);
+    return code;
+}
+
+int main(void)
+{
+    gracht_client_t* client;
+    int              status;
+
+    status = init_client_with_socket_link(&client);
+    if (status) {
+        fprintf(stderr, "failed to create client: %s\n", strerror(errno));
+        return status;
+    }
+
+    gracht_client_register_protocol(client, &test_utils_client_protocol);
+
+    status = __test_checksum(client, 4 * 1024 * 1024);
+    if (status) {
+        fprintf(stderr, "__test_checksum (bulk): FAILED [%s]\n", strerror(errno));
+        return status;
+    }
+
+    status = __test_checksum(client, 100);
+    if (status) {
+        fprintf(stderr, "__test_checksum (inline): FAILED [%s]\n", strerror(errno));
+        return status;
+    }
+
+    gracht_client_shutdown(client);
+    return status;
+}
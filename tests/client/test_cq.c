@@ -0,0 +1,178 @@
+/**
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Gracht Completion Queue Test
+ * - Issues many calls without waiting for them individually, while another thread receives
+ *   the responses, and collects the completed calls from a completion queue.
+ */
+
+#include <errno.h>
+#include <gracht/client.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "test_utils_service_client.h"
+#include "gatomic.h"
+#include "thread_api.h"
+
+#define CALL_COUNT   1000
+#define CALL_WINDOW  64
+#define POLL_COUNT   16
+
+extern int init_client_with_socket_link(gracht_client_t** clientOut);
+
+struct test_call {
+    struct gracht_message_context context;
+    uint8_t                       data[32];
+    uint32_t                      expected;
+    int                           completed;
+};
+
+static gracht_client_t* g_client;
+static struct test_call g_calls[CALL_COUNT];
+static atomic_int       g_pumping;
+
+void test_utils_event_myevent_invocation(gracht_client_t* client, const int n)
+{
+    (void)client;
+    (void)n;
+}
+
+void test_utils_event_transfer_status_invocation(gracht_client_t* client, const struct test_transfer_status* transfer_status)
+{
+    (void)client;
+    (void)transfer_status;
+}
+
+static int __pump_thread(void* context)
+{
+    (void)context;
+    while (atomic_load(&g_pumping)) {
+        if (gracht_client_wait_message(g_client, NULL, GRACHT_MESSAGE_BLOCK)) {
+            break;
+        }
+    }
+    return 0;
+}
+
+static int __issue_call(gracht_client_cq_t* cq, int index)
+{
+    struct test_call* call = &g_calls[index];
+
+    // the data is unique to the call, so completions that are mixed up are detected
+    call->expected = 0;
+    for (int j = 0; j < (int)sizeof(call->data); j++) {
+        call->data[j]  = (uint8_t)((index * 7) + j);
+        call->expected = (call->expected * 31) + call->data[j];
+    }
+
+    if (test_utils_checksum(g_client, &call->context, &call->data[0], sizeof(call->data))) {
+        return -1;
+    }
+    return gracht_client_cq_add(cq, &call->context, call);
+}
+
+static int __test_cq(gracht_client_cq_t* cq)
+{
+    struct gracht_client_completion completions[POLL_COUNT];
+    int                             issued    = 0;
+    int                             completed = 0;
+    int                             invalid   = 0;
+
+    while (completed < CALL_COUNT) {
+        int count;
+
+        // responses are held by the client until their results are read, so keep a window of calls
+        // outstanding instead of issuing all of them at once
+        while (issued < CALL_COUNT && issued - completed < CALL_WINDOW) {
+            if (__issue_call(cq, issued)) {
+                fprintf(stderr, "__test_cq: failed to issue call %i [%s]\n", issued, strerror(errno));
+                return -1;
+            }
+            issued++;
+        }
+
+        count = gracht_client_cq_poll(cq, &completions[0], POLL_COUNT, GRACHT_MESSAGE_BLOCK);
+        for (int i = 0; i < count; i++) {
+            struct test_call* call   = completions[i].tag;
+            uint32_t          result = 0;
+
+            if (completions[i].context != &call->context || completions[i].status != GRACHT_MESSAGE_COMPLETED ||
+                call->completed || test_utils_checksum_result(g_client, &call->context, &result) ||
+                result != call->expected) {
+                invalid++;
+            }
+            call->completed = 1;
+        }
+        completed += count;
+    }
+
+    // every completion was collected, so the queue must be empty now
+    if (gracht_client_cq_poll(cq, &completions[0], POLL_COUNT, 0)) {
+        invalid++;
+    }
+
+    printf("gracht_client: completion queue collected %i calls, invalid %i\n", completed, invalid);
+    if (invalid) {
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+int main(void)
+{
+    struct gracht_message_context context;
+    gracht_client_cq_t*           cq;
+    thrd_t                        pump;
+    uint32_t                      result;
+    int                           status;
+
+    status = init_client_with_socket_link(&g_client);
+    if (status) {
+        fprintf(stderr, "failed to create client: %s\n", strerror(errno));
+        return status;
+    }
+
+    gracht_client_register_protocol(g_client, &test_utils_client_protocol);
+
+    status = gracht_client_cq_create(g_client, &cq);
+    if (status) {
+        fprintf(stderr, "failed to create completion queue: %s\n", strerror(errno));
+        return status;
+    }
+
+    atomic_store(&g_pumping, 1);
+    thrd_create(&pump, __pump_thread, NULL);
+
+    status = __test_cq(cq);
+    if (status) {
+        fprintf(stderr, "__test_cq: FAILED [%s]\n", strerror(errno));
+    }
+
+    // the pump thread is blocked receiving, so make one last call to let it see that it must stop
+    atomic_store(&g_pumping, 0);
+    if (!test_utils_checksum(g_client, &context, &g_calls[0].data[0], sizeof(g_calls[0].data))) {
+        gracht_client_wait_message(g_client, &context, GRACHT_MESSAGE_BLOCK);
+        test_utils_checksum_result(g_client, &context, &result);
+    }
+    thrd_join(pump, NULL);
+
+    gracht_client_cq_destroy(cq);
+    gracht_client_shutdown(g_client);
+    return status;
+}
@@ -30,11 +30,18 @@
 extern int init_client_with_socket_link(gracht_client_t** clientOut);
 
 static volatile int g_eventsReceived = 0;
+static volatile int g_eventsOutOfOrder = 0;
+static volatile int g_eventsQuiet = 0;
 
 void test_utils_event_myevent_invocation(gracht_client_t* client, const int n)
 {
     (void)client;
-    printf("myevent: %i\n", n);
+    if (!g_eventsQuiet) {
+        printf("myevent: %i\n", n);
+    }
+    if (n != g_eventsReceived) {
+        g_eventsOutOfOrder++;
+    }
     g_eventsReceived++;
 }
 
@@ -44,6 +51,14 @@ void test_utils_event_transfer_status_invocation(gracht_client_t* client, const
     (void)transfer_status;
 }
 
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(MOLLENOS)
+#include <threads.h>
+#else
+#include <unistd.h>
+#endif
+
 int main(void)
 {
     gracht_client_t* client;
@@ -67,6 +82,43 @@ int main(void)
     }
     
     printf("gracht_client: recieved event count %i\n", g_eventsReceived);
+
+    // streaming clients are subscribed to all protocols, so broadcasts should reach us too
+    g_eventsReceived = 0;
+    test_utils_get_broadcast(client, NULL, code);
+    while (g_eventsReceived != code) {
+        gracht_client_wait_message(client, NULL, GRACHT_MESSAGE_BLOCK);
+    }
+
+    printf("gracht_client: recieved broadcast count %i\n", g_eventsReceived);
+
+    // subscribing to the protocol replaces the subscription to all, so we are still reached
+    g_eventsReceived = 0;
+    test_utils_subscribe(client, NULL);
+    test_utils_get_broadcast(client, NULL, code);
+    while (g_eventsReceived != code) {
+        gracht_client_wait_message(client, NULL, GRACHT_MESSAGE_BLOCK);
+    }
+
+    printf("gracht_client: recieved subscribed broadcast count %i\n", g_eventsReceived);
+
+    // act as a slow consumer, the server must queue what does not fit in the socket
+    // and deliver the rest once we start reading again
+    g_eventsReceived = 0;
+    g_eventsQuiet    = 1;
+    test_utils_get_event(client, NULL, 5000);
+#ifdef _WIN32
+    Sleep(500);
+#elif defined(MOLLENOS)
+    thrd_sleep(&(struct timespec) { .tv_nsec = 500000000 }, NULL);
+#else
+    usleep(500000);
+#endif
+    while (g_eventsReceived != 5000) {
+        gracht_client_wait_message(client, NULL, GRACHT_MESSAGE_BLOCK);
+    }
+
+    printf("gracht_client: recieved delayed event count %i, out of order %i\n", g_eventsReceived, g_eventsOutOfOrder);
     gracht_client_shutdown(client);
-    return 0;
+    return g_eventsOutOfOrder != 0;
 }
@@ -0,0 +1,118 @@
+/**
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Gracht Fragmentation Test
+ * - Echoes arrays that are larger than the maximum message size, so both the request
+ *   and the response has to be split into frames and assembled again.
+ */
+
+#include <errno.h>
+#include <gracht/client.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test_utils_service_client.h"
+
+extern int init_client_with_socket_link(gracht_client_t** clientOut);
+
+void test_utils_event_myevent_invocation(gracht_client_t* client, const int n)
+{
+    (void)client;
+    (void)n;
+}
+
+void test_utils_event_transfer_status_invocation(gracht_client_t* client, const struct test_transfer_status* transfer_status)
+{
+    (void)client;
+    (void)transfer_status;
+}
+
+static int __test_echo(gracht_client_t* client, uint32_t length)
+{
+    struct gracht_message_context context;
+    uint8_t*                      data;
+    uint8_t*                      result;
+    int                           code;
+
+    data   = malloc(length);
+    result = malloc(length);
+    if (!data || !result) {
+        free(data);
+        free(result);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < length; i++) {
+        data[i] = (uint8_t)((i * 13) + (i >> 8));
+    }
+    memset(result, 0, length);
+
+    code = test_utils_echo(client, &context, data, length);
+    if (code) {
+        goto exit;
+    }
+
+    code = gracht_client_wait_message(client, &context, GRACHT_MESSAGE_BLOCK);
+    if (code) {
+        goto exit;
+    }
+
+    test_utils_echo_result(client, &context, result, length);
+    printf("gracht_client: echo of %u bytes: %s\n", length, memcmp(data, result, length) ? "mismatch" : "ok");
+    if (memcmp(data, result, length)) {
+        errno = EINVAL;
+        code = -1;
+    }
+
+exit:
+    free(data);
+    free(result);
+    return code;
+}
+
+int main(void)
+{
+    gracht_client_t* client;
+    int              status;
+
+    status = init_client_with_socket_link(&client);
+    if (status) {
+        fprintf(stderr, "failed to create client: %s\n", strerror(errno));
+        return status;
+    }
+
+    gracht_client_register_protocol(client, &test_utils_client_protocol);
+
+    // small enough to be sent inline, so the request is fragmented as well as the response
+    status = __test_echo(client, 10000);
+    if (status) {
+        fprintf(stderr, "__test_echo (inline): FAILED [%s]\n", strerror(errno));
+        return status;
+    }
+
+    // the request is passed as bulk memory where supported, but the response is always fragmented
+    status = __test_echo(client, 300000);
+    if (status) {
+        fprintf(stderr, "__test_echo (bulk): FAILED [%s]\n", strerror(errno));
+        return status;
+    }
+
+    gracht_client_shutdown(client);
+    return status;
+}
@@ -0,0 +1,214 @@
+/**
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Gracht Loopback Link Test
+ * - Runs its own server on a seperate thread, and runs requests and events against it
+ *   over the loopback link. The external test server is not used.
+ */
+
+#include <errno.h>
+#include <gracht/client.h>
+#include <gracht/server.h>
+#include <gracht/link/loopback.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "test_utils_service_client.h"
+#include "test_utils_service_server.h"
+#include "thread_api.h"
+
+static const char*      g_loopbackName = "g_loopback";
+static gracht_server_t* g_server       = NULL;
+static thrd_t           g_serverThread;
+
+static volatile int g_eventsReceived = 0;
+static volatile int g_eventsOutOfOrder = 0;
+
+void test_utils_event_myevent_invocation(gracht_client_t* client, const int n)
+{
+    (void)client;
+    if (n != g_eventsReceived) {
+        g_eventsOutOfOrder++;
+    }
+    g_eventsReceived++;
+}
+
+void test_utils_event_transfer_status_invocation(gracht_client_t* client, const struct test_transfer_status* transfer_status)
+{
+    (void)client;
+    (void)transfer_status;
+}
+
+static int server_main(void* context)
+{
+    (void)context;
+    return gracht_server_main_loop(g_server);
+}
+
+static int __start_server(void)
+{
+    struct gracht_server_configuration configuration;
+    struct gracht_link_loopback*       link;
+    int                                status;
+
+    gracht_server_configuration_init(&configuration);
+    status = gracht_server_create(&configuration, &g_server);
+    if (status) {
+        return status;
+    }
+
+    gracht_link_loopback_create(&link);
+    gracht_link_loopback_set_name(link, g_loopbackName);
+    gracht_link_loopback_set_listen(link, 1);
+    status = gracht_server_add_link(g_server, (struct gracht_link*)link);
+    if (status) {
+        return status;
+    }
+
+    gracht_server_register_protocol(g_server, &test_utils_server_protocol);
+    if (thrd_create(&g_serverThread, server_main, NULL) != thrd_success) {
+        return -1;
+    }
+    return 0;
+}
+
+static int __create_client(gracht_client_t** clientOut)
+{
+    struct gracht_client_configuration configuration;
+    struct gracht_link_loopback*       link;
+    int                                status;
+
+    gracht_link_loopback_create(&link);
+    gracht_link_loopback_set_name(link, g_loopbackName);
+
+    gracht_client_configuration_init(&configuration);
+    gracht_client_configuration_set_link(&configuration, (struct gracht_link*)link);
+    status = gracht_client_create(&configuration, clientOut);
+    if (status) {
+        return status;
+    }
+
+    status = gracht_client_connect(*clientOut);
+    if (status) {
+        gracht_client_shutdown(*clientOut);
+    }
+    return status;
+}
+
+static int __test_print(gracht_client_t* client, const char* string)
+{
+    struct gracht_message_context context;
+    int code, status = -1337;
+
+    code = test_utils_print(client, &context, string);
+    if (code) {
+        return code;
+    }
+
+    gracht_client_wait_message(client, &context, GRACHT_MESSAGE_BLOCK);
+    test_utils_print_result(client, &context, &status);
+    if (status != strlen(string)) {
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+static int __test_receive_string(gracht_client_t* client, const char* expected)
+{
+    struct gracht_message_context context;
+    int code;
+    char buffer[128];
+
+    code = test_utils_receive_string(client, &context);
+    if (code) {
+        return code;
+    }
+
+    gracht_client_wait_message(client, &context, GRACHT_MESSAGE_BLOCK);
+    test_utils_receive_string_result(client, &context, &buffer[0], sizeof(buffer));
+    if (strcmp(buffer, expected)) {
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+static int __test_events(gracht_client_t* client, int count)
+{
+    g_eventsReceived   = 0;
+    g_eventsOutOfOrder = 0;
+    test_utils_get_event(client, NULL, count);
+
+    while (g_eventsReceived != count) {
+        if (gracht_client_wait_message(client, NULL, GRACHT_MESSAGE_BLOCK)) {
+            return -1;
+        }
+    }
+    return g_eventsOutOfOrder != 0;
+}
+
+int main(void)
+{
+    gracht_client_t* client;
+    int              status;
+    int              exitCode;
+    char*            text = "hello over loopback!";
+
+    status = __start_server();
+    if (status) {
+        fprintf(stderr, "failed to start server: %s\n", strerror(errno));
+        return status;
+    }
+
+    status = __create_client(&client);
+    if (status) {
+        fprintf(stderr, "failed to create client: %s\n", strerror(errno));
+        return status;
+    }
+
+    gracht_client_register_protocol(client, &test_utils_client_protocol);
+
+    status = __test_print(client, text);
+    if (status) {
+        fprintf(stderr, "__test_print: FAILED [%s]\n", strerror(errno));
+        return status;
+    }
+
+    status = __test_receive_string(client, text);
+    if (status) {
+        fprintf(stderr, "__test_receive_string: FAILED [%s]\n", strerror(errno));
+        return status;
+    }
+
+    status = __test_events(client, 5000);
+    printf("gracht_client: loopback link recieved event count %i, out of order %i\n",
+        g_eventsReceived, g_eventsOutOfOrder);
+    if (status) {
+        fprintf(stderr, "__test_events: FAILED\n");
+        return status;
+    }
+
+    // the request is dropped along with the connection if the client is gone before the server
+    // has read it. Requests are handled in order, so wait for the one sent after it to complete,
+    // which it also does when the server has shut down before responding
+    test_utils_shutdown(client, NULL);
+    (void)__test_print(client, text);
+    gracht_client_shutdown(client);
+    thrd_join(g_serverThread, &exitCode);
+    return exitCode;
+}
@@ -0,0 +1,147 @@
+/**
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Gracht Shared Memory Link Test
+ * - Runs requests and events over the shared memory link, the server uses the smallest
+ *   rings so the larger event bursts fill them up.
+ */
+
+#include <errno.h>
+#include <gracht/client.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "test_utils_service_client.h"
+
+extern int init_client_with_shm_link(gracht_client_t** clientOut);
+
+static volatile int g_eventsReceived = 0;
+static volatile int g_eventsOutOfOrder = 0;
+
+void test_utils_event_myevent_invocation(gracht_client_t* client, const int n)
+{
+    (void)client;
+    if (n != g_eventsReceived) {
+        g_eventsOutOfOrder++;
+    }
+    g_eventsReceived++;
+}
+
+void test_utils_event_transfer_status_invocation(gracht_client_t* client, const struct test_transfer_status* transfer_status)
+{
+    (void)client;
+    (void)transfer_status;
+}
+
+static int __test_print(gracht_client_t* client, const char* string)
+{
+    struct gracht_message_context context;
+    int code, status = -1337;
+
+    code = test_utils_print(client, &context, string);
+    if (code) {
+        return code;
+    }
+
+    gracht_client_wait_message(client, &context, GRACHT_MESSAGE_BLOCK);
+    test_utils_print_result(client, &context, &status);
+    if (status != strlen(string)) {
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+static int __test_receive_string(gracht_client_t* client, const char* expected)
+{
+    struct gracht_message_context context;
+    int code;
+    char buffer[128];
+
+    code = test_utils_receive_string(client, &context);
+    if (code) {
+        return code;
+    }
+
+    gracht_client_wait_message(client, &context, GRACHT_MESSAGE_BLOCK);
+    test_utils_receive_string_result(client, &context, &buffer[0], sizeof(buffer));
+    if (strcmp(buffer, expected)) {
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+static int __test_events(gracht_client_t* client, int count, int delay)
+{
+    g_eventsReceived   = 0;
+    g_eventsOutOfOrder = 0;
+    test_utils_get_event(client, NULL, count);
+
+    // when delayed the server must wait for room in the ring
+    if (delay) {
+        usleep(500000);
+    }
+
+    while (g_eventsReceived != count) {
+        if (gracht_client_wait_message(client, NULL, GRACHT_MESSAGE_BLOCK)) {
+            return -1;
+        }
+    }
+    return g_eventsOutOfOrder != 0;
+}
+
+int main(void)
+{
+    gracht_client_t* client;
+    int              status;
+    char*            text = "hello over shared memory!";
+
+    status = init_client_with_shm_link(&client);
+    if (status) {
+        fprintf(stderr, "failed to create client: %s\n", strerror(errno));
+        return status;
+    }
+
+    gracht_client_register_protocol(client, &test_utils_client_protocol);
+
+    status = __test_print(client, text);
+    if (status) {
+        fprintf(stderr, "__test_print: FAILED [%s]\n", strerror(errno));
+        return status;
+    }
+
+    status = __test_receive_string(client, text);
+    if (status) {
+        fprintf(stderr, "__test_receive_string: FAILED [%s]\n", strerror(errno));
+        return status;
+    }
+
+    status = __test_events(client, 50, 0);
+    if (status) {
+        fprintf(stderr, "__test_events: FAILED [%s]\n", strerror(errno));
+        return status;
+    }
+
+    status = __test_events(client, 5000, 1);
+    printf("gracht_client: shm link recieved event count %i, out of order %i\n",
+        g_eventsReceived, g_eventsOutOfOrder);
+
+    gracht_client_shutdown(client);
+    return status;
+}
@@ -0,0 +1,145 @@
+/**
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Gracht Testing Suite
+ * - Implementation of various test programs that verify behaviour of libgracht
+ */
+
+#include <errno.h>
+#include <gracht/link/socket.h>
+#include <gracht/client.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "test_utils_service_client.h"
+
+extern int init_client_with_socket_link(gracht_client_t** clientOut);
+
+void test_utils_event_myevent_invocation(gracht_client_t* client, const int n)
+{
+    (void)client;
+    (void)n;
+}
+
+void test_utils_event_transfer_status_invocation(gracht_client_t* client, const struct test_transfer_status* transfer_status)
+{
+    (void)client;
+    (void)transfer_status;
+}
+
+#if defined(__linux__)
+#include <sys/un.h>
+#include <unistd.h>
+
+static const char* clientsPath = "/tmp/g_clients";
+
+// Connects to the server without the client library, and sends the header and the first part
+// of a message, but never the rest of it.
+static int __start_slow_sender(void)
+{
+    struct sockaddr_un addr = { 0 };
+    uint8_t            message[GRACHT_MESSAGE_HEADER_SIZE + 16] = { 0 };
+    uint32_t           length = 128;
+    int                sock;
+
+    sock = socket(AF_LOCAL, SOCK_STREAM, 0);
+    if (sock < 0) {
+        return -1;
+    }
+
+    addr.sun_family = AF_LOCAL;
+    strncpy(addr.sun_path, clientsPath, sizeof(addr.sun_path) - 1);
+    if (connect(sock, (const struct sockaddr*)&addr, sizeof(struct sockaddr_un))) {
+        close(sock);
+        return -1;
+    }
+
+    memcpy(&message[4], &length, sizeof(uint32_t));
+    if (send(sock, &message[0], sizeof(message), 0) != (ssize_t)sizeof(message)) {
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+static void __stop_slow_sender(int sock)
+{
+    close(sock);
+}
+#else
+static int __start_slow_sender(void)
+{
+    return 0;
+}
+
+static void __stop_slow_sender(int sock)
+{
+    (void)sock;
+}
+#endif
+
+static int __test_print(gracht_client_t* client, const char* string)
+{
+    struct gracht_message_context context;
+    int code, status = -1337;
+
+    code = test_utils_print(client, &context, string);
+    if (code) {
+        return code;
+    }
+
+    gracht_client_wait_message(client, &context, GRACHT_MESSAGE_BLOCK);
+    test_utils_print_result(client, &context, &status);
+    if (status != strlen(string)) {
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+int main(void)
+{
+    gracht_client_t* client;
+    int              sock;
+    int              status;
+
+    // the incomplete message must not keep the server from serving other clients
+    sock = __start_slow_sender();
+    if (sock < 0) {
+        fprintf(stderr, "failed to start slow sender: %s\n", strerror(errno));
+        return -1;
+    }
+
+    status = init_client_with_socket_link(&client);
+    if (status) {
+        fprintf(stderr, "failed to create client: %s\n", strerror(status));
+        __stop_slow_sender(sock);
+        return status;
+    }
+
+    gracht_client_register_protocol(client, &test_utils_client_protocol);
+
+    status = __test_print(client, "message while another client is sending slowly");
+    if (status) {
+        fprintf(stderr, "__test_print: FAILED [%s]\n", strerror(errno));
+    }
+
+    gracht_client_shutdown(client);
+    __stop_slow_sender(sock);
+    return status;
+}
@@ -0,0 +1,125 @@
+/**
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Gracht Streamed Response Test
+ * - Calls a function that responds with a stream of chunks, and verifies that all of
+ *   them arrive in order before the call completes.
+ */
+
+#include <errno.h>
+#include <gracht/client.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "test_utils_service_client.h"
+
+extern int init_client_with_socket_link(gracht_client_t** clientOut);
+
+static struct gracht_message_context g_context;
+static volatile int                  g_statusesReceived = 0;
+static volatile int                  g_statusesInvalid  = 0;
+static volatile int                  g_chunksReceived   = 0;
+
+void test_utils_event_myevent_invocation(gracht_client_t* client, const int n)
+{
+    (void)client;
+    (void)n;
+}
+
+void test_utils_event_transfer_status_invocation(gracht_client_t* client, const struct test_transfer_status* transfer_status)
+{
+    (void)client;
+    (void)transfer_status;
+}
+
+void test_utils_transfer_stream_chunk_invocation(gracht_client_t* client, struct gracht_message_context* context,
+    const struct test_transfer_status* results, const uint32_t results_count)
+{
+    (void)client;
+
+    if (context->message_id != g_context.message_id) {
+        g_statusesInvalid++;
+        return;
+    }
+
+    for (uint32_t i = 0; i < results_count; i++) {
+        if (results[i].test_id != (uint32_t)g_statusesReceived || results[i].code != 13) {
+            g_statusesInvalid++;
+        }
+        g_statusesReceived++;
+    }
+    g_chunksReceived++;
+}
+
+static int __test_stream(gracht_client_t* client, int count)
+{
+    int code;
+
+    g_statusesReceived = 0;
+    g_statusesInvalid  = 0;
+    g_chunksReceived   = 0;
+
+    code = test_utils_transfer_stream(client, &g_context, count);
+    if (code) {
+        return code;
+    }
+
+    // the chunks are delivered while waiting for the end of the stream
+    code = gracht_client_wait_message(client, &g_context, GRACHT_MESSAGE_BLOCK);
+    if (code) {
+        return code;
+    }
+
+    code = test_utils_transfer_stream_result(client, &g_context);
+    printf("gracht_client: stream of %i statuses, recieved %i in %i chunks, invalid %i\n",
+        count, g_statusesReceived, g_chunksReceived, g_statusesInvalid);
+    if (code || g_statusesReceived != count || g_statusesInvalid) {
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+int main(void)
+{
+    gracht_client_t* client;
+    int              status;
+
+    status = init_client_with_socket_link(&client);
+    if (status) {
+        fprintf(stderr, "failed to create client: %s\n", strerror(errno));
+        return status;
+    }
+
+    gracht_client_register_protocol(client, &test_utils_client_protocol);
+
+    status = __test_stream(client, 5000);
+    if (status) {
+        fprintf(stderr, "__test_stream: FAILED [%s]\n", strerror(errno));
+        return status;
+    }
+
+    // a stream without any chunks is completed right away
+    status = __test_stream(client, 0);
+    if (status) {
+        fprintf(stderr, "__test_stream (empty): FAILED [%s]\n", strerror(errno));
+        return status;
+    }
+
+    gracht_client_shutdown(client);
+    return status;
+}
@@ -94,6 +94,35 @@ static int __test_empty_strings(gracht_client_t* client)
     return 0;
 }
 
+// the fused calls send, wait and decode in one go
+static int __test_call_sync(gracht_client_t* client, const char* string)
+{
+    int  status = -1337;
+    char buffer[128];
+    int  code;
+
+    code = test_utils_print_call_sync(client, string, &status);
+    if (code) {
+        return code;
+    }
+
+    if (status != strlen(string)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    code = test_utils_receive_string_call_sync(client, &buffer[0], sizeof(buffer));
+    if (code) {
+        return code;
+    }
+
+    if (strcmp(buffer, string)) {
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
 int main(int argc, char **argv)
 {
     gracht_client_t* client;
@@ -132,6 +161,12 @@ int main(int argc, char **argv)
         return status;
     }
 
+    status = __test_call_sync(client, text);
+    if (status) {
+        fprintf(stderr, "__test_call_sync: FAILED [%s]\n", strerror(status));
+        return status;
+    }
+
     gracht_client_shutdown(client);
     return status;
 }
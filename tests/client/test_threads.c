@@ -0,0 +1,107 @@
+/**
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Gracht Multi-threaded Client Test
+ * - Invokes calls through the same client from several threads at once, and verifies
+ *   that each thread gets the responses to its own calls.
+ */
+
+#include <errno.h>
+#include <gracht/client.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "test_utils_service_client.h"
+#include "thread_api.h"
+
+#define THREAD_COUNT 4
+#define CALL_COUNT   250
+
+extern int init_client_with_socket_link(gracht_client_t** clientOut);
+
+static gracht_client_t* g_client;
+static volatile int     g_invalid[THREAD_COUNT];
+
+void test_utils_event_myevent_invocation(gracht_client_t* client, const int n)
+{
+    (void)client;
+    (void)n;
+}
+
+void test_utils_event_transfer_status_invocation(gracht_client_t* client, const struct test_transfer_status* transfer_status)
+{
+    (void)client;
+    (void)transfer_status;
+}
+
+static int __test_thread(void* context)
+{
+    int     index = (int)(intptr_t)context;
+    uint8_t data[64];
+
+    for (int i = 0; i < CALL_COUNT; i++) {
+        struct gracht_message_context messageContext;
+        uint32_t                      expected = 0;
+        uint32_t                      result   = 0;
+
+        // the data is unique to the thread and the call, so mixed up responses are detected
+        for (int j = 0; j < (int)sizeof(data); j++) {
+            data[j]  = (uint8_t)((index * 31) + (i * 7) + j);
+            expected = (expected * 31) + data[j];
+        }
+
+        if (test_utils_checksum(g_client, &messageContext, &data[0], sizeof(data)) ||
+            gracht_client_wait_message(g_client, &messageContext, GRACHT_MESSAGE_BLOCK) ||
+            test_utils_checksum_result(g_client, &messageContext, &result) ||
+            result != expected) {
+            g_invalid[index]++;
+        }
+    }
+    return 0;
+}
+
+int main(void)
+{
+    thrd_t threads[THREAD_COUNT];
+    int    invalid = 0;
+    int    status;
+
+    status = init_client_with_socket_link(&g_client);
+    if (status) {
+        fprintf(stderr, "failed to create client: %s\n", strerror(errno));
+        return status;
+    }
+
+    gracht_client_register_protocol(g_client, &test_utils_client_protocol);
+
+    for (int i = 0; i < THREAD_COUNT; i++) {
+        thrd_create(&threads[i], __test_thread, (void*)(intptr_t)i);
+    }
+    for (int i = 0; i < THREAD_COUNT; i++) {
+        thrd_join(threads[i], NULL);
+        invalid += g_invalid[i];
+    }
+
+    printf("gracht_client: %i threads made %i calls each, invalid %i\n", THREAD_COUNT, CALL_COUNT, invalid);
+    if (invalid) {
+        fprintf(stderr, "__test_thread: FAILED\n");
+        status = -1;
+    }
+
+    gracht_client_shutdown(g_client);
+    return status;
+}
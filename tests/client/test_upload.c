@@ -0,0 +1,263 @@
+/**
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Gracht Streamed Request Test
+ * - Uploads transactions to a function with streamed parameters in chunks, and verifies that
+ *   the server received all of them in order. Uploads also run from two threads at once, so
+ *   the chunks of different calls are received in between each other.
+ */
+
+#include <errno.h>
+#include <gracht/client.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test_utils_service_client.h"
+#include "thread_api.h"
+
+#define THREAD_COUNT 2
+
+extern int init_client_with_socket_link(gracht_client_t** clientOut);
+
+void test_utils_event_myevent_invocation(gracht_client_t* client, const int n)
+{
+    (void)client;
+    (void)n;
+}
+
+void test_utils_event_transfer_status_invocation(gracht_client_t* client, const struct test_transfer_status* transfer_status)
+{
+    (void)client;
+    (void)transfer_status;
+}
+
+static int __test_upload(gracht_client_t* client, int count)
+{
+    struct gracht_message_context context;
+    struct test_transaction       transactions[100];
+    uint8_t                       data[100];
+    struct test_transfer_status   status = { 0 };
+    int                           i = 0;
+    int                           code;
+
+    code = test_utils_transfer_upload(client, &context);
+    if (code) {
+        return code;
+    }
+
+    // the transactions are sent as they are produced, a hundred at a time
+    while (i < count) {
+        uint32_t transactionCount = 0;
+        while (transactionCount < 100 && i < count) {
+            data[transactionCount] = (uint8_t)i;
+            transactions[transactionCount].test_id    = (uint32_t)i++;
+            transactions[transactionCount].serial     = (char*)"upload";
+            transactions[transactionCount].data       = &data[transactionCount];
+            transactions[transactionCount].data_count = 1;
+            transactionCount++;
+        }
+
+        code = test_utils_transfer_upload_chunk(client, &context, &transactions[0], transactionCount);
+        if (code) {
+            return code;
+        }
+    }
+
+    code = test_utils_transfer_upload_end(client, &context);
+    if (code) {
+        return code;
+    }
+
+    code = gracht_client_wait_message(client, &context, GRACHT_MESSAGE_BLOCK);
+    if (code) {
+        return code;
+    }
+
+    code = test_utils_transfer_upload_result(client, &context, &status);
+    printf("gracht_client: upload of %i transactions, server recieved %u, invalid %i\n",
+        count, status.test_id, status.code);
+    if (code || status.test_id != (uint32_t)count || status.code) {
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+static gracht_client_t* g_client;
+static volatile int     g_errors[THREAD_COUNT];
+
+static int __test_upload_thread(void* context)
+{
+    int index = (int)(intptr_t)context;
+
+    // keep the errno of the thread, it is lost otherwise
+    if (__test_upload(g_client, 5000)) {
+        g_errors[index] = errno ? errno : EINVAL;
+    }
+    return 0;
+}
+
+static int __test_concurrent(gracht_client_t* client)
+{
+    thrd_t threads[THREAD_COUNT];
+    int    status = 0;
+
+    g_client = client;
+    for (int i = 0; i < THREAD_COUNT; i++) {
+        thrd_create(&threads[i], __test_upload_thread, (void*)(intptr_t)i);
+    }
+    for (int i = 0; i < THREAD_COUNT; i++) {
+        thrd_join(threads[i], NULL);
+        if (g_errors[i]) {
+            status = g_errors[i];
+        }
+    }
+
+    if (status) {
+        errno = status;
+        return -1;
+    }
+    return 0;
+}
+
+// a chunk that is larger than the maximum transfer size is not sent, the call stays open
+static int __test_oversized(gracht_client_t* client)
+{
+    struct gracht_message_context context;
+    struct test_transaction*      transactions;
+    struct test_transfer_status   status = { 0 };
+    uint8_t                       data[64] = { 0 };
+    uint32_t                      count = 32 * 1024;
+    int                           code;
+
+    transactions = malloc(sizeof(struct test_transaction) * count);
+    if (!transactions) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        transactions[i].test_id    = i;
+        transactions[i].serial     = (char*)"oversized";
+        transactions[i].data       = &data[0];
+        transactions[i].data_count = sizeof(data);
+    }
+
+    code = test_utils_transfer_upload(client, &context);
+    if (code) {
+        free(transactions);
+        return code;
+    }
+
+    code = test_utils_transfer_upload_chunk(client, &context, transactions, count);
+    free(transactions);
+    if (!code || errno != EMSGSIZE) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    code = test_utils_transfer_upload_end(client, &context);
+    if (code) {
+        return code;
+    }
+
+    code = gracht_client_wait_message(client, &context, GRACHT_MESSAGE_BLOCK);
+    if (code) {
+        return code;
+    }
+
+    code = test_utils_transfer_upload_result(client, &context, &status);
+    if (code || status.test_id != 0 || status.code) {
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+// an abandoned call gives its slot back, and nothing can be sent with it afterwards
+static int __test_abort(gracht_client_t* client)
+{
+    struct gracht_message_context context;
+    int                           code;
+
+    code = test_utils_transfer_upload(client, &context);
+    if (code) {
+        return code;
+    }
+
+    code = gracht_client_abort_stream(client, &context);
+    if (code) {
+        return code;
+    }
+
+    if (!gracht_client_abort_stream(client, &context) || errno != ENOENT ||
+        !test_utils_transfer_upload_end(client, &context) || errno != ENOENT) {
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+int main(void)
+{
+    gracht_client_t* client;
+    int              status;
+
+    status = init_client_with_socket_link(&client);
+    if (status) {
+        fprintf(stderr, "failed to create client: %s\n", strerror(errno));
+        return status;
+    }
+
+    gracht_client_register_protocol(client, &test_utils_client_protocol);
+
+    status = __test_upload(client, 5000);
+    if (status) {
+        fprintf(stderr, "__test_upload: FAILED [%s]\n", strerror(errno));
+        return status;
+    }
+
+    // a call without any chunks is completed by the end of it
+    status = __test_upload(client, 0);
+    if (status) {
+        fprintf(stderr, "__test_upload (empty): FAILED [%s]\n", strerror(errno));
+        return status;
+    }
+
+    status = __test_concurrent(client);
+    if (status) {
+        fprintf(stderr, "__test_concurrent: FAILED [%s]\n", strerror(errno));
+        return status;
+    }
+
+    status = __test_oversized(client);
+    if (status) {
+        fprintf(stderr, "__test_oversized: FAILED [%s]\n", strerror(errno));
+        return status;
+    }
+
+    status = __test_abort(client);
+    if (status) {
+        fprintf(stderr, "__test_abort: FAILED [%s]\n", strerror(errno));
+        return status;
+    }
+
+    gracht_client_shutdown(client);
+    return status;
+}
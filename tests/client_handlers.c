@@ -0,0 +1,31 @@
+/**
+ * Copyright 2021, Philip Meulengracht
+ *
+ * This program is free software : you can redistribute it and / or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation ? , either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Gracht Testing Suite
+ * - Default client handlers shared by the client tests that do not exercise them
+ */
+
+#include "test_utils_service_client.h"
+
+void test_utils_transfer_stream_chunk_invocation(gracht_client_t* client, struct gracht_message_context* context,
+    const struct test_transfer_status* results, const uint32_t results_count)
+{
+    (void)client;
+    (void)context;
+    (void)results;
+    (void)results_count;
+}
@@ -22,6 +22,9 @@
 
 #include <gracht/link/socket.h>
 #include <gracht/client.h>
+#if defined(GRACHT_C_LINK_SHM)
+#include <gracht/link/shm.h>
+#endif
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
@@ -31,6 +34,7 @@
 
 //static const char* dgramPath = "/tmp/g_dgram";
 static const char* clientsPath = "/tmp/g_clients";
+static const char* shmPath = "/tmp/g_shm";
 
 static void init_socket_config(struct gracht_link_socket* link)
 {
@@ -94,3 +98,34 @@ int init_client_with_socket_link(gracht_client_t** clientOut)
     *clientOut = client;
     return code;
 }
+
+#if defined(GRACHT_C_LINK_SHM)
+int init_client_with_shm_link(gracht_client_t** clientOut)
+{
+    struct gracht_link_shm*            link;
+    struct gracht_client_configuration clientConfiguration;
+    gracht_client_t*                   client = NULL;
+    int                                code;
+
+    gracht_client_configuration_init(&clientConfiguration);
+
+    gracht_link_shm_create(&link);
+    gracht_link_shm_set_path(link, shmPath);
+
+    gracht_client_configuration_set_link(&clientConfiguration, (struct gracht_link*)link);
+
+    code = gracht_client_create(&clientConfiguration, &client);
+    if (code) {
+        printf("init_client_with_shm_link: error initializing client library %i, %i\n", errno, code);
+        return code;
+    }
+
+    code = gracht_client_connect(client);
+    if (code) {
+        printf("init_client_with_shm_link: failed to connect client %i, %i\n", errno, code);
+    }
+
+    *clientOut = client;
+    return code;
+}
+#endif
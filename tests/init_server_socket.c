@@ -22,6 +22,9 @@
 
 #include <gracht/link/socket.h>
 #include <gracht/server.h>
+#if defined(GRACHT_C_LINK_SHM)
+#include <gracht/link/shm.h>
+#endif
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
@@ -31,6 +34,7 @@
 
 static const char* dgramPath = "/tmp/g_dgram";
 static const char* clientsPath = "/tmp/g_clients";
+static const char* shmPath = "/tmp/g_shm";
 
 static void init_packet_link_config(struct gracht_link_socket* link)
 {
@@ -64,6 +68,27 @@ static void init_client_link_config(struct gracht_link_socket* link)
     gracht_link_socket_set_domain(link, AF_LOCAL);
 }
 
+#if defined(GRACHT_C_LINK_SHM)
+static void register_shm_link(gracht_server_t* server)
+{
+    struct gracht_link_shm* link;
+    int                     code;
+
+    unlink(shmPath);
+    gracht_link_shm_create(&link);
+    gracht_link_shm_set_path(link, shmPath);
+    gracht_link_shm_set_listen(link, 1);
+
+    // use the smallest rings so the tests also cover full rings
+    gracht_link_shm_set_ring_size(link, 0);
+
+    code = gracht_server_add_link(server, (struct gracht_link*)link);
+    if (code) {
+        printf("register_shm_link failed to add link: %i (%i)\n", code, errno);
+    }
+}
+#endif
+
 #elif defined(_WIN32)
 #include <windows.h>
 
@@ -117,6 +142,10 @@ void register_server_links(gracht_server_t* server)
     if (code) {
         printf("register_server_links failed to add link: %i (%i)\n", code, errno);
     }
+
+#if defined(__linux__) && defined(GRACHT_C_LINK_SHM)
+    register_shm_link(server);
+#endif
 }
 
 int init_server_with_socket_link(gracht_server_t** serverOut)
@@ -166,3 +195,29 @@ int init_mt_server_with_socket_link(int workerCount, gracht_server_t** serverOut
     register_server_links(*serverOut);
     return 0;
 }
+
+int init_mr_server_with_socket_link(int workerCount, int reactorCount, gracht_server_t** serverOut)
+{
+    struct gracht_server_configuration serverConfiguration;
+    int                                code;
+    
+#ifdef _WIN32
+    // initialize the WSA library
+    gracht_link_socket_setup();
+#endif
+
+    gracht_server_configuration_init(&serverConfiguration);
+
+    // setup the number of workers and reactors
+    gracht_server_configuration_set_num_workers(&serverConfiguration, workerCount);
+    gracht_server_configuration_set_num_reactors(&serverConfiguration, reactorCount);
+    code = gracht_server_create(&serverConfiguration, serverOut);
+    if (code) {
+        printf("init_mr_server_with_socket_link: error initializing server library %i\n", errno);
+        return code;
+    }
+
+    // register links
+    register_server_links(*serverOut);
+    return 0;
+}
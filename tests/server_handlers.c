@@ -28,6 +28,7 @@
 #include <test_utils_service_server.h>
 
 // reuse the private api
+#include <gatomic.h>
 #include <thread_api.h>
 
 static char* g_message = "hello from test server!";
@@ -94,11 +95,135 @@ void test_utils_transfer_many_invocation(struct gracht_message* message, const s
     free(statuses);
 }
 
+void test_utils_transfer_stream_invocation(struct gracht_message* message, const int count)
+{
+    struct test_transfer_status statuses[100];
+    int                         i = 0;
+
+    // the statuses are sent as they are produced, a hundred at a time
+    while (i < count) {
+        uint32_t statusCount = 0;
+        while (statusCount < 100 && i < count) {
+            statuses[statusCount].test_id = (uint32_t)i++;
+            statuses[statusCount].code    = 13;
+            statusCount++;
+        }
+
+        if (test_utils_transfer_stream_response_chunk(message, &statuses[0], statusCount)) {
+            break;
+        }
+    }
+    test_utils_transfer_stream_response_end(message);
+}
+
+// the uploads in progress, a client may upload on several calls at once, so they are kept
+// per call. The chunks of a call are handled one at a time, but other calls run alongside them
+#define UPLOAD_COUNT 16
+
+struct upload {
+    int           used;
+    gracht_conn_t client;
+    uint32_t      id;
+    uint32_t      received;
+    uint32_t      invalid;
+};
+
+static struct upload g_uploads[UPLOAD_COUNT] = { { 0 } };
+static atomic_int    g_uploadsLock = 0;
+
+static void uploads_lock(void)
+{
+    int expected = 0;
+    while (!atomic_compare_exchange_strong(&g_uploadsLock, &expected, 1)) {
+        expected = 0;
+        thrd_yield();
+    }
+}
+
+static void uploads_unlock(void)
+{
+    atomic_store(&g_uploadsLock, 0);
+}
+
+// must be called with the lock held
+static struct upload* upload_get(struct gracht_message* message, int create)
+{
+    struct upload* unused = NULL;
+    uint32_t       id     = gracht_server_message_id(message);
+
+    for (int i = 0; i < UPLOAD_COUNT; i++) {
+        if (g_uploads[i].used && g_uploads[i].client == message->client && g_uploads[i].id == id) {
+            return &g_uploads[i];
+        }
+        if (!unused && !g_uploads[i].used) {
+            unused = &g_uploads[i];
+        }
+    }
+
+    if (create && unused) {
+        unused->used     = 1;
+        unused->client   = message->client;
+        unused->id       = id;
+        unused->received = 0;
+        unused->invalid  = 0;
+    }
+    return create ? unused : NULL;
+}
+
+void test_utils_transfer_upload_chunk_invocation(struct gracht_message* message, const struct test_transaction* transactions, const uint32_t transactions_count)
+{
+    struct upload* upload;
+
+    uploads_lock();
+    upload = upload_get(message, 1);
+    if (upload) {
+        // the transactions are numbered in the order they are sent
+        for (uint32_t i = 0; i < transactions_count; i++) {
+            if (transactions[i].test_id != upload->received || transactions[i].data_count != 1 ||
+                transactions[i].data[0] != (uint8_t)transactions[i].test_id) {
+                upload->invalid++;
+            }
+            upload->received++;
+        }
+    }
+    uploads_unlock();
+}
+
+void test_utils_transfer_upload_invocation(struct gracht_message* message)
+{
+    struct test_transfer_status status = { 0 };
+    struct upload*              upload;
+
+    uploads_lock();
+    upload = upload_get(message, 0);
+    if (upload) {
+        status.test_id = upload->received;
+        status.code    = (int)upload->invalid;
+        upload->used = 0;
+    }
+    uploads_unlock();
+    test_utils_transfer_upload_response(message, &status);
+}
+
 void test_utils_transfer_data_invocation(struct gracht_message* message, const uint8_t* data, const uint32_t data_count)
 {
     
 }
 
+void test_utils_checksum_invocation(struct gracht_message* message, const uint8_t* data, const uint32_t data_count)
+{
+    uint32_t result = 0;
+    for (uint32_t i = 0; i < data_count; i++) {
+        result = (result * 31) + data[i];
+    }
+    test_utils_checksum_response(message, result);
+}
+
+void test_utils_echo_invocation(struct gracht_message* message, const uint8_t* data, const uint32_t data_count)
+{
+    test_utils_echo_response(message, (uint8_t*)data, data_count);
+}
+
 void test_utils_receive_data_invocation(struct gracht_message* message)
 {
     char tmp[16] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 };
@@ -117,6 +242,13 @@ void test_utils_get_event_invocation(struct gracht_message* message, const int c
     }
 }
 
+void test_utils_get_broadcast_invocation(struct gracht_message* message, const int count)
+{
+    for (int i = 0; i < count; i++) {
+        test_utils_event_myevent_all(message->server, i);
+    }
+}
+
 void test_utils_shutdown_invocation(struct gracht_message* message)
 {
     printf("shutdown requested\n");